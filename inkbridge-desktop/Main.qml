@@ -593,6 +593,52 @@ ApplicationWindow {
                             Behavior on color { ColorAnimation { duration: animDuration } }
                         }
 
+                        // Only shown with more than one tablet connected. "All tablets"
+                        // edits the defaults and every session at once.
+                        ComboBox {
+                            id: sessionCombo
+                            Layout.fillWidth: true
+                            Layout.preferredHeight: 42
+                            visible: backend.sessions.length > 1
+
+                            model: {
+                                var labels = ["All tablets"];
+                                for (var i = 0; i < backend.sessions.length; i++)
+                                    labels.push(backend.sessions[i].label);
+                                return labels;
+                            }
+
+                            currentIndex: {
+                                for (var i = 0; i < backend.sessions.length; i++) {
+                                    if (backend.sessions[i].id === backend.selectedSession)
+                                        return i + 1;
+                                }
+                                return 0;
+                            }
+
+                            onActivated: backend.selectSession(index === 0 ? -1 : backend.sessions[index - 1].id)
+
+                            background: Rectangle {
+                                color: isDark ? "#252525" : "#f5f5f5"
+                                radius: 8
+                                border.color: parent.activeFocus ? accentCol : borderCol
+                                border.width: parent.activeFocus ? 2 : 1
+
+                                Behavior on color { ColorAnimation { duration: animDuration } }
+                                Behavior on border.color { ColorAnimation { duration: animDuration } }
+                            }
+
+                            contentItem: Text {
+                                leftPadding: 14
+                                rightPadding: 14
+                                text: parent.displayText
+                                font.pixelSize: 14
+                                color: textCol
+                                verticalAlignment: Text.AlignVCenter
+                                elide: Text.ElideRight
+                            }
+                        }
+
                         Rectangle {
                             Layout.fillWidth: true
                             height: 280
@@ -615,7 +661,7 @@ ApplicationWindow {
                                     Layout.fillHeight: true
                                     
                                     property var geometries: backend.screenGeometries
-                                    property int selectedIndex: 0
+                                    property int selectedIndex: backend.selectedScreen
 
                                     property real minX: 0
                                     property real minY: 0
@@ -685,7 +731,6 @@ ApplicationWindow {
                                                 hoverEnabled: true
                                                 cursorShape: Qt.PointingHandCursor
                                                 onClicked: {
-                                                    screenCanvas.selectedIndex = index;
                                                     backend.selectScreen(index)
                                                 }
                                             }
@@ -958,6 +1003,220 @@ ApplicationWindow {
                                     }
                                 }
 
+                                // Barrel button: a BTN_STYLUS/BTN_STYLUS2 key by default, or
+                                // the old behaviour of switching to the eraser while held.
+                                RowLayout {
+                                    Layout.fillWidth: true
+                                    spacing: 12
+                                    Label {
+                                        text: "Side Button"
+                                        color: textCol
+                                        font.pixelSize: 14
+                                        font.weight: Font.Medium
+                                        Behavior on color { ColorAnimation { duration: animDuration } }
+                                    }
+                                    Item { Layout.fillWidth: true }
+                                    ComboBox {
+                                        Layout.preferredWidth: 180
+                                        Layout.preferredHeight: 36
+                                        model: ["Stylus button", "Stylus button 2", "Eraser"]
+                                        currentIndex: backend.buttonMapping
+                                        onActivated: backend.setButtonMapping(index)
+
+                                        background: Rectangle {
+                                            color: isDark ? "#252525" : "#f5f5f5"
+                                            radius: 8
+                                            border.color: parent.activeFocus ? accentCol : borderCol
+                                            border.width: parent.activeFocus ? 2 : 1
+
+                                            Behavior on color { ColorAnimation { duration: animDuration } }
+                                            Behavior on border.color { ColorAnimation { duration: animDuration } }
+                                        }
+
+                                        contentItem: Text {
+                                            leftPadding: 14
+                                            rightPadding: 14
+                                            text: parent.displayText
+                                            font.pixelSize: 14
+                                            color: textCol
+                                            verticalAlignment: Text.AlignVCenter
+                                            elide: Text.ElideRight
+                                        }
+                                    }
+                                }
+
+                                // Contact decided on the desktop with hysteresis, so strokes
+                                // near the minimum pressure are not broken up.
+                                RowLayout {
+                                    Layout.fillWidth: true
+                                    spacing: 12
+                                    Label {
+                                        text: "Touch Debounce"
+                                        color: textCol
+                                        font.pixelSize: 14
+                                        font.weight: Font.Medium
+                                        Behavior on color { ColorAnimation { duration: animDuration } }
+                                    }
+                                    CheckBox {
+                                        checked: backend.touchDebounce
+                                        onToggled: backend.setTouchDebounce(checked)
+                                        
+                                        indicator: Rectangle {
+                                            implicitWidth: 22
+                                            implicitHeight: 22
+                                            x: parent.leftPadding
+                                            y: parent.height / 2 - height / 2
+                                            radius: 5
+                                            border.color: parent.checked ? accentCol : borderCol
+                                            border.width: 2
+                                            color: parent.checked ? accentCol : "transparent"
+                                            
+                                            Behavior on color { ColorAnimation { duration: animDuration } }
+                                            Behavior on border.color { ColorAnimation { duration: animDuration } }
+                                            
+                                            Text {
+                                                anchors.centerIn: parent
+                                                text: "✓"
+                                                color: "white"
+                                                font.pixelSize: 14
+                                                font.bold: true
+                                                opacity: parent.parent.checked ? 1 : 0
+                                                
+                                                Behavior on opacity { NumberAnimation { duration: 150 } }
+                                            }
+                                        }
+                                    }
+                                }
+
+                                // Watches the stylus device for SYN_DROPPED and paces hover
+                                // output while the seat is overloaded.
+                                RowLayout {
+                                    Layout.fillWidth: true
+                                    spacing: 12
+                                    Label {
+                                        text: "Seat Protection"
+                                        color: textCol
+                                        font.pixelSize: 14
+                                        font.weight: Font.Medium
+                                        Behavior on color { ColorAnimation { duration: animDuration } }
+                                    }
+                                    CheckBox {
+                                        checked: backend.synDropGuard
+                                        onToggled: backend.setSynDropGuard(checked)
+                                        
+                                        indicator: Rectangle {
+                                            implicitWidth: 22
+                                            implicitHeight: 22
+                                            x: parent.leftPadding
+                                            y: parent.height / 2 - height / 2
+                                            radius: 5
+                                            border.color: parent.checked ? accentCol : borderCol
+                                            border.width: 2
+                                            color: parent.checked ? accentCol : "transparent"
+                                            
+                                            Behavior on color { ColorAnimation { duration: animDuration } }
+                                            Behavior on border.color { ColorAnimation { duration: animDuration } }
+                                            
+                                            Text {
+                                                anchors.centerIn: parent
+                                                text: "✓"
+                                                color: "white"
+                                                font.pixelSize: 14
+                                                font.bold: true
+                                                opacity: parent.parent.checked ? 1 : 0
+                                                
+                                                Behavior on opacity { NumberAnimation { duration: 150 } }
+                                            }
+                                        }
+                                    }
+                                }
+
+                                // Publishes raw samples to shared memory for local tools
+                                // (/dev/shm/inkbridge-pen-emu-N, see stylusstream.h).
+                                RowLayout {
+                                    Layout.fillWidth: true
+                                    spacing: 12
+                                    Label {
+                                        text: "Shared-Memory Stream"
+                                        color: textCol
+                                        font.pixelSize: 14
+                                        font.weight: Font.Medium
+                                        Behavior on color { ColorAnimation { duration: animDuration } }
+                                    }
+                                    CheckBox {
+                                        checked: backend.sharedStream
+                                        onToggled: backend.setSharedStream(checked)
+                                        
+                                        indicator: Rectangle {
+                                            implicitWidth: 22
+                                            implicitHeight: 22
+                                            x: parent.leftPadding
+                                            y: parent.height / 2 - height / 2
+                                            radius: 5
+                                            border.color: parent.checked ? accentCol : borderCol
+                                            border.width: 2
+                                            color: parent.checked ? accentCol : "transparent"
+                                            
+                                            Behavior on color { ColorAnimation { duration: animDuration } }
+                                            Behavior on border.color { ColorAnimation { duration: animDuration } }
+                                            
+                                            Text {
+                                                anchors.centerIn: parent
+                                                text: "✓"
+                                                color: "white"
+                                                font.pixelSize: 14
+                                                font.bold: true
+                                                opacity: parent.parent.checked ? 1 : 0
+                                                
+                                                Behavior on opacity { NumberAnimation { duration: 150 } }
+                                            }
+                                        }
+                                    }
+                                }
+
+                                // Real-time priority, CPU pinning and locked memory for the
+                                // pen threads. Falls back to nice when RT is not permitted.
+                                RowLayout {
+                                    Layout.fillWidth: true
+                                    spacing: 12
+                                    Label {
+                                        text: "Low-Latency Mode"
+                                        color: textCol
+                                        font.pixelSize: 14
+                                        font.weight: Font.Medium
+                                        Behavior on color { ColorAnimation { duration: animDuration } }
+                                    }
+                                    CheckBox {
+                                        checked: backend.lowLatencyMode
+                                        onToggled: backend.setLowLatencyMode(checked)
+                                        
+                                        indicator: Rectangle {
+                                            implicitWidth: 22
+                                            implicitHeight: 22
+                                            x: parent.leftPadding
+                                            y: parent.height / 2 - height / 2
+                                            radius: 5
+                                            border.color: parent.checked ? accentCol : borderCol
+                                            border.width: 2
+                                            color: parent.checked ? accentCol : "transparent"
+                                            
+                                            Behavior on color { ColorAnimation { duration: animDuration } }
+                                            Behavior on border.color { ColorAnimation { duration: animDuration } }
+                                            
+                                            Text {
+                                                anchors.centerIn: parent
+                                                text: "✓"
+                                                color: "white"
+                                                font.pixelSize: 14
+                                                font.bold: true
+                                                opacity: parent.parent.checked ? 1 : 0
+                                                
+                                                Behavior on opacity { NumberAnimation { duration: 150 } }
+                                            }
+                                        }
+                                    }
+                                }
+
                                 Rectangle {
                                     height: 1
                                     Layout.fillWidth: true
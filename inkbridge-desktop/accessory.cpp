@@ -1,69 +1,241 @@
 #include "accessory.h"
 #include "linux-adk.h"
 #include "protocol.h"
+#include "streamdecoder.h"
+#include "hovershedder.h"
+#include "controlchannel.h"
 #include "virtualstylus.h"
 #include "backend.h"
+#include "rtsched.h"
 
 #include <iostream>
 #include <vector>
 #include <atomic>
+#include <chrono>
+#include <thread>
 #include <libusb-1.0/libusb.h>
 #include <QDebug>
 
 using namespace std;
 
-namespace InkBridge {
-    volatile std::atomic<bool> stop_acc(false);
-}
-
 #define AOA_ACCESSORY_INTERFACE 0
 #define AOA_ACCESSORY_EP_IN     0x81
 
+// Control frames go back on the interface's bulk OUT endpoint. A tablet that
+// does not read it stalls the write, so keep the timeout short.
+#define CONTROL_PERIOD_US  (1000ULL * 1000)
+#define CONTROL_TIMEOUT_MS 20
+
+// How many recovery attempts in a row are allowed before the loop gives up
+// and hands control back to the caller for a full reconnect. A successful
+// transfer resets the budget.
+#define MAX_CONSECUTIVE_RECOVERIES 5
+
+// A capture restart later than this after the previous exit is treated as a
+// new connection (cable unplugged, tablet put away) rather than a reconnect.
+#define MAX_RECONNECT_GAP_US (30ULL * 1000 * 1000)
+
 // ----------------------------------------------------------------------------
-// Helper: Extract Data
+// Error Classification
+//
+// libusb reports every non-success as a negative code, but they mean very
+// different things for a running bulk stream:
+//
+//   TIMEOUT            - no data within 200 ms; normal when the pen is idle.
+//   OVERFLOW/INTERRUPTED/BUSY
+//                      - this one transfer was lost, the pipe itself is fine.
+//                        Just submit the next transfer.
+//   PIPE               - the endpoint is halted (STALL). Nothing will arrive
+//                        until the halt is cleared with CLEAR_FEATURE.
+//   IO/OTHER           - the host controller lost track of the interface,
+//                        usually after a hub hiccup. Releasing and claiming
+//                        the interface again recovers it without an AOA mode
+//                        switch, because the device is still enumerated as
+//                        an accessory.
+//   NO_DEVICE & rest   - the device is gone. Only a full reconnect helps.
 // ----------------------------------------------------------------------------
-static void fillEventData(AccessoryEventData& data, const PenPacket* packet) {
-    data.toolType = packet->toolType;
-    data.action = packet->action;
-    data.x = packet->x;
-    data.y = packet->y;
-    // Pressure is encoded as (event.pressure * 4096) on Android.
-    // Dividing by 4096.0f restores the original 0.0-1.0 float range.
-    // The previous value of 1000.0f was mismatched, causing values above
-    // 1.0 that PressureTranslator would clamp, squashing most of the
-    // pressure range to maximum.
-    data.pressure = static_cast<float>(packet->pressure) / 4096.0f;
-    
-    // --- NEW: Copy Tilt Data ---
-    data.tiltX = packet->tiltX;
-    data.tiltY = packet->tiltY;
+enum class UsbRecovery {
+    None,         // Not an error (timeout)
+    Resubmit,
+    ClearHalt,
+    Reclaim,
+    Reconnect
+};
+
+static UsbRecovery classifyTransferError(int ret) {
+    switch (ret) {
+    case LIBUSB_ERROR_TIMEOUT:
+        return UsbRecovery::None;
+    case LIBUSB_ERROR_OVERFLOW:
+    case LIBUSB_ERROR_INTERRUPTED:
+    case LIBUSB_ERROR_BUSY:
+        return UsbRecovery::Resubmit;
+    case LIBUSB_ERROR_PIPE:
+        return UsbRecovery::ClearHalt;
+    case LIBUSB_ERROR_IO:
+    case LIBUSB_ERROR_OTHER:
+        return UsbRecovery::Reclaim;
+    default:
+        return UsbRecovery::Reconnect;
+    }
+}
+
+static void recordMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t prev = target.load();
+    while (value > prev && !target.compare_exchange_weak(prev, value)) {}
+}
+
+static uint64_t steadyNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Performs the recovery action for 'kind'. Returns true if the capture loop
+// may continue with the same handle. The stylus is deliberately not touched
+// here: if the stream resumes before the watchdog timeout the stroke simply
+// continues, otherwise the watchdog lifts the pen as it would for any gap.
+static bool recoverInPlace(libusb_device_handle* handle, UsbRecovery kind,
+                           int attempt, UsbRecoveryStats* stats) {
+    using namespace std::chrono;
+
+    // Back off a little more on every consecutive attempt so a device that
+    // is genuinely going away does not get hammered with control requests.
+    if (attempt > 1) {
+        std::this_thread::sleep_for(milliseconds(10 * (attempt - 1)));
+    }
+
+    int ret = 0;
+    switch (kind) {
+    case UsbRecovery::Resubmit:
+        if (stats) stats->resubmits++;
+        return true;
+
+    case UsbRecovery::ClearHalt:
+        ret = libusb_clear_halt(handle, AOA_ACCESSORY_EP_IN);
+        if (ret != 0) {
+            cerr << "clear_halt failed: " << libusb_error_name(ret) << endl;
+            return false;
+        }
+        if (stats) stats->haltClears++;
+        return true;
+
+    case UsbRecovery::Reclaim:
+        libusb_release_interface(handle, AOA_ACCESSORY_INTERFACE);
+        ret = libusb_claim_interface(handle, AOA_ACCESSORY_INTERFACE);
+        if (ret != 0) {
+            cerr << "Re-claim failed: " << libusb_error_name(ret) << endl;
+            return false;
+        }
+        // A fresh claim does not reset the data toggle on its own.
+        libusb_clear_halt(handle, AOA_ACCESSORY_EP_IN);
+        if (stats) stats->reclaims++;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Returns the bulk OUT endpoint of the accessory interface, or 0 if the
+// active configuration does not have one.
+static unsigned char findBulkOutEndpoint(libusb_device_handle* handle) {
+    libusb_config_descriptor* config = nullptr;
+    if (libusb_get_active_config_descriptor(libusb_get_device(handle), &config) != 0) return 0;
+
+    unsigned char endpoint = 0;
+    if (config->bNumInterfaces > AOA_ACCESSORY_INTERFACE &&
+        config->interface[AOA_ACCESSORY_INTERFACE].num_altsetting > 0) {
+        const libusb_interface_descriptor& alt =
+            config->interface[AOA_ACCESSORY_INTERFACE].altsetting[0];
+        for (int i = 0; i < alt.bNumEndpoints && !endpoint; ++i) {
+            const libusb_endpoint_descriptor& ep = alt.endpoint[i];
+            if ((ep.bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_OUT &&
+                (ep.bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == LIBUSB_TRANSFER_TYPE_BULK) {
+                endpoint = ep.bEndpointAddress;
+            }
+        }
+    }
+    libusb_free_config_descriptor(config);
+    return endpoint;
 }
 
 // ----------------------------------------------------------------------------
 // Main Capture Loop
 // ----------------------------------------------------------------------------
-void accessory_main(InkBridge::UsbConnection* conn, VirtualStylus* virtualStylus)
+void accessory_main(InkBridge::UsbConnection* conn, VirtualStylus* virtualStylus,
+                    UsbRecoveryStats* stats)
 {
     if (!conn || !virtualStylus) return;
 
+    using Clock = std::chrono::steady_clock;
+
     int ret = 0;
     int transferred = 0;
     unsigned char acc_buf[512]; 
+    RtSched::prefault(acc_buf, sizeof(acc_buf));
 
     // Tracker variables to filter out redundant coordinate data
     int lastAction = -1;
     int lastTool = -1;
 
-    ret = libusb_claim_interface(conn->getHandle(), AOA_ACCESSORY_INTERFACE);
-    if (ret != 0) {
-        cerr << "Error claiming interface: " << libusb_error_name(ret) << endl;
-        return;
+    // Recovery bookkeeping: how many attempts in a row, when the first error
+    // of the current streak happened and when the last recovery action
+    // finished. The streak is closed by the next transfer that does not
+    // fail, and its duration (first error -> pipe usable again) is recorded.
+    int consecutiveRecoveries = 0;
+    Clock::time_point recoveryStart;
+    Clock::time_point recoveryDone;
+
+    // UsbConnection::open() has claimed AOA_ACCESSORY_INTERFACE.
+    cout << "Starting capture loop..." << endl;
+    PenStreamDecoder decoder;
+    HoverShedder shedder;
+
+    ControlChannel control;
+    unsigned char controlEndpoint = findBulkOutEndpoint(conn->getHandle());
+    uint64_t lastControlTickUs = 0; // tick on the first pass: advertise v2 early
+
+    if (stats) {
+        uint64_t lastEnd = stats->lastCaptureEndUs.exchange(0);
+        uint64_t gap     = lastEnd ? steadyNowUs() - lastEnd : 0;
+        if (lastEnd && gap <= MAX_RECONNECT_GAP_US) {
+            stats->fullReconnects++;
+            stats->reconnectTimeTotalUs += gap;
+            recordMax(stats->reconnectTimeMaxUs, gap);
+        }
     }
 
-    cout << "Accessory interface claimed. Starting capture loop..." << endl;
-    AccessoryEventData eventData;
+    while (!conn->shouldStop()) {
+        // Ticked between reads; an idle pen still returns every 200 ms. A
+        // hello ack goes out right away.
+        const bool tickDue = steadyNowUs() - lastControlTickUs >= CONTROL_PERIOD_US;
+        if (controlEndpoint && (tickDue || control.urgent())) {
+            unsigned char frames[ControlChannel::MAX_BYTES];
+            size_t len;
+            if (tickDue) {
+                lastControlTickUs = steadyNowUs();
+                len = control.tick(shedder.samples(), shedder.shed(), frames);
+            } else {
+                len = control.takeUrgent(frames);
+            }
+            if (len > 0) {
+                int sent = 0;
+                int out = libusb_bulk_transfer(conn->getHandle(), controlEndpoint,
+                                               frames, static_cast<int>(len), &sent,
+                                               CONTROL_TIMEOUT_MS);
+                if (out == LIBUSB_ERROR_TIMEOUT || out == LIBUSB_ERROR_PIPE) {
+                    // The tablet app predates the channel. Stop trying for
+                    // this connection rather than stall every second.
+                    cout << "Tablet does not read control frames over USB ("
+                         << libusb_error_name(out) << "); disabled." << endl;
+                    if (out == LIBUSB_ERROR_PIPE) libusb_clear_halt(conn->getHandle(), controlEndpoint);
+                    controlEndpoint = 0;
+                } else if (out < 0 || sent != static_cast<int>(len)) {
+                    control.markUnsent();
+                }
+            }
+        }
 
-    while (!InkBridge::stop_acc) {
         ret = libusb_bulk_transfer(conn->getHandle(),
                                    AOA_ACCESSORY_EP_IN,
                                    acc_buf,
@@ -71,24 +243,65 @@ void accessory_main(InkBridge::UsbConnection* conn, VirtualStylus* virtualStylus
                                    &transferred,
                                    200);
 
+        UsbRecovery kind = (ret < 0) ? classifyTransferError(ret) : UsbRecovery::None;
+
+        if (kind == UsbRecovery::None && consecutiveRecoveries > 0) {
+            if (stats) {
+                uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    recoveryDone - recoveryStart).count();
+                stats->recoveredStreaks++;
+                stats->recoveryTimeTotalUs += us;
+                recordMax(stats->recoveryTimeMaxUs, us);
+            }
+            consecutiveRecoveries = 0;
+        }
+
         if (ret < 0) {
-            if (ret == LIBUSB_ERROR_TIMEOUT) continue; 
-            if (ret == LIBUSB_ERROR_NO_DEVICE) {
-                cout << "Device disconnected." << endl;
+            if (kind == UsbRecovery::None) continue; // Timeout
+
+            if (kind == UsbRecovery::Reconnect) {
+                if (ret == LIBUSB_ERROR_NO_DEVICE) {
+                    cout << "Device disconnected." << endl;
+                } else {
+                    cerr << "Bulk transfer error: " << libusb_error_name(ret) << endl;
+                }
                 break;
             }
-            cerr << "Bulk transfer error: " << libusb_error_name(ret) << endl;
-            break;
+
+            if (consecutiveRecoveries == 0) recoveryStart = Clock::now();
+            consecutiveRecoveries++;
+
+            cerr << "Bulk transfer error: " << libusb_error_name(ret)
+                 << " (recovery attempt " << consecutiveRecoveries << ")" << endl;
+
+            if (consecutiveRecoveries > MAX_CONSECUTIVE_RECOVERIES ||
+                !recoverInPlace(conn->getHandle(), kind, consecutiveRecoveries, stats)) {
+                if (stats) stats->failedRecoveries++;
+                cerr << "In-place recovery failed, falling back to reconnect." << endl;
+                break;
+            }
+            // Whatever was in flight is lost, so a packet split across the
+            // failed transfer can never be completed. Resynchronise.
+            decoder.reset();
+            recoveryDone = Clock::now();
+            continue;
         }
 
         if (transferred == 0) continue;
 
-        int processed = 0;
-        while (processed + (int)sizeof(PenPacket) <= transferred) {
-            const PenPacket* packet = reinterpret_cast<const PenPacket*>(acc_buf + processed);
-            
-            fillEventData(eventData, packet);
+        const uint64_t arrivedUs = HoverShedder::nowUs();
+        decoder.feed(acc_buf, transferred,
+                     [&](AccessoryEventData& eventData) { shedder.push(eventData); },
+                     [&] { virtualStylus->noteHeartbeat(); });
 
+        TabletHello hello;
+        if (decoder.takeHello(hello)) {
+            cout << "Tablet hello: " << Handshake::describe(hello) << endl;
+            virtualStylus->applyTabletHello(hello);
+            control.acceptHello(hello);
+        }
+
+        shedder.drain(arrivedUs, [&](AccessoryEventData& eventData) {
             // --- THE UPDATED DEBUGGER: STATE CHANGE ONLY ---
             if (Backend::isDebugMode) {
                 // Only print if Action or ToolType changes (ignores coordinate/pressure jitter)
@@ -104,9 +317,9 @@ void accessory_main(InkBridge::UsbConnection* conn, VirtualStylus* virtualStylus
             // -----------------------------------------------
 
             virtualStylus->handleAccessoryEventData(&eventData);
-            processed += sizeof(PenPacket);
-        }
+        });
     }
+    if (stats) stats->lastCaptureEndUs = steadyNowUs();
     cout << "Capture loop finished." << endl;
 }
 
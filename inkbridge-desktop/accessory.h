@@ -4,17 +4,16 @@
 #include <string>
 #include <array>
 #include <atomic> // <--- THIS WAS MISSING. REQUIRED FOR std::atomic
+#include <cstdint>
 
 // Forward declarations
 class VirtualStylus;
 
-// We need to forward declare UsbConnection properly since it's inside a namespace
+// We need to forward declare UsbConnection properly since it's inside a namespace.
+// The capture loop is stopped per connection (UsbConnection::setStopFlag),
+// so several tablets can be captured and stopped independently.
 namespace InkBridge {
     class UsbConnection;
-    
-    // This variable controls the main loop in accessory.cpp
-    // 'extern' tells the compiler "this exists, but is defined in the .cpp file"
-    extern volatile std::atomic<bool> stop_acc;
 }
 
 struct AccessoryEventData {
@@ -26,10 +25,47 @@ struct AccessoryEventData {
     // --- NEW FIELDS ---
     int tiltX;
     int tiltY;
+    // When the tablet saw this sample, on the desktop's steady clock (us).
+    // 0 = the tablet sent no device time or the clocks are not synced yet.
+    uint64_t hostTimeUs = 0;
+};
+
+/**
+ * @brief Counters describing how the USB capture loop survived errors.
+ *
+ * "In-place" recoveries are handled inside accessory_main (endpoint halt
+ * clear, resubmit, interface re-claim) without leaving the capture loop.
+ * "Full reconnects" are counted when a capture loop starts again shortly
+ * after a previous one exited, i.e. the device had to be found, opened and
+ * claimed from scratch. Pass the same instance to every capture session.
+ *
+ * All fields are atomics so the UI thread can read them while the capture
+ * thread updates them. Times are in microseconds.
+ */
+struct UsbRecoveryStats {
+    std::atomic<uint64_t> resubmits{0};        // Transfer simply retried (OVERFLOW, INTERRUPTED)
+    std::atomic<uint64_t> haltClears{0};       // LIBUSB_ERROR_PIPE -> libusb_clear_halt
+    std::atomic<uint64_t> reclaims{0};         // Interface released and claimed again
+    std::atomic<uint64_t> failedRecoveries{0}; // Gave up and fell back to a full reconnect
+    std::atomic<uint64_t> recoveredStreaks{0}; // Error streaks that ended with a working pipe
+    std::atomic<uint64_t> recoveryTimeTotalUs{0};
+    std::atomic<uint64_t> recoveryTimeMaxUs{0};
+
+    std::atomic<uint64_t> fullReconnects{0};
+    std::atomic<uint64_t> reconnectTimeTotalUs{0};
+    std::atomic<uint64_t> reconnectTimeMaxUs{0};
+
+    // steady_clock timestamp (us) of the last capture loop exit, 0 if none.
+    // The next successful claim turns the gap into a full-reconnect sample.
+    std::atomic<uint64_t> lastCaptureEndUs{0};
+
+    uint64_t inPlaceRecoveries() const { return resubmits + haltClears + reclaims; }
 };
 
 // Function prototypes
-void accessory_main(InkBridge::UsbConnection* conn, VirtualStylus* virtualStylus);
+// 'stats' is optional; pass nullptr when nobody is interested in the counters.
+void accessory_main(InkBridge::UsbConnection* conn, VirtualStylus* virtualStylus,
+                    UsbRecoveryStats* stats = nullptr);
 bool parseAccessoryEventDataLine(const std::string &line, AccessoryEventData * accessoryEventData);
 
 #endif // ACCESSORY_H
\ No newline at end of file
@@ -2,8 +2,11 @@
 #include "linux-adk.h"
 #include <libusb-1.0/libusb.h>
 #include <iostream> // For std::cout if needed, though qDebug is preferred for Qt
+#include <algorithm>
 #include "protocol.h"  // For PenPacket struct
 #include "accessory.h" // For AccessoryEventData struct
+#include "uinputwriter.h"
+#include "rtsched.h"
 // AOA Protocol Constants
 #define AOA_GET_PROTOCOL    51
 #define AOA_SEND_STRING     52
@@ -20,29 +23,30 @@ Backend::Backend(QObject *parent)
     , m_status("Ready")     
     , m_connected(false)
     , m_wifiDirectRunning(false) 
+    , m_bluetoothRunning(false)
     , m_pressureSensitivity(50)
     , m_minPressure(0)
     , m_swapAxis(false)
     , m_autoScanRunning(false) // Initialize flag
-    , m_bluetoothRunning(false)
 {
-    m_displayTranslator = new DisplayScreenTranslator();
-    m_pressureTranslator = new PressureTranslator();
-    m_stylus = new VirtualStylus(m_displayTranslator, m_pressureTranslator);
-    
-    
     m_wifiDirectServer = new WifiDirectServer(this);
 
+    // Every tablet that connects gets its own session (and uinput device).
+    // The reactor creates and releases sessions on its shard threads and
+    // feeds them directly; the signals below only update the status line.
+    m_wifiDirectServer->setSessionCallbacks(
+        [this](int, QString ip) { return createSession(SessionTransport::WifiDirect, ip); },
+        [this](StylusSession *session) { destroySession(session->id()); });
     connect(m_wifiDirectServer, &WifiDirectServer::clientConnected,
-            this, [this](QString ip) {
-        updateStatus("Connected via WiFi Direct (" + ip + ")", true);
+            this, [this](int, QString) {
+        refreshConnectionStatus();
     });
     connect(m_wifiDirectServer, &WifiDirectServer::clientDisconnected,
-            this, [this]() {
-        updateStatus("WiFi Direct: Waiting for tablet...", false);
+            this, [this](int) {
+        if (!refreshConnectionStatus()) {
+            updateStatus("WiFi Direct: Waiting for tablet...", false);
+        }
     });
-    connect(m_wifiDirectServer, &WifiDirectServer::dataReceived,
-            this, &Backend::handleWifiDirectData);
     connect(m_wifiDirectServer, &WifiDirectServer::serverError,
             this, [this](QString msg) {
         updateStatus("WiFi Direct Error: " + msg, false);
@@ -56,25 +60,28 @@ Backend::Backend(QObject *parent)
         emit connectionStatusChanged();
     });
 
-    m_stylus->initializeStylus();
-
     m_bluetoothServer = new BluetoothServer(this);
 
+    // Same as WiFi Direct: each tablet's RFCOMM reader thread feeds its
+    // session directly and sends its control frames.
+    m_bluetoothServer->setSessionCallbacks(
+        [this](int, QString address) { return createSession(SessionTransport::Bluetooth, address); },
+        [this](StylusSession *session) { destroySession(session->id()); });
+
     connect(m_bluetoothServer, &BluetoothServer::clientConnected,
-            this, [this](QString address) {
-        qDebug() << "[BT] Client connected from" << address;
-        updateStatus("Connected via Bluetooth (" + address + ")", true);
+            this, [this](int clientId, QString address) {
+        qDebug() << "[BT] Client" << clientId << "connected from" << address;
+        refreshConnectionStatus();
     });
 
     connect(m_bluetoothServer, &BluetoothServer::clientDisconnected,
-            this, [this]() {
-        qDebug() << "[BT] Client disconnected";
-        updateStatus("Bluetooth Listening...", false);
+            this, [this](int clientId) {
+        qDebug() << "[BT] Client" << clientId << "disconnected";
+        if (!refreshConnectionStatus()) {
+            updateStatus("Bluetooth Listening...", false);
+        }
     });
 
-    connect(m_bluetoothServer, &BluetoothServer::dataReceived,
-            this, &Backend::handleBluetoothData);
-
     connect(m_bluetoothServer, &BluetoothServer::serverError,
             this, [this](QString msg) {
         qDebug() << "[BT] Server error:" << msg;
@@ -93,7 +100,7 @@ Backend::Backend(QObject *parent)
 }
 
 Backend::~Backend() {
-    stopAutoConnect(); // Stop thread safely
+    stopAutoConnect(); // Stop threads safely
     if (m_bluetoothServer) {
         m_bluetoothServer->stopServer();
     }
@@ -102,9 +109,13 @@ Backend::~Backend() {
         m_wifiDirectServer->stopServer();
     }
 
-    delete m_stylus;
-    delete m_displayTranslator;
-    delete m_pressureTranslator;
+    // Anything left (e.g. a client that never disconnected cleanly).
+    std::map<int, std::unique_ptr<StylusSession>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        remaining.swap(m_sessions);
+    }
+    remaining.clear();
 }
 
 // --- Getters ---
@@ -115,61 +126,243 @@ bool Backend::isConnected() const { return m_connected; }
 QStringList Backend::usbDevices() const { return m_usbDeviceNames; }
 bool Backend::isWifiDirectRunning() const { return m_wifiDirectRunning; }
 bool Backend::isBluetoothRunning() const { return m_bluetoothRunning; }
-int Backend::pressureSensitivity() const { return m_pressureSensitivity; }
-int Backend::minPressure() const { return m_minPressure; }
-bool Backend::swapAxis() const { return m_swapAxis; }
+
+// The settings getters show the selected tablet's values, or the defaults
+// (which every tablet shares unless changed individually) when "All" is
+// selected.
+int Backend::pressureSensitivity() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_sessions.find(m_selectedSession);
+    return it != m_sessions.end() ? it->second->pressureSensitivity() : m_pressureSensitivity;
+}
+
+int Backend::minPressure() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_sessions.find(m_selectedSession);
+    return it != m_sessions.end() ? it->second->minPressure() : m_minPressure;
+}
+
+bool Backend::swapAxis() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_sessions.find(m_selectedSession);
+    return it != m_sessions.end() ? it->second->swapAxis() : m_swapAxis;
+}
+
+bool Backend::touchDebounce() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_sessions.find(m_selectedSession);
+    return it != m_sessions.end() ? it->second->touchDebounce() : m_touchDebounce;
+}
+
+bool Backend::synDropGuard() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_sessions.find(m_selectedSession);
+    return it != m_sessions.end() ? it->second->synDropGuard() : m_synDropGuard;
+}
+
+bool Backend::sharedStream() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_sessions.find(m_selectedSession);
+    return it != m_sessions.end() ? it->second->sharedStream() : m_sharedStream;
+}
+
+int Backend::buttonMapping() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_sessions.find(m_selectedSession);
+    return static_cast<int>(it != m_sessions.end() ? it->second->buttonMapping() : m_buttonMapping);
+}
+
+int Backend::selectedScreen() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_sessions.find(m_selectedSession);
+    return it != m_sessions.end() ? it->second->screenIndex() : m_defaultScreen;
+}
+
+int Backend::selectedSession() const {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    return m_selectedSession;
+}
+
+QVariantList Backend::sessions() const {
+    QVariantList list;
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    for (const auto &entry : m_sessions) {
+        const StylusSession *session = entry.second.get();
+        QVariantMap map;
+        map["id"]        = session->id();
+        map["transport"] = StylusSession::transportName(session->transport());
+        map["peer"]      = session->peer();
+        map["label"]     = session->label();
+        map["screen"]    = session->screenIndex();
+        list.append(map);
+    }
+    return list;
+}
+
+// --- Sessions ---
+
+StylusSession *Backend::createSession(SessionTransport transport, const QString &peer) {
+    // Constructing the session creates the uinput device; keep that outside
+    // the registry lock.
+    auto session = std::make_unique<StylusSession>(m_nextSessionId++, transport, peer);
+    StylusSession *raw = session.get();
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        applySettings(raw, true);
+        m_sessions.emplace(raw->id(), std::move(session));
+    }
+
+    // May be called from a USB capture thread.
+    QMetaObject::invokeMethod(this, [this]() { emit sessionsChanged(); }, Qt::QueuedConnection);
+    return raw;
+}
+
+void Backend::destroySession(int sessionId) {
+    std::unique_ptr<StylusSession> doomed;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessions.find(sessionId);
+        if (it == m_sessions.end()) return;
+        doomed = std::move(it->second);
+        m_sessions.erase(it);
+        if (m_selectedSession == sessionId) m_selectedSession = -1;
+    }
+
+    const VirtualStylus::WatchdogStats st = doomed->stylus()->watchdogStats();
+    qDebug() << "[Session]" << doomed->label() << "watchdog: timeout" << st.timeoutMs
+             << "ms," << st.lifts << "lifts," << st.spuriousLifts << "spurious";
+
+    // Lifts the pen and removes the uinput device. No thread is joined: the
+    // transport that fed the session (USB capture thread, reactor shard or
+    // RFCOMM reader) has already let go of it.
+    doomed.reset();
+
+    QMetaObject::invokeMethod(this, [this]() {
+        emit sessionsChanged();
+        emit settingsChanged();
+    }, Qt::QueuedConnection);
+}
+
+// Must be called with m_sessionsMutex held.
+void Backend::applySettings(StylusSession *session, bool includeScreen) {
+    session->setPressure(m_pressureSensitivity, m_minPressure);
+    session->setSwapAxis(m_swapAxis);
+    session->setButtonMapping(m_buttonMapping);
+    session->setTouchDebounce(m_touchDebounce);
+    session->setSynDropGuard(m_synDropGuard);
+    session->setSharedStream(m_sharedStream);
+    session->setTotalDesktopGeometry(m_totalDesktopRect);
+    if (includeScreen && m_defaultScreen >= 0 && m_defaultScreen < m_screenRects.size()) {
+        session->setTargetScreen(m_defaultScreen, m_screenRects[m_defaultScreen]);
+    }
+}
+
+// Shows every connected tablet in the status line. Returns false (and
+// leaves the status alone) when nothing is connected, so the caller can
+// show a transport-specific idle message instead.
+bool Backend::refreshConnectionStatus() {
+    QStringList labels;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        for (const auto &entry : m_sessions) labels << entry.second->label();
+    }
+    if (labels.isEmpty()) return false;
+
+    updateStatus("Connected: " + labels.join(", "), true);
+    return true;
+}
+
+void Backend::selectSession(int sessionId) {
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        m_selectedSession = m_sessions.count(sessionId) ? sessionId : -1;
+    }
+    emit settingsChanged();
+}
 
 // --- Logic ---
 void Backend::refreshScreens() {
+    // Without a QGuiApplication (the daemon) there are no screens to list;
+    // the geometry comes from setScreens() instead.
+    QVector<QRect> rects;
+    QStringList names;
+    for (QScreen *screen : QGuiApplication::screens()) {
+        rects.append(screen->geometry());
+        names.append(screen->name());
+    }
+    setScreens(rects, names);
+}
+
+void Backend::setScreens(const QVector<QRect> &rects, const QStringList &names) {
     m_screenNames.clear();
-    m_screenRects.clear();
     m_screenGeometriesVariant.clear();
     QRect totalRect;
 
-    const auto screens = QGuiApplication::screens();
-    int i = 1;
-    for (QScreen *screen : screens) {
-        QRect geom = screen->geometry();
-        m_screenRects.append(geom);
-        
+    for (int i = 0; i < rects.size(); ++i) {
+        const QRect &geom = rects[i];
+
         // Populate QML friendly map
         QVariantMap map;
         map["x"] = geom.x();
         map["y"] = geom.y();
         map["width"] = geom.width();
         map["height"] = geom.height();
-        map["name"] = QString::number(i);
+        map["name"] = QString::number(i + 1);
         m_screenGeometriesVariant.append(map);
         
         m_screenNames.append(QString("Screen %1: %2 (%3x%4)")
-                             .arg(i++)
-                             .arg(screen->name())
+                             .arg(i + 1)
+                             .arg(i < names.size() ? names[i] : QString("configured"))
                              .arg(geom.width())
                              .arg(geom.height()));
         
         totalRect = totalRect.united(geom);
     }
-    m_stylus->setTotalDesktopGeometry(totalRect);
-    emit screenListChanged();
 
-    // --- ADD THIS BLOCK HERE ---
-    // Force the stylus to map to the first screen immediately
-    if (!m_screenRects.isEmpty()) {
-        selectScreen(0); 
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        m_screenRects     = rects;
+        m_totalDesktopRect = totalRect;
+        // New defaults map to the first screen; existing tablets keep their
+        // monitor if it still exists.
+        m_defaultScreen = 0;
+        for (auto &entry : m_sessions) {
+            StylusSession *session = entry.second.get();
+            int index = session->screenIndex() < m_screenRects.size() ? session->screenIndex() : 0;
+            session->setTotalDesktopGeometry(totalRect);
+            if (!m_screenRects.isEmpty()) {
+                session->setTargetScreen(index, m_screenRects[index]);
+            }
+        }
     }
-    // ---------------------------
+    emit screenListChanged();
+    emit settingsChanged();
 }
 
 void Backend::selectScreen(int index) {
-    if (index >= 0 && index < m_screenRects.size()) {
-        m_stylus->setTargetScreen(m_screenRects[index]);
-        qDebug() << "Selected Screen Index:" << index;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        if (index < 0 || index >= m_screenRects.size()) return;
+
+        auto it = m_sessions.find(m_selectedSession);
+        if (it != m_sessions.end()) {
+            it->second->setTargetScreen(index, m_screenRects[index]);
+        } else {
+            m_defaultScreen = index;
+            for (auto &entry : m_sessions) {
+                entry.second->setTargetScreen(index, m_screenRects[index]);
+            }
+        }
     }
+    qDebug() << "Selected Screen Index:" << index << "for session" << selectedSession();
+    emit sessionsChanged();
+    emit settingsChanged();
 }
 
 void Backend::refreshUsbDevices() {
     m_usbDeviceNames.clear();
     m_usbDeviceIds.clear();
+    m_usbDeviceLocations.clear();
 
     libusb_context *ctx = nullptr;
     libusb_device **devs = nullptr;
@@ -198,6 +391,7 @@ void Backend::refreshUsbDevices() {
         
         m_usbDeviceNames.append(QString("%1 [%2]").arg((char*)product).arg(idStr));
         m_usbDeviceIds.append(QString(idStr));
+        m_usbDeviceLocations.append(QString::fromStdString(InkBridge::UsbConnection::locationOf(dev)));
     }
     
     libusb_free_device_list(devs, 1);
@@ -212,54 +406,136 @@ void Backend::connectDevice(int deviceIndex) {
     }
     QString deviceId = m_usbDeviceIds[deviceIndex];
     updateStatus("Connecting...", true); 
-    
-    InkBridge::stop_acc = false;
 
-    QtConcurrent::run([=, this](){
-        InkBridge::UsbConnection connection;
-        int res = connection.startCapture(deviceId.toStdString(), m_stylus);
-        QMetaObject::invokeMethod(this, [=, this](){
-            updateStatus("Disconnected (Code " + QString::number(res) + ")", false);
-        });
-    });
+    // Pinned to the selected device's port, so with two tablets of the same
+    // model the one picked in the list is opened. The port survives the
+    // AOA re-enumeration, so the capture finds the accessory there too.
+    startUsbWorker(deviceId.toStdString(), m_usbDeviceLocations[deviceIndex].toStdString());
 }
 
 void Backend::disconnectDevice() {
-    InkBridge::stop_acc = true;
+    std::lock_guard<std::mutex> lock(m_usbWorkersMutex);
+    for (auto &entry : m_usbWorkers) {
+        entry.second->stop = true;
+    }
     updateStatus("Disconnecting...", false);
 }
 
 // --- Restored Features ---
+// Settings apply to the selected tablet, or to every tablet (and become the
+// default for new ones) when no tablet is selected.
 
 void Backend::setPressureSensitivity(int value) {
-    if (m_pressureSensitivity != value) {
-        m_pressureSensitivity = value;
-        
-        // --- THE FIX: Update the translator ---
-        if (m_pressureTranslator) {
-            m_pressureTranslator->sensitivity = value;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessions.find(m_selectedSession);
+        if (it != m_sessions.end()) {
+            it->second->setPressure(value, it->second->minPressure());
+        } else {
+            m_pressureSensitivity = value;
+            for (auto &entry : m_sessions) {
+                entry.second->setPressure(value, entry.second->minPressure());
+            }
         }
-        
-        emit settingsChanged(); 
     }
+    emit settingsChanged(); 
 }
 
 void Backend::setMinPressure(int value) {
-    if (m_minPressure != value) {
-        m_minPressure = value;
-        
-        // --- THE FIX: Update the translator ---
-        if (m_pressureTranslator) {
-            m_pressureTranslator->minPressure = value;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessions.find(m_selectedSession);
+        if (it != m_sessions.end()) {
+            it->second->setPressure(it->second->pressureSensitivity(), value);
+        } else {
+            m_minPressure = value;
+            for (auto &entry : m_sessions) {
+                entry.second->setPressure(entry.second->pressureSensitivity(), value);
+            }
         }
-        
-        emit settingsChanged();
     }
+    emit settingsChanged();
 }
 
 void Backend::setSwapAxis(bool swap) {
-    m_swapAxis = swap;
-    m_stylus->swapAxis = swap;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessions.find(m_selectedSession);
+        if (it != m_sessions.end()) {
+            it->second->setSwapAxis(swap);
+        } else {
+            m_swapAxis = swap;
+            for (auto &entry : m_sessions) {
+                entry.second->setSwapAxis(swap);
+            }
+        }
+    }
+    emit settingsChanged();
+}
+
+void Backend::setButtonMapping(int mapping) {
+    if (mapping < 0 || mapping > static_cast<int>(ButtonMapping::Eraser)) return;
+    const ButtonMapping value = static_cast<ButtonMapping>(mapping);
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessions.find(m_selectedSession);
+        if (it != m_sessions.end()) {
+            it->second->setButtonMapping(value);
+        } else {
+            m_buttonMapping = value;
+            for (auto &entry : m_sessions) {
+                entry.second->setButtonMapping(value);
+            }
+        }
+    }
+    emit settingsChanged();
+}
+
+void Backend::setTouchDebounce(bool enable) {
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessions.find(m_selectedSession);
+        if (it != m_sessions.end()) {
+            it->second->setTouchDebounce(enable);
+        } else {
+            m_touchDebounce = enable;
+            for (auto &entry : m_sessions) {
+                entry.second->setTouchDebounce(enable);
+            }
+        }
+    }
+    emit settingsChanged();
+}
+
+void Backend::setSynDropGuard(bool enable) {
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessions.find(m_selectedSession);
+        if (it != m_sessions.end()) {
+            it->second->setSynDropGuard(enable);
+        } else {
+            m_synDropGuard = enable;
+            for (auto &entry : m_sessions) {
+                entry.second->setSynDropGuard(enable);
+            }
+        }
+    }
+    emit settingsChanged();
+}
+
+void Backend::setSharedStream(bool enable) {
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessions.find(m_selectedSession);
+        if (it != m_sessions.end()) {
+            it->second->setSharedStream(enable);
+        } else {
+            m_sharedStream = enable;
+            for (auto &entry : m_sessions) {
+                entry.second->setSharedStream(enable);
+            }
+        }
+    }
     emit settingsChanged();
 }
 
@@ -274,6 +550,12 @@ void Backend::toggleWifiDirect() {
             m_wifiDirectRunning = false;
         }
     } else {
+        qDebug().noquote() << "[P2P]" << networkLatencyReport();
+        qDebug().noquote() << "[P2P]" << uinputIoReport();
+        qDebug().noquote() << "[P2P]" << sheddingReport();
+        qDebug().noquote() << "[P2P]" << sequenceReport();
+        qDebug().noquote() << "[P2P]" << wireFormatReport();
+        qDebug().noquote() << "[P2P]" << clockSyncReport();
         m_wifiDirectServer->stopServer();
         updateStatus("WiFi Direct Stopped", false);
     }
@@ -300,73 +582,189 @@ void Backend::toggleBluetooth() {
     emit bluetoothStatusChanged();
 }
 
-void Backend::handleWifiDirectData(QByteArray data) {
-    if (data.isEmpty() || !m_stylus) return;
+bool Backend::lowLatencyMode() const { return RtSched::lowLatency(); }
 
-    if (Backend::isDebugMode) {
-        qDebug() << "[P2P] Received" << data.size() << "bytes";
-    }
-
-    const int packetSize = sizeof(PenPacket);
-    int offset = 0;
+void Backend::setLowLatencyMode(bool enable) {
+    if (enable == RtSched::lowLatency()) return;
+    // Print the jitter seen so far first, so "before" and "after" can be
+    // compared in the log.
+    qDebug().noquote() << "[RtSched]" << schedulingReport();
+    RtSched::setLowLatency(enable);
+    qDebug().noquote() << "[RtSched]" << schedulingReport();
+    emit lowLatencyModeChanged();
+}
 
-    while (offset + packetSize <= data.size()) {
-        const PenPacket *packet =
-            reinterpret_cast<const PenPacket *>(data.constData() + offset);
+QString Backend::sheddingReport() const {
+    const HoverShedder::Stats &st = HoverShedder::stats();
+    return QString("Hover shedding: %1 of %2 samples shed in %3 lagging batches")
+        .arg(st.shed.load()).arg(st.samples.load()).arg(st.batchesShed.load());
+}
 
-        AccessoryEventData eventData;
-        eventData.toolType = packet->toolType;
-        eventData.action   = packet->action;
-        eventData.x        = packet->x;
-        eventData.y        = packet->y;
-        eventData.pressure = static_cast<float>(packet->pressure) / 4096.0f;
-        eventData.tiltX    = packet->tiltX;
-        eventData.tiltY    = packet->tiltY;
+QString Backend::sequenceReport() const {
+    QStringList lines;
+    for (int link = 0; link < SequenceTracker::LINK_COUNT; ++link) {
+        const SequenceTracker::Stats &st = SequenceTracker::stats(link);
+        const uint64_t received = st.received;
+        const uint64_t lost     = st.lost;
+        if (!received && !st.misframed) continue;
+        const double lossPct = received + lost ? 100.0 * lost / (received + lost) : 0.0;
+        lines << QString("%1: %2 samples, %3 lost (%4%) in %5 gaps, %6 concealed, "
+                         "%7 duplicates, %8 reordered, %9 resyncs, %10 misframed bytes")
+                     .arg(StylusSession::transportName(static_cast<SessionTransport>(link)))
+                     .arg(received)
+                     .arg(lost)
+                     .arg(lossPct, 0, 'f', 2)
+                     .arg(st.gaps.load())
+                     .arg(st.concealed.load())
+                     .arg(st.duplicates.load())
+                     .arg(st.reordered.load())
+                     .arg(st.resyncs.load())
+                     .arg(st.misframed.load());
+    }
+    return lines.isEmpty() ? "No sequenced (v2) samples received." : lines.join("\n");
+}
 
-        m_stylus->handleAccessoryEventData(&eventData);
-        offset += packetSize;
+QString Backend::wireFormatReport() const {
+    QStringList lines;
+    for (int link = 0; link < SequenceTracker::LINK_COUNT; ++link) {
+        const PenStreamDecoder::WireStats &st = PenStreamDecoder::wireStats(link);
+        const uint64_t samples = st.samples;
+        if (!samples) continue;
+        const uint64_t deltas = st.deltas;
+        lines << QString("%1: %2 samples, %3 bytes/sample, %4 ns/sample decode, "
+                         "%10 bytes/sample copied to reassemble; "
+                         "compact: %5 key frames, %6 deltas (%7 bytes/delta), %8 orphaned; "
+                         "%9 UDP datagrams")
+                     .arg(StylusSession::transportName(static_cast<SessionTransport>(link)))
+                     .arg(samples)
+                     .arg(static_cast<double>(st.bytes) / samples, 0, 'f', 2)
+                     .arg(static_cast<double>(st.decodeNs) / samples, 0, 'f', 1)
+                     .arg(st.keyframes.load())
+                     .arg(deltas)
+                     .arg(deltas ? static_cast<double>(st.deltaBytes) / deltas : 0.0, 0, 'f', 2)
+                     .arg(st.orphanDeltas.load())
+                     .arg(st.datagrams.load())
+                     .arg(static_cast<double>(st.copiedBytes) / samples, 0, 'f', 2);
     }
+    return lines.isEmpty() ? "No samples decoded." : lines.join("\n");
 }
 
-void Backend::handleBluetoothData(QByteArray data) {
-    if (data.isEmpty() || !m_stylus) return;
+QString Backend::clockSyncReport() const {
+    QStringList lines;
+    for (int link = 0; link < SequenceTracker::LINK_COUNT; ++link) {
+        const ClockSync::Stats &st = ClockSync::stats(link);
+        if (!st.exchanges) continue;
+        const uint64_t samples = st.latency.count();
+        lines << QString("%1: %2 ping exchanges, offset %3 us, drift %4 ppm, best round trip %5 us; "
+                         "one-way latency avg %6 us, p50 <%7 us, p99 <%8 us, max %9 us over %10 samples")
+                     .arg(StylusSession::transportName(static_cast<SessionTransport>(link)))
+                     .arg(st.exchanges.load())
+                     .arg(st.offsetUs.load())
+                     .arg(st.driftPpb.load() / 1000.0, 0, 'f', 2)
+                     .arg(st.minDelayUs.load())
+                     .arg(st.latency.avgUs())
+                     .arg(st.latency.quantileUs(0.50))
+                     .arg(st.latency.quantileUs(0.99))
+                     .arg(st.latency.maxUs())
+                     .arg(samples);
+    }
+    return lines.isEmpty() ? "No tablet sends device time." : lines.join("\n");
+}
 
-    if (Backend::isDebugMode) {
-        qDebug() << "[BT] Received" << data.size() << "bytes";
+QString Backend::handshakeReport() const {
+    QStringList lines;
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    for (const auto &entry : m_sessions) {
+        TabletHello hello;
+        lines << QString("%1: %2").arg(entry.second->label(),
+                                       entry.second->stylus()->tabletHello(hello)
+                                           ? QString::fromStdString(Handshake::describe(hello))
+                                           : QString("no hello (legacy tablet, defaults)"));
     }
+    return lines.isEmpty() ? "No tablets connected." : lines.join("\n");
+}
 
-    const int packetSize = sizeof(PenPacket);
-    int offset = 0;
+QString Backend::watchdogReport() const {
+    QStringList lines;
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    for (const auto &entry : m_sessions) {
+        const VirtualStylus::WatchdogStats st = entry.second->stylus()->watchdogStats();
+        double perHour = st.hours > 0 ? st.spuriousLifts / st.hours : 0.0;
+        lines << QString("%1: timeout %2 ms (sample gap %3 ms, heartbeat gap %4 ms), "
+                         "%5 lifts, %6 spurious (%7/h)")
+                     .arg(entry.second->label())
+                     .arg(st.timeoutMs)
+                     .arg(st.sampleGapMs, 0, 'f', 1)
+                     .arg(st.heartbeatGapMs, 0, 'f', 1)
+                     .arg(st.lifts)
+                     .arg(st.spuriousLifts)
+                     .arg(perHour, 0, 'f', 1);
+    }
+    return lines.isEmpty() ? "No tablets connected." : lines.join("\n");
+}
 
-    while (offset + packetSize <= data.size()) {
-        const PenPacket *packet =
-            reinterpret_cast<const PenPacket *>(data.constData() + offset);
+QString Backend::touchReport() const {
+    QStringList lines;
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    for (const auto &entry : m_sessions) {
+        const TouchDebouncer &debouncer = entry.second->stylus()->touchDebouncer();
+        lines << QString("%1: debounce %2, %3 contacts (%4 short taps), %5 touch flips held back")
+                     .arg(entry.second->label())
+                     .arg(entry.second->touchDebounce() ? "on" : "off")
+                     .arg(debouncer.contacts())
+                     .arg(debouncer.taps())
+                     .arg(debouncer.suppressed());
+    }
+    return lines.isEmpty() ? "No tablets connected." : lines.join("\n");
+}
 
-        // Ignore heartbeat packets (all bytes == 127).
-        // The Android client sends these during idle to keep the connection alive.
-        bool isHeartbeat = true;
-        const uint8_t *raw = reinterpret_cast<const uint8_t *>(packet);
-        for (int i = 0; i < packetSize; ++i) {
-            if (raw[i] != 127) { isHeartbeat = false; break; }
+QString Backend::synDropReport() const {
+    QStringList lines;
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    for (const auto &entry : m_sessions) {
+        const VirtualStylus::SynDropStats st = entry.second->stylus()->synDropStats();
+        if (!st.enabled) {
+            lines << QString("%1: seat protection off").arg(entry.second->label());
+            continue;
         }
-        if (isHeartbeat) { offset += packetSize; continue; }
-
-        AccessoryEventData eventData;
-        eventData.toolType = packet->toolType;
-        eventData.action   = packet->action;
-        eventData.x        = packet->x;
-        eventData.y        = packet->y;
-        eventData.pressure = static_cast<float>(packet->pressure) / 4096.0f;
-        eventData.tiltX    = packet->tiltX;
-        eventData.tiltY    = packet->tiltY;
-
-        m_stylus->handleAccessoryEventData(&eventData);
+        lines << QString("%1: %2, %3 SYN_DROPPED (%4), output %5, %6 hover-moves coalesced")
+                     .arg(entry.second->label())
+                     .arg(st.node.empty() ? QString("node not watched")
+                                          : QString("watching %1 (%2 events)")
+                                                .arg(QString::fromStdString(st.node))
+                                                .arg(st.events))
+                     .arg(st.incidents)
+                     .arg(st.incidents ? QString("last %1 s ago").arg(st.sinceDropS, 0, 'f', 1)
+                                       : QString("none"))
+                     .arg(st.paced ? "paced" : "full rate")
+                     .arg(st.coalesced);
+    }
+    return lines.isEmpty() ? "No tablets connected." : lines.join("\n");
+}
 
-        offset += packetSize;
+QString Backend::streamReport() const {
+    QStringList lines;
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    for (const auto &entry : m_sessions) {
+        const VirtualStylus::StreamStats st = entry.second->stylus()->streamStats();
+        if (st.name.empty()) {
+            lines << QString("%1: shared-memory stream off").arg(entry.second->label());
+            continue;
+        }
+        lines << QString("%1: /dev/shm%2, %3 readers, %4 samples published, "
+                         "%5 skipped with no reader, %6 wake-ups")
+                     .arg(entry.second->label())
+                     .arg(QString::fromStdString(st.name))
+                     .arg(st.readers)
+                     .arg(st.published)
+                     .arg(st.skipped)
+                     .arg(st.wakes);
     }
+    return lines.isEmpty() ? "No tablets connected." : lines.join("\n");
+}
 
-    // Partial packet at end of buffer is dropped — acceptable for the same
-    // reason as in handleWifiData(): the next event arrives in < 8ms.
+QString Backend::schedulingReport() const {
+    return QString::fromStdString(RtSched::report()).trimmed();
 }
 
 void Backend::toggleDebug(bool enable) {
@@ -375,10 +773,13 @@ void Backend::toggleDebug(bool enable) {
 }
 
 void Backend::resetDefaults() {
-    m_pressureSensitivity = 50;
-    m_minPressure = 0;
+    setPressureSensitivity(50);
+    setMinPressure(0);
     setSwapAxis(false); // Helper handles bool update
-    emit settingsChanged();
+    setButtonMapping(static_cast<int>(ButtonMapping::Stylus));
+    setTouchDebounce(true);
+    setSynDropGuard(false);
+    setSharedStream(false);
     qDebug() << "Defaults Reset";
 }
 
@@ -407,12 +808,14 @@ void Backend::startAutoConnect() {
 void Backend::stopAutoConnect() {
     qDebug() << "[AutoConnect] Stopping background service...";
     m_autoScanRunning = false;
-    InkBridge::stop_acc = true; // Break the blocking capture loop
     
     if (m_autoScanThread.joinable()) {
         m_autoScanThread.join();
         qDebug() << "[AutoConnect] Thread joined and stopped.";
     }
+
+    // Break every blocking capture loop and wait for it.
+    reapUsbWorkers(true);
 }
 
 bool Backend::trySwitchToAccessoryMode(libusb_device *dev, libusb_device_handle *handle) {
@@ -457,53 +860,142 @@ void Backend::autoConnectLoop() {
     qDebug() << "[AutoConnect] Thread started. Loop entering...";
 
     while (m_autoScanRunning) {
-        
-        // 1. Scan
-        qDebug() << "[AutoConnect] Scanning USB bus..."; // Comment out to reduce spam if too frequent
-        QString deviceId = scanForInkBridgeDevice();
+        // 1. Forget capture threads whose tablet went away, so the same port
+        //    can be picked up again below.
+        reapUsbWorkers(false);
+
+        // 2. Scan. Every tablet already in accessory mode is a candidate;
+        //    tablets that still need the handshake are switched and show up
+        //    as candidates on a later pass.
+        // qDebug() << "[AutoConnect] Scanning USB bus..."; // Too spammy once per second
+        const std::vector<UsbCandidate> candidates = scanForInkBridgeDevices();
+
+        // 3. One capture thread per tablet. Ports that already have one are
+        //    skipped by startUsbWorker.
+        for (const UsbCandidate &candidate : candidates) {
+            startUsbWorker(candidate.deviceId, candidate.location);
+        }
 
-        if (!deviceId.isEmpty()) {
-            qDebug() << "[AutoConnect] >>> DEVICE FOUND: " << deviceId;
-            
-            // 2. Connect
-            QMetaObject::invokeMethod(this, [this](){
-                updateStatus("Tablet found! Connecting...", true);
-            });
+        // 4. Wait
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    qDebug() << "[AutoConnect] Loop exited.";
+}
 
-            InkBridge::stop_acc = false; 
-            InkBridge::UsbConnection connection;
-            
-            qDebug() << "[AutoConnect] Engaging Capture Mode (Blocking)...";
-            // This line blocks until the device is unplugged or error occurs
-            int res = connection.startCapture(deviceId.toStdString(), m_stylus);
+void Backend::startUsbWorker(const std::string &deviceId, const std::string &location) {
+    const std::string key = location.empty() ? "manual:" + deviceId : location;
 
-            qDebug() << "[AutoConnect] <<< DISCONNECTED. Return Code:" << res;
+    std::lock_guard<std::mutex> lock(m_usbWorkersMutex);
+    if (m_usbWorkers.count(key)) return; // Already capturing this tablet
 
-            // 3. Handle Disconnect
-            QMetaObject::invokeMethod(this, [this, res](){
-                updateStatus("Disconnected (Code " + QString::number(res) + "). Scanning...", false);
-            });
-            
-            // Cooldown to prevent crazy loops
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+    qDebug() << "[AutoConnect] >>> DEVICE FOUND: " << QString::fromStdString(deviceId)
+             << "at" << QString::fromStdString(key);
 
-        } else {
-            // 4. Wait
-            // No device found, sleep for 1s
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+    QMetaObject::invokeMethod(this, [this](){
+        updateStatus("Tablet found! Connecting...", true);
+    });
+
+    auto worker = std::make_unique<UsbWorker>();
+    UsbWorker *raw = worker.get();
+    worker->thread = std::thread(&Backend::runUsbCapture, this, raw, deviceId, location);
+    m_usbWorkers.emplace(key, std::move(worker));
+}
+
+void Backend::runUsbCapture(UsbWorker *worker, std::string deviceId, std::string location) {
+    RtSched::ThreadScope rt(RtSched::ThreadRole::Ingest, "usb-capture");
+
+    InkBridge::UsbConnection::Config config;
+    config.location = location;
+    InkBridge::UsbConnection connection(config);
+    connection.setStopFlag(&worker->stop);
+
+    // The device is claimed before the session (and its uinput device)
+    // exists. A tablet we cannot claim, because another process holds it or
+    // for lack of permission, is retried by the scan loop every second; it
+    // must not create and remove an input device, dump the reports and flip
+    // the session list each time.
+    const int res = connection.open(deviceId);
+    if (res != 0) {
+        qDebug() << "[AutoConnect] Cannot claim"
+                 << QString::fromStdString(location.empty() ? deviceId : location)
+                 << "Return Code:" << res;
+        QMetaObject::invokeMethod(this, [this, res](){
+            if (!refreshConnectionStatus()) {
+                updateStatus("Cannot claim tablet (Code " + QString::number(res) + "). Retrying...", false);
+            }
+        });
+        worker->finished = true;
+        return;
+    }
+
+    StylusSession *session = createSession(SessionTransport::Usb,
+                                           location.empty() ? QString::fromStdString(deviceId)
+                                                            : QString::fromStdString(location));
+
+    qDebug() << "[AutoConnect] Engaging Capture Mode (Blocking) for" << session->label();
+    // This line blocks until the device is unplugged, an unrecoverable error
+    // occurs or the worker is asked to stop.
+    UsbRecoveryStats *stats = usbStatsFor(location.empty() ? deviceId : location);
+    connection.capture(session->stylus(), stats);
+
+    qDebug() << "[AutoConnect] <<< DISCONNECTED" << session->label();
+    qDebug().noquote() << "[AutoConnect]" << usbRecoveryReport();
+    qDebug().noquote() << "[AutoConnect]" << uinputIoReport();
+    qDebug().noquote() << "[AutoConnect]" << sheddingReport();
+    qDebug().noquote() << "[AutoConnect]" << sequenceReport();
+    qDebug().noquote() << "[AutoConnect]" << wireFormatReport();
+    qDebug().noquote() << "[AutoConnect]" << clockSyncReport();
+
+    destroySession(session->id());
+
+    // Handle Disconnect
+    QMetaObject::invokeMethod(this, [this](){
+        if (!refreshConnectionStatus()) {
+            updateStatus("Disconnected. Scanning...", false);
+        }
+    });
+
+    // The scan loop joins us and frees the port for the next attempt; its
+    // one second period doubles as the reconnect cooldown.
+    worker->finished = true;
+}
+
+void Backend::reapUsbWorkers(bool stopAll) {
+    std::vector<std::unique_ptr<UsbWorker>> done;
+    {
+        std::lock_guard<std::mutex> lock(m_usbWorkersMutex);
+        for (auto it = m_usbWorkers.begin(); it != m_usbWorkers.end();) {
+            if (stopAll) it->second->stop = true;
+            if (stopAll || it->second->finished) {
+                done.push_back(std::move(it->second));
+                it = m_usbWorkers.erase(it);
+            } else {
+                ++it;
+            }
         }
     }
-    qDebug() << "[AutoConnect] Loop exited.";
+
+    // Join outside the lock: a stopping worker may still be tearing down
+    // its session.
+    for (auto &worker : done) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+UsbRecoveryStats *Backend::usbStatsFor(const std::string &location) {
+    std::lock_guard<std::mutex> lock(m_usbStatsMutex);
+    auto &stats = m_usbStats[location];
+    if (!stats) stats = std::make_unique<UsbRecoveryStats>();
+    return stats.get();
 }
 
 void Backend::forceUsbReset() {
     qDebug() << "[Backend] User requested Manual USB Reset.";
     
-    // 1. Tell the background loop to stop capturing momentarily
-    InkBridge::stop_acc = true; 
-    
-    // 2. Find the device again to get a fresh handle for resetting
-    // We reuse the scanning logic essentially, but just to find the VID/PID
+    // 1. Find every accessory again to get a fresh handle for resetting.
+    // The capture threads notice the reset as a lost device, end their
+    // sessions and the scan loop picks the tablets up again once they
+    // re-enumerate.
     libusb_context *ctx = nullptr;
     if (libusb_init(&ctx) < 0) return;
 
@@ -527,37 +1019,80 @@ void Backend::forceUsbReset() {
                  libusb_reset_device(handle);
                  
                  libusb_close(handle);
-                 break; // Done
              }
         }
     }
 
     libusb_free_device_list(devs, 1);
     libusb_exit(ctx);
-    
-    // 3. Reset the stop flag so the loop can reconnect naturally
-    // We give it a small delay so the loop in the other thread has time to fail and reset
-    QTimer::singleShot(2000, this, [this](){
-        InkBridge::stop_acc = false;
-    });
 }
 
-QString Backend::scanForInkBridgeDevice() {
+QString Backend::uinputIoReport() const {
+    return QString::fromStdString(UinputWriter::report());
+}
+
+QString Backend::networkLatencyReport() const {
+    return m_wifiDirectServer ? m_wifiDirectServer->latencyReport() : QString();
+}
+
+QString Backend::usbRecoveryReport() const {
+    auto avgMs = [](uint64_t totalUs, uint64_t count) {
+        return count ? (double)totalUs / count / 1000.0 : 0.0;
+    };
+
+    // Sum over every tablet port seen so far.
+    uint64_t resubmits = 0, haltClears = 0, reclaims = 0, failed = 0, streaks = 0;
+    uint64_t recoveryTotal = 0, recoveryMax = 0;
+    uint64_t reconnects = 0, reconnectTotal = 0, reconnectMax = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_usbStatsMutex);
+        for (const auto &entry : m_usbStats) {
+            const UsbRecoveryStats &st = *entry.second;
+            resubmits      += st.resubmits;
+            haltClears     += st.haltClears;
+            reclaims       += st.reclaims;
+            failed         += st.failedRecoveries;
+            streaks        += st.recoveredStreaks;
+            recoveryTotal  += st.recoveryTimeTotalUs;
+            recoveryMax     = std::max<uint64_t>(recoveryMax, st.recoveryTimeMaxUs);
+            reconnects     += st.fullReconnects;
+            reconnectTotal += st.reconnectTimeTotalUs;
+            reconnectMax    = std::max<uint64_t>(reconnectMax, st.reconnectTimeMaxUs);
+        }
+    }
+
+    return QString("USB recovery: %1 in-place (resubmit %2, halt clear %3, re-claim %4), "
+                   "avg %5 ms / max %6 ms | %7 failed | %8 full reconnects, "
+                   "avg %9 ms / max %10 ms")
+        .arg(resubmits + haltClears + reclaims)
+        .arg(resubmits)
+        .arg(haltClears)
+        .arg(reclaims)
+        .arg(avgMs(recoveryTotal, streaks), 0, 'f', 2)
+        .arg(recoveryMax / 1000.0, 0, 'f', 2)
+        .arg(failed)
+        .arg(reconnects)
+        .arg(avgMs(reconnectTotal, reconnects), 0, 'f', 2)
+        .arg(reconnectMax / 1000.0, 0, 'f', 2);
+}
+
+std::vector<Backend::UsbCandidate> Backend::scanForInkBridgeDevices() {
     libusb_context *ctx = nullptr;
     libusb_device **devs = nullptr;
-    QString foundId = "";
+    std::vector<UsbCandidate> found;
+    bool handshakeSent = false;
 
     // 1. Initialize LibUSB
     if (libusb_init(&ctx) < 0) {
         qCritical() << "[AutoConnect] libusb_init failed!";
-        return "";
+        return found;
     }
 
     // 2. Get Device List
     ssize_t cnt = libusb_get_device_list(ctx, &devs);
     if (cnt < 0) { 
         libusb_exit(ctx); 
-        return ""; 
+        return found; 
     }
 
     for (ssize_t i = 0; i < cnt; i++) {
@@ -568,15 +1103,14 @@ QString Backend::scanForInkBridgeDevice() {
         // ======================================================
         // PATH A: The "Happy Path" (Already Connected)
         // ======================================================
-        // If the device is ALREADY a Google Accessory (0x18D1), we are done.
-        // We catch PIDs: 0x2D00 (Accessory), 0x2D01 (Accessory + ADB)
+        // If the device is ALREADY a Google Accessory (0x18D1), it can be
+        // captured. We catch PIDs: 0x2D00 (Accessory), 0x2D01 (Accessory + ADB)
+        // Keep scanning: several tablets may be attached.
         if (desc.idVendor == 0x18d1 && (desc.idProduct == 0x2d00 || desc.idProduct == 0x2d01)) {
              char idStr[16]; // Increased buffer size for safety
              snprintf(idStr, sizeof(idStr), "%04x:%04x", desc.idVendor, desc.idProduct);
-             foundId = QString(idStr);
-             
-             qDebug() << "[AutoConnect] Found active accessory:" << foundId;
-             break; // Stop scanning immediately
+             found.push_back({ idStr, InkBridge::UsbConnection::locationOf(dev) });
+             continue;
         }
 
         // ======================================================
@@ -603,23 +1137,19 @@ QString Backend::scanForInkBridgeDevice() {
         if (err == 0) {
             // Attempt to switch (Handshake)
             // If successful, the device will disconnect and reappear as Path A in ~2 seconds.
-            bool switched = trySwitchToAccessoryMode(dev, handle);
-            
+            handshakeSent |= trySwitchToAccessoryMode(dev, handle);
             libusb_close(handle);
-            
-            if (switched) {
-                qDebug() << "[AutoConnect] Handshake sent. Waiting for re-enumeration...";
-                // We don't return an ID here. We return "" and let the loop run again.
-                // The next scan (in 1-2 seconds) will catch it in Path A.
-                std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-                
-                // Optional: Break here to save CPU, since the device is rebooting anyway
-                break; 
-            }
         }
     }
 
     libusb_free_device_list(devs, 1);
     libusb_exit(ctx);
-    return foundId;
-}
\ No newline at end of file
+
+    if (handshakeSent) {
+        qDebug() << "[AutoConnect] Handshake sent. Waiting for re-enumeration...";
+        // The switched tablets are not returned here; the next scan (in 1-2
+        // seconds) will catch them in Path A.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+    }
+    return found;
+}
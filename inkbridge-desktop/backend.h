@@ -10,9 +10,15 @@
 #include <QDebug>
 #include <QtConcurrent/QtConcurrent>
 #include <QVariantList> 
+#include <QHash>
 #include <atomic> // REQUIRED
 #include <thread> // REQUIRED
 #include <chrono> // REQUIRED
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <libusb-1.0/libusb.h>
 #include "wifidirectserver.h"
 #include "virtualstylus.h"
@@ -20,6 +26,7 @@
 #include "displayscreentranslator.h"
 #include "pressuretranslator.h"
 #include "bluetoothserver.h"
+#include "stylussession.h"
 
 class Backend : public QObject
 {
@@ -33,7 +40,18 @@ class Backend : public QObject
     Q_PROPERTY(int pressureSensitivity READ pressureSensitivity NOTIFY settingsChanged)
     Q_PROPERTY(int minPressure READ minPressure NOTIFY settingsChanged)
     Q_PROPERTY(bool swapAxis READ swapAxis NOTIFY settingsChanged)
+    // Barrel button: 0 = BTN_STYLUS, 1 = BTN_STYLUS2, 2 = eraser (ButtonMapping)
+    Q_PROPERTY(int buttonMapping READ buttonMapping NOTIFY settingsChanged)
+    Q_PROPERTY(bool touchDebounce READ touchDebounce NOTIFY settingsChanged)
+    Q_PROPERTY(bool synDropGuard READ synDropGuard NOTIFY settingsChanged)
+    Q_PROPERTY(bool sharedStream READ sharedStream NOTIFY settingsChanged)
     Q_PROPERTY(bool isBluetoothRunning READ isBluetoothRunning NOTIFY bluetoothStatusChanged)
+    Q_PROPERTY(bool lowLatencyMode READ lowLatencyMode WRITE setLowLatencyMode NOTIFY lowLatencyModeChanged)
+    // One entry per connected tablet: { id, transport, peer, label, screen }
+    Q_PROPERTY(QVariantList sessions READ sessions NOTIFY sessionsChanged)
+    // Session the mapping/pressure controls apply to; -1 = all tablets.
+    Q_PROPERTY(int selectedSession READ selectedSession WRITE selectSession NOTIFY settingsChanged)
+    Q_PROPERTY(int selectedScreen READ selectedScreen NOTIFY settingsChanged)
 
 
 public:
@@ -50,12 +68,52 @@ public:
     int pressureSensitivity() const;
     int minPressure() const;
     bool swapAxis() const;
+    int buttonMapping() const;
+    bool touchDebounce() const;
+    bool synDropGuard() const;
+    bool sharedStream() const;
+    QVariantList sessions() const;
+    int selectedSession() const;
+    int selectedScreen() const;
+    bool lowLatencyMode() const;
 
     // --- NEW: Auto-Connect Public Methods ---
     Q_INVOKABLE void startAutoConnect();
     Q_INVOKABLE void stopAutoConnect();
     // NEW: The "Software Eject" button
     Q_INVOKABLE void forceUsbReset();
+    // Human-readable summary of in-place USB recoveries vs full reconnects.
+    Q_INVOKABLE QString usbRecoveryReport() const;
+    // Per-tablet injection latency (p50/p99/max) for WiFi Direct clients.
+    Q_INVOKABLE QString networkLatencyReport() const;
+    // Frames/syscalls/flush time of the uinput write path (write or io_uring).
+    Q_INVOKABLE QString uinputIoReport() const;
+    // Thread scheduling policies and wakeup jitter in normal vs low-latency mode.
+    Q_INVOKABLE QString schedulingReport() const;
+    // Per-tablet adaptive watchdog timeout and spurious lifts per hour.
+    Q_INVOKABLE QString watchdogReport() const;
+    // Hover-moves dropped because injection was lagging.
+    Q_INVOKABLE QString sheddingReport() const;
+    // Per-transport loss, duplicates and reordering of v2 sample sequences.
+    Q_INVOKABLE QString sequenceReport() const;
+    // Per-transport bytes per sample, compact-encoding share and decode cost.
+    Q_INVOKABLE QString wireFormatReport() const;
+    // What each connected tablet declared in its hello (or that it sent none).
+    Q_INVOKABLE QString handshakeReport() const;
+    // Per-transport clock offset/drift and true one-way latency (tablet event
+    // to desktop receive), for tablets that send device time.
+    Q_INVOKABLE QString clockSyncReport() const;
+    // Per-tablet debounced touch contacts and BTN_TOUCH flips held back.
+    Q_INVOKABLE QString touchReport() const;
+    // Per-tablet SYN_DROPPED incidents on the stylus device and whether hover
+    // output is currently paced because of them.
+    Q_INVOKABLE QString synDropReport() const;
+    // Per-tablet shared-memory stream name, attached readers and samples.
+    Q_INVOKABLE QString streamReport() const;
+
+    // Screen layout from somewhere other than QGuiApplication (the headless
+    // daemon's config file). refreshScreens() ends up here too.
+    void setScreens(const QVector<QRect> &rects, const QStringList &names);
 
     bool isBluetoothRunning() const;
 
@@ -69,10 +127,16 @@ public slots:
     void setPressureSensitivity(int value);
     void setMinPressure(int value);
     void setSwapAxis(bool swap);
+    void setButtonMapping(int mapping);
+    void setTouchDebounce(bool enable);
+    void setSynDropGuard(bool enable);
+    void setSharedStream(bool enable);
     void toggleWifiDirect();
     void toggleDebug(bool enable);
     void resetDefaults();
     void toggleBluetooth();
+    void selectSession(int sessionId);
+    void setLowLatencyMode(bool enable);
 
 signals:
     void screenListChanged();
@@ -82,11 +146,10 @@ signals:
     void wifiDirectStatusChanged();
     void settingsChanged();
     void bluetoothStatusChanged();
+    void sessionsChanged();
+    void lowLatencyModeChanged();
 
 private:
-    VirtualStylus *m_stylus;
-    DisplayScreenTranslator *m_displayTranslator;
-    PressureTranslator *m_pressureTranslator;
     WifiDirectServer *m_wifiDirectServer;
     BluetoothServer *m_bluetoothServer;
         
@@ -94,7 +157,9 @@ private:
     QVariantList m_screenGeometriesVariant;
     QStringList m_screenNames;
     QStringList m_usbDeviceIds;
+    QStringList m_usbDeviceLocations; // "bus-port.port", parallel to the ids
     QStringList m_usbDeviceNames;
+    QRect m_totalDesktopRect;
     
     QString m_status;
     bool m_connected;
@@ -102,21 +167,63 @@ private:
     bool m_bluetoothRunning;
     bool trySwitchToAccessoryMode(libusb_device *dev, libusb_device_handle *handle);
     
+    // Defaults: applied to every new session, and to all sessions when
+    // selectedSession is -1.
     int m_pressureSensitivity;
     int m_minPressure;
     bool m_swapAxis;
+    ButtonMapping m_buttonMapping = ButtonMapping::Stylus;
+    bool m_touchDebounce = true;
+    bool m_synDropGuard = false;
+    bool m_sharedStream = false;
+    int m_defaultScreen = 0;
 
     void updateStatus(QString msg, bool connected);
-    void handleWifiDirectData(QByteArray data);
-    void handleBluetoothData(QByteArray data);
+
+    // --- SESSIONS ---
+    // The registry lock only guards the map itself (create, destroy, and
+    // settings changes from the UI). It is never taken on the data path:
+    // each session ingests through its own thread and its own locks.
+    mutable std::mutex m_sessionsMutex;
+    std::map<int, std::unique_ptr<StylusSession>> m_sessions;
+    std::atomic<int> m_nextSessionId{1};
+    int m_selectedSession = -1;
+
+    StylusSession *createSession(SessionTransport transport, const QString &peer);
+    void destroySession(int sessionId);
+    void applySettings(StylusSession *session, bool includeScreen);
+    bool refreshConnectionStatus();
 
     // --- NEW: Auto-Connect Private Members ---
     std::atomic<bool> m_autoScanRunning;
     std::thread m_autoScanThread;
-    
+
+    // One capture thread per attached tablet, keyed by USB location.
+    struct UsbWorker {
+        std::thread       thread;
+        std::atomic<bool> stop{false};
+        std::atomic<bool> finished{false};
+    };
+    std::mutex m_usbWorkersMutex;
+    std::map<std::string, std::unique_ptr<UsbWorker>> m_usbWorkers;
+
+    // Per-location recovery counters (a location keeps its stats across
+    // reconnects so full reconnects can be measured).
+    mutable std::mutex m_usbStatsMutex;
+    std::map<std::string, std::unique_ptr<UsbRecoveryStats>> m_usbStats;
+    UsbRecoveryStats *usbStatsFor(const std::string &location);
+
+    struct UsbCandidate {
+        std::string deviceId;  // "vid:pid"
+        std::string location;  // "bus-port.port"
+    };
+
     // These were missing from your header, causing the error:
     void autoConnectLoop();
-    QString scanForInkBridgeDevice();
+    std::vector<UsbCandidate> scanForInkBridgeDevices();
+    void startUsbWorker(const std::string &deviceId, const std::string &location);
+    void runUsbCapture(UsbWorker *worker, std::string deviceId, std::string location);
+    void reapUsbWorkers(bool stopAll);
 };
 
 #endif // BACKEND_H
\ No newline at end of file
@@ -0,0 +1,375 @@
+// Per-sample processing in VirtualStylus: the compile-time StylusPipeline
+// (pipeline.h), one instantiation per combination of settings picked
+// through a function pointer, against the branchy path it replaced, which
+// tested the map and pressure settings on every sample.
+//
+// VirtualStylus needs Qt (QRect, QScreen), so both paths are copied here
+// onto a Qt-free stand-in that keeps what they spend time on: ToolFsm
+// transitions, PressureTranslator and a UinputWriter. Frames go to
+// /dev/null, as in uinput_write. The stages are VirtualStylus::Stages
+// without the debounce and pacing filters, which are off by default and
+// have no counterpart in the old path, and without the primary-screen map,
+// which needs QScreen.
+//
+//   pipeline [samples]   (default 2000000 per row)
+
+#include "pipeline.h"
+#include "toolfsm.h"
+#include "pressuretranslator.h"
+#include "uinputwriter.h"
+#include "uinput.h"
+#include "constants.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+static const int ACTION_HOVER_ENTER = 9;
+static const int ACTION_HOVER_EXIT  = 10;
+static const int BUTTON_BIT         = 32;
+
+enum class ButtonMapping { Stylus, Stylus2, Eraser };
+
+// The parts of QRect the map uses.
+struct Rect {
+    int left, top, width, height;
+    int right() const  { return left + width - 1; }
+    int bottom() const { return top + height - 1; }
+    bool isEmpty() const { return width <= 0 || height <= 0; }
+};
+
+struct Stylus;
+using Pipeline = void (*)(Stylus &, PenFrame &);
+
+// VirtualStylus's per-sample state. Screen 2 of a 1920 + 2560 desktop.
+struct Stylus {
+    UinputWriter       writer;
+    PressureTranslator pressureTranslator;
+    ToolFsm::State     toolState     = ToolFsm::Out;
+    int                buttonCode    = 0;
+    ButtonMapping      buttonMapping = ButtonMapping::Stylus;
+    Rect               screen  { 1920, 0, 2560, 1440 };
+    Rect               desktop { 0, 0, 4480, 1440 };
+    int                inputWidth  = 32767;
+    int                inputHeight = 32767;
+    bool               swapAxis    = false;
+    Pipeline           pipeline    = nullptr;
+
+    void applyTransition(ToolFsm::Input input) {
+        const ToolFsm::Transition &t = ToolFsm::transition(toolState, input);
+        if (t.leavesProximity && buttonCode != 0) {
+            writer.queue(ET_KEY, buttonCode, 0);
+            buttonCode = 0;
+        }
+        writer.append(t.events.data(), t.count);
+        toolState = t.next;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Before: one function, every setting tested per sample
+// ---------------------------------------------------------------------------
+static void branchy(Stylus &s, AccessoryEventData *e, uint64_t timestampUs) {
+    Error *err = new Error();
+
+    bool isButtonPressed = (e->action & BUTTON_BIT);
+    int  baseAction      =  e->action & ~BUTTON_BIT;
+    const bool eraserButton = (s.buttonMapping == ButtonMapping::Eraser);
+    const int  buttonCode   = (isButtonPressed && !eraserButton)
+        ? (s.buttonMapping == ButtonMapping::Stylus2 ? EC_KEY_STYLUS2 : EC_KEY_STYLUS)
+        : 0;
+    const bool eraser = (isButtonPressed && eraserButton) || e->toolType == ERASER_TOOL_TYPE;
+
+    bool isPositionEvent = (baseAction == ACTION_DOWN        ||
+                            baseAction == ACTION_MOVE        ||
+                            baseAction == ACTION_HOVER_MOVE  ||
+                            baseAction == ACTION_HOVER_ENTER ||
+                            baseAction == ACTION_UP);
+
+    if (isPositionEvent) {
+        bool isTouching = (baseAction == ACTION_DOWN || baseAction == ACTION_MOVE);
+        s.applyTransition(ToolFsm::positionInput(eraser, isTouching));
+
+        int32_t finalX = 0;
+        int32_t finalY = 0;
+        if (!s.screen.isEmpty() && s.inputWidth > 0 && s.inputHeight > 0) {
+            double calcX, calcY;
+            double maxInputX, maxInputY;
+            if (s.swapAxis) {
+                calcX     = e->y;
+                calcY     = s.inputWidth - e->x;
+                maxInputX = s.inputHeight;
+                maxInputY = s.inputWidth;
+            } else {
+                calcX     = e->x;
+                calcY     = e->y;
+                maxInputX = s.inputWidth;
+                maxInputY = s.inputHeight;
+            }
+            double xPercent      = calcX / maxInputX;
+            double yPercent      = calcY / maxInputY;
+            double monitorPixelX = s.screen.left + (xPercent * s.screen.width);
+            double monitorPixelY = s.screen.top  + (yPercent * s.screen.height);
+            if (monitorPixelX < s.screen.left)     monitorPixelX = s.screen.left;
+            if (monitorPixelX > s.screen.right())  monitorPixelX = s.screen.right();
+            if (monitorPixelY < s.screen.top)      monitorPixelY = s.screen.top;
+            if (monitorPixelY > s.screen.bottom()) monitorPixelY = s.screen.bottom();
+            double globalX = monitorPixelX - s.desktop.left;
+            double globalY = monitorPixelY - s.desktop.top;
+            finalX = (int32_t)((globalX / s.desktop.width)  * ABS_MAX_VAL);
+            finalY = (int32_t)((globalY / s.desktop.height) * ABS_MAX_VAL);
+        }
+
+        s.writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_X, finalX);
+        s.writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_Y, finalY);
+        if (isTouching) {
+            int p = s.pressureTranslator.getResultingPressure(e);
+            s.writer.queue(ET_KEY,      EC_KEY_TOUCH,         1);
+            s.writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, p);
+        } else {
+            s.writer.queue(ET_KEY,      EC_KEY_TOUCH,         0);
+            s.writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, 0);
+        }
+        s.writer.queue(ET_ABSOLUTE, ABS_TILT_X, e->tiltX);
+        s.writer.queue(ET_ABSOLUTE, ABS_TILT_Y, e->tiltY);
+
+        if (buttonCode != s.buttonCode) {
+            if (s.buttonCode != 0) s.writer.queue(ET_KEY, s.buttonCode, 0);
+            if (buttonCode   != 0) s.writer.queue(ET_KEY, buttonCode,   1);
+            s.buttonCode = buttonCode;
+        }
+    } else {
+        s.applyTransition(ToolFsm::Exit);
+    }
+
+    s.writer.queue(ET_MSC,  EC_MSC_TIMESTAMP, static_cast<int32_t>(static_cast<uint32_t>(timestampUs)));
+    s.writer.queue(ET_SYNC, EC_SYNC_REPORT,   0);
+    s.writer.flush(err);
+    delete err;
+}
+
+// ---------------------------------------------------------------------------
+// After: VirtualStylus::Stages
+// ---------------------------------------------------------------------------
+struct Stages {
+    struct Decode {
+        static bool apply(Stylus &s, PenFrame &f) {
+            const AccessoryEventData *e = f.event;
+            const bool isButtonPressed = (e->action & BUTTON_BIT);
+            const int  baseAction      =  e->action & ~BUTTON_BIT;
+            const bool eraserButton = (s.buttonMapping == ButtonMapping::Eraser);
+            f.buttonCode = (isButtonPressed && !eraserButton)
+                ? (s.buttonMapping == ButtonMapping::Stylus2 ? EC_KEY_STYLUS2 : EC_KEY_STYLUS)
+                : 0;
+            f.eraser = (isButtonPressed && eraserButton) || e->toolType == ERASER_TOOL_TYPE;
+            f.position = (baseAction == ACTION_DOWN        ||
+                          baseAction == ACTION_MOVE        ||
+                          baseAction == ACTION_HOVER_MOVE  ||
+                          baseAction == ACTION_HOVER_ENTER ||
+                          baseAction == ACTION_UP);
+            f.touching = (baseAction == ACTION_DOWN || baseAction == ACTION_MOVE);
+            return true;
+        }
+    };
+
+    template <bool Swapped>
+    struct MapToScreen {
+        static bool apply(Stylus &s, PenFrame &f) {
+            if (!f.position) return true;
+            const AccessoryEventData *e = f.event;
+            const Rect &screen  = s.screen;
+            const Rect &desktop = s.desktop;
+            double calcX, calcY;
+            double maxInputX, maxInputY;
+            if constexpr (Swapped) {
+                calcX     = e->y;
+                calcY     = s.inputWidth - e->x;
+                maxInputX = s.inputHeight;
+                maxInputY = s.inputWidth;
+            } else {
+                calcX     = e->x;
+                calcY     = e->y;
+                maxInputX = s.inputWidth;
+                maxInputY = s.inputHeight;
+            }
+            double xPercent      = calcX / maxInputX;
+            double yPercent      = calcY / maxInputY;
+            double monitorPixelX = screen.left + (xPercent * screen.width);
+            double monitorPixelY = screen.top  + (yPercent * screen.height);
+            if (monitorPixelX < screen.left)     monitorPixelX = screen.left;
+            if (monitorPixelX > screen.right())  monitorPixelX = screen.right();
+            if (monitorPixelY < screen.top)      monitorPixelY = screen.top;
+            if (monitorPixelY > screen.bottom()) monitorPixelY = screen.bottom();
+            double globalX = monitorPixelX - desktop.left;
+            double globalY = monitorPixelY - desktop.top;
+            f.x = (int32_t)((globalX / desktop.width)  * ABS_MAX_VAL);
+            f.y = (int32_t)((globalY / desktop.height) * ABS_MAX_VAL);
+            return true;
+        }
+    };
+
+    struct PressureCurve {
+        static bool apply(Stylus &s, PenFrame &f) {
+            f.pressure = f.touching ? s.pressureTranslator.getResultingPressure(f.event) : 0;
+            return true;
+        }
+    };
+
+    struct PressureLinear {
+        static bool apply(Stylus &s, PenFrame &f) {
+            f.pressure = f.touching ? s.pressureTranslator.getLinearPressure(f.event) : 0;
+            return true;
+        }
+    };
+
+    struct Emit {
+        static bool apply(Stylus &s, PenFrame &f) {
+            if (f.position) {
+                s.applyTransition(ToolFsm::positionInput(f.eraser, f.touching));
+                s.writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_X, f.x);
+                s.writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_Y, f.y);
+                s.writer.queue(ET_KEY,      EC_KEY_TOUCH,         f.touching ? 1 : 0);
+                s.writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, f.touching ? std::max(f.pressure, 1) : 0);
+                s.writer.queue(ET_ABSOLUTE, ABS_TILT_X, f.event->tiltX);
+                s.writer.queue(ET_ABSOLUTE, ABS_TILT_Y, f.event->tiltY);
+                if (f.buttonCode != s.buttonCode) {
+                    if (s.buttonCode != 0) s.writer.queue(ET_KEY, s.buttonCode, 0);
+                    if (f.buttonCode != 0) s.writer.queue(ET_KEY, f.buttonCode, 1);
+                    s.buttonCode = f.buttonCode;
+                }
+            } else {
+                s.applyTransition(ToolFsm::Exit);
+            }
+            Error err{};
+            s.writer.queue(ET_MSC,  EC_MSC_TIMESTAMP, static_cast<int32_t>(static_cast<uint32_t>(f.timestampUs)));
+            s.writer.queue(ET_SYNC, EC_SYNC_REPORT,   0);
+            s.writer.flush(&err);
+            f.injected = true;
+            return true;
+        }
+    };
+
+    // Index bit 0: linear pressure; bit 1: swapped axes.
+    template <int I>
+    using Chain = StylusPipeline<Decode,
+                                 MapToScreen<(I & 2) != 0>,
+                                 std::conditional_t<(I & 1) != 0, PressureLinear, PressureCurve>,
+                                 Emit>;
+
+    static constexpr int COUNT = 4;
+    template <int... I>
+    static constexpr std::array<Pipeline, COUNT> table(std::integer_sequence<int, I...>) {
+        return {{ &Chain<I>::template run<Stylus>... }};
+    }
+};
+
+static void selectPipeline(Stylus &s) {
+    static constexpr auto PIPELINES = Stages::table(std::make_integer_sequence<int, Stages::COUNT>{});
+    s.pipeline = PIPELINES[(s.swapAxis ? 2 : 0) | (s.pressureTranslator.isLinear() ? 1 : 0)];
+}
+
+// ---------------------------------------------------------------------------
+// Input and timing
+// ---------------------------------------------------------------------------
+
+// Strokes of about a second with hover before them; every fifth with the
+// eraser, every seventh with the barrel button held, every eighth followed
+// by the pen leaving proximity.
+static std::vector<AccessoryEventData> strokes(int count) {
+    std::vector<AccessoryEventData> samples;
+    samples.reserve(count);
+    for (int stroke = 0; static_cast<int>(samples.size()) < count; ++stroke) {
+        const int tool   = stroke % 5 == 4 ? ERASER_TOOL_TYPE : PEN_TOOL_TYPE;
+        const int button = stroke % 7 == 6 ? BUTTON_BIT : 0;
+        for (int i = -48; i <= 240; ++i) {
+            const double t = i / 240.0;
+            AccessoryEventData d{};
+            d.toolType = tool;
+            d.action   = (i < 0 ? ACTION_HOVER_MOVE : i == 0 ? ACTION_DOWN
+                          : i == 240 ? ACTION_UP : ACTION_MOVE) | button;
+            d.x        = 16000 + static_cast<int>(9000 * std::sin(2.3 * t + stroke));
+            d.y        = 16000 + static_cast<int>(7000 * std::sin(1.7 * t + 0.5 * stroke));
+            d.pressure = i >= 0 && i < 240 ? static_cast<float>(0.45 + 0.4 * std::sin(3.1 * t)) : 0.0f;
+            d.tiltX    = 20 + stroke % 9;
+            d.tiltY    = -10 + stroke % 5;
+            samples.push_back(d);
+        }
+        if (stroke % 8 == 7) {
+            AccessoryEventData exit{};
+            exit.toolType = tool;
+            exit.action   = ACTION_HOVER_EXIT;
+            samples.push_back(exit);
+        }
+    }
+    samples.resize(count);
+    return samples;
+}
+
+template <typename Step>
+static double nsPerSample(std::vector<AccessoryEventData> &samples, Step step) {
+    uint64_t timestampUs = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (AccessoryEventData &d : samples) step(&d, timestampUs += 4167);
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / samples.size();
+}
+
+int main(int argc, char **argv) {
+    const int count = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    std::vector<AccessoryEventData> samples = strokes(count);
+
+    const int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::perror("/dev/null");
+        return 1;
+    }
+
+    const struct { const char *name; int sensitivity; bool swapAxis; } rows[] = {
+        { "default",       50, false },
+        { "custom curve",  70, false },
+        { "swapped axes",  50, true  },
+    };
+
+    std::printf("%d samples per row, frames written to /dev/null\n", count);
+    std::printf("%14s %16s %16s %8s\n", "settings", "branchy ns", "pipeline ns", "ratio");
+    for (const auto &row : rows) {
+        Stylus before, after;
+        for (Stylus *s : { &before, &after }) {
+            s->writer.attach(fd);
+            s->pressureTranslator.sensitivity = row.sensitivity;
+            s->swapAxis = row.swapAxis;
+        }
+        selectPipeline(after);
+
+        // Warm up both, then time them in turn.
+        std::vector<AccessoryEventData> warm(samples.begin(), samples.begin() + std::min(count, 10000));
+        nsPerSample(warm, [&](AccessoryEventData *d, uint64_t ts) { branchy(before, d, ts); });
+        nsPerSample(warm, [&](AccessoryEventData *d, uint64_t ts) {
+            PenFrame frame;
+            frame.event = d;
+            frame.timestampUs = ts;
+            after.pipeline(after, frame);
+        });
+
+        const double old = nsPerSample(samples, [&](AccessoryEventData *d, uint64_t ts) {
+            branchy(before, d, ts);
+        });
+        const double now = nsPerSample(samples, [&](AccessoryEventData *d, uint64_t ts) {
+            PenFrame frame;
+            frame.event = d;
+            frame.timestampUs = ts;
+            after.pipeline(after, frame);
+        });
+        std::printf("%14s %16.1f %16.1f %8.2f\n", row.name, old, now, old / now);
+    }
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,216 @@
+// IngestReactor under load: N loopback TCP tablets each stream v2 samples
+// at a tablet's rate, staggered, into one reactor. Every connection gets a
+// sink doing what a StylusSession does on the shard thread (decode, shed,
+// control channel, one uinput-sized write per sample, to /dev/null here).
+//
+// Each sample carries its send time in x, so the sink measures send ->
+// injected per sample. Per-client p99 should stay flat as N grows until
+// the shards run out of CPU.
+//
+//   reactor_load [rateHz] [seconds]   (defaults: 240 Hz, 2 s per round)
+
+#include "ingestreactor.h"
+#include "streamdecoder.h"
+#include "hovershedder.h"
+#include "controlchannel.h"
+#include "uinputwriter.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+static constexpr uint16_t PORT = 47391;
+static constexpr int ACTION_MOVE = 2;
+static constexpr int PEN_TOOL    = 2;
+
+static uint32_t sendStamp() {
+    return static_cast<uint32_t>(HoverShedder::nowUs()) & 0x7FFFFFFF;
+}
+
+class LoadSink : public IngestSink
+{
+public:
+    explicit LoadSink(int devNull) : m_decoder(SequenceTracker::LinkWifiDirect) {
+        m_writer.attach(devNull);
+        m_latencyUs.reserve(4096);
+    }
+
+    void ingest(ByteRing &ring, uint64_t arrivedUs) override {
+        const uint8_t *first, *second;
+        size_t firstLen, secondLen;
+        ring.readable(first, firstLen, second, secondLen);
+        ring.consume(m_decoder.decode(first, firstLen, second, secondLen,
+                                      [this](AccessoryEventData &d) { m_shedder.push(d); },
+                                      [] {}));
+        m_shedder.drain(arrivedUs, [this](AccessoryEventData &d) { inject(d); });
+    }
+
+    void ingestDatagram(const uint8_t *, size_t, uint64_t) override {}
+
+    size_t controlTick(uint8_t *out) override {
+        return m_control.tick(m_shedder.samples(), m_shedder.shed(), out);
+    }
+    void   controlUnsent() override { m_control.markUnsent(); }
+    bool   controlUrgent() const override { return m_control.urgent(); }
+    size_t takeUrgentControl(uint8_t *out) override { return m_control.takeUrgent(out); }
+    void   setUdpOffer(uint16_t port, uint32_t token) override { m_control.setUdpOffer(port, token); }
+
+    // Read once the reactor has let go of the connection.
+    std::vector<uint32_t> &latencies() { return m_latencyUs; }
+
+private:
+    void inject(const AccessoryEventData &d) {
+        m_writer.queue(EV_ABS, ABS_X, d.x);
+        m_writer.queue(EV_ABS, ABS_Y, d.y);
+        m_writer.queue(EV_ABS, ABS_PRESSURE, static_cast<int>(d.pressure * 4096));
+        m_writer.queue(EV_ABS, ABS_TILT_X, d.tiltX);
+        m_writer.queue(EV_ABS, ABS_TILT_Y, d.tiltY);
+        m_writer.queue(EV_SYN, SYN_REPORT, 0);
+        Error err{};
+        m_writer.flush(&err);
+        m_latencyUs.push_back((sendStamp() - static_cast<uint32_t>(d.x)) & 0x7FFFFFFF);
+    }
+
+    PenStreamDecoder      m_decoder;
+    HoverShedder          m_shedder;
+    ControlChannel        m_control;
+    UinputWriter          m_writer;
+    std::vector<uint32_t> m_latencyUs;
+};
+
+static int connectClient() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(PORT);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+static uint32_t quantile(std::vector<uint32_t> &v, double q) {
+    if (v.empty()) return 0;
+    const size_t rank = std::min(v.size() - 1, static_cast<size_t>(q * v.size()));
+    std::nth_element(v.begin(), v.begin() + rank, v.end());
+    return v[rank];
+}
+
+int main(int argc, char **argv) {
+    const int    rateHz  = argc > 1 ? std::atoi(argv[1]) : 240;
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 2.0;
+    const int    devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+    std::mutex sinksMutex;
+    std::map<int, std::unique_ptr<LoadSink>> sinks;   // by client id, kept after disconnect
+
+    IngestReactor::Callbacks callbacks;
+    callbacks.onConnect = [&](int clientId, const std::string &) -> IngestSink * {
+        std::lock_guard<std::mutex> lock(sinksMutex);
+        return (sinks[clientId] = std::make_unique<LoadSink>(devNull)).get();
+    };
+    callbacks.onDisconnect = [](int, IngestSink *) {};
+
+    // The reactor logs every connect and disconnect; keep the table readable.
+    std::ostringstream reactorLog;
+    std::streambuf *console = std::cout.rdbuf(reactorLog.rdbuf());
+    IngestReactor reactor(std::move(callbacks));
+    if (!reactor.start(PORT)) {
+        std::cout.rdbuf(console);
+        std::cerr << "cannot listen on port " << PORT << std::endl;
+        return 1;
+    }
+
+    std::printf("%u CPU(s), %d Hz per client, %.1f s per round\n",
+                std::thread::hardware_concurrency(), rateHz, seconds);
+    std::printf("%8s %10s %14s %14s %14s %10s\n", "clients", "samples",
+                "p50 (median)", "p99 (median)", "p99 (worst)", "max");
+
+    for (int clients : { 1, 2, 4, 8, 16, 32, 64 }) {
+        {
+            std::lock_guard<std::mutex> lock(sinksMutex);
+            sinks.clear();
+        }
+        std::vector<int> fds;
+        for (int i = 0; i < clients; ++i) {
+            const int fd = connectClient();
+            if (fd < 0) { std::cerr << "connect failed" << std::endl; return 1; }
+            fds.push_back(fd);
+        }
+        while (reactor.clientCount() < clients) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        // Client i sends at t0 + k * period + i * period / N.
+        using namespace std::chrono;
+        const auto period = nanoseconds(1000000000LL / rateHz);
+        const auto slot   = period / clients;
+        const int  rounds = static_cast<int>(seconds * rateHz);
+        auto next = steady_clock::now();
+        for (int k = 0; k < rounds; ++k) {
+            for (int i = 0; i < clients; ++i) {
+                std::this_thread::sleep_until(next);
+                next += slot;
+
+                PenPacketV2 packet{};
+                packet.marker          = PEN_PACKET_V2;
+                packet.sequence        = static_cast<uint16_t>(k);
+                packet.sample.toolType = PEN_TOOL;
+                packet.sample.action   = ACTION_MOVE;
+                packet.sample.x        = static_cast<int32_t>(sendStamp());
+                packet.sample.y        = k;
+                packet.sample.pressure = 2048;
+                if (send(fds[i], &packet, sizeof(packet), MSG_NOSIGNAL) != sizeof(packet)) {
+                    std::cerr << "send failed" << std::endl;
+                    return 1;
+                }
+            }
+        }
+
+        // Half-close first: closing with unread control frames would reset
+        // the connection and could discard the last samples in flight.
+        for (int fd : fds) shutdown(fd, SHUT_WR);
+        while (reactor.clientCount() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (int fd : fds) close(fd);
+
+        std::vector<uint32_t> p50s, p99s;
+        uint32_t maxUs = 0;
+        size_t samples = 0;
+        {
+            std::lock_guard<std::mutex> lock(sinksMutex);
+            for (auto &entry : sinks) {
+                std::vector<uint32_t> &lat = entry.second->latencies();
+                samples += lat.size();
+                if (lat.empty()) continue;
+                maxUs = std::max(maxUs, *std::max_element(lat.begin(), lat.end()));
+                p50s.push_back(quantile(lat, 0.50));
+                p99s.push_back(quantile(lat, 0.99));
+            }
+        }
+        std::printf("%8d %10zu %11u us %11u us %11u us %7u us\n", clients, samples,
+                    quantile(p50s, 0.5), quantile(p99s, 0.5),
+                    p99s.empty() ? 0 : *std::max_element(p99s.begin(), p99s.end()), maxUs);
+        std::fflush(stdout);
+    }
+
+    reactor.stop();
+    std::cout.rdbuf(console);
+    close(devNull);
+    return 0;
+}
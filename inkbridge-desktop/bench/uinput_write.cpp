@@ -0,0 +1,101 @@
+// uinput injection cost per frame: one write() per event (how VirtualStylus
+// injected before UinputWriter) against UinputWriter's one write() per
+// frame, or one io_uring submission when built with INKBRIDGE_IO_URING.
+//
+// Writes to a real uinput stylus when /dev/uinput can be opened, otherwise
+// to /dev/null; the latter measures the syscall overhead only, which is the
+// part batching removes, but not the kernel's per-event input handling.
+//
+//   uinput_write [frames]   (default 200000 per row)
+
+#include "uinput.h"
+#include "uinputwriter.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct FrameShape {
+    const char *name;
+    int         events;   // including the closing SYN_REPORT
+};
+
+// A pen move (X, Y, touch, pressure, two tilts, timestamp, SYN) and a tool
+// swap (the three-phase proximity change plus the same axes).
+static const FrameShape SHAPES[] = { { "move", 8 }, { "tool swap", 16 } };
+
+static void eventAt(int i, int last, int value, int &type, int &code, int &out) {
+    static const int CODES[] = { ABS_X, ABS_Y, ABS_PRESSURE, ABS_TILT_X, ABS_TILT_Y };
+    if (i == last) { type = EV_SYN; code = SYN_REPORT; out = 0; return; }
+    if (i % 6 == 5) { type = EV_KEY; code = BTN_TOUCH; out = value & 1; return; }
+    type = EV_ABS;
+    code = CODES[i % 6 % 5];
+    out  = value;
+}
+
+static double perEventWrite(int fd, const FrameShape &shape, int frames) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        for (int i = 0; i < shape.events; ++i) {
+            int type, code, value;
+            eventAt(i, shape.events - 1, f, type, code, value);
+            Error err{};
+            send_uinput_event(fd, type, code, value, &err);
+        }
+    }
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+static double batched(UinputWriter &writer, const FrameShape &shape, int frames) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        for (int i = 0; i < shape.events; ++i) {
+            int type, code, value;
+            eventAt(i, shape.events - 1, f, type, code, value);
+            writer.queue(type, code, value);
+        }
+        Error err{};
+        writer.flush(&err);
+    }
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+int main(int argc, char **argv) {
+    const int frames = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    Error err{};
+    int fd = init_uinput_stylus("inkbridge-bench", &err);
+    const bool real = fd >= 0 && err.code == 0;
+    if (!real) {
+        if (fd >= 0) close(fd);
+        fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    }
+
+    UinputWriter writer;
+    writer.attach(fd);
+    std::printf("target: %s, batched backend: %s, %d frames per row\n",
+                real ? "uinput" : "/dev/null (no /dev/uinput)",
+                writer.usingIoUring() ? "io_uring" : "write()", frames);
+    std::printf("%10s %8s %18s %18s %8s\n", "frame", "events", "write per event",
+                "batched", "speedup");
+
+    for (const FrameShape &shape : SHAPES) {
+        perEventWrite(fd, shape, frames / 10);   // warm up
+        batched(writer, shape, frames / 10);
+        const double before = perEventWrite(fd, shape, frames);
+        const double after  = batched(writer, shape, frames);
+        std::printf("%10s %8d %13.0f ns/f %13.0f ns/f %7.1fx\n", shape.name, shape.events,
+                    before, after, before / after);
+    }
+    std::printf("%s\n", UinputWriter::report().c_str());
+
+    writer.detach();
+    if (real) destroy_uinput_device(fd);
+    else close(fd);
+    return 0;
+}
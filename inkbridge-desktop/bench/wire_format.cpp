@@ -0,0 +1,131 @@
+// Wire format cost: bytes per sample and decode time per sample for the
+// same synthetic handwriting sent as v1 PenPackets, v2 PenPacketV2s and the
+// compact format (key frame every 64 samples and on every state change,
+// deltas in between, as protocol.h recommends).
+//
+// The strokes follow what TouchListener sends: x and y normalised to
+// 0-32767, pressure 0-4096, tilt in degrees, 240 Hz, hovering between
+// strokes. Device timestamps are left out of all three.
+//
+//   wire_format [seconds] [passes]   (defaults: 20 s of writing, 200 passes)
+
+#include "wirefixtures.h"
+#include "streamdecoder.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using Wire::Bytes;
+
+static constexpr int RATE_HZ    = 240;
+static constexpr int PEN        = 2;
+static constexpr int DOWN       = 0;
+static constexpr int UP         = 1;
+static constexpr int MOVE       = 2;
+static constexpr int HOVER_MOVE = 7;
+
+// Strokes of 0.3-1.2 s with 0.2 s of hover between them, each a Lissajous
+// curve of its own size and speed.
+static std::vector<PenPacket> handwriting(double seconds) {
+    std::vector<PenPacket> samples;
+    const int total = static_cast<int>(seconds * RATE_HZ);
+    int stroke = 0;
+    while (static_cast<int>(samples.size()) < total) {
+        const int    length = RATE_HZ * (3 + stroke % 10) / 10;
+        const double cx = 8000 + (stroke * 3001) % 16000, cy = 8000 + (stroke * 1777) % 16000;
+        const double ax = 600 + (stroke % 7) * 250, ay = 400 + (stroke % 5) * 300;
+        const double fx = 1.1 + (stroke % 3) * 0.7, fy = 1.9 + (stroke % 4) * 0.5;
+
+        for (int i = -RATE_HZ / 5; i <= length; ++i) {
+            const double t = static_cast<double>(i) / RATE_HZ;
+            const bool touching = i >= 0 && i < length;
+            const int action = i < 0 ? HOVER_MOVE : i == 0 ? DOWN : i == length ? UP : MOVE;
+            samples.push_back(Wire::sample(
+                PEN, touching || i == length ? action : HOVER_MOVE,
+                static_cast<int>(cx + ax * std::sin(2 * M_PI * fx * t)),
+                static_cast<int>(cy + ay * std::sin(2 * M_PI * fy * t + 0.7)),
+                touching ? static_cast<int>(2000 + 900 * std::sin(2 * M_PI * 0.8 * t)) : 0,
+                static_cast<int>(20 + 8 * std::sin(0.9 * t)),
+                static_cast<int>(-10 + 6 * std::cos(0.7 * t))));
+        }
+        ++stroke;
+    }
+    samples.resize(total);
+    return samples;
+}
+
+static Bytes encodeV1(const std::vector<PenPacket> &samples) {
+    Bytes out;
+    for (const PenPacket &p : samples) Wire::v1(out, p);
+    return out;
+}
+
+static Bytes encodeV2(const std::vector<PenPacket> &samples) {
+    Bytes out;
+    uint16_t seq = 0;
+    for (const PenPacket &p : samples) Wire::v2(out, seq++, p);
+    return out;
+}
+
+static Bytes encodeCompact(const std::vector<PenPacket> &samples, size_t &keyframes) {
+    Bytes out;
+    uint16_t seq = 0;
+    int sinceKey = 0;
+    keyframes = 0;
+    for (size_t i = 0; i < samples.size(); ++i, ++seq) {
+        const PenPacket &p = samples[i];
+        const bool stateChange = i == 0 || p.action != samples[i - 1].action ||
+                                 p.toolType != samples[i - 1].toolType;
+        if (stateChange || ++sinceKey >= 64) {
+            Wire::keyframe(out, seq, p);
+            sinceKey = 0;
+            ++keyframes;
+        } else {
+            Wire::delta(out, samples[i - 1], p);
+        }
+    }
+    return out;
+}
+
+// Decode time per sample over 'passes' runs of a fresh decoder.
+static double decodeNs(const Bytes &stream, size_t samples, int passes) {
+    size_t decoded = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < passes; ++i) {
+        PenStreamDecoder decoder;
+        decoder.feed(stream.data(), stream.size(),
+                     [&](AccessoryEventData &) { ++decoded; }, [] {});
+    }
+    const double ns = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+    if (decoded != samples * passes) {
+        std::fprintf(stderr, "decoded %zu of %zu samples\n", decoded, samples * passes);
+    }
+    return ns / decoded;
+}
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 20.0;
+    const int    passes  = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    const std::vector<PenPacket> samples = handwriting(seconds);
+    size_t keyframes = 0;
+    const Bytes v1 = encodeV1(samples);
+    const Bytes v2 = encodeV2(samples);
+    const Bytes compact = encodeCompact(samples, keyframes);
+
+    std::printf("%zu samples (%.0f s at %d Hz), %zu key frames in compact\n",
+                samples.size(), seconds, RATE_HZ, keyframes);
+    std::printf("%10s %14s %14s %16s\n", "format", "bytes/sample", "kbit/s", "decode ns/sample");
+    const struct { const char *name; const Bytes *stream; } rows[] = {
+        { "v1", &v1 }, { "v2", &v2 }, { "compact", &compact } };
+    for (const auto &row : rows) {
+        const double perSample = static_cast<double>(row.stream->size()) / samples.size();
+        std::printf("%10s %14.2f %14.1f %16.1f\n", row.name, perSample,
+                    perSample * 8 * RATE_HZ / 1000.0, decodeNs(*row.stream, samples.size(), passes));
+    }
+    return 0;
+}
@@ -1,6 +1,15 @@
 #include "bluetoothserver.h"
+#include "stylussession.h"
+#include <QBluetoothAddress>
 #include <QBluetoothLocalDevice>
+#include <QBluetoothServiceInfo>
 #include <QDebug>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/rfcomm.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
 
 // Standard SPP UUID — must match BluetoothStreamService.kt on Android.
 const QBluetoothUuid BluetoothServer::SPP_UUID =
@@ -15,6 +24,11 @@ BluetoothServer::~BluetoothServer() {
     stopServer();
 }
 
+void BluetoothServer::setSessionCallbacks(SessionFactory factory, SessionRelease release) {
+    m_sessionFactory = std::move(factory);
+    m_sessionRelease = std::move(release);
+}
+
 bool BluetoothServer::startServer() {
     if (m_running) {
         qDebug() << "[BT Server] Already running, ignoring start request.";
@@ -36,23 +50,30 @@ bool BluetoothServer::startServer() {
     // but only while the server is actively listening.
     localDevice.setHostMode(QBluetoothLocalDevice::HostDiscoverable);
 
-    // Create the RFCOMM server socket.
-    m_server = new QBluetoothServer(QBluetoothServiceInfo::RfcommProtocol, this);
-
-    connect(m_server, &QBluetoothServer::newConnection,
-            this,     &BluetoothServer::onClientConnected);
-
-    // Listen on the SPP UUID. Qt registers the SDP service record
-    // automatically, so Android can discover it by UUID without needing
-    // a hardcoded channel number.
-    if (!m_server->listen(localDevice.address())) {
+    // Create the RFCOMM server socket. Channel 0 lets the kernel pick a
+    // free one on listen(); the SDP record below tells Android which.
+    m_listenFd = ::socket(AF_BLUETOOTH, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, BTPROTO_RFCOMM);
+    sockaddr_rc addr{};
+    addr.rc_family  = AF_BLUETOOTH;
+    addr.rc_channel = 0;
+    socklen_t addrLen = sizeof(addr);
+    if (m_listenFd < 0 ||
+        ::bind(m_listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        ::listen(m_listenFd, 4) < 0 ||
+        ::getsockname(m_listenFd, reinterpret_cast<sockaddr *>(&addr), &addrLen) < 0) {
+        qDebug() << "[BT Server] RFCOMM listen failed:" << strerror(errno);
         emit serverError("Failed to open RFCOMM server socket. "
                          "Check that Bluetooth is enabled and no other "
                          "app is using the SPP channel.");
-        delete m_server;
-        m_server = nullptr;
+        if (m_listenFd >= 0) ::close(m_listenFd);
+        m_listenFd = -1;
         return false;
     }
+    const quint8 channel = addr.rc_channel;
+
+    m_acceptNotifier = new QSocketNotifier(m_listenFd, QSocketNotifier::Read, this);
+    connect(m_acceptNotifier, &QSocketNotifier::activated,
+            this,             &BluetoothServer::onClientConnected);
 
     // Register the SDP service record so the Android SPP client can
     // locate us by the standard UUID during discovery.
@@ -76,13 +97,13 @@ bool BluetoothServer::startServer() {
     protocolList.append(QVariant::fromValue(protocol));
     protocol.clear();
     protocol << QVariant::fromValue(QBluetoothUuid(QBluetoothUuid::ProtocolUuid::Rfcomm))
-             << QVariant::fromValue(quint8(m_server->serverPort()));
+             << QVariant::fromValue(channel);
     protocolList.append(QVariant::fromValue(protocol));
     serviceInfo.setAttribute(QBluetoothServiceInfo::ProtocolDescriptorList, protocolList);
     serviceInfo.registerService(localDevice.address());
 
     m_running = true;
-    qDebug() << "[BT Server] Listening on RFCOMM channel" << m_server->serverPort()
+    qDebug() << "[BT Server] Listening on RFCOMM channel" << channel
              << "| Address:" << localDevice.address().toString();
 
     return true;
@@ -94,19 +115,15 @@ void BluetoothServer::stopServer() {
     qDebug() << "[BT Server] Stopping...";
     m_running = false;
 
-    // Disconnect and destroy the active client socket first.
-    if (m_socket) {
-        m_socket->disconnectFromService();
-        m_socket->deleteLater();
-        m_socket = nullptr;
-    }
+    // Stop accepting, then stop every reader and release its session. A
+    // reader that already reported its tablet gone has its queued
+    // dropClient() find nothing left to do.
+    delete m_acceptNotifier;
+    m_acceptNotifier = nullptr;
+    if (m_listenFd >= 0) ::close(m_listenFd);
+    m_listenFd = -1;
 
-    // Close the server socket.
-    if (m_server) {
-        m_server->close();
-        m_server->deleteLater();
-        m_server = nullptr;
-    }
+    while (!m_clients.empty()) dropClient(m_clients.begin()->first);
 
     // Return adapter to connectable (not discoverable) mode.
     QBluetoothLocalDevice localDevice;
@@ -122,8 +139,11 @@ bool BluetoothServer::isRunning() const {
 }
 
 bool BluetoothServer::isClientConnected() const {
-    return m_socket != nullptr &&
-           m_socket->state() == QBluetoothSocket::SocketState::ConnectedState;
+    return !m_clients.empty();
+}
+
+int BluetoothServer::clientCount() const {
+    return static_cast<int>(m_clients.size());
 }
 
 // ---------------------------------------------------------------------------
@@ -131,73 +151,83 @@ bool BluetoothServer::isClientConnected() const {
 // ---------------------------------------------------------------------------
 
 void BluetoothServer::onClientConnected() {
-    if (!m_server) return;
-
-    // If a client is already connected, reject the new one. Only one
-    // Android device should be driving input at a time.
-    QBluetoothSocket *pending = m_server->nextPendingConnection();
-    if (!pending) return;
-
-    if (m_socket && m_socket->state() == QBluetoothSocket::SocketState::ConnectedState) {
-        qDebug() << "[BT Server] Second client rejected — already have an active connection.";
-        pending->disconnectFromService();
-        pending->deleteLater();
-        return;
-    }
+    if (m_listenFd < 0) return;
+
+    // Accept every pending connection. Each Android device drives its own
+    // virtual stylus, so a second tablet is no longer rejected.
+    while (true) {
+        sockaddr_rc peer{};
+        socklen_t   peerLen = sizeof(peer);
+        int fd = ::accept4(m_listenFd, reinterpret_cast<sockaddr *>(&peer), &peerLen, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                qDebug() << "[BT Server] accept failed:" << strerror(errno);
+            }
+            return;
+        }
 
-    // Accept the connection.
-    m_socket = pending;
-    m_socket->setParent(this);
-
-    connect(m_socket, &QBluetoothSocket::readyRead,
-            this,     &BluetoothServer::onDataReady);
-    connect(m_socket, &QBluetoothSocket::disconnected,
-            this,     &BluetoothServer::onClientDisconnected);
-    // QBluetoothSocket::errorOccurred was introduced in Qt 6.2.
-    // For compatibility with Qt 5 and early Qt 6, we use a version guard.
-#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
-    connect(m_socket, &QBluetoothSocket::errorOccurred,
-            this,     &BluetoothServer::onSocketError);
-#else
-    connect(m_socket, QOverload<QBluetoothSocket::SocketError>::of(&QBluetoothSocket::error),
-            this,     &BluetoothServer::onSocketError);
-#endif
-
-    QString address = m_socket->peerAddress().toString();
-    qDebug() << "[BT Server] Client connected:" << address;
-    emit clientConnected(address);
-}
+        // bdaddr_t is stored least significant byte first.
+        quint64 raw = 0;
+        for (int i = 5; i >= 0; --i) raw = (raw << 8) | peer.rc_bdaddr.b[i];
+        const QString address = QBluetoothAddress(raw).toString();
+
+        auto client = std::make_unique<Client>();
+        client->clientId = m_nextClientId++;
+        client->session  = m_sessionFactory ? m_sessionFactory(client->clientId, address) : nullptr;
+        if (!client->session) {
+            ::close(fd);
+            continue;
+        }
 
-void BluetoothServer::onClientDisconnected() {
-    qDebug() << "[BT Server] Client disconnected.";
+        // The callbacks run on the reader thread and only touch this
+        // client's session and reader, which outlive the thread.
+        StylusSession *session = client->session;
+        RfcommReader::Callbacks callbacks;
+        callbacks.onData = [session, &reader = client->reader](ByteRing &ring, uint64_t arrivedUs) {
+            session->ingest(ring, arrivedUs);
+            // A hello is acked now rather than on the next tick.
+            if (session->controlUrgent()) {
+                uint8_t frames[ControlChannel::MAX_BYTES];
+                size_t n = session->takeUrgentControl(frames);
+                if (n > 0 && !reader->send(frames, n)) session->controlUnsent();
+            }
+        };
+        callbacks.onTick = [session, &reader = client->reader] {
+            uint8_t frames[ControlChannel::MAX_BYTES];
+            size_t n = session->controlTick(frames);
+            if (n > 0 && !reader->send(frames, n)) session->controlUnsent();
+        };
+        const int clientId = client->clientId;
+        callbacks.onClosed = [this, clientId] {
+            QMetaObject::invokeMethod(this, [this, clientId] { dropClient(clientId); },
+                                      Qt::QueuedConnection);
+        };
+        client->reader = std::make_unique<RfcommReader>(fd, std::move(callbacks));
+
+        if (!client->reader->start()) {
+            client->reader.reset();
+            if (m_sessionRelease) m_sessionRelease(client->session);
+            continue;
+        }
+        m_clients.emplace(clientId, std::move(client));
 
-    if (m_socket) {
-        m_socket->deleteLater();
-        m_socket = nullptr;
+        qDebug() << "[BT Server] Client" << clientId << "connected:" << address;
+        emit clientConnected(clientId, address);
     }
-
-    emit clientDisconnected();
 }
 
-void BluetoothServer::onDataReady() {
-    if (!m_socket) return;
+void BluetoothServer::dropClient(int clientId) {
+    auto it = m_clients.find(clientId);
+    if (it == m_clients.end()) return;
 
-    // Read all available bytes and emit them. Backend's handleBluetoothData()
-    // handles the packet framing, exactly as handleWifiData() does.
-    // We loop in case multiple chunks are queued.
-    while (m_socket->bytesAvailable() > 0) {
-        QByteArray data = m_socket->readAll();
-        if (!data.isEmpty()) {
-            emit dataReceived(data);
-        }
-    }
-}
+    std::unique_ptr<Client> client = std::move(it->second);
+    m_clients.erase(it);
 
-void BluetoothServer::onSocketError(QBluetoothSocket::SocketError error) {
-    QString msg = m_socket ? m_socket->errorString() : "Unknown socket error";
-    qDebug() << "[BT Server] Socket error" << error << ":" << msg;
+    // Joins the reader, so the session is no longer referenced after this.
+    client->reader.reset();
+    if (m_sessionRelease) m_sessionRelease(client->session);
 
-    // Treat any socket error as a disconnect — the client will reconnect.
-    onClientDisconnected();
-    emit serverError(msg);
-}
\ No newline at end of file
+    qDebug() << "[BT Server] Client" << clientId << "disconnected.";
+    emit clientDisconnected(clientId);
+}
@@ -2,27 +2,32 @@
 #define BLUETOOTHSERVER_H
 
 #include <QObject>
-#include <QBluetoothServer>
-#include <QBluetoothSocket>
-#include <QBluetoothAddress>
 #include <QBluetoothUuid>
-#include <QByteArray>
+#include <QSocketNotifier>
+#include <functional>
+#include <map>
+#include <memory>
+#include "rfcommreader.h"
+
+class StylusSession;
 
 /**
  * BluetoothServer
  *
- * Opens an RFCOMM server socket using Qt Bluetooth and waits for the
- * Android client to connect. Once connected it reads the incoming byte
- * stream and emits dataReceived() for every chunk of data, exactly as
- * WifiServer does — so Backend can use an identical handler.
+ * Opens a native BlueZ RFCOMM server socket and waits for Android clients
+ * to connect. Every connected tablet gets a clientId and a StylusSession
+ * from the session factory, exactly as WifiDirectServer does.
  *
  * The well-known SPP UUID is used so the Android client can find the
  * service without any manual configuration. This UUID must match the
  * one in BluetoothStreamService.kt on the Android side.
  *
- * Threading: QBluetoothServer and QBluetoothSocket are event-driven and
- * live on the Qt event loop thread. No manual threading is needed here —
- * Qt handles async I/O internally, unlike the USB path which is blocking.
+ * Threading: accepting runs on the Qt event loop (a QSocketNotifier on the
+ * listening socket); it is rare and cheap. Each accepted socket is handed
+ * to its own RfcommReader thread, which reads, decodes and injects without
+ * going through the event loop, and sends that tablet's control frames.
+ * When the tablet goes away the reader reports it back to the Qt thread,
+ * which joins it and releases the session.
  */
 class BluetoothServer : public QObject
 {
@@ -32,44 +37,56 @@ public:
     explicit BluetoothServer(QObject *parent = nullptr);
     ~BluetoothServer();
 
+    // Called on the Qt thread when a tablet connects / after its reader has
+    // stopped.
+    using SessionFactory = std::function<StylusSession *(int clientId, QString address)>;
+    using SessionRelease = std::function<void(StylusSession *session)>;
+    void setSessionCallbacks(SessionFactory factory, SessionRelease release);
+
     // Starts listening for incoming RFCOMM connections.
     // Returns true if the server socket was opened successfully.
     bool startServer();
 
-    // Closes the server and disconnects any active client.
+    // Closes the server and disconnects every active client.
     void stopServer();
 
     bool isRunning() const;
     bool isClientConnected() const;
+    int  clientCount() const;
 
     // The SPP UUID — must match BluetoothStreamService.kt on Android.
     static const QBluetoothUuid SPP_UUID;
 
 signals:
-    // Emitted whenever raw bytes arrive from the Android client.
-    // Backend connects this to its handleBluetoothData() slot,
-    // identical to the WifiServer → handleWifiData() pattern.
-    void dataReceived(QByteArray data);
-
     // Emitted when a client connects, with its Bluetooth address as a string.
-    void clientConnected(QString address);
+    void clientConnected(int clientId, QString address);
 
-    // Emitted when the active client disconnects.
-    void clientDisconnected();
+    // Emitted when a client disconnects.
+    void clientDisconnected(int clientId);
 
     // Emitted if the server encounters an unrecoverable error.
     void serverError(QString message);
 
 private slots:
     void onClientConnected();
-    void onClientDisconnected();
-    void onDataReady();
-    void onSocketError(QBluetoothSocket::SocketError error);
 
 private:
-    QBluetoothServer  *m_server  = nullptr;
-    QBluetoothSocket  *m_socket  = nullptr;  // The currently connected client
-    bool               m_running = false;
+    struct Client {
+        int                           clientId = 0;
+        StylusSession                *session  = nullptr;
+        std::unique_ptr<RfcommReader> reader;
+    };
+
+    int              m_listenFd = -1;
+    QSocketNotifier *m_acceptNotifier = nullptr;
+    std::map<int, std::unique_ptr<Client>> m_clients; // clientId -> client, Qt thread only
+    int              m_nextClientId = 1;
+    bool             m_running = false;
+
+    SessionFactory   m_sessionFactory;
+    SessionRelease   m_sessionRelease;
+
+    void dropClient(int clientId);
 };
 
 #endif // BLUETOOTHSERVER_H
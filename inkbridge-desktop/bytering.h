@@ -0,0 +1,88 @@
+#ifndef BYTERING_H
+#define BYTERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+
+/**
+ * @brief Receive ring for one network connection.
+ *
+ * The socket reads straight into the free space (writable() hands out up
+ * to two iovecs for readv()), and the decoder works on the filled space in
+ * place (readable() returns it as one or two spans, two when it wraps).
+ * Bytes a decoder cannot use yet (the start of a record whose rest is
+ * still in flight) simply stay where they are until the next read, so
+ * nothing is copied between recv() and the sample decode.
+ *
+ * Storage is borrowed (e.g. from IngestReactor's buffer pool) and its size
+ * must be a power of two. Single producer, single consumer: the indices
+ * are atomics, so the reading and decoding thread may differ, although
+ * every current transport does both on one thread.
+ */
+class ByteRing
+{
+public:
+    ByteRing() = default;
+    ByteRing(uint8_t *storage, size_t capacity) { attach(storage, capacity); }
+
+    void attach(uint8_t *storage, size_t capacity) {
+        m_data = storage;
+        m_mask = capacity - 1;
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+    }
+
+    uint8_t *storage() const  { return m_data; }
+    size_t   capacity() const { return m_mask + 1; }
+    size_t   size() const {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    // Producer: free space as up to two iovecs. Returns how many are used
+    // (0 when full).
+    int writable(iovec iov[2]) const {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t free = capacity() - (head - m_tail.load(std::memory_order_acquire));
+        if (free == 0) {
+            iov[0].iov_base = m_data;
+            iov[0].iov_len  = 0;
+            return 0;
+        }
+        const size_t at    = head & m_mask;
+        const size_t first = free < capacity() - at ? free : capacity() - at;
+        iov[0].iov_base = m_data + at;
+        iov[0].iov_len  = first;
+        if (first == free) return 1;
+        iov[1].iov_base = m_data;
+        iov[1].iov_len  = free - first;
+        return 2;
+    }
+
+    void commit(size_t n) { m_head.store(m_head.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+    // Consumer: the filled space as 'first' (up to the end of the storage)
+    // and 'second' (the wrapped part, often empty).
+    void readable(const uint8_t *&first, size_t &firstLen,
+                  const uint8_t *&second, size_t &secondLen) const {
+        const size_t tail  = m_tail.load(std::memory_order_relaxed);
+        const size_t used  = m_head.load(std::memory_order_acquire) - tail;
+        const size_t at    = tail & m_mask;
+        firstLen  = used < capacity() - at ? used : capacity() - at;
+        first     = m_data + at;
+        second    = m_data;
+        secondLen = used - firstLen;
+    }
+
+    void consume(size_t n) { m_tail.store(m_tail.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+private:
+    uint8_t            *m_data = nullptr;
+    size_t              m_mask = 0;
+    // Free-running byte counts; only their difference and low bits matter.
+    std::atomic<size_t> m_head{0};   // written by the producer
+    std::atomic<size_t> m_tail{0};   // written by the consumer
+};
+
+#endif // BYTERING_H
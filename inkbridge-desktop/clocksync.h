@@ -0,0 +1,130 @@
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "latencyhistogram.h"
+#include "sequencetracker.h"
+
+/**
+ * @brief Maps tablet device time to the desktop's steady clock.
+ *
+ * NTP-style: every ping/pong exchange gives four times, t0 (ping left the
+ * desktop), t1 (ping reached the tablet), t2 (pong left the tablet) and t3
+ * (pong reached the desktop). From them:
+ *
+ *   offset = ((t1 - t0) + (t2 - t3)) / 2     device minus host
+ *   delay  = (t3 - t0) - (t2 - t1)            round trip on the wire
+ *
+ * An exchange that sat in a queue has a long delay and a skewed offset, so
+ * the estimate uses the minimum-delay exchange of the last FILTER_SIZE
+ * (NTP's clock filter). Drift is the slope between the best exchange of the
+ * older and the newer half of HISTORY, once they are far enough apart; it
+ * corrects for the two crystals running at slightly different rates
+ * between pings.
+ *
+ * One instance per connection, owned by the decoder (ingest thread). The
+ * per-link Stats are atomics for the UI thread.
+ */
+class ClockSync
+{
+public:
+    static constexpr int     HISTORY        = 16;
+    static constexpr int     FILTER_SIZE    = 8;
+    static constexpr int64_t MIN_DRIFT_SPAN = 4000000;  // us between estimates
+    static constexpr double  MAX_DRIFT_PPM  = 500.0;
+    static constexpr int     LATENCY_BUCKETS = 24;      // log2 us
+
+    struct Stats {
+        std::atomic<uint64_t> exchanges{0};
+        std::atomic<int64_t>  offsetUs{0};
+        std::atomic<int64_t>  driftPpb{0};       // parts per billion
+        std::atomic<int64_t>  minDelayUs{0};
+        LatencyHistogram<LATENCY_BUCKETS> latency;  // one-way latency samples
+    };
+
+    static Stats& stats(int link) {
+        static Stats s[SequenceTracker::LINK_COUNT];
+        return s[link >= 0 && link < SequenceTracker::LINK_COUNT ? link : 0];
+    }
+
+    explicit ClockSync(int link = SequenceTracker::LinkUsb) : m_stats(stats(link)) {}
+
+    void addExchange(int64_t t0, int64_t t1, int64_t t2, int64_t t3) {
+        const int64_t delay = (t3 - t0) - (t2 - t1);
+        if (delay < 0 || t3 < t0) return;  // clocks or echo are nonsense
+
+        Exchange &e = m_history[m_next];
+        e.hostUs   = t0 + (t3 - t0) / 2;
+        e.offsetUs = ((t1 - t0) + (t2 - t3)) / 2;
+        e.delayUs  = delay;
+        m_next = (m_next + 1) % HISTORY;
+        if (m_count < HISTORY) ++m_count;
+
+        // Clock filter over the newest FILTER_SIZE exchanges.
+        const Exchange *best = nullptr;
+        for (int i = 0; i < m_count && i < FILTER_SIZE; ++i) {
+            const Exchange &c = at(i);
+            if (!best || c.delayUs < best->delayUs) best = &c;
+        }
+        m_ref = *best;
+
+        // Drift between the best of the older and newer half of the history.
+        if (m_count == HISTORY) {
+            const Exchange *newer = nullptr, *older = nullptr;
+            for (int i = 0; i < HISTORY; ++i) {
+                const Exchange &c = at(i);
+                const Exchange *&slot = i < HISTORY / 2 ? newer : older;
+                if (!slot || c.delayUs < slot->delayUs) slot = &c;
+            }
+            const int64_t span = newer->hostUs - older->hostUs;
+            if (span >= MIN_DRIFT_SPAN) {
+                double drift = static_cast<double>(newer->offsetUs - older->offsetUs) / span;
+                const double limit = MAX_DRIFT_PPM / 1e6;
+                m_drift = drift > limit ? limit : (drift < -limit ? -limit : drift);
+            }
+        }
+        m_synced = true;
+
+        m_stats.exchanges.fetch_add(1, std::memory_order_relaxed);
+        m_stats.offsetUs.store(m_ref.offsetUs, std::memory_order_relaxed);
+        m_stats.driftPpb.store(static_cast<int64_t>(m_drift * 1e9), std::memory_order_relaxed);
+        m_stats.minDelayUs.store(m_ref.delayUs, std::memory_order_relaxed);
+    }
+
+    bool synced() const { return m_synced; }
+
+    // Host steady-clock time of a device time. Only valid once synced().
+    int64_t toHost(int64_t deviceUs) const {
+        const int64_t approxHost = deviceUs - m_ref.offsetUs;
+        const double  offset = m_ref.offsetUs + m_drift * static_cast<double>(approxHost - m_ref.hostUs);
+        return deviceUs - static_cast<int64_t>(offset);
+    }
+
+    // Time from the tablet seeing a sample to the desktop receiving it.
+    void recordOneWay(int64_t latencyUs) {
+        if (latencyUs < 0) latencyUs = 0;  // within the estimate's error
+        m_stats.latency.add(static_cast<uint64_t>(latencyUs));
+    }
+
+private:
+    struct Exchange {
+        int64_t hostUs   = 0;  // midpoint of the exchange, host clock
+        int64_t offsetUs = 0;
+        int64_t delayUs  = 0;
+    };
+
+    // i = 0 is the newest exchange.
+    const Exchange &at(int i) const { return m_history[(m_next - 1 - i + HISTORY) % HISTORY]; }
+
+    Stats   &m_stats;
+    std::array<Exchange, HISTORY> m_history{};
+    int      m_next   = 0;
+    int      m_count  = 0;
+    Exchange m_ref;
+    double   m_drift  = 0.0;
+    bool     m_synced = false;
+};
+
+#endif // CLOCKSYNC_H
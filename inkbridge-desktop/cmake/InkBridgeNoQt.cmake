@@ -0,0 +1,30 @@
+# The Qt-free part of the core as a static library, shared by tests/ and
+# bench/. Both include this file; the library is only defined once.
+if(NOT TARGET inkbridge_noqt)
+    set(INKBRIDGE_SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR}/..)
+    find_package(Threads REQUIRED)
+
+    add_library(inkbridge_noqt STATIC
+        ${INKBRIDGE_SOURCE_DIR}/uinputwriter.cpp
+        ${INKBRIDGE_SOURCE_DIR}/ingestreactor.cpp
+        ${INKBRIDGE_SOURCE_DIR}/rfcommreader.cpp
+        ${INKBRIDGE_SOURCE_DIR}/rtsched.cpp
+        ${INKBRIDGE_SOURCE_DIR}/pressuretranslator.cpp
+        ${INKBRIDGE_SOURCE_DIR}/stylusstream.cpp
+        ${INKBRIDGE_SOURCE_DIR}/uinput.c
+        ${INKBRIDGE_SOURCE_DIR}/error.c
+    )
+    target_include_directories(inkbridge_noqt PUBLIC ${INKBRIDGE_SOURCE_DIR})
+    target_link_libraries(inkbridge_noqt PUBLIC Threads::Threads)
+    target_compile_options(inkbridge_noqt PRIVATE -Wall -Wextra -Wpedantic)
+
+    # Same switch as the app. PUBLIC: it changes UinputWriter's layout.
+    option(INKBRIDGE_IO_URING "Inject uinput frames through io_uring" OFF)
+    if(INKBRIDGE_IO_URING)
+        find_package(PkgConfig REQUIRED)
+        pkg_check_modules(LIBURING REQUIRED liburing)
+        target_compile_definitions(inkbridge_noqt PUBLIC INKBRIDGE_HAVE_IO_URING)
+        target_include_directories(inkbridge_noqt PUBLIC ${LIBURING_INCLUDE_DIRS})
+        target_link_libraries(inkbridge_noqt PUBLIC ${LIBURING_LIBRARIES})
+    endif()
+endif()
@@ -14,6 +14,8 @@ const int EC_SYNC_REPORT = 0;
 const int EC_KEY_TOOL_PEN = 0x140;
 const int EC_KEY_TOOL_RUBBER = 0x141;
 const int EC_KEY_TOUCH = 0x14a;
+const int EC_KEY_STYLUS = 0x14b;
+const int EC_KEY_STYLUS2 = 0x14c;
 
 const int EC_ABSOLUTE_X = 0x00;
 const int EC_ABSOLUTE_Y = 0x01;
@@ -0,0 +1,141 @@
+#ifndef CONTROLCHANNEL_H
+#define CONTROLCHANNEL_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include "protocol.h"
+#include "flowcontroller.h"
+#include "handshake.h"
+
+/**
+ * @brief Everything the desktop sends back to one tablet.
+ *
+ * The transports only know how to move bytes; this class decides which
+ * control frames are due. tick() is called about once per second by the
+ * thread that owns the connection and writes the frames into 'out'
+ * (at least MAX_BYTES long):
+ *   - a ProtocolVersionFrame when the connection is new, so a capable
+ *     tablet may switch to sequence-numbered or compact samples,
+ *   - a HelloAck once the tablet has sent its TabletHello, followed by a
+ *     UdpOfferFrame if the transport offered one and FEATURE_UDP was agreed,
+ *   - a PingFrame, if the tablet agreed to FEATURE_DEVICE_TIME (one also
+ *     goes with the ack, so the clocks are synced early),
+ *   - a FlowControlFrame whenever FlowController has something to say.
+ *
+ * The ack should not wait for the next tick: after ingesting, a transport
+ * that can send from the ingest thread checks urgent() and calls
+ * takeUrgent(). acceptHello() may run on a different thread than tick().
+ *
+ * If the caller could not send the bytes it calls markUnsent() and the same
+ * frames are produced again on the next tick. Every frame is idempotent, so
+ * resending one the tablet already had is harmless.
+ */
+class ControlChannel
+{
+public:
+    static constexpr size_t MAX_BYTES = sizeof(ProtocolVersionFrame) + sizeof(HelloAck) +
+                                        sizeof(UdpOfferFrame) + sizeof(PingFrame) +
+                                        sizeof(FlowControlFrame);
+
+    size_t tick(uint64_t samples, uint64_t shed, uint8_t *out) {
+        const bool acked = m_ackPending.load(std::memory_order_relaxed);
+        size_t len = takeUrgent(out);
+        if (!acked && m_pingEnabled.load(std::memory_order_relaxed)) len += writePing(out + len);
+
+        FlowControlFrame flow;
+        if (m_flow.tick(samples, shed, flow)) {
+            std::memcpy(out + len, &flow, sizeof(flow));
+            len += sizeof(flow);
+        }
+        return len;
+    }
+
+    // Records the tablet's hello; the ack goes out with the next
+    // takeUrgent() or tick().
+    void acceptHello(const TabletHello &hello) {
+        std::lock_guard<std::mutex> lock(m_ackMutex);
+        m_ack = Handshake::negotiate(hello);
+        m_haveAck = true;
+        m_pingEnabled = (m_ack.features & FEATURE_DEVICE_TIME) != 0;
+        m_ackPending = true;
+    }
+
+    // A UDP port and token the tablet may send samples to (WiFi Direct).
+    // Call before the connection starts ingesting.
+    void setUdpOffer(uint16_t port, uint32_t token) {
+        std::lock_guard<std::mutex> lock(m_ackMutex);
+        m_udpOffer.type   = CONTROL_UDP_OFFER;
+        m_udpOffer.length = sizeof(UdpOfferFrame) - 2;
+        m_udpOffer.port   = port;
+        m_udpOffer.token  = token;
+        m_haveUdpOffer    = true;
+    }
+
+    bool urgent() const { return m_ackPending.load(std::memory_order_relaxed); }
+
+    // The version advertisement and a pending ack, without ticking the flow
+    // controller. Returns the bytes written to 'out'.
+    size_t takeUrgent(uint8_t *out) {
+        size_t len = 0;
+
+        if (!m_versionSent) {
+            ProtocolVersionFrame version;
+            version.type       = CONTROL_VERSION;
+            version.length     = sizeof(ProtocolVersionFrame) - 2;
+            version.maxVersion = PROTOCOL_VERSION_MAX;
+            version.features   = Handshake::DESKTOP_FEATURES;
+            std::memcpy(out + len, &version, sizeof(version));
+            len += sizeof(version);
+            m_versionSent = true;
+        }
+
+        if (m_ackPending.exchange(false)) {
+            std::lock_guard<std::mutex> lock(m_ackMutex);
+            std::memcpy(out + len, &m_ack, sizeof(m_ack));
+            len += sizeof(m_ack);
+            if (m_haveUdpOffer && (m_ack.features & FEATURE_UDP)) {
+                std::memcpy(out + len, &m_udpOffer, sizeof(m_udpOffer));
+                len += sizeof(m_udpOffer);
+            }
+            if (m_pingEnabled) len += writePing(out + len);
+        }
+        return len;
+    }
+
+    void markUnsent() {
+        m_versionSent = false;
+        m_flow.markUnsent();
+        std::lock_guard<std::mutex> lock(m_ackMutex);
+        if (m_haveAck) m_ackPending = true;
+    }
+
+    const FlowController &flow() const { return m_flow; }
+
+private:
+    static size_t writePing(uint8_t *out) {
+        PingFrame ping;
+        ping.type       = CONTROL_PING;
+        ping.length     = sizeof(PingFrame) - 2;
+        // Same clock as HoverShedder::nowUs(); the pong echoes it back.
+        ping.hostSendUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::memcpy(out, &ping, sizeof(ping));
+        return sizeof(ping);
+    }
+
+    FlowController    m_flow;
+    bool              m_versionSent = false;
+
+    std::mutex        m_ackMutex;   // m_ack, m_haveAck, m_udpOffer, m_haveUdpOffer
+    HelloAck          m_ack{};
+    bool              m_haveAck = false;
+    UdpOfferFrame     m_udpOffer{};
+    bool              m_haveUdpOffer = false;
+    std::atomic<bool> m_ackPending{false};
+    std::atomic<bool> m_pingEnabled{false};
+};
+
+#endif // CONTROLCHANNEL_H
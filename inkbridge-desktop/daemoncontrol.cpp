@@ -0,0 +1,335 @@
+#include "daemoncontrol.h"
+#include "backend.h"
+#include "procstats.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMetaMethod>
+#include <QMetaProperty>
+#include <QSettings>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <unistd.h>
+#include <cctype>
+
+// Backend properties that are settings (everything else is status).
+static const char *const SETTINGS[] = {
+    "pressureSensitivity", "minPressure", "swapAxis", "buttonMapping",
+    "touchDebounce", "synDropGuard", "sharedStream", "lowLatencyMode",
+};
+
+static bool parseBool(const QString &value, bool *ok) {
+    const QString v = value.trimmed().toLower();
+    *ok = true;
+    if (v == "on"  || v == "true"  || v == "1" || v == "yes") return true;
+    if (v == "off" || v == "false" || v == "0" || v == "no")  return false;
+    *ok = false;
+    return false;
+}
+
+DaemonControl::DaemonControl(Backend *backend, QObject *parent)
+    : QObject(parent)
+    , m_backend(backend)
+{
+}
+
+DaemonControl::~DaemonControl() {
+    if (m_server) m_server->close();
+}
+
+QString DaemonControl::defaultConfigPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
+         + "/inkbridge/inkbridged.conf";
+}
+
+QString DaemonControl::defaultSocketPath() {
+    const QString runtime = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (!runtime.isEmpty()) return runtime + "/inkbridged.sock";
+    return QString("/tmp/inkbridged-%1.sock").arg(getuid());
+}
+
+// ---------------------------------------------------------------------------
+// Config file
+// ---------------------------------------------------------------------------
+bool DaemonControl::loadConfig(const QString &path, QString *socketPath) {
+    if (!QFileInfo::exists(path)) {
+        qDebug() << "[Daemon] No config at" << path << "- using defaults";
+        return true;
+    }
+    QSettings config(path, QSettings::IniFormat);
+    if (config.status() != QSettings::NoError) {
+        qDebug() << "[Daemon] Cannot parse" << path;
+        return false;
+    }
+
+    // QSettings splits unquoted values at commas; the keys here want the
+    // raw text back.
+    auto raw = [&config](const QString &key) {
+        const QVariant v = config.value(key);
+        return v.canConvert<QStringList>() && v.toStringList().size() > 1
+            ? v.toStringList().join(",") : v.toString();
+    };
+
+    bool ok = true;
+    // Layout before the screen index, listeners last so a tablet that
+    // connects at once already gets the configured settings.
+    QStringList keys = config.childKeys();
+    QStringList ordered;
+    for (const char *first : {"screens", "session"}) {
+        if (keys.removeAll(first)) ordered << first;
+    }
+    QStringList last;
+    for (const char *listener : {"wifiDirect", "bluetooth"}) {
+        if (keys.removeAll(listener)) last << listener;
+    }
+    ordered << keys << last;
+
+    for (const QString &key : ordered) {
+        if (key == "socket") {
+            if (socketPath) *socketPath = raw(key);
+            continue;
+        }
+        const QString reply = set(key, raw(key));
+        if (reply != "ok") {
+            qDebug().noquote() << "[Daemon]" << path << key << "->" << reply;
+            ok = false;
+        }
+    }
+    qDebug() << "[Daemon] Loaded" << path;
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Control socket
+// ---------------------------------------------------------------------------
+bool DaemonControl::listen(const QString &path) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QLocalServer::removeServer(path);
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server->listen(path)) {
+        qDebug() << "[Daemon] Cannot listen on" << path << ":" << m_server->errorString();
+        return false;
+    }
+    connect(m_server, &QLocalServer::newConnection, this, &DaemonControl::onNewConnection);
+    qDebug() << "[Daemon] Control socket" << path;
+    return true;
+}
+
+void DaemonControl::onNewConnection() {
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { serve(socket); });
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void DaemonControl::serve(QLocalSocket *socket) {
+    while (socket->canReadLine()) {
+        const QString line = QString::fromUtf8(socket->readLine()).trimmed();
+        if (line.isEmpty()) continue;
+        socket->write((execute(line) + "\n\n").toUtf8());
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Commands
+// ---------------------------------------------------------------------------
+QString DaemonControl::execute(const QString &line) {
+    const QStringList words = line.split(' ', Qt::SkipEmptyParts);
+    if (words.isEmpty()) return "error: empty command";
+    const QString cmd = words[0].toLower();
+    const QString arg = words.mid(1).join(' ');
+
+    if (cmd == "status")   return status();
+    if (cmd == "settings") {
+        QStringList lines{"ok"};
+        for (const QString &name : settingNames()) lines << name + " " + get(name);
+        return lines.join("\n");
+    }
+    if (cmd == "get") {
+        const QString value = get(arg);
+        return value.isNull() ? "error: unknown setting '" + arg + "'" : "ok\n" + value;
+    }
+    if (cmd == "set") {
+        if (words.size() < 3) return "error: usage: set <setting> <value>";
+        return set(words[1], words.mid(2).join(' '));
+    }
+    if (cmd == "reports") return "ok\n" + reportNames().join("\n");
+    if (cmd == "report")  return report(arg);
+    if (cmd == "wifi")      return set("wifiDirect", arg);
+    if (cmd == "bluetooth") return set("bluetooth", arg);
+    if (cmd == "reset-defaults") {
+        m_backend->resetDefaults();
+        return "ok";
+    }
+    if (cmd == "usb-reset") {
+        m_backend->forceUsbReset();
+        return "ok";
+    }
+    if (cmd == "help") {
+        return "ok\n"
+               "status | settings | get <setting> | set <setting> <value>\n"
+               "reports | report <name> | wifi on|off | bluetooth on|off\n"
+               "reset-defaults | usb-reset\n"
+               "settings: " + settingNames().join(", ");
+    }
+    return "error: unknown command '" + cmd + "' (try help)";
+}
+
+QStringList DaemonControl::settingNames() const {
+    QStringList names;
+    for (const char *name : SETTINGS) names << name;
+    names << "wifiDirect" << "bluetooth" << "screens" << "screen" << "session" << "debug";
+    return names;
+}
+
+QString DaemonControl::get(const QString &key) const {
+    if (key == "wifiDirect") return m_backend->isWifiDirectRunning() ? "on" : "off";
+    if (key == "bluetooth")  return m_backend->isBluetoothRunning() ? "on" : "off";
+    if (key == "screen")     return QString::number(m_backend->selectedScreen());
+    if (key == "session")    return QString::number(m_backend->selectedSession());
+    if (key == "debug")      return Backend::isDebugMode ? "on" : "off";
+    if (key == "screens") {
+        QStringList rects;
+        for (const QVariant &v : m_backend->screenGeometries()) {
+            const QVariantMap m = v.toMap();
+            rects << QString("%1,%2,%3,%4").arg(m["x"].toInt()).arg(m["y"].toInt())
+                                           .arg(m["width"].toInt()).arg(m["height"].toInt());
+        }
+        return rects.isEmpty() ? QString("none") : rects.join(' ');
+    }
+    for (const char *name : SETTINGS) {
+        if (key != name) continue;
+        const QVariant v = m_backend->property(name);
+        if (v.userType() == QMetaType::Bool) return v.toBool() ? "on" : "off";
+        return v.toString();
+    }
+    return QString();
+}
+
+QString DaemonControl::set(const QString &key, const QString &value) {
+    bool ok = false;
+
+    if (key == "wifiDirect" || key == "bluetooth") {
+        const bool on = parseBool(value, &ok);
+        if (!ok) return "error: expected on or off";
+        const bool running = key == "wifiDirect" ? m_backend->isWifiDirectRunning()
+                                                 : m_backend->isBluetoothRunning();
+        if (on != running) {
+            if (key == "wifiDirect") m_backend->toggleWifiDirect();
+            else                     m_backend->toggleBluetooth();
+        }
+        const bool now = key == "wifiDirect" ? m_backend->isWifiDirectRunning()
+                                             : m_backend->isBluetoothRunning();
+        return now == on ? "ok" : "error: " + m_backend->connectionStatus();
+    }
+    if (key == "debug") {
+        const bool on = parseBool(value, &ok);
+        if (!ok) return "error: expected on or off";
+        m_backend->toggleDebug(on);
+        return "ok";
+    }
+    if (key == "screens") {
+        QVector<QRect> rects;
+        for (const QString &rect : value.split(QRegularExpression("[\\s;]+"), Qt::SkipEmptyParts)) {
+            const QStringList n = rect.split(',');
+            bool okX, okY, okW, okH;
+            if (n.size() != 4) return "error: expected x,y,w,h per screen";
+            QRect r(n[0].toInt(&okX), n[1].toInt(&okY), n[2].toInt(&okW), n[3].toInt(&okH));
+            if (!okX || !okY || !okW || !okH || r.isEmpty()) return "error: bad screen '" + rect + "'";
+            rects << r;
+        }
+        m_backend->setScreens(rects, QStringList());
+        return "ok";
+    }
+    if (key == "screen" || key == "session") {
+        const int index = value.toInt(&ok);
+        if (!ok) return "error: expected a number";
+        if (key == "screen") {
+            if (index < 0 || index >= m_backend->screenGeometries().size())
+                return "error: no screen " + value + " (set screens first)";
+            m_backend->selectScreen(index);
+        } else {
+            m_backend->selectSession(index);
+            if (index != -1 && m_backend->selectedSession() != index)
+                return "error: no tablet with id " + value;
+        }
+        return "ok";
+    }
+
+    for (const char *name : SETTINGS) {
+        if (key != name) continue;
+        const QMetaObject *meta = m_backend->metaObject();
+        const QMetaProperty prop = meta->property(meta->indexOfProperty(name));
+        QVariant v;
+        const bool isBool = prop.userType() == QMetaType::Bool;
+        if (isBool) {
+            v = parseBool(value, &ok);
+            if (!ok) return "error: expected on or off";
+        } else {
+            v = value.toInt(&ok);
+            if (!ok) return "error: expected a number";
+        }
+        if (prop.isWritable()) {
+            prop.write(m_backend, v);
+            return "ok";
+        }
+        // Read-only properties are written through their set<Name> slot,
+        // as the UI does.
+        QByteArray slot = QByteArray("set") + name;
+        slot[3] = static_cast<char>(std::toupper(slot[3]));
+        const bool invoked = isBool
+            ? QMetaObject::invokeMethod(m_backend, slot.constData(), Qt::DirectConnection, Q_ARG(bool, v.toBool()))
+            : QMetaObject::invokeMethod(m_backend, slot.constData(), Qt::DirectConnection, Q_ARG(int, v.toInt()));
+        return invoked ? "ok" : "error: no setter for " + key;
+    }
+    return "error: unknown setting '" + key + "'";
+}
+
+// ---------------------------------------------------------------------------
+// Status and reports
+// ---------------------------------------------------------------------------
+QString DaemonControl::status() const {
+    QStringList lines{"ok"};
+    lines << "status: " + m_backend->connectionStatus()
+          << QString("connected: %1").arg(m_backend->isConnected() ? "yes" : "no")
+          << "wifiDirect: " + get("wifiDirect")
+          << "bluetooth: " + get("bluetooth");
+    const QVariantList sessions = m_backend->sessions();
+    lines << QString("sessions: %1 (selected %2)").arg(sessions.size()).arg(m_backend->selectedSession());
+    for (const QVariant &v : sessions) {
+        const QVariantMap m = v.toMap();
+        lines << QString("  %1: %2, screen %3").arg(m["id"].toInt()).arg(m["label"].toString())
+                                              .arg(m["screen"].toInt());
+    }
+    lines << QString("rss: %1 KiB").arg(ProcStats::rssKiB());
+    if (m_startupMs >= 0) lines << QString("startup: %1 ms").arg(m_startupMs, 0, 'f', 0);
+    return lines.join("\n");
+}
+
+// Every Q_INVOKABLE QString fooReport() const on Backend, as "foo".
+QStringList DaemonControl::reportNames() const {
+    QStringList names;
+    const QMetaObject *meta = m_backend->metaObject();
+    for (int i = meta->methodOffset(); i < meta->methodCount(); ++i) {
+        const QMetaMethod method = meta->method(i);
+        const QByteArray name = method.name();
+        if (method.methodType() == QMetaMethod::Method && method.parameterCount() == 0
+            && method.returnType() == QMetaType::QString && name.endsWith("Report")) {
+            names << QString::fromLatin1(name.left(name.size() - 6));
+        }
+    }
+    return names;
+}
+
+QString DaemonControl::report(const QString &name) const {
+    if (!reportNames().contains(name)) return "error: unknown report '" + name + "' (try reports)";
+    QString out;
+    const QByteArray method = (name + "Report").toLatin1();
+    QMetaObject::invokeMethod(m_backend, method.constData(), Qt::DirectConnection,
+                              Q_RETURN_ARG(QString, out));
+    return "ok\n" + out;
+}
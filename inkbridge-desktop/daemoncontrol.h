@@ -0,0 +1,88 @@
+#ifndef DAEMONCONTROL_H
+#define DAEMONCONTROL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class Backend;
+class QLocalServer;
+class QLocalSocket;
+
+/**
+ * DaemonControl — settings and status for the headless daemon (inkbridged),
+ * from its config file and over a Unix socket.
+ *
+ * Everything goes through Backend, exactly as the QML UI does: settings are
+ * its Q_PROPERTYs (same names, e.g. pressureSensitivity, touchDebounce),
+ * written through the matching slot, and reports are its Q_INVOKABLE
+ * *Report() methods.
+ *
+ * PROTOCOL: one command per line (UTF-8). Every reply starts with "ok" or
+ * "error: <reason>", may carry more lines, and ends with an empty line.
+ *
+ *   status                     connection, sessions, listeners, footprint
+ *   get <setting>              current value (selected tablet, or defaults)
+ *   set <setting> <value>      bool: on/off/true/false/1/0; int otherwise
+ *   settings                   every setting and its value
+ *   reports                    the report names
+ *   report <name>              e.g. "report touch" -> Backend::touchReport()
+ *   wifi on|off, bluetooth on|off
+ *   reset-defaults, usb-reset, help
+ *
+ * Besides the Backend properties, set (and the config file) accept:
+ *   wifiDirect, bluetooth      on/off, start or stop the listener
+ *   screens                    "x,y,w,h x,y,w,h ...": the desktop layout,
+ *                              since the daemon has no display connection
+ *   screen                     index into 'screens' for the selected tablet
+ *   session                    tablet id the settings apply to, -1 = all
+ *   debug                      on/off
+ *
+ * The CONFIG FILE is INI without sections, the same keys and values:
+ *   screens = 0,0,1920,1080 1920,0,2560,1440
+ *   screen = 1
+ *   pressureSensitivity = 60
+ *   wifiDirect = on
+ *   socket = /run/inkbridged.sock    (config only)
+ */
+class DaemonControl : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DaemonControl(Backend *backend, QObject *parent = nullptr);
+    ~DaemonControl();
+
+    // Applies every key of the config file. Returns false (and logs) if the
+    // file does not parse or a key is rejected; the rest is still applied.
+    bool loadConfig(const QString &path, QString *socketPath);
+    // Owner-only socket; replaces a stale one left by a crash.
+    bool listen(const QString &path);
+
+    static QString defaultConfigPath();
+    static QString defaultSocketPath();
+
+    // Shown by "status": time from process start until the daemon was ready.
+    void setStartupMs(double ms) { m_startupMs = ms; }
+
+    // One command line in, one reply (without the terminating empty line) out.
+    QString execute(const QString &line);
+
+private slots:
+    void onNewConnection();
+
+private:
+    QString set(const QString &key, const QString &value);
+    QString get(const QString &key) const;
+    QString status() const;
+    QStringList settingNames() const;
+    QStringList reportNames() const;
+    QString report(const QString &name) const;
+    void serve(QLocalSocket *socket);
+
+    Backend      *m_backend;
+    QLocalServer *m_server = nullptr;
+    double        m_startupMs = -1;
+};
+
+#endif // DAEMONCONTROL_H
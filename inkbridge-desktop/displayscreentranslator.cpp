@@ -41,10 +41,12 @@ int32_t DisplayScreenTranslator::getFixedSize(int posOnDevice, int accessorySize
 }
 
 
+// Without a screen (headless daemon, nothing configured) "fixed" falls
+// back to stretched.
 int DisplayScreenTranslator::getScreenX(){
-    return screen->geometry().width();
+    return screen ? screen->geometry().width() : size_x;
 }
 
 int DisplayScreenTranslator::getScreenY(){
-    return screen->geometry().height();
+    return screen ? screen->geometry().height() : size_y;
 }
@@ -0,0 +1,78 @@
+#ifndef FLOWCONTROLLER_H
+#define FLOWCONTROLLER_H
+
+#include <cstdint>
+#include "protocol.h"
+
+/**
+ * @brief Decides what sample rate the desktop asks a tablet for.
+ *
+ * Ticked about once per second by whichever thread owns the connection,
+ * with that connection's cumulative sample and shed counters (see
+ * HoverShedder). Any shedding during the last window means the injector
+ * is behind: the requested rate is halved and hover decimation doubled.
+ * After RECOVERY_WINDOWS clean windows in a row it steps back up, until the
+ * tablet is again free to send at full rate.
+ *
+ * tick() returns true when a FlowControlFrame should be sent: the first
+ * time (so the tablet learns the channel exists), whenever the request
+ * changes, and again after a send the caller reported as failed.
+ */
+class FlowController
+{
+public:
+    static constexpr uint16_t FULL_RATE_HZ     = 240;
+    static constexpr uint16_t MIN_RATE_HZ      = 60;
+    static constexpr uint8_t  MAX_DECIMATION   = 8;
+    static constexpr int      RECOVERY_WINDOWS = 5;
+
+    bool tick(uint64_t samples, uint64_t shed, FlowControlFrame &frame) {
+        const uint64_t windowSamples = samples - m_lastSamples;
+        const uint64_t windowShed    = shed - m_lastShed;
+        m_lastSamples = samples;
+        m_lastShed    = shed;
+
+        bool changed = false;
+        if (windowShed > 0) {
+            m_cleanWindows = 0;
+            if (m_rateHz > MIN_RATE_HZ || m_decimation < MAX_DECIMATION) {
+                m_rateHz     = m_rateHz / 2 < MIN_RATE_HZ ? MIN_RATE_HZ : m_rateHz / 2;
+                m_decimation = m_decimation * 2 > MAX_DECIMATION ? MAX_DECIMATION : m_decimation * 2;
+                changed = true;
+            }
+        } else if (windowSamples > 0 && ++m_cleanWindows >= RECOVERY_WINDOWS) {
+            m_cleanWindows = 0;
+            if (m_rateHz < FULL_RATE_HZ || m_decimation > 1) {
+                m_rateHz     = m_rateHz * 2 > FULL_RATE_HZ ? FULL_RATE_HZ : m_rateHz * 2;
+                m_decimation = m_decimation / 2 < 1 ? 1 : m_decimation / 2;
+                changed = true;
+            }
+        }
+
+        if (!changed && !m_unsent) return false;
+        m_unsent = false;
+
+        frame.type            = CONTROL_FLOW;
+        frame.length          = sizeof(FlowControlFrame) - 2;
+        frame.maxSampleRateHz = m_rateHz;
+        frame.hoverDecimation = m_decimation;
+        frame.reserved        = 0;
+        return true;
+    }
+
+    // The frame from the last tick() did not go out; resend it next time.
+    void markUnsent() { m_unsent = true; }
+
+    uint16_t rateHz() const { return m_rateHz; }
+    uint8_t  hoverDecimation() const { return m_decimation; }
+
+private:
+    uint16_t m_rateHz       = FULL_RATE_HZ;
+    uint8_t  m_decimation   = 1;
+    int      m_cleanWindows = 0;
+    bool     m_unsent       = true; // advertise once on the first tick
+    uint64_t m_lastSamples  = 0;
+    uint64_t m_lastShed     = 0;
+};
+
+#endif // FLOWCONTROLLER_H
@@ -0,0 +1,57 @@
+#ifndef HANDSHAKE_H
+#define HANDSHAKE_H
+
+#include <cstdint>
+#include <string>
+#include "protocol.h"
+
+/**
+ * @brief Desktop side of the hello/ack capability exchange.
+ *
+ * negotiate() turns a TabletHello into the HelloAck the desktop answers
+ * with. The decoder uses the same result to decide which record types are
+ * legitimate on this connection, the stylus uses the hello itself for its
+ * watchdog priors and input range (VirtualStylus::applyTabletHello).
+ */
+namespace Handshake {
+
+// Everything this desktop decodes or makes use of. FEATURE_UDP only has an
+// effect where the transport makes an offer (ControlChannel::setUdpOffer).
+constexpr uint8_t DESKTOP_FEATURES =
+    FEATURE_COMPACT | FEATURE_HISTORICAL | FEATURE_HEARTBEAT | FEATURE_TILT |
+    FEATURE_DEVICE_TIME | FEATURE_UDP;
+
+inline HelloAck negotiate(const TabletHello &hello) {
+    HelloAck ack;
+    ack.type     = CONTROL_HELLO_ACK;
+    ack.length   = sizeof(HelloAck) - 2;
+    ack.version  = hello.version < PROTOCOL_VERSION_MAX ? hello.version : PROTOCOL_VERSION_MAX;
+    if (ack.version < 1) ack.version = 1;
+    ack.features = hello.features & DESKTOP_FEATURES;
+    ack.reserved = 0;
+    return ack;
+}
+
+// One line for the diagnostics, e.g. "v2, 240 Hz, 2560x1600, heartbeat
+// 100 ms, compact, tilt".
+inline std::string describe(const TabletHello &hello) {
+    const HelloAck agreed = negotiate(hello);
+    std::string out = "v" + std::to_string(agreed.version);
+    out += hello.sampleRateHz ? ", " + std::to_string(hello.sampleRateHz) + " Hz" : ", rate unknown";
+    if (hello.surfaceWidth && hello.surfaceHeight) {
+        out += ", " + std::to_string(hello.surfaceWidth) + "x" + std::to_string(hello.surfaceHeight);
+    }
+    out += (agreed.features & FEATURE_HEARTBEAT)
+               ? ", heartbeat " + std::to_string(hello.heartbeatMs) + " ms"
+               : ", no heartbeat";
+    if (agreed.features & FEATURE_COMPACT)     out += ", compact";
+    if (agreed.features & FEATURE_HISTORICAL)  out += ", historical";
+    if (agreed.features & FEATURE_TILT)        out += ", tilt";
+    if (agreed.features & FEATURE_DEVICE_TIME) out += ", device time";
+    if (agreed.features & FEATURE_UDP)         out += ", udp";
+    return out;
+}
+
+} // namespace Handshake
+
+#endif // HANDSHAKE_H
@@ -5,6 +5,10 @@
  *
  * Based on usbAccReadWrite.c by Jeremy Rosen
  *
+ * Rewritten for InkBridge in C++ (epoll, libusb pollfd notifiers and a
+ * preallocated transfer pool); the AOA 2.0 HID registration flow is
+ * unchanged.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -19,314 +23,412 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
  */
-#ifndef WIN32
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <poll.h>
-#include <libusb-1.0/libusb.h>
 
-#include "linux-adk.h"
 #include "hid.h"
+#include "rtsched.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+
+// AOA 2.0 HID requests (the accessory ones are in linux-adk.cpp).
+#define AOA_REGISTER_HID        54
+#define AOA_UNREGISTER_HID      55
+#define AOA_SET_HID_REPORT_DESC 56
+#define AOA_SEND_HID_EVENT      57
+
+// The one HID this forwarder registers on the Android device.
+#define HID_ID 1
+
+#define FORWARD_TIMEOUT_MS 100
+// How long stop() keeps pumping events for in-flight transfers.
+#define DRAIN_TIMEOUT_MS   200
+// How often the loop refreshes its CPU counters.
+#define CPU_SAMPLE_US      100000
+
+namespace InkBridge {
+
+static uint64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t threadCpuUs() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t epollEventsFor(short events) {
+    uint32_t out = 0;
+    if (events & POLLIN)  out |= EPOLLIN;
+    if (events & POLLOUT) out |= EPOLLOUT;
+    return out;
+}
+
+HidForwarder::HidForwarder(libusb_context* context) : ctx(context) {
+    std::memset(descriptor, 0, sizeof(descriptor));
+    std::memset(reportBuffer, 0, sizeof(reportBuffer));
+
+    // Allocated once; the data path only moves slots between the free list
+    // and libusb.
+    slots.resize(POOL_SIZE);
+    freeSlots.reserve(POOL_SIZE);
+    for (Slot& slot : slots) {
+        slot.transfer = libusb_alloc_transfer(0);
+        slot.owner = this;
+        if (slot.transfer) freeSlots.push_back(&slot);
+    }
+    reportTransfer = libusb_alloc_transfer(0);
+}
+
+HidForwarder::~HidForwarder() {
+    stop();
+    for (Slot& slot : slots) {
+        if (slot.transfer) libusb_free_transfer(slot.transfer);
+    }
+    if (reportTransfer) libusb_free_transfer(reportTransfer);
+    if (hidHandle) {
+        libusb_release_interface(hidHandle, hidInterface);
+        libusb_close(hidHandle);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Setup
+// ---------------------------------------------------------------------------
+
+bool HidForwarder::open() {
+    if (!ctx) return false;
+
+    libusb_device** devs = nullptr;
+    ssize_t cnt = libusb_get_device_list(ctx, &devs);
+    if (cnt < 0) return false;
+
+    // First interface of HID class with an interrupt IN endpoint.
+    libusb_device* found = nullptr;
+    for (ssize_t i = 0; i < cnt && !found; i++) {
+        libusb_config_descriptor* config = nullptr;
+        if (libusb_get_active_config_descriptor(devs[i], &config) < 0) continue;
+
+        for (int j = 0; j < config->bNumInterfaces && !found; j++) {
+            for (int k = 0; k < config->interface[j].num_altsetting && !found; k++) {
+                const libusb_interface_descriptor& alt = config->interface[j].altsetting[k];
+                if (alt.bInterfaceClass != LIBUSB_CLASS_HID) continue;
+                for (int e = 0; e < alt.bNumEndpoints; e++) {
+                    const libusb_endpoint_descriptor& ep = alt.endpoint[e];
+                    if ((ep.bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN &&
+                        (ep.bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == LIBUSB_TRANSFER_TYPE_INTERRUPT) {
+                        found        = devs[i];
+                        hidInterface = alt.bInterfaceNumber;
+                        endpointIn   = ep.bEndpointAddress;
+                        packetSize   = ep.wMaxPacketSize < MAX_REPORT ? ep.wMaxPacketSize : MAX_REPORT;
+                        break;
+                    }
+                }
+            }
+        }
+        libusb_free_config_descriptor(config);
+    }
+
+    bool ok = false;
+    if (found && libusb_open(found, &hidHandle) == 0) {
+        libusb_device_descriptor desc;
+        libusb_get_device_descriptor(found, &desc);
+        libusb_set_auto_detach_kernel_driver(hidHandle, 1);
+        if (libusb_claim_interface(hidHandle, hidInterface) == 0) {
+            descriptorSize = libusb_control_transfer(hidHandle,
+                                                     LIBUSB_ENDPOINT_IN | LIBUSB_RECIPIENT_INTERFACE,
+                                                     LIBUSB_REQUEST_GET_DESCRIPTOR,
+                                                     LIBUSB_DT_REPORT << 8,
+                                                     static_cast<uint16_t>(hidInterface),
+                                                     descriptor, sizeof(descriptor), 0);
+            ok = descriptorSize > 0;
+            if (ok) {
+                std::cout << "Found HID device " << std::hex << desc.idVendor << ":"
+                          << desc.idProduct << std::dec << ", interface " << hidInterface
+                          << ", " << packetSize << " byte reports" << std::endl;
+            } else {
+                std::cerr << "Could not read the HID report descriptor." << std::endl;
+                libusb_release_interface(hidHandle, hidInterface);
+            }
+        } else {
+            std::cerr << "Failed to claim HID interface " << hidInterface << "." << std::endl;
+        }
+        if (!ok) {
+            libusb_close(hidHandle);
+            hidHandle = nullptr;
+        }
+    }
+    libusb_free_device_list(devs, 1);
+    return ok;
+}
+
+bool HidForwarder::start(libusb_device_handle* acc) {
+    if (running || !hidHandle || !acc || !reportTransfer) return false;
+    accessory = acc;
+
+    int ret = libusb_control_transfer(accessory, LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR,
+                                      AOA_REGISTER_HID, HID_ID,
+                                      static_cast<uint16_t>(descriptorSize), nullptr, 0, 0);
+    if (ret >= 0) {
+        ret = libusb_control_transfer(accessory, LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR,
+                                      AOA_SET_HID_REPORT_DESC, HID_ID, 0,
+                                      descriptor, static_cast<uint16_t>(descriptorSize), 0);
+    }
+    if (ret < 0) {
+        std::cerr << "Couldn't register the HID on the Android device: "
+                  << libusb_error_name(ret) << std::endl;
+        return false;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        std::cerr << "HID forwarder: epoll/eventfd setup failed: " << strerror(errno) << std::endl;
+        unregisterHid();
+        return false;
+    }
+    epoll_event ev{};
+    ev.events  = EPOLLIN;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    // Keep the epoll set in step with libusb from now on, then add what it
+    // already has. Adding one twice is harmless (see onPollfdAdded).
+    timeoutsInFds = libusb_pollfds_handle_timeouts(ctx) != 0;
+    libusb_set_pollfd_notifiers(ctx, onPollfdAdded, onPollfdRemoved, this);
+    if (const libusb_pollfd** fds = libusb_get_pollfds(ctx)) {
+        for (int i = 0; fds[i]; i++) onPollfdAdded(fds[i]->fd, fds[i]->events, this);
+        libusb_free_pollfds(fds);
+    }
+
+    libusb_fill_interrupt_transfer(reportTransfer, hidHandle, endpointIn,
+                                   reportBuffer, packetSize, onReport, this, 0);
+    running = true;
+    reportInFlight = true;
+    ret = libusb_submit_transfer(reportTransfer);
+    if (ret) {
+        std::cerr << "USB error : " << libusb_error_name(ret) << std::endl;
+        reportInFlight = false;
+        running = false;
+        libusb_set_pollfd_notifiers(ctx, nullptr, nullptr, nullptr);
+        unregisterHid();
+        return false;
+    }
+
+    thread = std::thread(&HidForwarder::run, this);
+    return true;
+}
+
+void HidForwarder::stop() {
+    if (!thread.joinable()) return;
+    running = false;
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The loop still notices 'running' on its next wakeup.
+    }
+    thread.join();
+
+    // Let the report read and any forwarded reports finish before their
+    // buffers and the accessory handle can go away.
+    if (reportInFlight) libusb_cancel_transfer(reportTransfer);
+    const uint64_t deadline = nowUs() + DRAIN_TIMEOUT_MS * 1000ULL;
+    while (nowUs() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(slotMutex);
+            if (!reportInFlight && freeSlots.size() == slots.size()) break;
+        }
+        timeval tv{0, 10000};
+        libusb_handle_events_timeout_completed(ctx, &tv, nullptr);
+    }
+
+    libusb_set_pollfd_notifiers(ctx, nullptr, nullptr, nullptr);
+    unregisterHid();
+    close(epollFd);
+    close(wakeFd);
+    epollFd = wakeFd = -1;
+}
+
+void HidForwarder::unregisterHid() {
+    libusb_control_transfer(accessory, LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR,
+                            AOA_UNREGISTER_HID, HID_ID, 0, nullptr, 0, FORWARD_TIMEOUT_MS);
+}
 
-static void *receive_loop(void *arg)
-{
-	while (!stop_acc) {
-		int ret = 0;
-		int i;
-		int nfds = 1;
-		struct timeval tv, zero_tv;
-		const struct libusb_pollfd **poll_list;
-		fd_set rfds, wfds, efds;
-		tv.tv_sec = 0;
-		tv.tv_usec = 0;
-		zero_tv.tv_sec = 0;
-		zero_tv.tv_usec = 0;
-
-		ret = libusb_get_next_timeout(NULL, &tv);
-		if (ret < 0) {
-			if (ret)
-				printf("USB error : %s\n",
-				       libusb_error_name(ret));
-			break;
-		}
-
-		if (ret == 1 && tv.tv_sec == 0 && tv.tv_usec == 0) {
-			ret = libusb_handle_events_timeout_completed(NULL,
-								     &zero_tv,
-								     NULL);
-			if (ret) {
-				if (ret)
-					printf("USB error : %s\n",
-					       libusb_error_name(ret));
-				break;
-			}
-			continue;
-		}
-
-		FD_ZERO(&rfds);
-		FD_ZERO(&wfds);
-		FD_ZERO(&efds);
-		FD_SET(0, &rfds);
-		poll_list = libusb_get_pollfds(NULL);
-		if (poll_list) {
-			for (i = 0; poll_list[i] != NULL; i++) {
-				const struct libusb_pollfd *cur_poll;
-
-				cur_poll = poll_list[i];
-				nfds = cur_poll->fd >= nfds
-					? cur_poll->fd + 1 : nfds;
-				if (cur_poll->events & POLLIN)
-					FD_SET(cur_poll->fd, &rfds);
-				if (cur_poll->events & POLLOUT)
-					FD_SET(cur_poll->fd, &wfds);
-			}
-			free(poll_list);
-		} else
-			break;
-
-		if (tv.tv_sec == 0 && tv.tv_usec == 0)
-			ret = select(nfds, &rfds, &wfds, &efds, NULL);
-		else
-			ret = select(nfds, &rfds, &wfds, &efds, &tv);
-
-		if (libusb_handle_events_timeout_completed
-		    (NULL, &zero_tv, NULL))
-			break;
-	}
-
-	return NULL;
+// ---------------------------------------------------------------------------
+// Event loop
+// ---------------------------------------------------------------------------
+
+void HidForwarder::onPollfdAdded(int fd, short events, void* user) {
+    HidForwarder* self = static_cast<HidForwarder*>(user);
+    epoll_event ev{};
+    ev.events  = epollEventsFor(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(self->epollFd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno == EEXIST) {
+        epoll_ctl(self->epollFd, EPOLL_CTL_MOD, fd, &ev);
+    }
 }
 
-static int open_device(struct libusb_device_handle **handle,
-		      libusb_device * device, int interface)
-{
-	int kernel_claimed = 0, ret;
-
-	libusb_ref_device(device);
-	ret = libusb_open(device, handle);
-	if (ret) {
-		printf("Unable to open usb device [%#08x]\n", ret);
-		*handle = NULL;
-		return -1;
-	}
-
-	ret = libusb_kernel_driver_active(*handle, interface);
-	if (ret == 1) {
-		if (libusb_detach_kernel_driver(*handle, interface)) {
-			printf("Unable to grab usb device\n");
-			libusb_close(*handle);
-			*handle = NULL;
-			return -1;
-		}
-		kernel_claimed = 1;
-	}
-
-	ret = libusb_claim_interface(*handle, interface);
-	if (ret) {
-		printf("Failed to claim interface %d.\n", interface);
-		if (kernel_claimed) {
-			libusb_attach_kernel_driver(*handle, interface);
-			kernel_claimed = 0;
-		}
-		libusb_close(*handle);
-		*handle = NULL;
-		return -1;
-	}
-
-	return 0;
+void HidForwarder::onPollfdRemoved(int fd, void* user) {
+    HidForwarder* self = static_cast<HidForwarder*>(user);
+    epoll_ctl(self->epollFd, EPOLL_CTL_DEL, fd, nullptr);
 }
 
-static void callback_hid(struct libusb_transfer *transfer)
-{
-    accessory_t *acc = (accessory_t*) transfer->user_data;
-	int rc = 0;
-
-	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
-		struct libusb_transfer *android_transfer;
-		unsigned char *keybuf;
-		int rc;
-
-		android_transfer = libusb_alloc_transfer(0);
-        keybuf = (unsigned char*) malloc(transfer->actual_length + LIBUSB_CONTROL_SETUP_SIZE);
-		memcpy(keybuf + LIBUSB_CONTROL_SETUP_SIZE, transfer->buffer,
-		       transfer->actual_length);
-
-		libusb_fill_control_setup(keybuf,
-					  LIBUSB_ENDPOINT_OUT |
-					  LIBUSB_REQUEST_TYPE_VENDOR,
-					  AOA_SEND_HID_EVENT, 1, 0,
-					  transfer->actual_length);
-
-		libusb_fill_control_transfer(android_transfer, acc->handle,
-					     keybuf, NULL, NULL, 0);
-
-		android_transfer->flags =
-		    LIBUSB_TRANSFER_FREE_BUFFER | LIBUSB_TRANSFER_FREE_TRANSFER;
-
-		rc = libusb_submit_transfer(android_transfer);
-		if (rc)
-			printf("USB error : %s\n", libusb_error_name(rc));
-
-		rc = libusb_submit_transfer(transfer);
-		if (rc)
-			printf("USB error : %s\n", libusb_error_name(rc));
-
-	} else if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
-		rc = libusb_submit_transfer(transfer);
-		if (rc)
-			printf("USB error : %s\n", libusb_error_name(rc));
-	}
+void HidForwarder::run() {
+    RtSched::ThreadScope rt(RtSched::ThreadRole::Ingest, "hid-forward");
+    epoll_event events[16];
+    const uint64_t startedUs  = nowUs();
+    const uint64_t startedCpu = threadCpuUs();
+    uint64_t sampledUs = startedUs;
+
+    while (running) {
+        int timeoutMs = -1;
+        if (!timeoutsInFds) {
+            timeval tv;
+            if (libusb_get_next_timeout(ctx, &tv) == 1) {
+                timeoutMs = static_cast<int>(tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000);
+            }
+        }
+
+        int n = epoll_wait(epollFd, events, 16, timeoutMs);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "HID forwarder: epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == wakeFd) {
+                uint64_t drained;
+                if (read(wakeFd, &drained, sizeof(drained)) < 0) { /* spurious */ }
+            }
+        }
+
+        // Only ever handles what is ready; never blocks.
+        timeval zero{0, 0};
+        int ret = libusb_handle_events_timeout_completed(ctx, &zero, nullptr);
+        if (ret && ret != LIBUSB_ERROR_INTERRUPTED) {
+            std::cerr << "USB error : " << libusb_error_name(ret) << std::endl;
+            break;
+        }
+
+        const uint64_t now = nowUs();
+        if (now - sampledUs >= CPU_SAMPLE_US) {
+            sampledUs = now;
+            counters.cpuUs.store(threadCpuUs() - startedCpu, std::memory_order_relaxed);
+            counters.wallUs.store(now - startedUs, std::memory_order_relaxed);
+        }
+    }
+
+    counters.cpuUs.store(threadCpuUs() - startedCpu, std::memory_order_relaxed);
+    counters.wallUs.store(nowUs() - startedUs, std::memory_order_relaxed);
 }
 
-unsigned char search_hid(hid_device * hid)
-{
-	libusb_device **list;
-	struct libusb_device_descriptor desc;
-	ssize_t cnt;
-	ssize_t i = 0;
-	int j;
-	libusb_device *device;
-
-	hid->handle = NULL;
-
-	/* List every USB device attached */
-	cnt = libusb_get_device_list(NULL, &list);
-	if (cnt < 0)
-		goto error0;
-
-	for (i = 0; i < cnt; i++) {
-		device = list[i];
-		int r;
-
-		r = libusb_get_device_descriptor(device, &desc);
-		if (r < 0)
-			continue;
-
-		if (desc.bDeviceClass == LIBUSB_CLASS_HID) {
-			goto found;
-			break;
-		} else if (desc.bDeviceClass == LIBUSB_CLASS_PER_INTERFACE) {
-			struct libusb_config_descriptor *current_config;
-			int r;
-
-			r = libusb_get_active_config_descriptor(device,
-								&current_config);
-			if (r < 0)
-				continue;
-
-			for (j = 0; j < current_config->bNumInterfaces; j++) {
-				int k;
-				for (k = 0;
-				     k <
-				     current_config->
-				     interface[j].num_altsetting; k++) {
-					if (current_config->
-					    interface[j].altsetting[k].
-					    bInterfaceClass ==
-					    LIBUSB_CLASS_HID) {
-						hid->endpoint_in =
-						    current_config->interface
-						    [j].
-						    altsetting[k].endpoint
-						    [0].bEndpointAddress;
-						hid->packet_size =
-						    current_config->interface
-						    [j].
-						    altsetting[k].endpoint[0].
-						    wMaxPacketSize;
-						goto found;
-					}
-				}
-			}
-			libusb_free_config_descriptor(current_config);
-		}
-	}
-found:
-	if (i == cnt)
-		goto error0;
-
-	if (open_device(&hid->handle, device, j) < 0)
-		goto error0;
-
-	hid->descriptor_size = libusb_control_transfer(hid->handle,
-						       LIBUSB_ENDPOINT_IN |
-						       LIBUSB_RECIPIENT_INTERFACE,
-						       LIBUSB_REQUEST_GET_DESCRIPTOR,
-						       LIBUSB_DT_REPORT << 8, 0,
-						       hid->descriptor, 256, 0);
-	if (hid->descriptor_size < 0)
-		goto error1;
-
-	libusb_free_device_list(list, 1);
-	printf("=> found HID device vid 0x%x pid 0x%x\n", desc.idVendor,
-	       desc.idProduct);
-	return 0;
-error1:
-	libusb_close(hid->handle);
-error0:
-	libusb_free_device_list(list, 1);
-	return -1;
+// ---------------------------------------------------------------------------
+// Transfers
+// ---------------------------------------------------------------------------
+
+void HidForwarder::onReport(libusb_transfer* transfer) {
+    HidForwarder* self = static_cast<HidForwarder*>(transfer->user_data);
+
+    if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        self->counters.reports.fetch_add(1, std::memory_order_relaxed);
+        self->forward(transfer->buffer, transfer->actual_length);
+    } else if (transfer->status != LIBUSB_TRANSFER_TIMED_OUT) {
+        if (transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+            std::cerr << "HID device read ended (status " << transfer->status << ")." << std::endl;
+        }
+        self->reportInFlight = false;
+        return;
+    }
+
+    if (!self->running) {
+        self->reportInFlight = false;
+        return;
+    }
+    int rc = libusb_submit_transfer(transfer);
+    if (rc) {
+        std::cerr << "USB error : " << libusb_error_name(rc) << std::endl;
+        self->reportInFlight = false;
+    }
 }
 
-int register_hid_callback(accessory_t * acc, hid_device * hid)
-{
-	struct libusb_transfer *hid_transfer;
-	unsigned char *keybuf;
-	int rc;
-
-    keybuf = (unsigned char*) malloc(hid->packet_size);
-
-	hid_transfer = libusb_alloc_transfer(0);
-	if (hid_transfer == NULL) {
-		libusb_close(hid->handle);
-		return -1;
-	}
-
-	libusb_fill_interrupt_transfer(hid_transfer, hid->handle,
-				       hid->endpoint_in,
-				       keybuf, hid->packet_size, callback_hid,
-				       acc, 0);
-
-	rc = libusb_submit_transfer(hid_transfer);
-	if (rc != 0) {
-		if (rc)
-			printf("USB error : %s\n", libusb_error_name(rc));
-		libusb_close(hid->handle);
-		return -1;
-	}
-
-	return 0;
+void HidForwarder::forward(const unsigned char* data, int length) {
+    Slot* slot = length > 0 && length <= MAX_REPORT ? takeSlot() : nullptr;
+    if (!slot) {
+        counters.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    slot->readUs = nowUs();
+    libusb_fill_control_setup(slot->buffer, LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR,
+                              AOA_SEND_HID_EVENT, HID_ID, 0, static_cast<uint16_t>(length));
+    std::memcpy(slot->buffer + LIBUSB_CONTROL_SETUP_SIZE, data, length);
+    libusb_fill_control_transfer(slot->transfer, accessory, slot->buffer,
+                                 onForwarded, slot, FORWARD_TIMEOUT_MS);
+
+    int rc = libusb_submit_transfer(slot->transfer);
+    if (rc) {
+        std::cerr << "USB error : " << libusb_error_name(rc) << std::endl;
+        counters.dropped.fetch_add(1, std::memory_order_relaxed);
+        releaseSlot(slot);
+    }
 }
 
-int send_hid_descriptor(accessory_t * acc, hid_device * hid)
-{
-	int ret;
-
-	ret = libusb_control_transfer(acc->handle, LIBUSB_ENDPOINT_OUT |
-				      LIBUSB_REQUEST_TYPE_VENDOR,
-				      AOA_REGISTER_HID, 1, hid->descriptor_size,
-				      NULL, 0, 0);
-	if (ret < 0) {
-		printf("couldn't register HID device on the android device : %s\n",
-		       libusb_error_name(ret));
-		libusb_close(hid->handle);
-		return -1;
-	}
-
-	ret = libusb_control_transfer(acc->handle, LIBUSB_ENDPOINT_OUT |
-				      LIBUSB_REQUEST_TYPE_VENDOR,
-				      AOA_SET_HID_REPORT_DESC, 1, 0,
-				      hid->descriptor, hid->descriptor_size, 0);
-	if (ret < 0) {
-		printf("couldn't send HID descriptor to the android device\n");
-		libusb_close(hid->handle);
-		return -1;
-	}
-
-	pthread_create(&hid->rx_thread, NULL, receive_loop, NULL);
-
-	return 0;
+void HidForwarder::onForwarded(libusb_transfer* transfer) {
+    Slot* slot = static_cast<Slot*>(transfer->user_data);
+    HidForwarder* self = slot->owner;
+
+    if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        self->counters.forwarded.fetch_add(1, std::memory_order_relaxed);
+        self->counters.latency.add(nowUs() - slot->readUs);
+    } else {
+        self->counters.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    self->releaseSlot(slot);
 }
-#endif
+
+HidForwarder::Slot* HidForwarder::takeSlot() {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    if (freeSlots.empty()) return nullptr;
+    Slot* slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+}
+
+void HidForwarder::releaseSlot(Slot* slot) {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    freeSlots.push_back(slot);
+}
+
+// ---------------------------------------------------------------------------
+// Stats
+// ---------------------------------------------------------------------------
+
+std::string HidForwarder::report() const {
+    const uint64_t total = counters.latency.count();
+    std::ostringstream out;
+    const uint64_t wallUs = counters.wallUs.load();
+    out << "HID: " << counters.reports.load() << " reports";
+    if (wallUs) out << " (" << counters.reports.load() * 1000000 / wallUs << "/s)";
+    out << ", " << counters.forwarded.load() << " forwarded, "
+        << counters.dropped.load() << " dropped";
+    if (total) {
+        out << "; latency avg " << counters.latency.avgUs() << " us"
+            << ", p50 <" << counters.latency.quantileUs(0.50) << " us"
+            << ", p99 <" << counters.latency.quantileUs(0.99) << " us"
+            << ", max " << counters.latency.maxUs() << " us";
+    }
+    if (wallUs) {
+        out << "; CPU " << static_cast<double>(counters.cpuUs.load()) * 100.0 / wallUs << "%";
+    }
+    return out.str();
+}
+
+} // namespace InkBridge
@@ -3,6 +3,10 @@
  *
  * Copyright (C) 2014 - Gary Bisson <bisson.gary@gmail.com>
  *
+ * Rewritten for InkBridge in C++ (epoll, libusb pollfd notifiers and a
+ * preallocated transfer pool); the AOA 2.0 HID registration flow is
+ * unchanged.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -18,25 +22,118 @@
  * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
  */
 
-#ifndef _HID_H_
-#define _HID_H_
+#ifndef HID_H
+#define HID_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <libusb-1.0/libusb.h>
+#include "latencyhistogram.h"
+
+namespace InkBridge {
+
+/**
+ * @brief Forwards a local USB HID device (keyboard, mouse) to the Android
+ * device as an AOA 2.0 HID.
+ *
+ * Event-driven: the forwarder thread waits on one persistent epoll set that
+ * holds libusb's file descriptors. libusb's pollfd notifiers add and remove
+ * them as they change, so nothing is rebuilt per iteration (the old
+ * select() loop re-read the list, and watched stdin, on every pass).
+ *
+ * Each report read from the HID device goes out as an AOA_SEND_HID_EVENT
+ * control transfer taken from a pool of POOL_SIZE preallocated transfers.
+ * When the pool is empty (Android is not keeping up) the report is dropped
+ * and counted instead of allocating more.
+ *
+ * Runs on the accessory's own libusb context (UsbConnection::getContext()),
+ * so completions on the accessory handle are handled by the same loop.
+ * libusb's event lock makes that safe alongside the capture thread's
+ * synchronous bulk reads.
+ */
+class HidForwarder {
+public:
+    static constexpr int POOL_SIZE  = 32;
+    static constexpr int MAX_REPORT = 64;   // bytes; full-speed interrupt max
+    static constexpr int LATENCY_BUCKETS = 20; // log2 us
+
+    // Read by report() on any thread.
+    struct Stats {
+        std::atomic<uint64_t> reports{0};     // read from the HID device
+        std::atomic<uint64_t> forwarded{0};   // acked by Android
+        std::atomic<uint64_t> dropped{0};     // pool empty or submit failed
+        LatencyHistogram<LATENCY_BUCKETS> latency;
+        std::atomic<uint64_t> cpuUs{0};       // forwarder thread CPU time
+        std::atomic<uint64_t> wallUs{0};      // forwarder thread run time
+    };
+
+    explicit HidForwarder(libusb_context* ctx);
+    ~HidForwarder();
+
+    HidForwarder(const HidForwarder&) = delete;
+    HidForwarder& operator=(const HidForwarder&) = delete;
+
+    // Finds and claims the first HID device and reads its report descriptor.
+    bool open();
+    // Registers the HID on the accessory and starts forwarding. The
+    // accessory must be open on the same context.
+    bool start(libusb_device_handle* accessory);
+    void stop();
+
+    // "N reports, M forwarded, D dropped, latency p50/p99/max, CPU x%".
+    std::string report() const;
+    const Stats& stats() const { return counters; }
+
+private:
+    struct Slot {
+        libusb_transfer* transfer = nullptr;
+        HidForwarder*    owner = nullptr;
+        uint64_t         readUs = 0;   // when the report came off the HID device
+        unsigned char    buffer[LIBUSB_CONTROL_SETUP_SIZE + MAX_REPORT];
+    };
+
+    static void LIBUSB_CALL onReport(libusb_transfer* transfer);
+    static void LIBUSB_CALL onForwarded(libusb_transfer* transfer);
+    static void LIBUSB_CALL onPollfdAdded(int fd, short events, void* user);
+    static void LIBUSB_CALL onPollfdRemoved(int fd, void* user);
+
+    void run();
+    void forward(const unsigned char* data, int length);
+    Slot* takeSlot();
+    void releaseSlot(Slot* slot);
+    void unregisterHid();
+
+    libusb_context*       ctx;
+    libusb_device_handle* hidHandle = nullptr;
+    libusb_device_handle* accessory = nullptr;
+    int                   hidInterface = -1;
+    unsigned char         endpointIn = 0;
+    int                   packetSize = 0;
+    unsigned char         descriptor[256];
+    int                   descriptorSize = 0;
+
+    libusb_transfer*      reportTransfer = nullptr;
+    unsigned char         reportBuffer[MAX_REPORT];
+    std::atomic<bool>     reportInFlight{false};
 
-#include <pthread.h>
-#include "linux-adk.h"
+    // The free list is touched from whichever thread handles libusb events
+    // (this one or the capture thread), hence the lock.
+    std::vector<Slot>     slots;
+    std::vector<Slot*>    freeSlots;
+    std::mutex            slotMutex;
 
-/* Structures */
-typedef struct {
-	struct libusb_device_handle *handle;
-	unsigned char descriptor[256];
-	int descriptor_size;
-	int endpoint_in;
-    size_t packet_size;
-	pthread_t rx_thread;
-} hid_device;
+    int                   epollFd = -1;
+    int                   wakeFd = -1;
+    bool                  timeoutsInFds = false;
+    std::thread           thread;
+    std::atomic<bool>     running{false};
+    Stats                 counters;
+};
 
-/* Functions */
-extern int send_hid_descriptor(accessory_t *acc, hid_device *hid);
-extern int register_hid_callback(accessory_t* acc, hid_device *hid);
-extern unsigned char search_hid(hid_device *hid);
+} // namespace InkBridge
 
-#endif /* _HID_H_ */
+#endif // HID_H
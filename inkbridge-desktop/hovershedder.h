@@ -0,0 +1,100 @@
+#ifndef HOVERSHEDDER_H
+#define HOVERSHEDDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "accessory.h"
+
+/**
+ * @brief Drops stale hover-moves when injection falls behind.
+ *
+ * Samples decoded from one read are collected with push() and injected in
+ * order by drain(). Normally every sample goes through. When the injector
+ * is behind (more than MAX_DEPTH samples still waiting, or the batch has
+ * been waiting longer than MAX_AGE_US), a hover-move that is immediately
+ * followed by another hover-move of the same tool and button state is
+ * skipped: only the newest hover position matters for a cursor nobody is
+ * drawing with.
+ *
+ * Never shed: touching samples, down/up, hover enter/exit, and anything
+ * where the tool or button changes. Those carry state the kernel must see.
+ *
+ * One instance per ingest thread. Not thread-safe.
+ */
+class HoverShedder
+{
+public:
+    static constexpr size_t   MAX_DEPTH  = 4;
+    static constexpr uint64_t MAX_AGE_US = 8000;
+
+    // Process-wide counters (read by the UI thread).
+    struct Stats {
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> shed{0};
+        std::atomic<uint64_t> batchesShed{0};
+    };
+
+    static Stats& stats() {
+        static Stats s;
+        return s;
+    }
+
+    static uint64_t nowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    HoverShedder() { m_pending.reserve(64); }
+
+    void push(const AccessoryEventData& sample) { m_pending.push_back(sample); }
+
+    // This instance's totals. Safe to read from another thread.
+    uint64_t samples() const { return m_samples.load(std::memory_order_relaxed); }
+    uint64_t shed() const    { return m_shed.load(std::memory_order_relaxed); }
+
+    // 'arrivedUs' is when the bytes behind this batch were received
+    // (steady clock, see nowUs()).
+    template <typename Sink>
+    void drain(uint64_t arrivedUs, Sink&& inject) {
+        const size_t n = m_pending.size();
+        uint64_t shedHere = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            AccessoryEventData& sample = m_pending[i];
+            if (i + 1 < n && collapsible(sample, m_pending[i + 1]) &&
+                (n - i > MAX_DEPTH || nowUs() - arrivedUs > MAX_AGE_US)) {
+                ++shedHere;
+                continue;
+            }
+            inject(sample);
+        }
+
+        Stats& st = stats();
+        st.samples.fetch_add(n, std::memory_order_relaxed);
+        m_samples.fetch_add(n, std::memory_order_relaxed);
+        if (shedHere) {
+            m_shed.fetch_add(shedHere, std::memory_order_relaxed);
+            st.shed.fetch_add(shedHere, std::memory_order_relaxed);
+            st.batchesShed.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_pending.clear();
+    }
+
+private:
+    static constexpr int HOVER_MOVE = 7;   // MotionEvent.ACTION_HOVER_MOVE
+    static constexpr int BUTTON_BIT = 32;
+
+    static bool collapsible(const AccessoryEventData& a, const AccessoryEventData& b) {
+        return (a.action & ~BUTTON_BIT) == HOVER_MOVE &&
+               a.action   == b.action &&
+               a.toolType == b.toolType;
+    }
+
+    std::vector<AccessoryEventData> m_pending;
+    std::atomic<uint64_t> m_samples{0};
+    std::atomic<uint64_t> m_shed{0};
+};
+
+#endif // HOVERSHEDDER_H
@@ -0,0 +1,492 @@
+#include "ingestreactor.h"
+#include "controlchannel.h"
+#include "rtsched.h"
+#include "protocol.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+static_assert((IngestReactor::RX_BUFFER_SIZE & (IngestReactor::RX_BUFFER_SIZE - 1)) == 0,
+              "receive rings need a power-of-two size");
+
+static uint64_t steadyNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------------------------------------------------------------------------
+// Buffer pool
+// ---------------------------------------------------------------------------
+
+uint8_t *IngestReactor::BufferPool::acquire() {
+    if (m_free.empty()) {
+        m_storage.push_back(std::make_unique<uint8_t[]>(RX_BUFFER_SIZE));
+        return m_storage.back().get();
+    }
+    uint8_t *buffer = m_free.back();
+    m_free.pop_back();
+    return buffer;
+}
+
+void IngestReactor::BufferPool::release(uint8_t *buffer) {
+    if (buffer) m_free.push_back(buffer);
+}
+
+// ---------------------------------------------------------------------------
+// Lifecycle
+// ---------------------------------------------------------------------------
+
+IngestReactor::IngestReactor(Callbacks callbacks)
+    : m_callbacks(std::move(callbacks))
+{
+}
+
+IngestReactor::~IngestReactor() {
+    stop();
+}
+
+bool IngestReactor::start(uint16_t port, int shards, uint16_t udpBasePort) {
+    if (m_running) return true;
+
+    if (shards <= 0) {
+        shards = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (shards < 1) shards = 1;
+    if (shards > MAX_SHARDS) shards = MAX_SHARDS;
+
+    for (int i = 0; i < shards; ++i) {
+        auto shard = std::make_unique<Shard>();
+        shard->index = i;
+        if (!openShard(*shard, port)) {
+            closeShard(*shard);
+            // The first shard failing means the port is unusable. A later
+            // one failing only costs parallelism.
+            if (i == 0) return false;
+            std::cerr << "[P2P] Running with " << i << " shard(s) instead of "
+                      << shards << "." << std::endl;
+            break;
+        }
+        // Without its UDP port a shard still serves TCP; its tablets are
+        // simply not offered UDP.
+        if (udpBasePort) openUdp(*shard, static_cast<uint16_t>(udpBasePort + i));
+        m_shards.push_back(std::move(shard));
+    }
+
+    m_running = true;
+    for (auto &shard : m_shards) {
+        shard->thread = std::thread(&IngestReactor::runShard, this, shard.get());
+    }
+
+    std::cout << "[P2P] Ingest reactor listening on TCP port " << port
+              << " with " << m_shards.size() << " shard(s)";
+    if (udpBasePort) {
+        std::cout << ", UDP ports " << udpBasePort << "-"
+                  << udpBasePort + m_shards.size() - 1;
+    }
+    std::cout << "." << std::endl;
+    return true;
+}
+
+void IngestReactor::stop() {
+    if (!m_running) return;
+    m_running = false;
+
+    for (auto &shard : m_shards) {
+        uint64_t one = 1;
+        if (write(shard->wakeFd, &one, sizeof(one)) < 0) {
+            // The shard still notices m_running on its next wakeup.
+        }
+    }
+    for (auto &shard : m_shards) {
+        if (shard->thread.joinable()) shard->thread.join();
+        closeShard(*shard);
+    }
+    m_shards.clear();
+}
+
+bool IngestReactor::openShard(Shard &shard, uint16_t port) {
+    shard.listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (shard.listenFd < 0) {
+        std::cerr << "[P2P] socket() failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    int on = 1;
+    setsockopt(shard.listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    // Every shard binds the same port; the kernel load-balances accepts.
+    if (setsockopt(shard.listenFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        std::cerr << "[P2P] SO_REUSEPORT unavailable: " << strerror(errno) << std::endl;
+        if (shard.index > 0) return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(port);
+    if (bind(shard.listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(shard.listenFd, SOMAXCONN) < 0) {
+        std::cerr << "[P2P] Failed to bind TCP port " << port << ": "
+                  << strerror(errno) << std::endl;
+        return false;
+    }
+
+    shard.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    shard.wakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    shard.timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (shard.epollFd < 0 || shard.wakeFd < 0 || shard.timerFd < 0) {
+        std::cerr << "[P2P] epoll/eventfd/timerfd setup failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    itimerspec period{};
+    period.it_interval.tv_sec = 1;
+    period.it_value.tv_sec    = 1;
+    timerfd_settime(shard.timerFd, 0, &period, nullptr);
+
+    // data.ptr == nullptr marks the listener, &shard the wake fd,
+    // &shard.timerFd the flow control timer and &shard.udpFd the UDP socket
+    // (openUdp); anything else is a Connection.
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(shard.epollFd, EPOLL_CTL_ADD, shard.listenFd, &ev);
+    ev.data.ptr = &shard;
+    epoll_ctl(shard.epollFd, EPOLL_CTL_ADD, shard.wakeFd, &ev);
+    ev.data.ptr = &shard.timerFd;
+    epoll_ctl(shard.epollFd, EPOLL_CTL_ADD, shard.timerFd, &ev);
+    return true;
+}
+
+bool IngestReactor::openUdp(Shard &shard, uint16_t port) {
+    shard.udpFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (shard.udpFd < 0) {
+        std::cerr << "[P2P] UDP socket() failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(port);
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = &shard.udpFd;
+    if (bind(shard.udpFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        epoll_ctl(shard.epollFd, EPOLL_CTL_ADD, shard.udpFd, &ev) < 0) {
+        std::cerr << "[P2P] Failed to bind UDP port " << port << ": "
+                  << strerror(errno) << std::endl;
+        close(shard.udpFd);
+        shard.udpFd = -1;
+        return false;
+    }
+
+    shard.udpPort    = port;
+    shard.udpBuffers = std::make_unique<uint8_t[]>(UDP_BATCH * UDP_MAX_DATAGRAM);
+    return true;
+}
+
+void IngestReactor::closeShard(Shard &shard) {
+    if (shard.listenFd >= 0) close(shard.listenFd);
+    if (shard.epollFd  >= 0) close(shard.epollFd);
+    if (shard.wakeFd   >= 0) close(shard.wakeFd);
+    if (shard.timerFd  >= 0) close(shard.timerFd);
+    if (shard.udpFd    >= 0) close(shard.udpFd);
+    shard.listenFd = shard.epollFd = shard.wakeFd = shard.timerFd = shard.udpFd = -1;
+}
+
+// ---------------------------------------------------------------------------
+// Shard loop
+// ---------------------------------------------------------------------------
+
+void IngestReactor::runShard(Shard *shard) {
+    RtSched::ThreadScope rt(RtSched::ThreadRole::Ingest, "p2p-shard");
+    epoll_event events[64];
+
+    while (m_running) {
+        int n = epoll_wait(shard->epollFd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[P2P] epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        const uint64_t wakeUs = steadyNowUs();
+
+        for (int i = 0; i < n; ++i) {
+            void *tag = events[i].data.ptr;
+            if (tag == nullptr) {
+                acceptClients(*shard);
+            } else if (tag == shard) {
+                uint64_t drained;
+                if (read(shard->wakeFd, &drained, sizeof(drained)) < 0) { /* spurious */ }
+            } else if (tag == &shard->timerFd) {
+                uint64_t expirations;
+                if (read(shard->timerFd, &expirations, sizeof(expirations)) > 0) {
+                    sendControl(*shard);
+                }
+            } else if (tag == &shard->udpFd) {
+                readUdp(*shard, wakeUs);
+            } else {
+                Connection *conn = static_cast<Connection *>(tag);
+                bool alive = !(events[i].events & (EPOLLERR | EPOLLHUP));
+                if (alive && (events[i].events & (EPOLLIN | EPOLLRDHUP))) {
+                    alive = readClient(*shard, conn, wakeUs);
+                }
+                if (!alive) dropClient(*shard, conn);
+            }
+        }
+    }
+
+    // Shutting down: release every client still attached to this shard.
+    std::vector<Connection *> remaining;
+    {
+        std::lock_guard<std::mutex> lock(shard->connectionsMutex);
+        for (auto &entry : shard->connections) remaining.push_back(entry.second.get());
+    }
+    for (Connection *conn : remaining) dropClient(*shard, conn);
+}
+
+void IngestReactor::acceptClients(Shard &shard) {
+    while (true) {
+        sockaddr_in addr{};
+        socklen_t   addrLen = sizeof(addr);
+        int fd = accept4(shard.listenFd, reinterpret_cast<sockaddr *>(&addr), &addrLen,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "[P2P] accept failed: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        // Pen samples are tiny and latency-bound.
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        char ip[INET_ADDRSTRLEN] = "?";
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+
+        auto conn = std::make_unique<Connection>();
+        conn->fd       = fd;
+        conn->clientId = m_nextClientId++;
+        conn->peer     = ip;
+        conn->peerAddr = addr.sin_addr.s_addr;
+        conn->session  = m_callbacks.onConnect ? m_callbacks.onConnect(conn->clientId, conn->peer)
+                                               : nullptr;
+        if (!conn->session) {
+            close(fd);
+            continue;
+        }
+        conn->rx.attach(shard.buffers.acquire(), RX_BUFFER_SIZE);
+
+        if (shard.udpFd >= 0) {
+            // Not a secret against someone on the same network, just enough
+            // that a stale tablet's datagrams never land in a new session.
+            static thread_local std::mt19937 tokens(std::random_device{}());
+            do { conn->udpToken = tokens(); }
+            while (conn->udpToken == 0 || shard.byToken.count(conn->udpToken));
+            shard.byToken.emplace(conn->udpToken, conn.get());
+            conn->session->setUdpOffer(shard.udpPort, conn->udpToken);
+        }
+
+        epoll_event ev{};
+        ev.events   = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn.get();
+        if (epoll_ctl(shard.epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            std::cerr << "[P2P] epoll_ctl failed: " << strerror(errno) << std::endl;
+            shard.buffers.release(conn->rx.storage());
+            shard.byToken.erase(conn->udpToken);
+            close(fd);
+            if (m_callbacks.onDisconnect) m_callbacks.onDisconnect(conn->clientId, conn->session);
+            continue;
+        }
+
+        std::cout << "[P2P] Tablet " << conn->clientId << " connected from " << ip
+                  << " (shard " << shard.index << ")." << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(shard.connectionsMutex);
+            shard.connections.emplace(fd, std::move(conn));
+        }
+        ++m_clientCount;
+    }
+}
+
+// Drains the socket (edge-triggered) into the connection's ring and lets
+// the session decode it from there. Returns false once the peer has gone
+// away.
+bool IngestReactor::readClient(Shard &, Connection *conn, uint64_t wakeUs) {
+    bool alive = true;
+    bool gotData = false;
+
+    while (true) {
+        // The ring never fills: the session consumes all but a split record.
+        iovec iov[2];
+        const int parts = conn->rx.writable(iov);
+        ssize_t n = readv(conn->fd, iov, parts);
+        if (n > 0) {
+            conn->rx.commit(static_cast<size_t>(n));
+            conn->session->ingest(conn->rx, wakeUs);
+            if (conn->session->controlUrgent()) sendControlTo(conn, true);
+            gotData = true;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        alive = false; // 0 = orderly shutdown, anything else = error
+        break;
+    }
+
+    if (gotData) conn->latency.add(steadyNowUs() - wakeUs);
+    return alive;
+}
+
+// Drains the UDP socket. A datagram is accepted only with a live token and
+// from the address of the TCP connection the token was offered on.
+void IngestReactor::readUdp(Shard &shard, uint64_t wakeUs) {
+    mmsghdr     msgs[UDP_BATCH];
+    iovec       iovs[UDP_BATCH];
+    sockaddr_in from[UDP_BATCH];
+
+    while (true) {
+        for (int i = 0; i < UDP_BATCH; ++i) {
+            iovs[i].iov_base = shard.udpBuffers.get() + i * UDP_MAX_DATAGRAM;
+            iovs[i].iov_len  = UDP_MAX_DATAGRAM;
+            msgs[i] = mmsghdr{};
+            msgs[i].msg_hdr.msg_iov     = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+            msgs[i].msg_hdr.msg_name    = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+
+        int n = recvmmsg(shard.udpFd, msgs, UDP_BATCH, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "[P2P] UDP receive failed: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            const uint8_t *data = static_cast<const uint8_t *>(iovs[i].iov_base);
+            const size_t   len  = msgs[i].msg_len;
+            if (len < sizeof(UdpDatagramHeader) || (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)) continue;
+
+            UdpDatagramHeader header;
+            std::memcpy(&header, data, sizeof(header));
+            if (header.marker != UDP_DATAGRAM) continue;
+            auto it = shard.byToken.find(header.token);
+            if (it == shard.byToken.end() || it->second->peerAddr != from[i].sin_addr.s_addr) continue;
+
+            Connection *conn = it->second;
+            conn->session->ingestDatagram(data + sizeof(header), len - sizeof(header), wakeUs);
+            conn->udpDatagrams.fetch_add(1, std::memory_order_relaxed);
+            conn->latency.add(steadyNowUs() - wakeUs);
+        }
+        if (n < UDP_BATCH) return;
+    }
+}
+
+void IngestReactor::dropClient(Shard &shard, Connection *conn) {
+    std::unique_ptr<Connection> owned;
+    {
+        std::lock_guard<std::mutex> lock(shard.connectionsMutex);
+        auto it = shard.connections.find(conn->fd);
+        if (it == shard.connections.end()) return;
+        owned = std::move(it->second);
+        shard.connections.erase(it);
+    }
+
+    shard.byToken.erase(owned->udpToken);
+    epoll_ctl(shard.epollFd, EPOLL_CTL_DEL, owned->fd, nullptr);
+    close(owned->fd);
+    shard.buffers.release(owned->rx.storage());
+    --m_clientCount;
+
+    std::cout << "[P2P] Tablet " << owned->clientId << " disconnected." << std::endl;
+    if (m_callbacks.onDisconnect) m_callbacks.onDisconnect(owned->clientId, owned->session);
+}
+
+// ---------------------------------------------------------------------------
+// Control channel (desktop -> tablet)
+// ---------------------------------------------------------------------------
+
+// Runs on the shard thread, which is the only one that changes the map, so
+// no lock is needed to walk it here.
+void IngestReactor::sendControl(Shard &shard) {
+    for (auto &entry : shard.connections) {
+        sendControlTo(entry.second.get(), false);
+    }
+}
+
+// 'urgentOnly' sends just what cannot wait for the next tick (the hello
+// ack) and leaves the flow controller alone.
+void IngestReactor::sendControlTo(Connection *conn, bool urgentOnly) {
+    // Finish frames the socket only partly took before starting new ones,
+    // or the tablet would lose framing.
+    if (!sendPending(conn)) return;
+
+    uint8_t frames[ControlChannel::MAX_BYTES];
+    size_t len = urgentOnly ? conn->session->takeUrgentControl(frames)
+                            : conn->session->controlTick(frames);
+    if (len == 0) return;
+
+    conn->txPending.assign(frames, frames + len);
+    if (!sendPending(conn) && conn->txPending.size() == len) {
+        // Nothing went out at all: drop it and let the channel resend.
+        conn->txPending.clear();
+        conn->session->controlUnsent();
+    }
+}
+
+// True once txPending is empty. Errors are left for the read path to see.
+bool IngestReactor::sendPending(Connection *conn) {
+    while (!conn->txPending.empty()) {
+        ssize_t n = send(conn->fd, conn->txPending.data(), conn->txPending.size(),
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        conn->txPending.erase(conn->txPending.begin(), conn->txPending.begin() + n);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Latency stats
+// ---------------------------------------------------------------------------
+
+std::string IngestReactor::latencyReport() const {
+    std::ostringstream out;
+    for (const auto &shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard->connectionsMutex);
+        for (const auto &entry : shard->connections) {
+            const Connection &conn = *entry.second;
+            const uint64_t total = conn.latency.count();
+            out << "Tablet " << conn.clientId << " (" << conn.peer << ", shard "
+                << shard->index << "): " << total << " reads";
+            if (const uint32_t datagrams = conn.udpDatagrams.load(std::memory_order_relaxed)) {
+                out << " (" << datagrams << " UDP)";
+            }
+            if (total) {
+                out << ", p50 <" << conn.latency.quantileUs(0.50) << " us"
+                    << ", p99 <" << conn.latency.quantileUs(0.99) << " us"
+                    << ", max " << conn.latency.maxUs() << " us";
+            }
+            out << "\n";
+        }
+    }
+    return out.str();
+}
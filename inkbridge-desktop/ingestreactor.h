@@ -0,0 +1,155 @@
+#ifndef INGESTREACTOR_H
+#define INGESTREACTOR_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "bytering.h"
+#include "ingestsink.h"
+#include "latencyhistogram.h"
+
+/**
+ * IngestReactor — epoll-based TCP ingest for network tablets.
+ *
+ * The reactor runs one shard per core (capped at MAX_SHARDS). Every shard
+ * owns a listening socket bound with SO_REUSEPORT, an epoll instance and a
+ * thread, so the kernel spreads incoming tablets across shards and no two
+ * shards ever touch the same connection.
+ *
+ * A connection is accepted, read, decoded and injected entirely on its
+ * shard's thread: the bytes go from recv() straight into the connection's
+ * session (an IngestSink; StylusSession in the app) without crossing the
+ * Qt event loop or another thread.
+ *
+ * Per connection the shard keeps:
+ *   - the session returned by onConnect (its own uinput device),
+ *   - a receive ring (ByteRing) on a buffer borrowed from the shard's
+ *     buffer pool; recv() fills it and the decoder reads it in place,
+ *   - a latency histogram (epoll wakeup -> uinput write done),
+ *   - unsent bytes of a desktop -> tablet control frame.
+ *
+ * Once per second each shard asks its sessions for control frames (see
+ * ControlChannel) and writes them back on the same socket.
+ *
+ * Optional UDP data channel: with a udpBasePort, shard i also binds UDP
+ * port udpBasePort + i. Every connection gets a random token, offered to
+ * the tablet with its hello ack (UdpOfferFrame) and only if the tablet
+ * agreed to FEATURE_UDP. Datagrams carrying a known token from the
+ * connection's peer address are fed to the same session on the same shard
+ * thread, so TCP and UDP samples meet in one decoder and one sequence
+ * tracker. Each shard owning its own port keeps that true without any
+ * cross-shard hand-off.
+ *
+ * The callbacks run on shard threads and must be thread-safe.
+ */
+class IngestReactor
+{
+public:
+    struct Callbacks {
+        // Returns the session that will receive this client's samples, or
+        // nullptr to refuse the connection.
+        std::function<IngestSink *(int clientId, const std::string &peer)> onConnect;
+        // The client is gone; the session is no longer referenced.
+        std::function<void(int clientId, IngestSink *session)> onDisconnect;
+    };
+
+    static constexpr int    MAX_SHARDS     = 8;
+    static constexpr size_t RX_BUFFER_SIZE = 4096;   // power of two (ByteRing)
+
+    explicit IngestReactor(Callbacks callbacks);
+    ~IngestReactor();
+
+    IngestReactor(const IngestReactor&) = delete;
+    IngestReactor& operator=(const IngestReactor&) = delete;
+
+    // shards <= 0 picks one per core.
+    // udpBasePort 0 leaves the UDP channel off.
+    bool start(uint16_t port, int shards = 0, uint16_t udpBasePort = 0);
+    void stop();
+    bool isRunning() const { return m_running; }
+    int  clientCount() const { return m_clientCount; }
+
+    // One line per connected client: reads (TCP reads and UDP datagrams)
+    // and p50/p99/max injection latency.
+    std::string latencyReport() const;
+
+private:
+    // Log2 buckets in microseconds: bucket i holds [2^(i-1), 2^i) us.
+    static constexpr int LATENCY_BUCKETS = 24;
+    // Datagrams fetched per recvmmsg().
+    static constexpr int UDP_BATCH = 16;
+
+    struct Connection {
+        int            fd       = -1;
+        int            clientId = 0;
+        std::string    peer;
+        IngestSink    *session  = nullptr;
+        ByteRing       rx;
+        std::vector<uint8_t> txPending; // control bytes the socket did not take
+        uint32_t       peerAddr = 0;    // network order; UDP must come from here
+        uint32_t       udpToken = 0;    // 0 = no UDP offered
+
+        // Written by the shard thread, read by latencyReport().
+        LatencyHistogram<LATENCY_BUCKETS> latency;
+        std::atomic<uint32_t> udpDatagrams{0};
+    };
+
+    // Fixed-size receive buffers recycled between connections, so a tablet
+    // reconnecting (or many connecting at once) does not hit the allocator.
+    class BufferPool {
+    public:
+        uint8_t *acquire();
+        void     release(uint8_t *buffer);
+    private:
+        std::vector<std::unique_ptr<uint8_t[]>> m_storage;
+        std::vector<uint8_t *>                  m_free;
+    };
+
+    struct Shard {
+        int         index    = 0;
+        int         listenFd = -1;
+        int         epollFd  = -1;
+        int         wakeFd   = -1;   // eventfd used by stop()
+        int         timerFd  = -1;   // 1 s flow control tick
+        int         udpFd    = -1;   // optional UDP data channel
+        uint16_t    udpPort  = 0;
+        std::thread thread;
+        BufferPool  buffers;
+
+        // Guards the map only (accept/close vs. latencyReport); the data
+        // path reaches its Connection through epoll_event.data.ptr.
+        mutable std::mutex connectionsMutex;
+        std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
+        // Shard thread only.
+        std::unordered_map<uint32_t, Connection *> byToken;
+        std::unique_ptr<uint8_t[]>                 udpBuffers; // UDP_BATCH datagrams
+    };
+
+    bool openShard(Shard &shard, uint16_t port);
+    bool openUdp(Shard &shard, uint16_t port);
+    void closeShard(Shard &shard);
+    void runShard(Shard *shard);
+    void acceptClients(Shard &shard);
+    bool readClient(Shard &shard, Connection *conn, uint64_t wakeUs);
+    void readUdp(Shard &shard, uint64_t wakeUs);
+    void dropClient(Shard &shard, Connection *conn);
+    void sendControl(Shard &shard);
+    void sendControlTo(Connection *conn, bool urgentOnly);
+    static bool sendPending(Connection *conn);
+
+    Callbacks m_callbacks;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<bool> m_running{false};
+    std::atomic<int>  m_clientCount{0};
+    std::atomic<int>  m_nextClientId{1};
+};
+
+#endif // INGESTREACTOR_H
@@ -0,0 +1,35 @@
+#ifndef INGESTSINK_H
+#define INGESTSINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include "bytering.h"
+
+/**
+ * IngestSink — what a network transport feeds one tablet's bytes into.
+ *
+ * IngestReactor only needs these calls from a connection's session, so it
+ * depends on this interface rather than on StylusSession (and Qt). The app
+ * always passes StylusSession; bench/ and tests/ pass their own sinks to
+ * drive the reactor without Qt or a uinput device.
+ *
+ * All calls come from the one thread that owns the connection, except
+ * controlUrgent(), which may come from any thread. See StylusSession for
+ * what each one does.
+ */
+class IngestSink
+{
+public:
+    virtual ~IngestSink() = default;
+
+    virtual void   ingest(ByteRing &ring, uint64_t arrivedUs) = 0;
+    virtual void   ingestDatagram(const uint8_t *data, size_t len, uint64_t arrivedUs) = 0;
+
+    virtual size_t controlTick(uint8_t *out) = 0;
+    virtual void   controlUnsent() = 0;
+    virtual bool   controlUrgent() const = 0;
+    virtual size_t takeUrgentControl(uint8_t *out) = 0;
+    virtual void   setUdpOffer(uint16_t port, uint32_t token) = 0;
+};
+
+#endif // INGESTSINK_H
@@ -0,0 +1,99 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QSocketNotifier>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "backend.h"
+#include "daemoncontrol.h"
+#include "latencyprobe.h"
+#include "procstats.h"
+
+// inkbridged — the InkBridge core without the UI: USB auto-connect, the
+// WiFi Direct and Bluetooth listeners and one VirtualStylus per tablet,
+// configured from a file and controlled over a Unix socket (DaemonControl).
+// Links Qt Core, Gui (types only; no QGuiApplication, so no display
+// connection), Network and Bluetooth, but not Qt Quick or QML.
+
+static int g_signalFds[2] = {-1, -1};
+
+static void onSignal(int) {
+    char one = 1;
+    if (write(g_signalFds[0], &one, 1) < 0) {
+        // Nothing more can be done from a signal handler.
+    }
+}
+
+static void usage(const char *argv0) {
+    printf("Usage: %s [--config FILE] [--socket PATH]\n"
+           "       %s --latency-probe[=FRAMES] [--probe-interval=US]\n"
+           "  --config FILE   settings (default %s)\n"
+           "  --socket PATH   control socket (default %s)\n"
+           "  --latency-probe[=FRAMES]  time uinput injection and exit (default %d frames)\n"
+           "  --probe-interval=US       gap between probe frames (default %d us)\n",
+           argv0, argv0,
+           qPrintable(DaemonControl::defaultConfigPath()),
+           qPrintable(DaemonControl::defaultSocketPath()),
+           LatencyProbe::DEFAULT_FRAMES, LatencyProbe::DEFAULT_INTERVAL_US);
+}
+
+int main(int argc, char *argv[])
+{
+    const int probeResult = LatencyProbe::runFromArgs(argc, argv);
+    if (probeResult >= 0) return probeResult;
+
+    QString configPath;
+    QString socketPath;
+    for (int i = 1; i < argc; ++i) {
+        if (LatencyProbe::isProbeArg(argv[i])) {
+            continue;  // --probe-interval without --latency-probe
+        } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            configPath = QString::fromLocal8Bit(argv[++i]);
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socketPath = QString::fromLocal8Bit(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("inkbridged");
+
+    // SIGINT/SIGTERM end the event loop, so every stylus is lifted and its
+    // uinput device destroyed on the way out.
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, g_signalFds) == 0) {
+        auto *notifier = new QSocketNotifier(g_signalFds[1], QSocketNotifier::Read, &app);
+        QObject::connect(notifier, &QSocketNotifier::activated, &app, [&app]() {
+            char byte;
+            if (read(g_signalFds[1], &byte, 1) > 0) qDebug() << "[Daemon] Shutting down";
+            app.quit();
+        });
+        struct sigaction sa{};
+        sa.sa_handler = onSignal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGINT,  &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+    }
+
+    Backend backend;
+    DaemonControl control(&backend);
+
+    QString configuredSocket;
+    control.loadConfig(configPath.isEmpty() ? DaemonControl::defaultConfigPath() : configPath,
+                       &configuredSocket);
+    if (socketPath.isEmpty()) socketPath = configuredSocket;
+    if (socketPath.isEmpty()) socketPath = DaemonControl::defaultSocketPath();
+    if (!control.listen(socketPath)) return 1;
+
+    const double startupMs = ProcStats::sinceStartMs();
+    control.setStartupMs(startupMs);
+    qDebug().noquote() << QString("[Daemon] Ready in %1 ms, RSS %2 KiB")
+                              .arg(startupMs, 0, 'f', 0)
+                              .arg(ProcStats::rssKiB());
+
+    return app.exec();
+}
@@ -0,0 +1,61 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief A log2-microsecond latency histogram with sum and max.
+ *
+ * Bucket i counts samples below 2^i us (and at or above 2^(i-1)); the last
+ * bucket is open-ended. add() is lock-free and may run on one thread while
+ * another reads, which is how the reactor, clock-sync, HID and probe stats
+ * all use it. Readers see each counter on its own, not a snapshot.
+ */
+template <int N>
+class LatencyHistogram
+{
+public:
+    static constexpr int BUCKETS = N;
+
+    void add(uint64_t us) {
+        int bucket = 0;
+        while (bucket < N - 1 && (uint64_t(1) << bucket) <= us) ++bucket;
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sumUs.fetch_add(us, std::memory_order_relaxed);
+        uint64_t prev = m_maxUs.load(std::memory_order_relaxed);
+        while (us > prev && !m_maxUs.compare_exchange_weak(prev, us)) {}
+    }
+
+    uint64_t count() const  { return m_count.load(std::memory_order_relaxed); }
+    uint64_t sumUs() const  { return m_sumUs.load(std::memory_order_relaxed); }
+    uint64_t maxUs() const  { return m_maxUs.load(std::memory_order_relaxed); }
+    uint64_t avgUs() const  { const uint64_t n = count(); return n ? sumUs() / n : 0; }
+    uint64_t bucket(int i) const { return m_buckets[i].load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the q-th quantile (0..1), in us;
+    // 0 with no samples.
+    uint64_t quantileUs(double q) const {
+        uint64_t counts[N];
+        uint64_t total = 0;
+        for (int i = 0; i < N; ++i) total += counts[i] = bucket(i);
+        if (!total) return 0;
+        const uint64_t rank = static_cast<uint64_t>(q * total);
+        uint64_t seen = 0;
+        for (int i = 0; i < N; ++i) {
+            seen += counts[i];
+            if (seen > rank) return uint64_t(1) << i;
+        }
+        return uint64_t(1) << (N - 1);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, N> m_buckets{};
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_sumUs{0};
+    std::atomic<uint64_t> m_maxUs{0};
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,232 @@
+#include "latencyprobe.h"
+#include "latencyhistogram.h"
+#include "uinput.h"
+#include "error.h"
+#include "constants.h"
+
+#include <linux/input.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+namespace LatencyProbe {
+
+namespace {
+
+constexpr int BUCKETS         = 20;   // log2 us, the last one open-ended
+constexpr int OPEN_ATTEMPTS   = 50;   // udev creates the node asynchronously
+constexpr int OPEN_RETRY_MS   = 20;
+constexpr int DRAIN_TIMEOUT_MS = 500; // after the last write
+
+int64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+struct Histogram {
+    const char *name;
+    LatencyHistogram<BUCKETS> us{};
+
+    void add(int64_t ns) { us.add(ns > 0 ? static_cast<uint64_t>(ns / 1000) : 0); }
+
+    void print(std::ostream &out) const {
+        out << name << ": ";
+        if (!us.count()) {
+            out << "no samples\n";
+            return;
+        }
+        out << "avg " << us.avgUs() << " us, p50 <" << us.quantileUs(0.50)
+            << " us, p99 <" << us.quantileUs(0.99) << " us, p99.9 <" << us.quantileUs(0.999)
+            << " us, max " << us.maxUs() << " us\n";
+        uint64_t counts[BUCKETS];
+        uint64_t peak = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            counts[i] = us.bucket(i);
+            peak = counts[i] > peak ? counts[i] : peak;
+        }
+        for (int i = 0; i < BUCKETS; ++i) {
+            if (!counts[i]) continue;
+            const uint64_t lo = i ? 1ULL << (i - 1) : 0;
+            const int bar = static_cast<int>(counts[i] * 40 / peak);
+            out << "  " << std::setw(7) << lo << " us - " << std::setw(7)
+                << (i == BUCKETS - 1 ? std::string("...") : std::to_string(1ULL << i))
+                << " us " << std::setw(8) << counts[i] << " " << std::string(bar ? bar : 1, '#')
+                << "\n";
+        }
+    }
+};
+
+int openNode(const char *path) {
+    for (int attempt = 0; attempt < OPEN_ATTEMPTS; ++attempt) {
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd >= 0 || errno != ENOENT) return fd;
+        usleep(OPEN_RETRY_MS * 1000);
+    }
+    return -1;
+}
+
+} // namespace
+
+int run(int frames, int intervalUs) {
+    if (frames <= 0) frames = DEFAULT_FRAMES;
+    if (intervalUs < 0) intervalUs = 0;
+
+    Error err{};
+    const int device = init_uinput_stylus("inkbridge-latency-probe", &err);
+    if (device < 0 || err.code) {
+        std::cerr << "[Probe] Cannot create a uinput device: " << err.error_str
+                  << " (is the uinput module loaded and /dev/uinput writable?)" << std::endl;
+        if (device >= 0) close(device);
+        return 1;
+    }
+
+    char node[64];
+    if (uinput_evdev_path(device, node, sizeof(node)) != 0) {
+        std::cerr << "[Probe] Cannot resolve the event node of the probe device" << std::endl;
+        destroy_uinput_device(device);
+        return 1;
+    }
+    const int reader = openNode(node);
+    if (reader < 0) {
+        std::cerr << "[Probe] Cannot open " << node << ": " << strerror(errno) << std::endl;
+        destroy_uinput_device(device);
+        return 1;
+    }
+    // Event timestamps on the same clock as our write times.
+    int clockId = CLOCK_MONOTONIC;
+    if (ioctl(reader, EVIOCSCLOCKID, &clockId) < 0) {
+        std::cerr << "[Probe] EVIOCSCLOCKID failed: " << strerror(errno) << std::endl;
+        close(reader);
+        destroy_uinput_device(device);
+        return 1;
+    }
+
+    // Written by the writer before each write(), read by the reader once
+    // the frame comes back.
+    std::unique_ptr<std::atomic<int64_t>[]> writtenNs(new std::atomic<int64_t>[frames]);
+    for (int i = 0; i < frames; ++i) writtenNs[i].store(0, std::memory_order_relaxed);
+
+    Histogram inject{"write -> stamp"};
+    Histogram wakeup{"stamp -> read "};
+    Histogram loop  {"write -> read "};
+    uint64_t received = 0, dropped = 0, unmatched = 0;
+    std::atomic<bool> writing{true};
+
+    std::thread readerThread([&]() {
+        pollfd pfd{reader, POLLIN, 0};
+        input_event events[64];
+        int64_t seq = -1;   // MSC_TIMESTAMP of the frame being read
+        while (true) {
+            const int n = poll(&pfd, 1, DRAIN_TIMEOUT_MS);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                if (!writing.load()) break;   // drained
+                continue;
+            }
+            const ssize_t got = read(reader, events, sizeof(events));
+            if (got <= 0) continue;
+            const int64_t readNs = monotonicNs();
+            const size_t count = static_cast<size_t>(got) / sizeof(input_event);
+            for (size_t i = 0; i < count; ++i) {
+                const input_event &ev = events[i];
+                if (ev.type == EV_MSC && ev.code == MSC_TIMESTAMP) {
+                    seq = static_cast<uint32_t>(ev.value);
+                } else if (ev.type == EV_SYN && ev.code == SYN_DROPPED) {
+                    dropped++;
+                    seq = -1;
+                } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                    if (seq < 0 || seq >= frames || !writtenNs[seq].load(std::memory_order_acquire)) {
+                        unmatched++;
+                        continue;
+                    }
+                    const int64_t wrote = writtenNs[seq].load(std::memory_order_acquire);
+                    const int64_t stamp = static_cast<int64_t>(ev.input_event_sec) * 1000000000LL
+                                        + static_cast<int64_t>(ev.input_event_usec) * 1000;
+                    inject.add(stamp - wrote);
+                    wakeup.add(readNs - stamp);
+                    loop.add(readNs - wrote);
+                    received++;
+                    seq = -1;
+                }
+            }
+            if (received + dropped >= static_cast<uint64_t>(frames) && !writing.load()) break;
+        }
+    });
+
+    std::cout << "Latency probe: " << frames << " frames, " << intervalUs
+              << " us apart, via " << node << std::endl;
+
+    input_event frame[4] = {};
+    frame[0].type = EV_MSC; frame[0].code = MSC_TIMESTAMP;
+    frame[1].type = EV_ABS; frame[1].code = ABS_X;
+    frame[2].type = EV_ABS; frame[2].code = ABS_Y;
+    frame[3].type = EV_SYN; frame[3].code = SYN_REPORT;
+
+    uint64_t writeErrors = 0;
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < frames; ++i) {
+        frame[0].value = i;
+        // Always a new position, so the input core never filters the frame.
+        frame[1].value = i % ABS_MAX_VAL;
+        frame[2].value = (i / ABS_MAX_VAL) % ABS_MAX_VAL;
+
+        writtenNs[i].store(monotonicNs(), std::memory_order_release);
+        Error werr{};
+        if (send_uinput_frame(device, frame, sizeof(frame), &werr) != static_cast<long>(sizeof(frame))) {
+            writeErrors++;
+        }
+
+        if (intervalUs > 0) {
+            next.tv_nsec += static_cast<long>(intervalUs) * 1000;
+            while (next.tv_nsec >= 1000000000L) { next.tv_nsec -= 1000000000L; next.tv_sec++; }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR) {}
+        }
+    }
+    writing = false;
+    readerThread.join();
+
+    close(reader);
+    destroy_uinput_device(device);
+
+    const uint64_t lost = static_cast<uint64_t>(frames) - received;
+    std::cout << "Delivered " << received << "/" << frames << ", " << dropped
+              << " SYN_DROPPED, " << writeErrors << " write errors, "
+              << unmatched << " unmatched reports\n";
+    inject.print(std::cout);
+    wakeup.print(std::cout);
+    loop.print(std::cout);
+    std::cout.flush();
+    return lost ? 2 : 0;
+}
+
+int runFromArgs(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--latency-probe", 15) != 0) continue;
+        int frames     = DEFAULT_FRAMES;
+        int intervalUs = DEFAULT_INTERVAL_US;
+        if (argv[i][15] == '=') frames = atoi(argv[i] + 16);
+        for (int j = 1; j < argc; ++j) {
+            if (strncmp(argv[j], "--probe-interval=", 17) == 0) intervalUs = atoi(argv[j] + 17);
+        }
+        return run(frames, intervalUs);
+    }
+    return -1;
+}
+
+bool isProbeArg(const char *arg) {
+    return strncmp(arg, "--latency-probe", 15) == 0 || strncmp(arg, "--probe-interval=", 17) == 0;
+}
+
+} // namespace LatencyProbe
@@ -0,0 +1,45 @@
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+
+/**
+ * LatencyProbe — measures how long the kernel takes to hand an injected
+ * frame to a reader of the event device, without a tablet or a display.
+ *
+ * Creates a throw-away uinput stylus, opens its /dev/input/eventN node
+ * (uinput_evdev_path) with CLOCK_MONOTONIC event timestamps, and writes
+ * 'frames' reports 'intervalUs' apart from one thread while a second thread
+ * reads them back. Every frame is MSC_TIMESTAMP = sequence number, an
+ * ABS_X move, SYN_REPORT; the reader matches each SYN_REPORT to the
+ * CLOCK_MONOTONIC time just before its write() and records three log2-us
+ * histograms:
+ *
+ *   write -> stamp   syscall entry until evdev stamped the frame
+ *   stamp -> read    kernel timestamp until the reader had it in hand
+ *   write -> read    the whole loopback
+ *
+ * No tool bit is ever set, so compositors ignore the device. Needs
+ * /dev/uinput and the event node to be accessible (the same rules as the
+ * app itself). Run with "inkbridge --latency-probe[=FRAMES]
+ * [--probe-interval=US]" (or the same on inkbridged); the report goes to
+ * stdout.
+ *
+ * Returns 0 when every frame came back, 1 if the probe could not run, 2 if
+ * frames were lost (SYN_DROPPED or never delivered).
+ */
+namespace LatencyProbe {
+
+constexpr int DEFAULT_FRAMES      = 5000;
+constexpr int DEFAULT_INTERVAL_US = 1000;   // a 1 kHz pen
+
+int run(int frames = DEFAULT_FRAMES, int intervalUs = DEFAULT_INTERVAL_US);
+
+// Runs the probe if argv has --latency-probe[=FRAMES], with the interval
+// from --probe-interval=US, and returns its exit code; -1 otherwise.
+int runFromArgs(int argc, char *argv[]);
+
+// True for the probe's own options, which the caller's parser should skip.
+bool isProbeArg(const char *arg);
+
+} // namespace LatencyProbe
+
+#endif // LATENCYPROBE_H
@@ -7,27 +7,45 @@
 
 // External legacy function - We will need to refactor this next!
 // Note: We changed the signature to accept our new C++ class
-extern void accessory_main(InkBridge::UsbConnection* conn, VirtualStylus* virtualStylus);
+extern void accessory_main(InkBridge::UsbConnection* conn, VirtualStylus* virtualStylus,
+                           UsbRecoveryStats* stats);
 
 namespace InkBridge {
 
+std::atomic<bool> shutdown_requested(false);
+
 void signal_handler(int) {
     std::cout << "SIGINT: Stopping accessory..." << std::endl;
-    stop_acc = true;
+    shutdown_requested = true;
 }
 
 UsbConnection::UsbConnection(Config cfg) : config(std::move(cfg)) {
-    // Initialize LibUSB context (could be wrapped in a class too, but acceptable here)
-    libusb_init(nullptr);
-    // libusb_set_option(nullptr, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_INFO);
+    // Private LibUSB context per connection (see linux-adk.h)
+    if (libusb_init(&ctx) < 0) {
+        std::cerr << "libusb_init failed." << std::endl;
+        ctx = nullptr;
+    }
+    // libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_INFO);
 }
 
 UsbConnection::~UsbConnection() {
     handle.reset(); // Closes device handle via LibUsbDeleter
-    libusb_exit(nullptr);
+    if (ctx) libusb_exit(ctx);
+}
+
+std::string UsbConnection::locationOf(libusb_device* dev) {
+    uint8_t ports[8];
+    int depth = libusb_get_port_numbers(dev, ports, sizeof(ports));
+
+    std::string location = std::to_string(libusb_get_bus_number(dev));
+    for (int i = 0; i < depth; ++i) {
+        location += (i == 0 ? "-" : ".");
+        location += std::to_string(ports[i]);
+    }
+    return location;
 }
 
-int UsbConnection::startCapture(const std::string& selectedDevice, VirtualStylus* stylus) {
+int UsbConnection::open(const std::string& selectedDevice) {
     // Update config with user selection
     config.deviceId = selectedDevice;
 
@@ -46,11 +64,24 @@ int UsbConnection::startCapture(const std::string& selectedDevice, VirtualStylus
         return -1;
     }
 
+    // Claimed here rather than in the capture loop, so a device another
+    // process holds (the GUI and inkbridged both running) or one we lack
+    // permission for fails before the caller builds a stylus for it.
+    int ret = libusb_claim_interface(handle.get(), 0);
+    if (ret != 0) {
+        std::cerr << "Error claiming interface: " << libusb_error_name(ret) << std::endl;
+        handle.reset();
+        return ret;
+    }
+    std::cout << "Accessory interface claimed." << std::endl;
+    return 0;
+}
+
+void UsbConnection::capture(VirtualStylus* stylus, UsbRecoveryStats* stats) {
+    if (!handle) return;
     // Call the main loop (defined in accessory.cpp)
     // We pass 'this' because we are the new "Accessory Context"
-    accessory_main(this, stylus);
-
-    return 0;
+    accessory_main(this, stylus, stats);
 }
 
 bool UsbConnection::isAccessoryPresent() {
@@ -58,25 +89,69 @@ bool UsbConnection::isAccessoryPresent() {
     const uint16_t VID = 0x18D1;
     const uint16_t PIDS[] = {0x2D00, 0x2D01};
 
-    for (uint16_t pid : PIDS) {
-        libusb_device_handle* raw_handle = libusb_open_device_with_vid_pid(nullptr, VID, pid);
-        if (raw_handle) {
-            std::cout << "Found accessory " << std::hex << VID << ":" << pid << std::dec << std::endl;
-            
-            // Transfer ownership to unique_ptr
-            handle.reset(raw_handle);
-
-            // --- THE FIX: AUTO-DETACH KERNEL DRIVER ---
-            // This tells libusb: "If the OS (cdc_acm) is holding this, detach it automatically."
-            if (libusb_set_auto_detach_kernel_driver(handle.get(), 1) != LIBUSB_SUCCESS) {
-                std::cerr << "Warning: Could not enable auto-detach kernel driver." << std::endl;
-            }
-            // ------------------------------------------
-
-            return true;
+    if (!ctx) return false;
+
+    libusb_device** devs = nullptr;
+    ssize_t cnt = libusb_get_device_list(ctx, &devs);
+    if (cnt < 0) return false;
+
+    libusb_device_handle* raw_handle = nullptr;
+    for (ssize_t i = 0; i < cnt && !raw_handle; i++) {
+        struct libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(devs[i], &desc) < 0) continue;
+        if (desc.idVendor != VID) continue;
+
+        bool isAccessoryPid = false;
+        for (uint16_t pid : PIDS) isAccessoryPid |= (desc.idProduct == pid);
+        if (!isAccessoryPid) continue;
+
+        // Skip accessories that belong to another connection.
+        if (!config.location.empty() && locationOf(devs[i]) != config.location) continue;
+
+        if (libusb_open(devs[i], &raw_handle) == 0) {
+            std::cout << "Found accessory " << std::hex << VID << ":" << desc.idProduct << std::dec
+                      << " at " << locationOf(devs[i]) << std::endl;
+        } else {
+            raw_handle = nullptr;
         }
     }
-    return false;
+    libusb_free_device_list(devs, 1);
+
+    if (!raw_handle) return false;
+
+    // Transfer ownership to unique_ptr
+    handle.reset(raw_handle);
+
+    // --- THE FIX: AUTO-DETACH KERNEL DRIVER ---
+    // This tells libusb: "If the OS (cdc_acm) is holding this, detach it automatically."
+    if (libusb_set_auto_detach_kernel_driver(handle.get(), 1) != LIBUSB_SUCCESS) {
+        std::cerr << "Warning: Could not enable auto-detach kernel driver." << std::endl;
+    }
+    // ------------------------------------------
+
+    return true;
+}
+
+libusb_device_handle* UsbConnection::openDevice(uint16_t vid, uint16_t pid) {
+    if (!ctx) return nullptr;
+    if (config.location.empty()) return libusb_open_device_with_vid_pid(ctx, vid, pid);
+
+    libusb_device** devs = nullptr;
+    ssize_t cnt = libusb_get_device_list(ctx, &devs);
+    if (cnt < 0) return nullptr;
+
+    libusb_device_handle* raw_handle = nullptr;
+    for (ssize_t i = 0; i < cnt; i++) {
+        struct libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(devs[i], &desc) < 0) continue;
+        if (desc.idVendor != vid || desc.idProduct != pid) continue;
+        if (locationOf(devs[i]) != config.location) continue;
+
+        if (libusb_open(devs[i], &raw_handle) != 0) raw_handle = nullptr;
+        break;
+    }
+    libusb_free_device_list(devs, 1);
+    return raw_handle;
 }
 
 void UsbConnection::sendString(uint16_t index, const std::string& str) {
@@ -119,10 +194,11 @@ int UsbConnection::initAccessory(int maxAoaVersion) {
     uint16_t vid = (uint16_t)std::stoi(config.deviceId.substr(0, colonPos), nullptr, 16);
     uint16_t pid = (uint16_t)std::stoi(config.deviceId.substr(colonPos + 1), nullptr, 16);
 
-    std::cout << "Looking for device " << std::hex << vid << ":" << pid << std::dec << std::endl;
+    std::cout << "Looking for device " << std::hex << vid << ":" << pid << std::dec
+              << (config.location.empty() ? "" : " at " + config.location) << std::endl;
 
-    // 3. Open generic device
-    libusb_device_handle* raw_handle = libusb_open_device_with_vid_pid(nullptr, vid, pid);
+    // 3. Open generic device (the one at our port, with several of a kind)
+    libusb_device_handle* raw_handle = openDevice(vid, pid);
     if (!raw_handle) {
         std::cerr << "Unable to open device." << std::endl;
         return -1;
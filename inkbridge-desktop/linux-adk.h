@@ -3,14 +3,20 @@
 
 #include <string>
 #include <memory>
+#include <atomic>
 #include <libusb-1.0/libusb.h>
 #include "virtualstylus.h"
+#include "accessory.h"
 
 namespace InkBridge {
 
 // Forward declaration
 class UsbConnection;
 
+// Set by the SIGINT handler only. Every capture loop checks it in addition
+// to its own per-connection stop flag.
+extern std::atomic<bool> shutdown_requested;
+
 // Moved OUTSIDE the class to fix GCC build error
 struct UsbConnectionConfig {
     std::string deviceId = "18d1:4ee2";
@@ -20,6 +26,11 @@ struct UsbConnectionConfig {
     std::string version = "1.0.0";
     std::string url = "https://github.com/dagaza/InkBridge";
     std::string serial = "INKBRIDGE001";
+
+    // Physical location ("bus-port.port...") of the device to open. Empty
+    // means "first matching device", which is fine with a single tablet.
+    // With several tablets attached every connection pins its own port.
+    std::string location;
 };
 
 /**
@@ -37,8 +48,26 @@ public:
     UsbConnection(const UsbConnection&) = delete;
     UsbConnection& operator=(const UsbConnection&) = delete;
 
-    int startCapture(const std::string& deviceId, VirtualStylus* stylus);
+    // Switches the device to accessory mode if needed, opens it and claims
+    // its interface. 0 on success; otherwise nothing is held and the caller
+    // has not committed anything (no stylus, no session) to the attempt.
+    int open(const std::string& deviceId);
+    // Runs the capture loop on the claimed interface. Blocks until the
+    // device is unplugged, an unrecoverable error occurs or the stop flag
+    // is set.
+    void capture(VirtualStylus* stylus, UsbRecoveryStats* stats = nullptr);
     libusb_device_handle* getHandle() const { return handle.get(); }
+    libusb_context* getContext() const { return ctx; }
+
+    // The capture loop runs until this flag (owned by the caller) is set,
+    // the process is interrupted, or the device goes away.
+    void setStopFlag(const std::atomic<bool>* flag) { stopFlag = flag; }
+    bool shouldStop() const {
+        return shutdown_requested || (stopFlag && stopFlag->load());
+    }
+
+    // "bus-port.port..." for a device, stable across the AOA re-enumeration.
+    static std::string locationOf(libusb_device* dev);
 
     // --- MOVED TO PUBLIC ---
     bool isAccessoryPresent();
@@ -54,11 +83,18 @@ private:
         }
     };
 
+    // Each connection has its own libusb context so concurrent captures do
+    // not serialize on the default context's internal locks.
+    libusb_context* ctx = nullptr;
     std::unique_ptr<libusb_device_handle, LibUsbDeleter> handle;
     Config config;
     uint32_t aoaVersion = 0;
+    const std::atomic<bool>* stopFlag = nullptr;
 
     int initAccessory(int maxAoaVersion);
+    // The vid:pid device at config.location, or the first one if no
+    // location is set. Null if there is none or it cannot be opened.
+    libusb_device_handle* openDevice(uint16_t vid, uint16_t pid);
     void sendString(uint16_t index, const std::string& str);
 };
 
@@ -3,9 +3,17 @@
 #include <QQmlContext>
 #include <QIcon>  // Required for the icon
 #include "backend.h"
+#include "latencyprobe.h"
+#include "procstats.h"
 
 int main(int argc, char *argv[])
 {
+    // Headless diagnostics: run before any Qt object exists, so no display
+    // is needed.
+    //   --latency-probe[=FRAMES] [--probe-interval=US]
+    const int probeResult = LatencyProbe::runFromArgs(argc, argv);
+    if (probeResult >= 0) return probeResult;
+
     // High DPI scaling for modern 4K/Laptop screens
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
@@ -38,5 +46,10 @@ int main(int argc, char *argv[])
     
     engine.load(url);
 
+    // Compare with the "[Daemon] Ready" line of inkbridged.
+    qDebug().noquote() << QString("[InkBridge] UI ready in %1 ms, RSS %2 KiB")
+                              .arg(ProcStats::sinceStartMs(), 0, 'f', 0)
+                              .arg(ProcStats::rssKiB());
+
     return app.exec();
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <cstdint>
+#include <type_traits>
+#include "accessory.h"
+
+/**
+ * Sample pipeline — per-sample processing as a compile-time chain of stages.
+ *
+ * A pen sample passes through
+ *     decode -> filter(s) -> map -> pressure -> emit
+ * where each stage is a type with
+ *     template <typename Ctx> static bool apply(Ctx &ctx, PenFrame &frame);
+ * and returning false ends the chain for that sample (a filter swallowing
+ * it). StylusPipeline<Stages...>::run is a fold over the list, so every
+ * stage is inlined into one function and a stage that is not in the list
+ * leaves no code behind: no flag test, no indirect call.
+ *
+ * The owner (VirtualStylus) keeps a small fixed set of instantiations, one
+ * per supported combination of features, and picks one through a function
+ * pointer when a setting changes (never per sample).
+ */
+
+// What the stages work on. 'event' is the decoded sample; the rest is
+// filled in as the frame moves down the chain.
+struct PenFrame {
+    AccessoryEventData *event = nullptr;
+    uint64_t timestampUs = 0;   // MSC_TIMESTAMP source
+
+    // decode
+    bool position   = false;    // carries a position (else the pen left)
+    bool touching   = false;
+    bool eraser     = false;    // tool to put in proximity
+    int  buttonCode = 0;        // barrel key to hold down, 0 = none
+    bool tap        = false;    // touching for this frame only (TouchDebouncer)
+
+    // map / pressure
+    int32_t x = 0;
+    int32_t y = 0;
+    int     pressure = 0;
+
+    // emit
+    bool injected   = false;    // reached the kernel (not swallowed by a filter)
+};
+
+template <typename... Stages>
+struct StylusPipeline {
+    template <typename Ctx>
+    static void run(Ctx &ctx, PenFrame &frame) {
+        (void)(Stages::apply(ctx, frame) && ...);
+    }
+};
+
+// Placeholder for a stage that is switched off in an instantiation.
+struct NoStage {
+    template <typename Ctx>
+    static bool apply(Ctx &, PenFrame &) { return true; }
+};
+
+// 'S' when 'On', else nothing, so optional stages can be listed in place.
+template <bool On, typename S>
+using Optional = std::conditional_t<On, S, NoStage>;
+
+#endif // PIPELINE_H
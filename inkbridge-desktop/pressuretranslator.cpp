@@ -27,6 +27,13 @@ int PressureTranslator::getResultingPressure(AccessoryEventData * accessoryEvent
     return static_cast<int>(curvedPressure * ABS_MAX_VAL);
 }
 
+int PressureTranslator::getLinearPressure(AccessoryEventData * accessoryEventData){
+    float rawPressure = accessoryEventData->pressure;
+    if (rawPressure <= 0.0f) return 0;
+    if (rawPressure > 1.0f) rawPressure = 1.0f;
+    return static_cast<int>(rawPressure * ABS_MAX_VAL);
+}
+
 float PressureTranslator::getPressureSensitivityPercentage(){
     return sensitivity / 50.0;
 }
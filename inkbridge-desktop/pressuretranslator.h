@@ -9,6 +9,10 @@ public:
     int sensitivity = 50;
     int minPressure = 0;
     int getResultingPressure(AccessoryEventData * accessoryEventData);
+    // True at the default settings, where the curve is the identity and
+    // getLinearPressure() gives the same result without the pow().
+    bool isLinear() const { return sensitivity == 50 && minPressure == 0; }
+    int getLinearPressure(AccessoryEventData * accessoryEventData);
 private:
     float getPressureSensitivityPercentage();
 };
@@ -0,0 +1,53 @@
+#ifndef PROCSTATS_H
+#define PROCSTATS_H
+
+#include <time.h>
+#include <unistd.h>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/**
+ * ProcStats — footprint figures for comparing the GUI and daemon builds.
+ *
+ * sinceStartMs() counts from the kernel's process start time, so dynamic
+ * loading and static initialisers (most of a Qt Quick startup) are
+ * included. The start time is in clock ticks, so the figure is only good
+ * to about 10 ms.
+ */
+namespace ProcStats {
+
+// Resident set size (VmRSS) in KiB, 0 if unavailable.
+inline uint64_t rssKiB() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) return std::stoull(line.substr(6));
+    }
+    return 0;
+}
+
+// Milliseconds since the process was started, -1 if unavailable.
+inline double sinceStartMs() {
+    std::ifstream statFile("/proc/self/stat");
+    std::string stat;
+    std::getline(statFile, stat);
+    // The command name may contain spaces; the fields after it do not.
+    const size_t close = stat.rfind(')');
+    if (close == std::string::npos) return -1;
+    std::istringstream fields(stat.substr(close + 2));
+    std::string field;
+    // starttime is field 22; 'fields' starts at field 3.
+    for (int i = 3; i <= 22 && fields >> field; ++i) {}
+    if (!fields) return -1;
+
+    timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    const double startMs = std::stoull(field) * 1000.0 / sysconf(_SC_CLK_TCK);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6 - startMs;
+}
+
+} // namespace ProcStats
+
+#endif // PROCSTATS_H
@@ -1,6 +1,7 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include <cstddef>
 #include <cstdint>
 
 // Ensure 1-byte alignment so the struct is exactly 22 bytes
@@ -26,6 +27,256 @@ struct PenPacket {
     int32_t tiltY; // New: Tilt along Y axis (Degrees)
 };
 
+/**
+ * @brief Protocol v2 sample: a PenPacket prefixed with a sequence number.
+ * Total size: 25 bytes.
+ * Format:
+ * [1B marker 0xB2] [2B sequence] [22B PenPacket]
+ *
+ * v1 and v2 records can share a stream: the first byte of a v1 packet is a
+ * toolType (0-4) and of a heartbeat 0x7F, so the marker alone tells them
+ * apart. The sequence increments by one per sample (not per heartbeat) and
+ * wraps at 65535. A tablet sends v2 only after the desktop advertised it
+ * with a ProtocolVersionFrame, so v1 tablets and older desktops are
+ * unaffected.
+ */
+enum : uint8_t {
+    PEN_PACKET_V2    = 0xB2,
+    PEN_TIMESTAMP    = 0xB3,
+    PEN_KEYFRAME     = 0xD0,
+    PEN_DELTA        = 0xD1
+};
+
+struct PenPacketV2 {
+    uint8_t   marker;   // PEN_PACKET_V2 or PEN_KEYFRAME
+    uint16_t  sequence;
+    PenPacket sample;
+};
+
+/**
+ * @brief Compact encoding (optional, for slow links such as RFCOMM).
+ *
+ * A key frame is laid out exactly like PenPacketV2 but marked PEN_KEYFRAME;
+ * it sets the state that the following deltas build on. A delta is:
+ * [1B marker 0xD1] [1B mask] [fields...]
+ *
+ * Only the fields whose mask bit is set follow, in bit order. toolType and
+ * action are single raw bytes; the others are the change since the previous
+ * sample as a zigzag varint (LEB128 of (v << 1) ^ (v >> 31)), so a move of a
+ * few units costs one byte. DELTA_TIME is the device time elapsed since the
+ * previous sample, in microseconds (FEATURE_DEVICE_TIME only). A delta's
+ * sequence number is the previous sample's plus one. A typical stroke
+ * sample is 5-7 bytes instead of 22.
+ *
+ * The tablet may switch to it only if the ProtocolVersionFrame carried
+ * FEATURE_COMPACT, and should send a key frame at least every 64 samples
+ * and after every state change it wants to be robust against loss.
+ */
+enum DeltaField : uint8_t {
+    DELTA_TOOL     = 1 << 0,
+    DELTA_ACTION   = 1 << 1,
+    DELTA_X        = 1 << 2,
+    DELTA_Y        = 1 << 3,
+    DELTA_PRESSURE = 1 << 4,
+    DELTA_TILT_X   = 1 << 5,
+    DELTA_TILT_Y   = 1 << 6,
+    DELTA_TIME     = 1 << 7
+};
+
+// Marker + mask + two raw bytes + six 32-bit varints of up to 5 bytes.
+constexpr size_t PEN_DELTA_MAX_SIZE = 2 + 2 + 6 * 5;
+
+/**
+ * @brief When the next sample happened, on the tablet's clock.
+ * Total size: 5 bytes.
+ * Format:
+ * [1B marker 0xB3] [4B device time, microseconds, low 32 bits]
+ *
+ * Precedes the sample record it describes (any format). The desktop widens
+ * it to 64 bits against the last full device time it saw (a PongFrame or an
+ * earlier timestamp), so it may wrap. Sent only with FEATURE_DEVICE_TIME.
+ */
+struct PenTimestamp {
+    uint8_t  marker;        // PEN_TIMESTAMP
+    uint32_t deviceTimeUs;
+};
+
+/**
+ * @brief Tablet -> desktop capability hello.
+ * Total size: 12 bytes (longer payloads from newer tablets are accepted;
+ * the extra bytes are ignored).
+ * Format:
+ * [1B type 0xA1] [1B payload length] [payload]
+ *
+ * Sent by the tablet as the first record of a USB, TCP or RFCOMM session,
+ * before any sample. The desktop answers with a HelloAck. A tablet that
+ * sends no hello is treated as v1 with the old defaults.
+ */
+enum : uint8_t {
+    TABLET_HELLO = 0xA1,
+    TABLET_PONG  = 0xA3
+};
+
+// Tablet -> desktop control records are 0xA0-0xAF and all follow the
+// [type][length][payload] layout, so a desktop can skip ones it does not know.
+constexpr uint8_t TABLET_CONTROL_FIRST = 0xA0;
+constexpr uint8_t TABLET_CONTROL_LAST  = 0xAF;
+
+struct TabletHello {
+    uint8_t  type;           // TABLET_HELLO
+    uint8_t  length;         // payload bytes that follow (10)
+    uint8_t  version;        // highest sample format the tablet can send
+    uint8_t  features;       // ProtocolFeature bits the tablet supports
+    uint16_t sampleRateHz;   // nominal rate while the pen moves, 0 = unknown
+    uint16_t surfaceWidth;   // range of PenPacket::x, 0 = unknown
+    uint16_t surfaceHeight;  // range of PenPacket::y, 0 = unknown
+    uint16_t heartbeatMs;    // idle heartbeat period, 0 = none
+};
+
+/**
+ * @brief Tablet -> desktop answer to a PingFrame. Total size: 26 bytes.
+ *
+ * All three times are microseconds; the device ones on the same clock as
+ * PenTimestamp, taken as close to the socket as the tablet can.
+ */
+struct PongFrame {
+    uint8_t  type;            // TABLET_PONG
+    uint8_t  length;          // payload bytes that follow (24)
+    uint64_t hostSendUs;      // echoed from the ping
+    uint64_t deviceRecvUs;    // when the ping arrived
+    uint64_t deviceSendUs;    // when this pong left
+};
+
+/**
+ * @brief Desktop -> tablet control frames (reverse channel).
+ *
+ * Sent over the same TCP socket, RFCOMM socket or USB accessory (bulk OUT)
+ * the tablet streams on. Format:
+ * [1B type] [1B payload length] [payload]
+ *
+ * Types are >= 0xC0 so they can never be confused with a PenPacket
+ * (toolType 0-4) or a heartbeat (0x7F). A tablet that does not know a type
+ * skips 'length' bytes; one that never reads the channel loses nothing.
+ */
+enum ControlType : uint8_t {
+    CONTROL_FLOW      = 0xC0,
+    CONTROL_VERSION   = 0xC1,
+    CONTROL_HELLO_ACK = 0xC2,
+    CONTROL_PING      = 0xC3,
+    CONTROL_UDP_OFFER = 0xC4
+};
+
+// Highest sample format this desktop decodes.
+constexpr uint8_t PROTOCOL_VERSION_MAX = 2;
+
+// ProtocolVersionFrame / TabletHello / HelloAck features
+enum ProtocolFeature : uint8_t {
+    FEATURE_COMPACT     = 1 << 0,  // PEN_KEYFRAME / PEN_DELTA records
+    FEATURE_HISTORICAL  = 1 << 1,  // batched historical samples are forwarded
+    FEATURE_HEARTBEAT   = 1 << 2,  // idle heartbeats every heartbeatMs
+    FEATURE_TILT        = 1 << 3,  // tiltX / tiltY are meaningful
+    FEATURE_DEVICE_TIME = 1 << 4,  // PenTimestamp / DELTA_TIME, answers pings
+    FEATURE_UDP         = 1 << 5   // samples may also arrive as UdpDatagrams
+};
+
+/**
+ * @brief Asks the tablet to send less when the desktop cannot keep up.
+ * Total size: 6 bytes.
+ */
+struct FlowControlFrame {
+    uint8_t  type;             // CONTROL_FLOW
+    uint8_t  length;           // payload bytes that follow (4)
+    uint16_t maxSampleRateHz;  // 0 = no limit
+    uint8_t  hoverDecimation;  // send 1 of every N hover-moves (1 = all)
+    uint8_t  reserved;
+};
+
+/**
+ * @brief Tells the tablet which sample formats the desktop understands.
+ * Sent once when the connection opens. Total size: 4 bytes.
+ */
+struct ProtocolVersionFrame {
+    uint8_t type;        // CONTROL_VERSION
+    uint8_t length;      // payload bytes that follow (2)
+    uint8_t maxVersion;  // PROTOCOL_VERSION_MAX
+    uint8_t features;    // ProtocolFeature bits the desktop decodes
+};
+
+/**
+ * @brief Answer to a TabletHello: what the tablet should use from now on.
+ * Total size: 6 bytes.
+ */
+struct HelloAck {
+    uint8_t  type;      // CONTROL_HELLO_ACK
+    uint8_t  length;    // payload bytes that follow (4)
+    uint8_t  version;   // sample format to send (<= both sides' maximum)
+    uint8_t  features;  // ProtocolFeature bits both sides agreed on
+    uint16_t reserved;
+};
+
+/**
+ * @brief Clock sync probe, sent once per second once FEATURE_DEVICE_TIME
+ * was agreed. The tablet answers with a PongFrame. Total size: 10 bytes.
+ */
+struct PingFrame {
+    uint8_t  type;        // CONTROL_PING
+    uint8_t  length;      // payload bytes that follow (8)
+    uint64_t hostSendUs;  // desktop steady clock, echoed back
+};
+
+/**
+ * @brief Where to send UDP samples, sent with the HelloAck once FEATURE_UDP
+ * was agreed (WiFi Direct only). Total size: 8 bytes.
+ */
+struct UdpOfferFrame {
+    uint8_t  type;    // CONTROL_UDP_OFFER
+    uint8_t  length;  // payload bytes that follow (6)
+    uint16_t port;    // on the address the TCP connection went to
+    uint32_t token;   // goes into every UdpDatagramHeader
+};
+
+/**
+ * @brief Low-latency sample datagram (tablet -> desktop, UDP).
+ * Format:
+ * [1B marker 0xE1] [1B reserved] [4B token] [records...]
+ *
+ * The records are whole PenPacketV2s, each optionally preceded by its
+ * PenTimestamp, oldest first. A datagram repeats the last few samples
+ * already sent (UDP_REDUNDANCY is the suggested count), so one lost
+ * datagram costs nothing; the desktop drops the copies by sequence number.
+ * Compact records are not allowed: a delta is useless once the datagram
+ * before it went missing.
+ *
+ * Touch-down, lift-off, hover enter/exit and button changes must also be
+ * sent on the TCP connection, with the same sequence number. Whichever copy
+ * arrives first is injected and the other is a duplicate, so a transition
+ * is never lost and is never late by more than the TCP path.
+ */
+enum : uint8_t {
+    UDP_DATAGRAM = 0xE1
+};
+
+constexpr int    UDP_REDUNDANCY   = 3;
+constexpr size_t UDP_MAX_DATAGRAM = 1400;  // stays under a WiFi MTU
+
+struct UdpDatagramHeader {
+    uint8_t  marker;    // UDP_DATAGRAM
+    uint8_t  reserved;
+    uint32_t token;     // from the UdpOfferFrame
+};
+
 #pragma pack(pop)
 
+static_assert(sizeof(PenPacket) == 22, "PenPacket must be 22 bytes on the wire");
+static_assert(sizeof(PenPacketV2) == 25, "PenPacketV2 must be 25 bytes on the wire");
+static_assert(sizeof(FlowControlFrame) == 6, "FlowControlFrame must be 6 bytes on the wire");
+static_assert(sizeof(ProtocolVersionFrame) == 4, "ProtocolVersionFrame must be 4 bytes on the wire");
+static_assert(sizeof(TabletHello) == 12, "TabletHello must be 12 bytes on the wire");
+static_assert(sizeof(HelloAck) == 6, "HelloAck must be 6 bytes on the wire");
+static_assert(sizeof(PenTimestamp) == 5, "PenTimestamp must be 5 bytes on the wire");
+static_assert(sizeof(PongFrame) == 26, "PongFrame must be 26 bytes on the wire");
+static_assert(sizeof(PingFrame) == 10, "PingFrame must be 10 bytes on the wire");
+static_assert(sizeof(UdpOfferFrame) == 8, "UdpOfferFrame must be 8 bytes on the wire");
+static_assert(sizeof(UdpDatagramHeader) == 6, "UdpDatagramHeader must be 6 bytes on the wire");
+
 #endif // PROTOCOL_H
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "rfcommreader.h"
+#include "hovershedder.h"
+#include "rtsched.h"
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+RfcommReader::RfcommReader(int fd, Callbacks callbacks)
+    : m_fd(fd)
+    , m_callbacks(std::move(callbacks))
+    , m_storage(std::make_unique<uint8_t[]>(RX_BUFFER_SIZE))
+    , m_ring(m_storage.get(), RX_BUFFER_SIZE)
+{
+}
+
+RfcommReader::~RfcommReader() {
+    stop();
+    if (m_wakeFd >= 0) close(m_wakeFd);
+    if (m_fd >= 0) close(m_fd);
+}
+
+bool RfcommReader::start() {
+    if (m_running) return true;
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        std::cerr << "[BT] eventfd failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // Reads are poll-driven; a send never blocks the reader for long.
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+
+    m_running = true;
+    m_thread = std::thread(&RfcommReader::run, this);
+    return true;
+}
+
+void RfcommReader::stop() {
+    if (!m_thread.joinable()) return;
+    m_running = false;
+    uint64_t one = 1;
+    if (write(m_wakeFd, &one, sizeof(one)) < 0) {
+        // The thread still notices m_running on its next wakeup.
+    }
+    m_thread.join();
+}
+
+bool RfcommReader::send(const uint8_t *data, size_t len) {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    // Finish a frame the socket only partly took before starting this one,
+    // or the tablet would lose framing.
+    if (!sendPending()) return false;
+
+    m_txPending.assign(data, data + len);
+    if (!sendPending() && m_txPending.size() == len) {
+        // Nothing went out at all: drop it and let the caller resend.
+        m_txPending.clear();
+        return false;
+    }
+    return true;
+}
+
+bool RfcommReader::sendPending() {
+    while (!m_txPending.empty()) {
+        ssize_t n = ::send(m_fd, m_txPending.data(), m_txPending.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        // Errors are left for the read path to see.
+        if (n <= 0) return false;
+        m_txPending.erase(m_txPending.begin(), m_txPending.begin() + n);
+    }
+    return true;
+}
+
+void RfcommReader::run() {
+    RtSched::ThreadScope rt(RtSched::ThreadRole::Ingest, "bt-reader");
+
+    pollfd fds[2];
+    fds[0] = {m_fd, POLLIN, 0};
+    fds[1] = {m_wakeFd, POLLIN, 0};
+    uint64_t nextTickUs = HoverShedder::nowUs() + TICK_MS * 1000ULL;
+    bool alive = true;
+
+    while (m_running && alive) {
+        uint64_t now = HoverShedder::nowUs();
+        int timeoutMs = now >= nextTickUs ? 0 : static_cast<int>((nextTickUs - now + 999) / 1000);
+        int n = poll(fds, 2, timeoutMs);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[BT] poll failed: " << strerror(errno) << std::endl;
+            alive = false;
+            break;
+        }
+        const uint64_t wakeUs = HoverShedder::nowUs();
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            while (true) {
+                iovec iov[2];
+                const int parts = m_ring.writable(iov);
+                const size_t room = iov[0].iov_len + (parts > 1 ? iov[1].iov_len : 0);
+                ssize_t got = readv(m_fd, iov, parts);
+                if (got > 0) {
+                    m_reads.fetch_add(1, std::memory_order_relaxed);
+                    m_bytes.fetch_add(static_cast<uint64_t>(got), std::memory_order_relaxed);
+                    m_ring.commit(static_cast<size_t>(got));
+                    if (m_callbacks.onData) m_callbacks.onData(m_ring, wakeUs);
+                    else m_ring.consume(m_ring.size());
+                    // A short read means the socket is drained.
+                    if (static_cast<size_t>(got) < room) break;
+                    continue;
+                }
+                if (got < 0 && errno == EINTR) continue;
+                if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                alive = false; // 0 = orderly shutdown, anything else = error
+                break;
+            }
+        }
+
+        if (alive && wakeUs >= nextTickUs) {
+            // A tail left by send() goes out even if the tick has nothing new.
+            {
+                std::lock_guard<std::mutex> lock(m_sendMutex);
+                sendPending();
+            }
+            if (m_callbacks.onTick) m_callbacks.onTick();
+            nextTickUs = wakeUs + TICK_MS * 1000ULL;
+        }
+    }
+
+    if (!alive && m_callbacks.onClosed) m_callbacks.onClosed();
+}
@@ -0,0 +1,86 @@
+#ifndef RFCOMMREADER_H
+#define RFCOMMREADER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bytering.h"
+
+/**
+ * RfcommReader — the ingest thread of one Bluetooth tablet.
+ *
+ * Owns the connected RFCOMM socket (a plain fd from accept()) and a thread
+ * that polls it and reads into a ByteRing. onData then decodes and injects
+ * straight out of the ring on that thread: nothing is copied into a
+ * QByteArray or queued on the Qt event loop.
+ *
+ * About once per second (TICK_MS) the thread also calls onTick, so the
+ * desktop -> tablet control frames are sent from the same thread, as the
+ * IngestReactor does for WiFi Direct.
+ *
+ * The class knows nothing about Bluetooth beyond the name: any connected
+ * stream socket works, e.g. one end of a socketpair() when exercising it
+ * without an adapter.
+ */
+class RfcommReader
+{
+public:
+    struct Callbacks {
+        // New bytes are in 'ring', on the reader thread. Consume what was
+        // used; the rest stays for the next read. 'arrivedUs' is
+        // HoverShedder::nowUs() at the wakeup.
+        std::function<void(ByteRing &ring, uint64_t arrivedUs)> onData;
+        // About once per second, on the reader thread.
+        std::function<void()> onTick;
+        // The peer closed the socket or it failed. Called once, on the
+        // reader thread, which exits right after.
+        std::function<void()> onClosed;
+    };
+
+    static constexpr size_t RX_BUFFER_SIZE = 4096;  // power of two (ByteRing)
+    static constexpr int    TICK_MS        = 1000;
+
+    // Takes ownership of 'fd'.
+    RfcommReader(int fd, Callbacks callbacks);
+    ~RfcommReader();
+
+    RfcommReader(const RfcommReader&) = delete;
+    RfcommReader& operator=(const RfcommReader&) = delete;
+
+    bool start();
+    // Wakes and joins the thread. Not from inside a callback.
+    void stop();
+
+    // Writes a control frame. Any thread. What the socket does not take
+    // is kept and finished, before anything newer, by the next send() or
+    // tick, so the tablet never sees a frame cut short. Returns false if
+    // nothing of this frame was written (the caller may resend later),
+    // which includes an earlier frame's tail still waiting.
+    bool send(const uint8_t *data, size_t len);
+
+    uint64_t reads() const { return m_reads.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    // True once m_txPending is empty. m_sendMutex held.
+    bool sendPending();
+
+    int                        m_fd;
+    int                        m_wakeFd = -1;  // eventfd used by stop()
+    Callbacks                  m_callbacks;
+    std::unique_ptr<uint8_t[]> m_storage;
+    ByteRing                   m_ring;
+    std::thread                m_thread;
+    std::atomic<bool>          m_running{false};
+    std::mutex                 m_sendMutex;
+    std::vector<uint8_t>       m_txPending;    // control bytes the socket did not take
+    std::atomic<uint64_t>      m_reads{0};
+    std::atomic<uint64_t>      m_bytes{0};
+};
+
+#endif // RFCOMMREADER_H
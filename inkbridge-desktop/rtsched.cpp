@@ -0,0 +1,247 @@
+#include "rtsched.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#ifndef MCL_ONFAULT
+#define MCL_ONFAULT 4
+#endif
+
+// ioprio_set(2) has no glibc wrapper.
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_NONE  0
+#define IOPRIO_CLASS_BE    2
+
+namespace RtSched {
+
+namespace {
+
+constexpr int MAX_THREADS       = 64;
+constexpr int INGEST_PRIORITY   = 10;
+constexpr int WATCHDOG_PRIORITY = 5;
+constexpr int FALLBACK_NICE     = -10;
+
+struct Slot {
+    bool        used = false;
+    pid_t       tid  = 0;
+    pthread_t   handle{};
+    ThreadRole  role = ThreadRole::Ingest;
+    std::string name;
+    std::string state = "default";
+    int         cpu   = -1;
+};
+
+struct JitterStats {
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> totalUs{0};
+    std::atomic<uint64_t> maxUs{0};
+    std::atomic<uint64_t> over1ms{0};
+};
+
+std::mutex        g_mutex;
+Slot              g_slots[MAX_THREADS];
+std::atomic<bool> g_lowLatency{false};
+bool              g_memoryLocked = false;
+int               g_nextCpu = 0;
+std::vector<int>  g_cpus;       // CPUs the process may run on, at startup
+cpu_set_t         g_originalMask;
+JitterStats       g_jitter[2];  // [0] normal, [1] low latency
+
+void loadCpus() {
+    if (!g_cpus.empty()) return;
+    CPU_ZERO(&g_originalMask);
+    if (sched_getaffinity(0, sizeof(g_originalMask), &g_originalMask) < 0) return;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &g_originalMask)) g_cpus.push_back(cpu);
+    }
+}
+
+// Ingest threads go to the highest-numbered CPUs first: CPU 0 usually takes
+// the bulk of device interrupts and housekeeping work.
+int pickCpu() {
+    loadCpus();
+    if (g_cpus.size() < 2) return -1;
+    size_t usable = g_cpus.size() - 1; // leave the lowest CPU alone
+    return g_cpus[g_cpus.size() - 1 - (g_nextCpu++ % usable)];
+}
+
+void applyTo(Slot &slot) {
+    const bool ingest = slot.role == ThreadRole::Ingest;
+    std::string state;
+
+    sched_param param{};
+    param.sched_priority = ingest ? INGEST_PRIORITY : WATCHDOG_PRIORITY;
+    int policy = ingest ? SCHED_FIFO : SCHED_RR;
+    int rc = pthread_setschedparam(slot.handle, policy, &param);
+    if (rc == 0) {
+        state = ingest ? "SCHED_FIFO/10" : "SCHED_RR/5";
+    } else {
+        // No real-time grant: do the best the normal scheduler allows.
+        if (setpriority(PRIO_PROCESS, slot.tid, FALLBACK_NICE) == 0) {
+            state = "nice " + std::to_string(FALLBACK_NICE);
+        } else {
+            state = std::string("default (") + strerror(rc) + ")";
+        }
+        // Best-effort class, level 0 (its highest).
+        int ioprio = IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, slot.tid, ioprio) == 0) {
+            state += ", ioprio be/0";
+        }
+    }
+
+    if (ingest) {
+        if (slot.cpu < 0) slot.cpu = pickCpu();
+        if (slot.cpu >= 0) {
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            CPU_SET(slot.cpu, &mask);
+            if (sched_setaffinity(slot.tid, sizeof(mask), &mask) == 0) {
+                state += ", cpu " + std::to_string(slot.cpu);
+            }
+        }
+    }
+    slot.state = state;
+}
+
+void revert(Slot &slot) {
+    sched_param param{};
+    pthread_setschedparam(slot.handle, SCHED_OTHER, &param);
+    setpriority(PRIO_PROCESS, slot.tid, 0);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, slot.tid, IOPRIO_CLASS_NONE << IOPRIO_CLASS_SHIFT);
+    if (slot.cpu >= 0) {
+        loadCpus();
+        sched_setaffinity(slot.tid, sizeof(g_originalMask), &g_originalMask);
+        slot.cpu = -1;
+    }
+    slot.state = "default";
+}
+
+const char* roleName(ThreadRole role) {
+    return role == ThreadRole::Ingest ? "ingest" : "watchdog";
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Thread registration
+// ---------------------------------------------------------------------------
+
+ThreadScope::ThreadScope(ThreadRole role, const char* name) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        if (g_slots[i].used) continue;
+        Slot &slot  = g_slots[i];
+        slot.used   = true;
+        slot.tid    = static_cast<pid_t>(syscall(SYS_gettid));
+        slot.handle = pthread_self();
+        slot.role   = role;
+        slot.name   = name;
+        slot.state  = "default";
+        slot.cpu    = -1;
+        if (g_lowLatency) applyTo(slot);
+        m_slot = i;
+        return;
+    }
+    // More threads than slots: this one simply stays at default priority.
+}
+
+ThreadScope::~ThreadScope() {
+    if (m_slot < 0) return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_slots[m_slot] = Slot();
+}
+
+// ---------------------------------------------------------------------------
+// Mode switch
+// ---------------------------------------------------------------------------
+
+void setLowLatency(bool enable) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_lowLatency == enable) return;
+    g_lowLatency = enable;
+
+    if (enable) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT) == 0) {
+            g_memoryLocked = true;
+        } else {
+            std::cerr << "[RtSched] mlockall failed: " << strerror(errno) << std::endl;
+        }
+    } else if (g_memoryLocked) {
+        munlockall();
+        g_memoryLocked = false;
+    }
+
+    for (Slot &slot : g_slots) {
+        if (!slot.used) continue;
+        if (enable) applyTo(slot);
+        else        revert(slot);
+    }
+}
+
+bool lowLatency() {
+    return g_lowLatency;
+}
+
+void prefault(void* buffer, size_t len) {
+    if (!buffer || len == 0) return;
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    volatile uint8_t *bytes = static_cast<volatile uint8_t *>(buffer);
+    for (size_t off = 0; off < len; off += page) {
+        bytes[off] = bytes[off];
+    }
+    bytes[len - 1] = bytes[len - 1];
+}
+
+// ---------------------------------------------------------------------------
+// Jitter
+// ---------------------------------------------------------------------------
+
+void recordWakeupLatency(uint64_t lateUs) {
+    JitterStats &st = g_jitter[g_lowLatency ? 1 : 0];
+    st.samples++;
+    st.totalUs += lateUs;
+    if (lateUs > 1000) st.over1ms++;
+    uint64_t prev = st.maxUs.load();
+    while (lateUs > prev && !st.maxUs.compare_exchange_weak(prev, lateUs)) {}
+}
+
+std::string report() {
+    std::ostringstream out;
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    out << "Low-latency mode: " << (g_lowLatency ? "on" : "off")
+        << (g_memoryLocked ? " (memory locked)" : "") << "\n";
+
+    const char *labels[2] = { "normal", "low-latency" };
+    for (int i = 0; i < 2; ++i) {
+        const JitterStats &st = g_jitter[i];
+        uint64_t n = st.samples;
+        out << "Wakeup jitter, " << labels[i] << ": ";
+        if (!n) {
+            out << "no samples\n";
+            continue;
+        }
+        out << n << " wakeups, avg " << (double)st.totalUs / n << " us, max "
+            << st.maxUs << " us, " << st.over1ms << " over 1 ms\n";
+    }
+
+    for (const Slot &slot : g_slots) {
+        if (!slot.used) continue;
+        out << "  " << slot.name << " [" << roleName(slot.role) << ", tid "
+            << slot.tid << "]: " << slot.state << "\n";
+    }
+    return out.str();
+}
+
+} // namespace RtSched
@@ -0,0 +1,68 @@
+#ifndef RTSCHED_H
+#define RTSCHED_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * RtSched — optional low-latency scheduling for the data-path threads.
+ *
+ * Threads that ingest or inject pen samples (USB capture, reactor shards,
+ * Bluetooth ingest) and the per-stylus watchdogs register themselves with a
+ * RtSched::ThreadScope for their lifetime. When low-latency mode is turned
+ * on, every registered thread (and every thread registering later) gets:
+ *
+ *   - Ingest threads:  SCHED_FIFO, priority 10, pinned to one CPU.
+ *   - Watchdog:        SCHED_RR,   priority 5, unpinned.
+ *
+ * Priorities stay well below audio servers (PipeWire/JACK use 80+) and
+ * kernel threads. Without CAP_SYS_NICE or an RLIMIT_RTPRIO grant the policy
+ * change fails; the thread then falls back to nice -10 and the best-effort
+ * I/O class at its highest level, which may also be refused (RLIMIT_NICE),
+ * in which case it stays as it was. What each thread ended up with is in
+ * report().
+ *
+ * Enabling also calls mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT), so
+ * pages stay resident once touched without populating every mapping the Qt
+ * process has. Turning the mode off reverts all of it.
+ */
+namespace RtSched {
+
+enum class ThreadRole {
+    Ingest,   // reads a transport, decodes and injects
+    Watchdog  // periodic liveness check
+};
+
+// Registers the calling thread for its lifetime.
+class ThreadScope
+{
+public:
+    ThreadScope(ThreadRole role, const char* name);
+    ~ThreadScope();
+
+    ThreadScope(const ThreadScope&) = delete;
+    ThreadScope& operator=(const ThreadScope&) = delete;
+
+private:
+    int m_slot = -1;
+};
+
+void setLowLatency(bool enable);
+bool lowLatency();
+
+// Touches every page of 'buffer' so the first real sample does not take a
+// page fault. With mlockall active the pages then stay resident.
+void prefault(void* buffer, size_t len);
+
+// Scheduling jitter: how late a periodic sleep woke up, recorded separately
+// for normal and low-latency mode so the two can be compared.
+void recordWakeupLatency(uint64_t lateUs);
+
+// Per-thread policy plus jitter before/after.
+std::string report();
+
+} // namespace RtSched
+
+#endif // RTSCHED_H
@@ -0,0 +1,134 @@
+#ifndef SEQUENCETRACKER_H
+#define SEQUENCETRACKER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Loss, duplicate and reorder accounting for v2 sample sequences.
+ *
+ * note() is called with the sequence number of every v2 sample in arrival
+ * order. The tracker remembers the highest sequence seen and a 64-sample
+ * window behind it, which is enough to tell apart:
+ *   - a gap (samples skipped ahead; counted as lost until they show up),
+ *   - a late arrival inside the window (reordered; no longer lost if a
+ *     gap had skipped it),
+ *   - a repeat of something already seen (duplicate).
+ * A jump far backwards means the tablet restarted its counter; the tracker
+ * resynchronises instead of counting thousands of duplicates.
+ *
+ * Counters are kept per transport (index = SessionTransport order) so the
+ * diagnostics can tell a lossy Bluetooth link from a misbehaving USB cable.
+ *
+ * One tracker per connection. Not thread-safe; the stats are.
+ */
+class SequenceTracker
+{
+public:
+    // Same order as SessionTransport.
+    enum Link { LinkUsb = 0, LinkWifiDirect = 1, LinkBluetooth = 2, LINK_COUNT };
+
+    // Process-wide counters per link (read by the UI thread).
+    struct Stats {
+        std::atomic<uint64_t> received{0};
+        std::atomic<uint64_t> lost{0};
+        std::atomic<uint64_t> gaps{0};        // gap events, whatever their length
+        std::atomic<uint64_t> duplicates{0};
+        std::atomic<uint64_t> reordered{0};
+        std::atomic<uint64_t> concealed{0};   // single-sample gaps interpolated
+        std::atomic<uint64_t> resyncs{0};
+        std::atomic<uint64_t> misframed{0};   // bytes skipped to find a record start
+    };
+
+    static Stats& stats(int link) {
+        static Stats s[LINK_COUNT];
+        return s[link >= 0 && link < LINK_COUNT ? link : LinkUsb];
+    }
+
+    // Result of note(): how the sample relates to the ones before it.
+    enum Order { InOrder, AfterGap, Late, Duplicate };
+
+    static constexpr int WINDOW      = 64;
+    static constexpr int RESYNC_BACK = 1024; // further back = counter restarted
+
+    explicit SequenceTracker(int link = LinkUsb) : m_stats(stats(link)) {}
+
+    // 'missing' is set to the number of samples skipped right before this
+    // one (only meaningful for AfterGap).
+    Order note(uint16_t sequence, int &missing) {
+        missing = 0;
+        m_stats.received.fetch_add(1, std::memory_order_relaxed);
+
+        if (!m_started) {
+            m_started = true;
+            m_highest = sequence;
+            m_window  = 1;
+            m_lost    = 0;
+            return InOrder;
+        }
+
+        const int delta = static_cast<int16_t>(static_cast<uint16_t>(sequence - m_highest));
+
+        if (delta > 0) {
+            m_window = delta >= WINDOW ? 1 : (m_window << delta) | 1;
+            // The skipped positions, as far back as the window reaches.
+            const uint64_t skipped = delta >= WINDOW ? ~uint64_t(1)
+                                                     : ((uint64_t(1) << delta) - 1) & ~uint64_t(1);
+            m_lost = (delta >= WINDOW ? 0 : m_lost << delta) | skipped;
+            m_highest = sequence;
+            if (delta == 1) return InOrder;
+            missing = delta - 1;
+            m_stats.lost.fetch_add(missing, std::memory_order_relaxed);
+            m_stats.gaps.fetch_add(1, std::memory_order_relaxed);
+            return AfterGap;
+        }
+
+        if (delta == 0) {
+            m_stats.duplicates.fetch_add(1, std::memory_order_relaxed);
+            return Duplicate;
+        }
+
+        if (-delta >= RESYNC_BACK) {
+            m_stats.resyncs.fetch_add(1, std::memory_order_relaxed);
+            m_highest = sequence;
+            m_window  = 1;
+            m_lost    = 0;
+            return InOrder;
+        }
+
+        if (-delta < WINDOW) {
+            const uint64_t bit = uint64_t(1) << -delta;
+            if (m_window & bit) {
+                m_stats.duplicates.fetch_add(1, std::memory_order_relaxed);
+                return Duplicate;
+            }
+            m_window |= bit;
+            // Only a position skipped by a gap was counted as lost; one
+            // from before the first sample or a resync never was.
+            if (m_lost & bit) {
+                m_lost &= ~bit;
+                m_stats.lost.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        m_stats.reordered.fetch_add(1, std::memory_order_relaxed);
+        return Late;
+    }
+
+    void noteConcealed() { m_stats.concealed.fetch_add(1, std::memory_order_relaxed); }
+    void noteMisframed(uint64_t bytes) { m_stats.misframed.fetch_add(bytes, std::memory_order_relaxed); }
+
+    void reset() {
+        m_started = false;
+        m_window  = 0;
+        m_lost    = 0;
+    }
+
+private:
+    Stats   &m_stats;
+    bool     m_started = false;
+    uint16_t m_highest = 0;
+    uint64_t m_window  = 0;  // bit i set = (m_highest - i) has been seen
+    uint64_t m_lost    = 0;  // bit i set = (m_highest - i) was counted lost
+};
+
+#endif // SEQUENCETRACKER_H
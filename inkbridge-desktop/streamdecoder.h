@@ -0,0 +1,528 @@
+#ifndef STREAMDECODER_H
+#define STREAMDECODER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "protocol.h"
+#include "accessory.h"
+#include "sequencetracker.h"
+#include "handshake.h"
+#include "clocksync.h"
+
+/**
+ * @brief Turns a raw byte stream from any transport into pen samples.
+ *
+ * USB bulk reads, TCP segments and RFCOMM chunks do not respect packet
+ * boundaries, so a record can arrive split across two reads. The decoder
+ * keeps the unfinished tail and completes it with the next feed() instead of
+ * dropping it. Network transports receive into a ByteRing instead and call
+ * decode(), which leaves the tail in the ring and so never copies it. UDP
+ * datagrams from the same tablet go through feedDatagram() into the same
+ * sequence and clock state.
+ *
+ * Heartbeats (22 bytes of 0x7F, sent by every Android transport when the
+ * pen is idle) are reported separately so they never reach the injector.
+ *
+ * Records are told apart by their first byte, so any kind of tablet works
+ * without setup:
+ *   - v1 PenPacket (toolType first),
+ *   - v2 PenPacketV2 (sequence-numbered),
+ *   - compact key frames and deltas (see PEN_DELTA in protocol.h),
+ *   - device timestamps (PenTimestamp, DELTA_TIME), which stamp the next
+ *     sample with its time on the desktop clock once ClockSync has pongs,
+ *   - tablet control records (0xA0-0xAF): the TabletHello, kept for
+ *     takeHello(), and PongFrames, fed to ClockSync.
+ * Once a hello has been seen, record types the tablet did not negotiate are
+ * treated as misframed bytes: a stray 0xB2 inside a v1 stream can then no
+ * longer swallow 25 bytes.
+ * For sequenced records the SequenceTracker accounts for loss, duplicates
+ * and reordering: duplicates and stale moves are dropped, and a single
+ * missing move between two moves of the same stroke is concealed by
+ * emitting the midpoint before the newer sample. A byte that cannot start
+ * any record means the stream lost framing; it is skipped (and counted)
+ * until a record start lines up.
+ *
+ * One decoder per connection. Not thread-safe; it is owned by whichever
+ * thread ingests that connection.
+ */
+class PenStreamDecoder
+{
+public:
+    static constexpr size_t PACKET_SIZE    = sizeof(PenPacket);
+    static constexpr size_t PACKET_V2_SIZE = sizeof(PenPacketV2);
+    static constexpr size_t MAX_RECORD     = PEN_DELTA_MAX_SIZE > PACKET_V2_SIZE
+                                             ? PEN_DELTA_MAX_SIZE : PACKET_V2_SIZE;
+    static constexpr uint8_t HEARTBEAT_BYTE = 127;
+    // Highest first byte of a v1 packet (its toolType). Android uses 0-5.
+    static constexpr uint8_t MAX_TOOL_TYPE = 0x1F;
+
+    // Process-wide wire format counters per link (read by the UI thread).
+    struct WireStats {
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> samples{0};      // records that decoded to a sample
+        std::atomic<uint64_t> keyframes{0};
+        std::atomic<uint64_t> deltas{0};
+        std::atomic<uint64_t> deltaBytes{0};
+        std::atomic<uint64_t> orphanDeltas{0}; // delta with no key frame to apply to
+        std::atomic<uint64_t> datagrams{0};    // fed through feedDatagram()
+        std::atomic<uint64_t> copiedBytes{0};  // moved to reassemble split records
+        std::atomic<uint64_t> decodeNs{0};     // time spent decoding
+    };
+
+    static WireStats& wireStats(int link) {
+        static WireStats s[SequenceTracker::LINK_COUNT];
+        return s[link >= 0 && link < SequenceTracker::LINK_COUNT ? link : 0];
+    }
+
+    // 'link' selects which per-transport stats to feed.
+    explicit PenStreamDecoder(int link = SequenceTracker::LinkUsb)
+        : m_sequence(link), m_wire(wireStats(link)), m_clock(link) {}
+
+    // Calls onSample(AccessoryEventData&) for every sample to inject and
+    // onHeartbeat() for every heartbeat, in stream order.
+    template <typename SampleSink, typename HeartbeatSink>
+    void feed(const uint8_t* data, size_t len,
+              SampleSink&& onSample, HeartbeatSink&& onHeartbeat)
+    {
+        const auto started = beginFeed(len);
+
+        // 1. Complete a record left over from the previous read. A delta's
+        //    length is only known once its varints are in, so this may take
+        //    a byte at a time; it only ever runs for the one split record.
+        while (m_partialLen > 0) {
+            size_t need = recordLength(m_partial, m_partialLen);
+            if (m_partialLen < need) {
+                if (len == 0) break;
+                size_t take = len < need - m_partialLen ? len : need - m_partialLen;
+                std::memcpy(m_partial + m_partialLen, data, take);
+                m_partialLen += take;
+                m_wire.copiedBytes.fetch_add(take, std::memory_order_relaxed);
+                data += take;
+                len  -= take;
+                continue;
+            }
+            size_t used = dispatch(m_partial, need, onSample, onHeartbeat);
+            std::memmove(m_partial, m_partial + used, m_partialLen - used);
+            m_partialLen -= used;
+        }
+
+        // 2. Whole records straight out of the caller's buffer.
+        while (len > 0) {
+            size_t need = recordLength(data, len);
+            if (need > len) break;
+            size_t used = dispatch(data, need, onSample, onHeartbeat);
+            data += used;
+            len  -= used;
+        }
+
+        // 3. Keep the tail for next time.
+        if (len > 0) {
+            std::memcpy(m_partial + m_partialLen, data, len);
+            m_partialLen += len;
+            m_wire.copiedBytes.fetch_add(len, std::memory_order_relaxed);
+        }
+
+        endFeed(started);
+    }
+
+    // Decodes in place from a receive ring's filled space, given as two
+    // spans (ByteRing::readable(); 'second' is the part that wrapped).
+    // Returns how many bytes were used; an incomplete last record is left
+    // for the caller to keep, so unlike feed() nothing is buffered here.
+    // Only a record that straddles the wrap is copied, into a stack buffer.
+    template <typename SampleSink, typename HeartbeatSink>
+    size_t decode(const uint8_t* first, size_t firstLen,
+                  const uint8_t* second, size_t secondLen,
+                  SampleSink&& onSample, HeartbeatSink&& onHeartbeat)
+    {
+        const size_t total = firstLen + secondLen;
+        const auto started = beginFeed(0);
+        size_t pos = 0;
+
+        while (pos < total) {
+            if (pos >= firstLen) {
+                const uint8_t *raw = second + (pos - firstLen);
+                const size_t avail = total - pos;
+                const size_t need  = recordLength(raw, avail);
+                if (need > avail) break;
+                pos += dispatch(raw, need, onSample, onHeartbeat);
+                continue;
+            }
+
+            const size_t inFirst = firstLen - pos;
+            const size_t need    = recordLength(first + pos, inFirst);
+            if (need <= inFirst) {
+                pos += dispatch(first + pos, need, onSample, onHeartbeat);
+                continue;
+            }
+
+            // The record runs past the end of the storage.
+            uint8_t stitched[MAX_RECORD];
+            const size_t have = total - pos < MAX_RECORD ? total - pos : MAX_RECORD;
+            std::memcpy(stitched, first + pos, inFirst);
+            std::memcpy(stitched + inFirst, second, have - inFirst);
+            const size_t whole = recordLength(stitched, have);
+            if (whole > have) break;
+            m_wire.copiedBytes.fetch_add(whole, std::memory_order_relaxed);
+            pos += dispatch(stitched, whole, onSample, onHeartbeat);
+        }
+
+        // Bytes left unused are counted when a later call uses them.
+        m_wire.bytes.fetch_add(pos, std::memory_order_relaxed);
+        endFeed(started);
+        return pos;
+    }
+
+    // Same as feed() for the payload of one UdpDatagram (after its header).
+    // A datagram is self-contained: it neither completes nor leaves a
+    // partial record, and only timestamps, v2 samples and heartbeats may be
+    // in it. Redundant copies of samples already seen (on UDP or TCP) are
+    // dropped as duplicates by the sequence tracker.
+    template <typename SampleSink, typename HeartbeatSink>
+    void feedDatagram(const uint8_t* data, size_t len,
+                      SampleSink&& onSample, HeartbeatSink&& onHeartbeat)
+    {
+        const auto started = beginFeed(len);
+        m_wire.datagrams.fetch_add(1, std::memory_order_relaxed);
+
+        // A timestamp the TCP stream left pending belongs to the stream's
+        // next sample, not to one in here.
+        const bool    streamPending = m_timePending;
+        const int64_t streamTimeUs  = m_deviceTimeUs;
+        m_timePending = false;
+
+        while (len > 0) {
+            const uint8_t first = data[0];
+            const size_t  need  = recordLength(data, len);
+            if (need > len || (first != PEN_PACKET_V2 && first != PEN_TIMESTAMP &&
+                               first != HEARTBEAT_BYTE)) {
+                m_sequence.noteMisframed(len);
+                break;
+            }
+            size_t used = dispatch(data, need, onSample, onHeartbeat);
+            data += used;
+            len  -= used;
+        }
+
+        m_timePending = streamPending;
+        if (streamPending) m_deviceTimeUs = streamTimeUs;
+
+        endFeed(started);
+    }
+
+    // Returns true once for every hello received, with its contents. The
+    // caller applies it (VirtualStylus::applyTabletHello) and acks it
+    // (ControlChannel::acceptHello).
+    bool takeHello(TabletHello &hello) {
+        if (!m_helloPending) return false;
+        m_helloPending = false;
+        hello = m_hello;
+        return true;
+    }
+
+    // Drops any half-received record (e.g. after a failed transfer). The
+    // sequence state is kept, so whatever was lost still counts as lost;
+    // deltas wait for the next key frame.
+    void reset() {
+        m_partialLen = 0;
+        m_havePrevious = false;
+        m_haveKey = false;
+    }
+
+    static bool isHeartbeat(const uint8_t* raw) {
+        for (size_t i = 0; i < PACKET_SIZE; ++i) {
+            if (raw[i] != HEARTBEAT_BYTE) return false;
+        }
+        return true;
+    }
+
+    static void toEventData(const PenPacket& packet, AccessoryEventData& data) {
+        data.toolType = packet.toolType;
+        data.action   = packet.action;
+        data.x        = packet.x;
+        data.y        = packet.y;
+        // Pressure is encoded as (event.pressure * 4096) on Android.
+        // Dividing by 4096.0f restores the original 0.0-1.0 float range.
+        data.pressure = static_cast<float>(packet.pressure) / 4096.0f;
+        data.tiltX    = packet.tiltX;
+        data.tiltY    = packet.tiltY;
+    }
+
+private:
+    static constexpr int ACTION_MOVE       = 2;  // MotionEvent.ACTION_MOVE
+    static constexpr int ACTION_HOVER_MOVE = 7;  // MotionEvent.ACTION_HOVER_MOVE
+    static constexpr int BUTTON_BIT        = 32;
+
+    std::chrono::steady_clock::time_point beginFeed(size_t len) {
+        const auto started = std::chrono::steady_clock::now();
+        m_feedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            started.time_since_epoch()).count();
+        m_wire.bytes.fetch_add(len, std::memory_order_relaxed);
+        return started;
+    }
+
+    void endFeed(std::chrono::steady_clock::time_point started) {
+        m_wire.decodeNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count(), std::memory_order_relaxed);
+    }
+
+    // Bytes the record starting at 'raw' occupies. If that cannot be known
+    // from the 'avail' bytes yet, returns more than 'avail'. Never more than
+    // MAX_RECORD.
+    static size_t recordLength(const uint8_t* raw, size_t avail) {
+        switch (raw[0]) {
+        case PEN_PACKET_V2:
+        case PEN_KEYFRAME:
+            return PACKET_V2_SIZE;
+        case PEN_DELTA:
+            return deltaLength(raw, avail);
+        case PEN_TIMESTAMP:
+            return sizeof(PenTimestamp);
+        default:
+            if (raw[0] >= TABLET_CONTROL_FIRST && raw[0] <= TABLET_CONTROL_LAST) {
+                if (avail < 2) return 2;
+                // Too long to be a record we could buffer: not one.
+                return raw[1] + size_t(2) <= MAX_RECORD ? raw[1] + size_t(2) : 1;
+            }
+            return PACKET_SIZE;
+        }
+    }
+
+    static size_t deltaLength(const uint8_t* raw, size_t avail) {
+        if (avail < 2) return 2;
+        const uint8_t mask = raw[1];
+        size_t pos = 2;
+        for (unsigned bit = DELTA_TOOL; bit <= DELTA_TIME; bit <<= 1) {
+            if (!(mask & bit)) continue;
+            if (bit == DELTA_TOOL || bit == DELTA_ACTION) { ++pos; continue; }
+            // Varint: continuation bit set on all but the last of <= 5 bytes.
+            for (int n = 0; n < 5; ++n) {
+                if (pos >= avail) return avail + 1;
+                if (!(raw[pos++] & 0x80)) break;
+            }
+        }
+        return pos;
+    }
+
+    static int32_t readVarint(const uint8_t*& p) {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte = *p++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+    }
+
+    static bool isMove(const AccessoryEventData& d) {
+        int base = d.action & ~BUTTON_BIT;
+        return base == ACTION_MOVE || base == ACTION_HOVER_MOVE;
+    }
+
+    // Decodes one record of 'length' bytes at 'raw' and returns how many
+    // bytes it consumed: 'length', or 1 if 'raw' does not start a record.
+    template <typename SampleSink, typename HeartbeatSink>
+    size_t dispatch(const uint8_t* raw, size_t length,
+                    SampleSink& onSample, HeartbeatSink& onHeartbeat) {
+        const uint8_t first = raw[0];
+
+        switch (first) {
+        case HEARTBEAT_BYTE:
+            if (!isHeartbeat(raw)) break;
+            onHeartbeat();
+            return PACKET_SIZE;
+
+        case TABLET_HELLO:
+            if (length < sizeof(TabletHello)) break;
+            std::memcpy(&m_hello, raw, sizeof(TabletHello));
+            m_hello.length = sizeof(TabletHello) - 2;
+            m_helloPending = true;
+            {
+                const HelloAck agreed = Handshake::negotiate(m_hello);
+                m_allowV2      = agreed.version >= 2;
+                m_allowCompact = agreed.features & FEATURE_COMPACT;
+                m_allowTime    = agreed.features & FEATURE_DEVICE_TIME;
+            }
+            return length;
+
+        case TABLET_PONG: {
+            if (length < sizeof(PongFrame)) break;
+            PongFrame pong;
+            std::memcpy(&pong, raw, sizeof(PongFrame));
+            m_clock.addExchange(static_cast<int64_t>(pong.hostSendUs),
+                                static_cast<int64_t>(pong.deviceRecvUs),
+                                static_cast<int64_t>(pong.deviceSendUs),
+                                m_feedUs);
+            m_deviceTimeUs = static_cast<int64_t>(pong.deviceSendUs);
+            return length;
+        }
+
+        case PEN_TIMESTAMP: {
+            if (!m_allowTime) break;
+            PenTimestamp stamp;
+            std::memcpy(&stamp, raw, sizeof(PenTimestamp));
+            // Widen against the last full device time; samples move forward.
+            m_deviceTimeUs += static_cast<int32_t>(stamp.deviceTimeUs -
+                                                   static_cast<uint32_t>(m_deviceTimeUs));
+            m_timePending = true;
+            return sizeof(PenTimestamp);
+        }
+
+        case PEN_PACKET_V2:
+        case PEN_KEYFRAME: {
+            if (!(first == PEN_PACKET_V2 ? m_allowV2 : m_allowCompact)) break;
+            // memcpy instead of reinterpret_cast: 'raw' has no alignment guarantee.
+            PenPacketV2 packet;
+            std::memcpy(&packet, raw, PACKET_V2_SIZE);
+            if (first == PEN_KEYFRAME) {
+                m_key = packet;
+                m_haveKey = true;
+                m_wire.keyframes.fetch_add(1, std::memory_order_relaxed);
+            }
+            AccessoryEventData eventData;
+            toEventData(packet.sample, eventData);
+            deliverSequenced(packet.sequence, eventData, onSample);
+            return PACKET_V2_SIZE;
+        }
+
+        case PEN_DELTA:
+            if (length < 2 || !m_allowCompact) break;
+            applyDelta(raw, length, onSample);
+            return length;
+
+        default:
+            if (first > MAX_TOOL_TYPE) break;
+            PenPacket packet;
+            std::memcpy(&packet, raw, PACKET_SIZE);
+            AccessoryEventData eventData;
+            toEventData(packet, eventData);
+            stamp(eventData);
+            m_wire.samples.fetch_add(1, std::memory_order_relaxed);
+            onSample(eventData);
+            return PACKET_SIZE;
+        }
+
+        // Unknown tablet control records are skipped whole.
+        if (first >= TABLET_CONTROL_FIRST && first <= TABLET_CONTROL_LAST && length >= 2) {
+            return length;
+        }
+
+        m_sequence.noteMisframed(1);
+        return 1;
+    }
+
+    template <typename SampleSink>
+    void applyDelta(const uint8_t* raw, size_t length, SampleSink& onSample) {
+        m_wire.deltas.fetch_add(1, std::memory_order_relaxed);
+        m_wire.deltaBytes.fetch_add(length, std::memory_order_relaxed);
+        if (!m_haveKey) {
+            m_wire.orphanDeltas.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        const uint8_t mask = raw[1];
+        const uint8_t *p = raw + 2;
+        PenPacket &s = m_key.sample;
+        // Sums wrap like the sender's int32 subtraction did.
+        auto add = [](int32_t base, int32_t d) {
+            return static_cast<int32_t>(static_cast<uint32_t>(base) + static_cast<uint32_t>(d));
+        };
+        if (mask & DELTA_TOOL)     s.toolType = *p++;
+        if (mask & DELTA_ACTION)   s.action   = *p++;
+        if (mask & DELTA_X)        s.x        = add(s.x, readVarint(p));
+        if (mask & DELTA_Y)        s.y        = add(s.y, readVarint(p));
+        if (mask & DELTA_PRESSURE) s.pressure = add(s.pressure, readVarint(p));
+        if (mask & DELTA_TILT_X)   s.tiltX    = add(s.tiltX, readVarint(p));
+        if (mask & DELTA_TILT_Y)   s.tiltY    = add(s.tiltY, readVarint(p));
+        if (mask & DELTA_TIME) {
+            m_deviceTimeUs += readVarint(p);
+            m_timePending = m_allowTime;
+        }
+        ++m_key.sequence;
+
+        AccessoryEventData eventData;
+        toEventData(s, eventData);
+        deliverSequenced(m_key.sequence, eventData, onSample);
+    }
+
+    template <typename SampleSink>
+    void deliverSequenced(uint16_t sequence, AccessoryEventData& eventData, SampleSink& onSample) {
+        stamp(eventData);
+        int missing = 0;
+        switch (m_sequence.note(sequence, missing)) {
+        case SequenceTracker::Duplicate:
+            return;
+        case SequenceTracker::Late:
+            // A newer position has already been injected; moving back to an
+            // older one would only draw a hook. State changes still count.
+            if (isMove(eventData)) return;
+            m_wire.samples.fetch_add(1, std::memory_order_relaxed);
+            onSample(eventData);
+            return;
+        case SequenceTracker::AfterGap:
+            if (missing == 1 && m_havePrevious && isMove(eventData) &&
+                m_previous.action == eventData.action &&
+                m_previous.toolType == eventData.toolType) {
+                AccessoryEventData mid = eventData;
+                mid.x        = m_previous.x + (eventData.x - m_previous.x) / 2;
+                mid.y        = m_previous.y + (eventData.y - m_previous.y) / 2;
+                mid.pressure = (m_previous.pressure + eventData.pressure) * 0.5f;
+                mid.tiltX    = m_previous.tiltX + (eventData.tiltX - m_previous.tiltX) / 2;
+                mid.tiltY    = m_previous.tiltY + (eventData.tiltY - m_previous.tiltY) / 2;
+                if (m_previous.hostTimeUs && eventData.hostTimeUs) {
+                    mid.hostTimeUs = m_previous.hostTimeUs +
+                                     (eventData.hostTimeUs - m_previous.hostTimeUs) / 2;
+                }
+                m_sequence.noteConcealed();
+                onSample(mid);
+            }
+            break;
+        case SequenceTracker::InOrder:
+            break;
+        }
+        m_previous = eventData;
+        m_havePrevious = true;
+        m_wire.samples.fetch_add(1, std::memory_order_relaxed);
+        onSample(eventData);
+    }
+
+    // Applies a pending device timestamp to the sample that follows it and
+    // records how long the sample took to get here.
+    void stamp(AccessoryEventData& eventData) {
+        if (!m_timePending) return;
+        m_timePending = false;
+        if (!m_clock.synced()) return;
+        const int64_t host = m_clock.toHost(m_deviceTimeUs);
+        if (host <= 0) return;
+        eventData.hostTimeUs = static_cast<uint64_t>(host);
+        m_clock.recordOneWay(m_feedUs - host);
+    }
+
+    uint8_t m_partial[MAX_RECORD];
+    size_t  m_partialLen = 0;
+
+    SequenceTracker    m_sequence;
+    WireStats         &m_wire;
+    AccessoryEventData m_previous{};
+    bool               m_havePrevious = false;
+
+    PenPacketV2        m_key{};      // state the next delta applies to
+    bool               m_haveKey = false;
+
+    // Until a hello narrows them down, every record type is accepted.
+    TabletHello        m_hello{};
+    bool               m_helloPending = false;
+    bool               m_allowV2      = true;
+    bool               m_allowCompact = true;
+    bool               m_allowTime    = true;
+
+    ClockSync          m_clock;
+    int64_t            m_feedUs       = 0;  // steady clock at the current feed()
+    int64_t            m_deviceTimeUs = 0;  // last full device time seen
+    bool               m_timePending  = false;
+};
+
+#endif // STREAMDECODER_H
@@ -0,0 +1,122 @@
+#include "stylussession.h"
+#include "virtualstylus.h"
+#include "displayscreentranslator.h"
+#include "pressuretranslator.h"
+#include <QDebug>
+
+StylusSession::StylusSession(int id, SessionTransport transport, const QString &peer)
+    : m_id(id)
+    , m_transport(transport)
+    , m_peer(peer)
+    , m_decoder(static_cast<int>(transport))
+{
+    m_displayTranslator  = std::make_unique<DisplayScreenTranslator>();
+    m_pressureTranslator = std::make_unique<PressureTranslator>();
+    m_stylus = std::make_unique<VirtualStylus>(m_displayTranslator.get(),
+                                               m_pressureTranslator.get());
+
+    // Each session gets its own uinput node so the compositor sees one
+    // independent tablet per physical device.
+    m_stylus->initializeStylus(QString("pen-emu-%1").arg(m_id).toStdString());
+
+    // Idle heartbeat period of the Android side, as the watchdog's starting
+    // point until it has measured the real one.
+    m_stylus->setHeartbeatInterval(m_transport == SessionTransport::Usb ? 500 : 100);
+
+    qDebug() << "[Session]" << label() << "created.";
+}
+
+StylusSession::~StylusSession() {
+    // Lift the pen and remove the uinput node before the translators it
+    // points at go away.
+    m_stylus->destroyStylus();
+    m_stylus.reset();
+
+    qDebug() << "[Session]" << label() << "destroyed.";
+}
+
+QString StylusSession::transportName(SessionTransport transport) {
+    switch (transport) {
+    case SessionTransport::Usb:        return "USB";
+    case SessionTransport::WifiDirect: return "WiFi Direct";
+    case SessionTransport::Bluetooth:  return "Bluetooth";
+    }
+    return "Unknown";
+}
+
+QString StylusSession::label() const {
+    return QString("#%1 %2 (%3)").arg(m_id).arg(transportName(m_transport), m_peer);
+}
+
+// ---------------------------------------------------------------------------
+// Mapping & pressure
+// ---------------------------------------------------------------------------
+
+void StylusSession::setTargetScreen(int index, QRect geometry) {
+    m_screenIndex = index;
+    m_stylus->setTargetScreen(geometry);
+}
+
+void StylusSession::setTotalDesktopGeometry(QRect geometry) {
+    m_stylus->setTotalDesktopGeometry(geometry);
+}
+
+void StylusSession::setPressure(int sensitivity, int minPressure) {
+    // Under the stylus lock: the ingest thread reads the curve per sample.
+    m_stylus->setPressureCurve(sensitivity, minPressure);
+}
+
+int StylusSession::pressureSensitivity() const { return m_stylus->pressureSensitivity(); }
+int StylusSession::minPressure() const         { return m_stylus->minPressure(); }
+
+void StylusSession::setSwapAxis(bool swap) { m_stylus->setSwapAxis(swap); }
+bool StylusSession::swapAxis() const       { return m_stylus->swapAxis(); }
+
+void StylusSession::setButtonMapping(ButtonMapping mapping) { m_stylus->setButtonMapping(mapping); }
+ButtonMapping StylusSession::buttonMapping() const         { return m_stylus->buttonMapping(); }
+
+void StylusSession::setTouchDebounce(bool enable) { m_stylus->setTouchDebounce(enable); }
+bool StylusSession::touchDebounce() const         { return m_stylus->touchDebounce(); }
+void StylusSession::setSynDropGuard(bool enable)  { m_stylus->setSynDropGuard(enable); }
+bool StylusSession::synDropGuard() const          { return m_stylus->synDropGuard(); }
+void StylusSession::setSharedStream(bool enable)  { m_stylus->setSharedStream(enable); }
+bool StylusSession::sharedStream() const          { return m_stylus->sharedStream(); }
+
+// ---------------------------------------------------------------------------
+// Network ingest
+// ---------------------------------------------------------------------------
+
+void StylusSession::ingest(ByteRing &ring, uint64_t arrivedUs) {
+    const uint8_t *first, *second;
+    size_t firstLen, secondLen;
+    ring.readable(first, firstLen, second, secondLen);
+    ring.consume(m_decoder.decode(first, firstLen, second, secondLen,
+                                  [this](AccessoryEventData &eventData) { m_shedder.push(eventData); },
+                                  [this] { m_stylus->noteHeartbeat(); }));
+
+    TabletHello hello;
+    if (m_decoder.takeHello(hello)) {
+        qDebug() << "[Session]" << label() << "hello:"
+                 << QString::fromStdString(Handshake::describe(hello));
+        m_stylus->applyTabletHello(hello);
+        m_control.acceptHello(hello);
+    }
+
+    m_shedder.drain(arrivedUs, [this](AccessoryEventData &eventData) {
+        m_stylus->handleAccessoryEventData(&eventData);
+    });
+}
+
+void StylusSession::ingestDatagram(const uint8_t *data, size_t len, uint64_t arrivedUs) {
+    m_decoder.feedDatagram(data, len,
+                           [this](AccessoryEventData &eventData) { m_shedder.push(eventData); },
+                           [this] { m_stylus->noteHeartbeat(); });
+
+    m_shedder.drain(arrivedUs, [this](AccessoryEventData &eventData) {
+        m_stylus->handleAccessoryEventData(&eventData);
+    });
+}
+
+size_t StylusSession::controlTick(uint8_t *out) {
+    return m_control.tick(m_shedder.samples(), m_shedder.shed(), out);
+}
@@ -0,0 +1,119 @@
+#ifndef STYLUSSESSION_H
+#define STYLUSSESSION_H
+
+#include <QString>
+#include <QRect>
+#include <memory>
+#include "streamdecoder.h"
+#include "bytering.h"
+#include "hovershedder.h"
+#include "controlchannel.h"
+#include "ingestsink.h"
+
+class VirtualStylus;
+enum class ButtonMapping;
+class DisplayScreenTranslator;
+class PressureTranslator;
+
+enum class SessionTransport {
+    Usb,
+    WifiDirect,
+    Bluetooth
+};
+
+/**
+ * StylusSession — one connected tablet.
+ *
+ * Everything a tablet needs to drive its own cursor lives here and is never
+ * shared with another session: the uinput device ("pen-emu-<id>"), the
+ * screen mapping, the pressure curve and the decoder. Each is fed by the
+ * one thread that owns the tablet's connection, so two tablets can draw at
+ * the same time without contending for anything on the data path.
+ *
+ * Ingest threads:
+ *   - USB: the capture thread that runs accessory_main() for this device
+ *     owns the session and drives the stylus directly.
+ *   - WiFi Direct: the IngestReactor shard that owns the connection calls
+ *     ingest() right after recv(), on the shard thread.
+ *   - Bluetooth: the RfcommReader thread that owns this tablet's RFCOMM
+ *     socket calls ingest() right after read(), so a slow uinput write on
+ *     one tablet never delays another tablet's socket.
+ */
+class StylusSession : public IngestSink
+{
+public:
+    StylusSession(int id, SessionTransport transport, const QString &peer);
+    ~StylusSession() override;
+
+    StylusSession(const StylusSession&) = delete;
+    StylusSession& operator=(const StylusSession&) = delete;
+
+    int id() const { return m_id; }
+    SessionTransport transport() const { return m_transport; }
+    QString peer() const { return m_peer; }
+    QString label() const;
+    static QString transportName(SessionTransport transport);
+
+    VirtualStylus *stylus() const { return m_stylus.get(); }
+
+    // --- MAPPING & PRESSURE ---
+    void setTargetScreen(int index, QRect geometry);
+    int  screenIndex() const { return m_screenIndex; }
+    void setTotalDesktopGeometry(QRect geometry);
+    void setPressure(int sensitivity, int minPressure);
+    int  pressureSensitivity() const;
+    int  minPressure() const;
+    void setSwapAxis(bool swap);
+    bool swapAxis() const;
+    void setButtonMapping(ButtonMapping mapping);
+    ButtonMapping buttonMapping() const;
+    void setTouchDebounce(bool enable);
+    bool touchDebounce() const;
+    void setSynDropGuard(bool enable);
+    bool synDropGuard() const;
+    void setSharedStream(bool enable);
+    bool sharedStream() const;
+
+    // --- NETWORK INGEST ---
+    // Decodes what 'ring' holds in place and injects it on the calling
+    // thread, consuming every complete record; a split one stays in the
+    // ring for the next read. Only one thread may call it for a given
+    // session (the reactor shard or RFCOMM reader owning the connection).
+    // 'arrivedUs' (HoverShedder::nowUs() clock) is when the bytes were
+    // received; it lets stale hover-moves be shed if injection lags.
+    void ingest(ByteRing &ring, uint64_t arrivedUs) override;
+
+    // One UDP datagram's records (header already checked and stripped).
+    // Same thread rules as ingest(); the reactor shard owns both sockets.
+    void ingestDatagram(const uint8_t *data, size_t len, uint64_t arrivedUs) override;
+
+    // --- CONTROL CHANNEL ---
+    // Called about once per second by the thread that owns the connection.
+    // Writes the control frames due for the tablet into 'out' (at least
+    // ControlChannel::MAX_BYTES) and returns their length; call
+    // controlUnsent() if the send fails.
+    size_t controlTick(uint8_t *out) override;
+    void   controlUnsent() override { m_control.markUnsent(); }
+    // True when a frame (the hello ack) should go out before the next tick;
+    // takeUrgentControl() then produces just that. Any thread.
+    bool   controlUrgent() const override { return m_control.urgent(); }
+    size_t takeUrgentControl(uint8_t *out) override { return m_control.takeUrgent(out); }
+    // Offered to the tablet with the hello ack if it agrees to FEATURE_UDP.
+    void   setUdpOffer(uint16_t port, uint32_t token) override { m_control.setUdpOffer(port, token); }
+
+private:
+    const int              m_id;
+    const SessionTransport m_transport;
+    const QString          m_peer;
+    int                    m_screenIndex = 0;
+
+    std::unique_ptr<DisplayScreenTranslator> m_displayTranslator;
+    std::unique_ptr<PressureTranslator>      m_pressureTranslator;
+    std::unique_ptr<VirtualStylus>           m_stylus;
+
+    PenStreamDecoder        m_decoder;
+    HoverShedder            m_shedder;
+    ControlChannel          m_control;
+};
+
+#endif // STYLUSSESSION_H
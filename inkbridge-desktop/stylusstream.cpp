@@ -0,0 +1,198 @@
+#include "stylusstream.h"
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace {
+
+constexpr size_t MAPPING_SIZE = sizeof(StylusStreamHeader) + STREAM_CAPACITY * sizeof(StylusStreamSlot);
+
+uint64_t monotonicUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+long futex(std::atomic<uint32_t> *word, int op, uint32_t value, const timespec *timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), op, value, timeout, nullptr, 0);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Producer
+// ---------------------------------------------------------------------------
+
+StylusStream::~StylusStream() {
+    close();
+}
+
+bool StylusStream::open(const std::string &name) {
+    close();
+
+    // A stream left behind by a crashed instance is replaced, not reused.
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        std::cerr << "[Stream] shm_open " << name << " failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, MAPPING_SIZE) < 0) {
+        std::cerr << "[Stream] ftruncate failed: " << strerror(errno) << std::endl;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void *mem = mmap(nullptr, MAPPING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        std::cerr << "[Stream] mmap failed: " << strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // The pages come zeroed, so every slot starts at seq 0 ("not written").
+    auto *header = new (mem) StylusStreamHeader{};
+    header->magic      = STREAM_MAGIC;
+    header->version    = STREAM_VERSION;
+    header->headerSize = sizeof(StylusStreamHeader);
+    header->slotSize   = sizeof(StylusStreamSlot);
+    header->capacity   = STREAM_CAPACITY;
+    header->createdUs  = monotonicUs();
+
+    m_header  = header;
+    m_slots   = reinterpret_cast<StylusStreamSlot *>(static_cast<uint8_t *>(mem) + sizeof(StylusStreamHeader));
+    m_size    = MAPPING_SIZE;
+    m_name    = name;
+    m_skipped = 0;
+    m_wakes   = 0;
+    std::cout << "[Stream] Publishing samples at /dev/shm" << name << std::endl;
+    return true;
+}
+
+void StylusStream::close() {
+    if (!m_header) return;
+    munmap(m_header, m_size);
+    shm_unlink(m_name.c_str());
+    m_header = nullptr;
+    m_slots  = nullptr;
+}
+
+void StylusStream::write(const StylusStreamSample &sample) {
+    const uint64_t n = m_header->head.load(std::memory_order_relaxed);
+    StylusStreamSlot &slot = m_slots[n & (STREAM_CAPACITY - 1)];
+
+    slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.sample, &sample, sizeof(sample));
+    slot.seq.store(2 * n + 2, std::memory_order_release);
+
+    // seq_cst store then load, paired with the reader's waiters increment
+    // then head re-check: one of the two always sees the other.
+    m_header->head.store(n + 1, std::memory_order_seq_cst);
+    if (m_header->waiters.load(std::memory_order_seq_cst) != 0) {
+        m_header->wake.fetch_add(1, std::memory_order_release);
+        futex(&m_header->wake, FUTEX_WAKE, INT_MAX, nullptr);
+        m_wakes++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Reference reader
+// ---------------------------------------------------------------------------
+
+StylusStreamReader::~StylusStreamReader() {
+    detach();
+}
+
+bool StylusStreamReader::attach(const std::string &name) {
+    detach();
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(StylusStreamHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void *mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) return false;
+
+    auto *header = static_cast<StylusStreamHeader *>(mem);
+    const size_t needed = header->headerSize + static_cast<size_t>(header->capacity) * header->slotSize;
+    if (header->magic != STREAM_MAGIC || header->version != STREAM_VERSION
+        || header->headerSize != sizeof(StylusStreamHeader)
+        || header->slotSize != sizeof(StylusStreamSlot)
+        || header->capacity != STREAM_CAPACITY
+        || static_cast<size_t>(st.st_size) < needed) {
+        munmap(mem, st.st_size);
+        return false;
+    }
+
+    m_header = header;
+    m_slots  = reinterpret_cast<StylusStreamSlot *>(static_cast<uint8_t *>(mem) + header->headerSize);
+    m_size   = st.st_size;
+    m_header->readers.fetch_add(1, std::memory_order_relaxed);
+    m_next   = m_header->head.load(std::memory_order_acquire);
+    m_lost   = 0;
+    return true;
+}
+
+void StylusStreamReader::detach() {
+    if (!m_header) return;
+    m_header->readers.fetch_sub(1, std::memory_order_relaxed);
+    munmap(m_header, m_size);
+    m_header = nullptr;
+    m_slots  = nullptr;
+}
+
+bool StylusStreamReader::next(StylusStreamSample &sample) {
+    while (true) {
+        const uint64_t head = m_header->head.load(std::memory_order_acquire);
+        if (m_next >= head) return false;
+        if (head - m_next > STREAM_CAPACITY) {
+            m_lost += head - STREAM_CAPACITY - m_next;
+            m_next  = head - STREAM_CAPACITY;
+        }
+
+        const StylusStreamSlot &slot = m_slots[m_next & (STREAM_CAPACITY - 1)];
+        const uint64_t want = 2 * m_next + 2;
+        const uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+        if (s1 == want) {
+            memcpy(&sample, &slot.sample, sizeof(sample));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == want) {
+                m_next++;
+                return true;
+            }
+        }
+        // Overwritten before or while copying: the producer lapped us.
+        // Count it and retry from wherever head is now.
+        m_lost++;
+        m_next++;
+    }
+}
+
+bool StylusStreamReader::wait(int timeoutMs) {
+    m_header->waiters.fetch_add(1, std::memory_order_seq_cst);
+    const uint32_t word = m_header->wake.load(std::memory_order_acquire);
+    bool ready = m_header->head.load(std::memory_order_seq_cst) > m_next;
+    if (!ready) {
+        timespec ts{timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+        futex(&m_header->wake, FUTEX_WAIT, word, timeoutMs < 0 ? nullptr : &ts);
+        ready = m_header->head.load(std::memory_order_acquire) > m_next;
+    }
+    m_header->waiters.fetch_sub(1, std::memory_order_relaxed);
+    return ready;
+}
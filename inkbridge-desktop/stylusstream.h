@@ -0,0 +1,181 @@
+#ifndef STYLUSSTREAM_H
+#define STYLUSSTREAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * StylusStream — every decoded pen sample, published to shared memory for
+ * local consumers (recorders, drawing apps, overlays) that want the raw
+ * tablet data without going through evdev/libinput.
+ *
+ * One stream per stylus, created with shm_open() as
+ * "/inkbridge-<device name>" (e.g. /dev/shm/inkbridge-pen-emu-1), mode
+ * 0600, and unlinked when the stylus goes away. Single producer (the
+ * stylus, under its mutex), any number of readers, no locks.
+ *
+ * LAYOUT (native endianness, all offsets fixed, see the static_asserts)
+ *
+ *   offset 0     StylusStreamHeader   (256 bytes)
+ *   offset 256   StylusStreamSlot[capacity]   (64 bytes each)
+ *
+ * Sample n (counting from 0) lives in slot n % capacity. The slot's 'seq'
+ * is a seqlock: 2n+1 while the producer writes it, 2n+2 once sample n is
+ * complete. 'head' is the number of samples published so far.
+ *
+ * READING sample n:
+ *   1. s1 = slot.seq (acquire). s1 != 2n+2: not written yet (s1 < 2n+2)
+ *      or already overwritten (s1 > 2n+2, the reader fell a lap behind).
+ *   2. Copy the sample, then an acquire fence, then s2 = slot.seq.
+ *      s1 != s2: overwritten while copying, skip ahead.
+ *
+ * WAITING: increment 'waiters', load 'wake', re-check 'head', then
+ * FUTEX_WAIT on 'wake' with the loaded value (a shared futex, not
+ * FUTEX_PRIVATE), and decrement 'waiters' afterwards. The producer bumps
+ * 'wake' and calls FUTEX_WAKE after each sample, but only while 'waiters'
+ * is non-zero.
+ *
+ * READERS register by incrementing 'readers' for as long as they are
+ * attached. With no reader registered, publishing is one relaxed load and
+ * a branch. A reader that dies without decrementing it only costs the
+ * producer the copy.
+ *
+ * StylusStreamReader below is the reference reader.
+ */
+
+constexpr uint32_t STREAM_MAGIC    = 0x54534249; // "IBST"
+constexpr uint16_t STREAM_VERSION  = 1;
+constexpr uint32_t STREAM_CAPACITY = 1024;       // ~1 s at 1 kHz; power of two
+
+// StylusStreamSample::flags
+constexpr uint32_t STREAM_TOUCHING    = 1u << 0;  // contact as injected (after debounce)
+constexpr uint32_t STREAM_ERASER      = 1u << 1;  // eraser tool in proximity
+constexpr uint32_t STREAM_BUTTON      = 1u << 2;  // barrel button held
+constexpr uint32_t STREAM_IN_RANGE    = 1u << 3;  // position sample (clear: the pen left)
+constexpr uint32_t STREAM_INJECTED    = 1u << 4;  // abs* are valid (not coalesced away)
+constexpr uint32_t STREAM_DEVICE_TIME = 1u << 5;  // timeUs is the tablet's clock, synced
+
+struct StylusStreamSample {
+    uint64_t timeUs;       // CLOCK_MONOTONIC us of the sample
+    uint64_t arrivalUs;    // CLOCK_MONOTONIC us when the desktop handled it
+    int32_t  rawX;         // tablet surface coordinates
+    int32_t  rawY;
+    float    rawPressure;  // 0..1
+    int16_t  tiltX;        // degrees
+    int16_t  tiltY;
+    int16_t  action;       // Android MotionEvent action, button bit (32) included
+    int16_t  toolType;     // Android MotionEvent tool type
+    int32_t  absX;         // injected ABS_X / ABS_Y / ABS_PRESSURE (0..65535)
+    int32_t  absY;
+    int32_t  absPressure;
+    uint32_t flags;        // STREAM_* bits
+    uint32_t reserved;
+};
+
+struct StylusStreamSlot {
+    std::atomic<uint64_t> seq;
+    StylusStreamSample    sample;
+};
+
+struct StylusStreamHeader {
+    uint32_t magic;        // STREAM_MAGIC
+    uint16_t version;      // STREAM_VERSION
+    uint16_t headerSize;   // sizeof(StylusStreamHeader)
+    uint32_t slotSize;     // sizeof(StylusStreamSlot)
+    uint32_t capacity;     // slots
+    uint64_t createdUs;    // CLOCK_MONOTONIC
+
+    alignas(64) std::atomic<uint64_t> head;    // samples published
+    alignas(64) std::atomic<uint32_t> readers; // attached readers
+    std::atomic<uint32_t> waiters;             // readers in FUTEX_WAIT
+    std::atomic<uint32_t> wake;                // the futex word
+    alignas(64) uint8_t   reserved[64];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be lock-free");
+static_assert(sizeof(std::atomic<uint32_t>) == 4, "futex word must be 32 bits");
+static_assert(sizeof(StylusStreamSample) == 56);
+static_assert(sizeof(StylusStreamSlot) == 64);
+static_assert(offsetof(StylusStreamSlot, sample) == 8);
+static_assert(sizeof(StylusStreamHeader) == 256);
+static_assert(offsetof(StylusStreamHeader, head) == 64);
+static_assert(offsetof(StylusStreamHeader, readers) == 128);
+static_assert(offsetof(StylusStreamHeader, waiters) == 132);
+static_assert(offsetof(StylusStreamHeader, wake) == 136);
+static_assert((STREAM_CAPACITY & (STREAM_CAPACITY - 1)) == 0);
+
+// The producer side. Not thread-safe: one publishing thread at a time.
+class StylusStream
+{
+public:
+    StylusStream() = default;
+    ~StylusStream();
+
+    StylusStream(const StylusStream&) = delete;
+    StylusStream& operator=(const StylusStream&) = delete;
+
+    // 'name' is the shm_open name ("/inkbridge-pen-emu-1").
+    bool open(const std::string &name);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+    const std::string &name() const { return m_name; }
+
+    void publish(const StylusStreamSample &sample) {
+        if (m_header->readers.load(std::memory_order_relaxed) == 0) {
+            m_skipped++;
+            return;
+        }
+        write(sample);
+    }
+
+    uint32_t readers() const   { return m_header ? m_header->readers.load(std::memory_order_relaxed) : 0; }
+    uint64_t published() const { return m_header ? m_header->head.load(std::memory_order_relaxed) : 0; }
+    uint64_t skipped() const   { return m_skipped; }
+    uint64_t wakes() const     { return m_wakes; }
+
+private:
+    void write(const StylusStreamSample &sample);
+
+    std::string         m_name;
+    StylusStreamHeader *m_header = nullptr;
+    StylusStreamSlot   *m_slots  = nullptr;
+    size_t              m_size   = 0;
+    uint64_t            m_skipped = 0;   // published with no reader attached
+    uint64_t            m_wakes   = 0;   // FUTEX_WAKE calls
+};
+
+// Reference reader. Attach, then call next() in a loop; wait() blocks on
+// the futex until the producer publishes (or the timeout passes).
+class StylusStreamReader
+{
+public:
+    StylusStreamReader() = default;
+    ~StylusStreamReader();
+
+    StylusStreamReader(const StylusStreamReader&) = delete;
+    StylusStreamReader& operator=(const StylusStreamReader&) = delete;
+
+    // Starts at the newest sample; nothing older is returned.
+    bool attach(const std::string &name);
+    void detach();
+
+    // Copies the next sample out. False when there is none yet.
+    bool next(StylusStreamSample &sample);
+    // False on timeout. timeoutMs < 0 waits forever.
+    bool wait(int timeoutMs);
+
+    // Samples overwritten before this reader got to them.
+    uint64_t lost() const { return m_lost; }
+
+private:
+    StylusStreamHeader *m_header = nullptr;
+    StylusStreamSlot   *m_slots  = nullptr;
+    size_t              m_size   = 0;
+    uint64_t            m_next   = 0;
+    uint64_t            m_lost   = 0;
+};
+
+#endif // STYLUSSTREAM_H
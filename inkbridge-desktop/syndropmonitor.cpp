@@ -0,0 +1,111 @@
+#include "syndropmonitor.h"
+#include "uinput.h"
+
+#include <linux/input.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace {
+// udev creates the /dev node a moment after UI_DEV_CREATE.
+constexpr int OPEN_ATTEMPTS   = 50;
+constexpr int OPEN_RETRY_MS   = 20;
+constexpr int READ_BATCH      = 64;
+}
+
+SynDropMonitor::SynDropMonitor(std::function<void()> onDropped)
+    : m_onDropped(std::move(onDropped))
+{
+}
+
+SynDropMonitor::~SynDropMonitor() {
+    stop();
+}
+
+bool SynDropMonitor::start(int uinputFd) {
+    if (m_thread.joinable()) return true;
+
+    char path[64];
+    if (uinput_evdev_path(uinputFd, path, sizeof(path)) != 0) {
+        std::cerr << "[SynDrop] Could not resolve the evdev node of the stylus" << std::endl;
+        return false;
+    }
+    m_node = path;
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        std::cerr << "[SynDrop] eventfd failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    m_running = true;
+    m_thread = std::thread(&SynDropMonitor::run, this);
+    return true;
+}
+
+void SynDropMonitor::stop() {
+    if (m_thread.joinable()) {
+        m_running = false;
+        uint64_t one = 1;
+        if (write(m_wakeFd, &one, sizeof(one)) < 0) {
+            // The thread still notices m_running on its next wakeup.
+        }
+        m_thread.join();
+    }
+    if (m_fd >= 0)     { close(m_fd);     m_fd = -1; }
+    if (m_wakeFd >= 0) { close(m_wakeFd); m_wakeFd = -1; }
+}
+
+void SynDropMonitor::run() {
+    // Deliberately no RtSched scope: the canary has to read no faster than
+    // an ordinary client would.
+    for (int attempt = 0; m_running && attempt < OPEN_ATTEMPTS; ++attempt) {
+        m_fd = open(m_node.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (m_fd >= 0 || errno != ENOENT) break;
+        pollfd wake{m_wakeFd, POLLIN, 0};
+        poll(&wake, 1, OPEN_RETRY_MS);
+    }
+    if (m_fd < 0) {
+        if (m_running) {
+            std::cerr << "[SynDrop] Cannot open " << m_node << ": " << strerror(errno)
+                      << " (is the user in the 'input' group?)" << std::endl;
+        }
+        return;
+    }
+    std::cout << "[SynDrop] Watching " << m_node << std::endl;
+
+    pollfd fds[2];
+    fds[0] = {m_fd, POLLIN, 0};
+    fds[1] = {m_wakeFd, POLLIN, 0};
+    input_event events[READ_BATCH];
+
+    while (m_running) {
+        int n = poll(fds, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[SynDrop] poll failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[0].revents & (POLLHUP | POLLERR)) break;   // device destroyed
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        while (true) {
+            ssize_t got = read(m_fd, events, sizeof(events));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) break;
+            const size_t count = static_cast<size_t>(got) / sizeof(input_event);
+            m_events.fetch_add(count, std::memory_order_relaxed);
+            for (size_t i = 0; i < count; ++i) {
+                if (events[i].type == EV_SYN && events[i].code == SYN_DROPPED) {
+                    m_incidents.fetch_add(1, std::memory_order_relaxed);
+                    if (m_onDropped) m_onDropped();
+                }
+            }
+            if (count < READ_BATCH) break;
+        }
+    }
+}
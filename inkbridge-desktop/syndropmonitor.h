@@ -0,0 +1,57 @@
+#ifndef SYNDROPMONITOR_H
+#define SYNDROPMONITOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * SynDropMonitor — notices when our uinput device overflows a reader.
+ *
+ * SYN_DROPPED is delivered per evdev client: a client whose buffer fills
+ * before it reads gets one, loses the events in between, and (for
+ * libinput) resyncs the whole seat. The compositor's client is out of our
+ * reach, so the monitor opens the same evdev node (resolved from the
+ * uinput fd with UI_GET_SYSNAME) as a client of its own. Its buffer is
+ * sized by the kernel exactly like the compositor's, and its thread runs at
+ * normal priority like the compositor, so when our injection is bursty
+ * enough to overflow one it very likely overflows the other: a canary.
+ *
+ * onDropped is called on the monitor thread for every SYN_DROPPED read.
+ * Reading the node needs access to /dev/input/event* (usually the "input"
+ * group); start() fails, and the monitor stays off, without it.
+ */
+class SynDropMonitor
+{
+public:
+    explicit SynDropMonitor(std::function<void()> onDropped);
+    ~SynDropMonitor();
+
+    SynDropMonitor(const SynDropMonitor&) = delete;
+    SynDropMonitor& operator=(const SynDropMonitor&) = delete;
+
+    // 'uinputFd' is the created uinput device.
+    bool start(int uinputFd);
+    // Not from inside onDropped.
+    void stop();
+
+    const std::string& node() const { return m_node; }
+    uint64_t incidents() const { return m_incidents.load(std::memory_order_relaxed); }
+    uint64_t events() const    { return m_events.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    std::function<void()>  m_onDropped;
+    std::string            m_node;
+    int                    m_fd = -1;
+    int                    m_wakeFd = -1;
+    std::thread            m_thread;
+    std::atomic<bool>      m_running{false};
+    std::atomic<uint64_t>  m_incidents{0};
+    std::atomic<uint64_t>  m_events{0};
+};
+
+#endif // SYNDROPMONITOR_H
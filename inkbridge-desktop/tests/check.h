@@ -0,0 +1,44 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <iostream>
+
+// Minimal assertions for the tests: a failed CHECK is reported and counted,
+// the test keeps going, and main() returns checkResult().
+
+inline int &checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond \
+                      << std::endl;                                              \
+            ++checkFailures();                                                   \
+        }                                                                        \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                           \
+    do {                                                                         \
+        const auto va_ = (a);                                                    \
+        const auto vb_ = (b);                                                    \
+        if (!(va_ == vb_)) {                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ failed: " #a \
+                      << " == " #b " (" << va_ << " vs " << vb_ << ")"           \
+                      << std::endl;                                              \
+            ++checkFailures();                                                   \
+        }                                                                        \
+    } while (0)
+
+inline int checkResult(const char *name) {
+    if (checkFailures()) {
+        std::cerr << name << ": " << checkFailures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << name << ": ok" << std::endl;
+    return 0;
+}
+
+#endif // CHECK_H
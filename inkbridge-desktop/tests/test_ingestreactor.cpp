@@ -0,0 +1,219 @@
+// IngestReactor over loopback with its UDP channel on: the hello ack comes
+// back with a UdpOfferFrame, datagrams carrying that token reach the same
+// session as the TCP stream (and their duplicates do not), and datagrams
+// with an unknown or stale token are ignored.
+
+#include "check.h"
+#include "wirefixtures.h"
+#include "ingestreactor.h"
+#include "streamdecoder.h"
+#include "controlchannel.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Wire::Bytes;
+
+static constexpr uint16_t TCP_PORT = 47395;
+static constexpr uint16_t UDP_PORT = 47396;
+static constexpr int PEN  = 2;
+static constexpr int DOWN = 0;
+static constexpr int UP   = 1;
+static constexpr int MOVE = 2;
+
+// What StylusSession does with the bytes, minus the stylus.
+class TestSink : public IngestSink
+{
+public:
+    TestSink() : m_decoder(SequenceTracker::LinkWifiDirect) {}
+
+    void ingest(ByteRing &ring, uint64_t) override {
+        const uint8_t *first, *second;
+        size_t firstLen, secondLen;
+        ring.readable(first, firstLen, second, secondLen);
+        ring.consume(m_decoder.decode(first, firstLen, second, secondLen,
+                                      [this](AccessoryEventData &d) { add(d); }, [] {}));
+        TabletHello hello;
+        if (m_decoder.takeHello(hello)) m_control.acceptHello(hello);
+    }
+
+    void ingestDatagram(const uint8_t *data, size_t len, uint64_t) override {
+        m_decoder.feedDatagram(data, len, [this](AccessoryEventData &d) { add(d); }, [] {});
+    }
+
+    size_t controlTick(uint8_t *out) override { return m_control.tick(0, 0, out); }
+    void   controlUnsent() override { m_control.markUnsent(); }
+    bool   controlUrgent() const override { return m_control.urgent(); }
+    size_t takeUrgentControl(uint8_t *out) override { return m_control.takeUrgent(out); }
+    void   setUdpOffer(uint16_t port, uint32_t token) override { m_control.setUdpOffer(port, token); }
+
+    std::vector<AccessoryEventData> samples() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_samples;
+    }
+
+    // Waits up to a second for at least 'count' samples.
+    size_t waitFor(size_t count) {
+        for (int i = 0; i < 1000 && samples().size() < count; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return samples().size();
+    }
+
+private:
+    void add(const AccessoryEventData &d) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_samples.push_back(d);
+    }
+
+    PenStreamDecoder                m_decoder;
+    ControlChannel                  m_control;
+    std::mutex                      m_mutex;
+    std::vector<AccessoryEventData> m_samples;
+};
+
+static sockaddr_in loopback(uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(port);
+    return addr;
+}
+
+static bool sendAll(int fd, const Bytes &bytes) {
+    return send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(bytes.size());
+}
+
+// Reads control frames ([type][length][payload]) until one of 'type'
+// arrives or a second passes. Returns its bytes, or nothing; frames read
+// past it stay in 'pending'.
+static Bytes readControl(int fd, uint8_t type, Bytes &pending) {
+    const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < until) {
+        while (pending.size() >= 2 && pending.size() >= pending[1] + size_t(2)) {
+            const size_t len = pending[1] + size_t(2);
+            const Bytes frame(pending.begin(), pending.begin() + len);
+            pending.erase(pending.begin(), pending.begin() + len);
+            if (frame[0] == type) return frame;
+        }
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 50) <= 0) continue;
+        uint8_t buffer[256];
+        const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        pending.insert(pending.end(), buffer, buffer + n);
+    }
+    return {};
+}
+
+int main() {
+    TestSink sink;
+    std::atomic<IngestSink *> released{nullptr};
+    IngestReactor::Callbacks callbacks;
+    callbacks.onConnect    = [&](int, const std::string &) -> IngestSink * { return &sink; };
+    callbacks.onDisconnect = [&](int, IngestSink *session) { released = session; };
+
+    IngestReactor reactor(std::move(callbacks));
+    if (!reactor.start(TCP_PORT, 1, UDP_PORT)) {
+        std::cerr << "cannot listen on ports " << TCP_PORT << "/" << UDP_PORT << std::endl;
+        return 1;
+    }
+
+    int tcp = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in tcpAddr = loopback(TCP_PORT);
+    CHECK(connect(tcp, reinterpret_cast<sockaddr *>(&tcpAddr), sizeof(tcpAddr)) == 0);
+    int on = 1;
+    setsockopt(tcp, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    // 1. The hello asks for UDP; the ack agrees and the offer follows it.
+    Bytes bytes;
+    Wire::hello(bytes, 2, FEATURE_UDP);
+    CHECK(sendAll(tcp, bytes));
+    Bytes control;
+    const Bytes ackBytes   = readControl(tcp, CONTROL_HELLO_ACK, control);
+    const Bytes offerBytes = readControl(tcp, CONTROL_UDP_OFFER, control);
+    CHECK_EQ(ackBytes.size(), sizeof(HelloAck));
+    CHECK_EQ(offerBytes.size(), sizeof(UdpOfferFrame));
+    if (ackBytes.size() != sizeof(HelloAck) || offerBytes.size() != sizeof(UdpOfferFrame)) {
+        reactor.stop();
+        return checkResult("test_ingestreactor");
+    }
+    HelloAck ack;
+    UdpOfferFrame offer;
+    std::memcpy(&ack, ackBytes.data(), sizeof(ack));
+    std::memcpy(&offer, offerBytes.data(), sizeof(offer));
+    CHECK(ack.features & FEATURE_UDP);
+    CHECK_EQ(offer.port, UDP_PORT);
+    CHECK(offer.token != 0);
+
+    int udp = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in udpAddr = loopback(offer.port);
+    CHECK(connect(udp, reinterpret_cast<sockaddr *>(&udpAddr), sizeof(udpAddr)) == 0);
+
+    // 2. Touch-down on TCP, then a datagram repeating it and adding two
+    //    moves: the session sees each sample once, in order.
+    const PenPacket down  = Wire::sample(PEN, DOWN, 100, 100, 800);
+    const PenPacket move1 = Wire::sample(PEN, MOVE, 104, 103, 900);
+    const PenPacket move2 = Wire::sample(PEN, MOVE, 109, 107, 950);
+    const PenPacket up    = Wire::sample(PEN, UP, 109, 107, 0);
+    bytes.clear();
+    Wire::v2(bytes, 1, down);
+    CHECK(sendAll(tcp, bytes));
+    CHECK_EQ(sink.waitFor(1), 1u);
+
+    bytes.clear();
+    Wire::datagramHeader(bytes, offer.token);
+    Wire::v2(bytes, 1, down);
+    Wire::v2(bytes, 2, move1);
+    Wire::v2(bytes, 3, move2);
+    CHECK(sendAll(udp, bytes));
+    CHECK_EQ(sink.waitFor(3), 3u);
+
+    // 3. A datagram with a token nobody was offered is ignored; the lift
+    //    then arrives on TCP as sample 4.
+    bytes.clear();
+    Wire::datagramHeader(bytes, offer.token + 1);
+    Wire::v2(bytes, 4, Wire::sample(PEN, MOVE, 9999, 9999, 500));
+    CHECK(sendAll(udp, bytes));
+    bytes.clear();
+    Wire::v2(bytes, 4, up);
+    CHECK(sendAll(tcp, bytes));
+    CHECK_EQ(sink.waitFor(4), 4u);
+
+    std::vector<AccessoryEventData> got = sink.samples();
+    const PenPacket want[] = { down, move1, move2, up };
+    for (size_t i = 0; i < got.size() && i < 4; ++i) {
+        CHECK_EQ(got[i].x, want[i].x);
+        CHECK_EQ(got[i].action, want[i].action);
+    }
+    CHECK(reactor.latencyReport().find("(1 UDP)") != std::string::npos);
+
+    // 4. Once the tablet is gone its token is dead.
+    close(tcp);
+    for (int i = 0; i < 1000 && !released; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(released == &sink);
+    CHECK_EQ(reactor.clientCount(), 0);
+    bytes.clear();
+    Wire::datagramHeader(bytes, offer.token);
+    Wire::v2(bytes, 5, Wire::sample(PEN, MOVE, 120, 110, 0));
+    CHECK(sendAll(udp, bytes));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_EQ(sink.samples().size(), 4u);
+
+    close(udp);
+    reactor.stop();
+    return checkResult("test_ingestreactor");
+}
@@ -0,0 +1,186 @@
+// RfcommReader on one end of a socketpair(), standing in for an RFCOMM
+// socket: records written in odd-sized pieces, so they arrive split across
+// reads and across the ring's wrap, decode whole and in order on the
+// reader thread; control frames go back the other way; the peer closing
+// is reported once, and stop() alone is not reported as a close. A frame
+// the socket only partly takes is finished later, never cut short.
+
+#include "check.h"
+#include "wirefixtures.h"
+#include "rfcommreader.h"
+#include "streamdecoder.h"
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Wire::Bytes;
+
+static constexpr int PEN  = 2;
+static constexpr int MOVE = 2;
+
+struct Received {
+    std::mutex                      mutex;
+    std::vector<AccessoryEventData> samples;
+    std::atomic<int>                ticks{0};
+    std::atomic<int>                closes{0};
+
+    size_t count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return samples.size();
+    }
+};
+
+static RfcommReader::Callbacks decodingInto(PenStreamDecoder &decoder, Received &got) {
+    RfcommReader::Callbacks callbacks;
+    callbacks.onData = [&decoder, &got](ByteRing &ring, uint64_t) {
+        const uint8_t *first, *second;
+        size_t firstLen, secondLen;
+        ring.readable(first, firstLen, second, secondLen);
+        ring.consume(decoder.decode(first, firstLen, second, secondLen,
+                                    [&got](AccessoryEventData &d) {
+                                        std::lock_guard<std::mutex> lock(got.mutex);
+                                        got.samples.push_back(d);
+                                    },
+                                    [] {}));
+    };
+    callbacks.onTick   = [&got] { ++got.ticks; };
+    callbacks.onClosed = [&got] { ++got.closes; };
+    return callbacks;
+}
+
+template <typename Condition>
+static bool waitUntil(Condition done, int ms) {
+    for (int i = 0; i < ms && !done(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return done();
+}
+
+int main() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        std::cerr << "socketpair failed" << std::endl;
+        return 1;
+    }
+
+    PenStreamDecoder decoder(SequenceTracker::LinkBluetooth);
+    Received got;
+    RfcommReader reader(fds[0], decodingInto(decoder, got));
+    CHECK(reader.start());
+
+    // 1. 400 samples, half v2 and half compact, about 6 KB: more than the
+    //    4 KB ring, so records straddle its wrap as well as the reads.
+    std::vector<PenPacket> want;
+    Bytes stream;
+    PenPacket previous{};
+    for (int i = 0; i < 400; ++i) {
+        const PenPacket p = Wire::sample(PEN, MOVE, 1000 + 3 * i, 2000 - 2 * i, 1500 + i % 50);
+        if (i < 200) Wire::v2(stream, static_cast<uint16_t>(i), p);
+        else if (i == 200) Wire::keyframe(stream, static_cast<uint16_t>(i), p);
+        else Wire::delta(stream, previous, p);
+        previous = p;
+        want.push_back(p);
+    }
+    for (size_t pos = 0; pos < stream.size(); ) {
+        const size_t len = std::min<size_t>(37, stream.size() - pos);
+        CHECK_EQ(write(fds[1], stream.data() + pos, len), static_cast<ssize_t>(len));
+        pos += len;
+        if (pos % 370 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(waitUntil([&] { return got.count() >= want.size(); }, 2000));
+    {
+        std::lock_guard<std::mutex> lock(got.mutex);
+        CHECK_EQ(got.samples.size(), want.size());
+        for (size_t i = 0; i < got.samples.size() && i < want.size(); ++i) {
+            if (got.samples[i].x != want[i].x || got.samples[i].y != want[i].y) {
+                std::cerr << "sample " << i << " differs" << std::endl;
+                ++checkFailures();
+                break;
+            }
+        }
+    }
+    CHECK_EQ(reader.bytes(), static_cast<uint64_t>(stream.size()));
+    CHECK(reader.reads() > 1);
+
+    // 2. A control frame goes back to the tablet whole.
+    const uint8_t frame[] = { CONTROL_FLOW, 4, 120, 0, 2, 0 };
+    CHECK(reader.send(frame, sizeof(frame)));
+    uint8_t echoed[sizeof(frame)] = {};
+    pollfd pfd = { fds[1], POLLIN, 0 };
+    CHECK(poll(&pfd, 1, 1000) == 1);
+    CHECK_EQ(read(fds[1], echoed, sizeof(echoed)), static_cast<ssize_t>(sizeof(frame)));
+    CHECK(std::memcmp(echoed, frame, sizeof(frame)) == 0);
+
+    // 3. The once-per-second tick, then the tablet hanging up.
+    CHECK(waitUntil([&] { return got.ticks > 0; }, RfcommReader::TICK_MS + 500));
+    close(fds[1]);
+    CHECK(waitUntil([&] { return got.closes > 0; }, 1000));
+    reader.stop();
+    CHECK_EQ(got.closes.load(), 1);
+
+    // 4. stop() on a live connection joins the thread without a close.
+    int pair[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    PenStreamDecoder other(SequenceTracker::LinkBluetooth);
+    Received quiet;
+    {
+        RfcommReader stopped(pair[0], decodingInto(other, quiet));
+        CHECK(stopped.start());
+        stopped.stop();
+    }
+    CHECK_EQ(quiet.closes.load(), 0);
+    close(pair[1]);
+
+    // 5. The tablet stops reading: a frame larger than the socket buffers
+    //    goes out in part and send() still reports it sent; the next frame
+    //    is refused while the tail waits. Once the tablet reads again, the
+    //    tick finishes the tail, and the stream holds the whole frame
+    //    followed by the next one.
+    int full[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, full) == 0);
+    int size = 4096;
+    setsockopt(full[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(full[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    fcntl(full[1], F_SETFL, O_NONBLOCK);
+    PenStreamDecoder unused(SequenceTracker::LinkBluetooth);
+    Received none;
+    RfcommReader blocked(full[0], decodingInto(unused, none));
+    CHECK(blocked.start());
+
+    Bytes big(12 * 1024);
+    for (size_t i = 0; i < big.size(); ++i) big[i] = static_cast<uint8_t>(i * 7);
+    const uint8_t next[] = { CONTROL_FLOW, 4, 1, 2, 3, 4 };
+    CHECK(blocked.send(big.data(), big.size()));
+    CHECK(!blocked.send(next, sizeof(next)));
+
+    Bytes arrived;
+    auto readAll = [&] {
+        uint8_t buffer[16384];
+        ssize_t n;
+        while ((n = read(full[1], buffer, sizeof(buffer))) > 0) {
+            arrived.insert(arrived.end(), buffer, buffer + n);
+        }
+        return arrived.size();
+    };
+    CHECK(readAll() < big.size());
+    CHECK(waitUntil([&] { return readAll() >= big.size(); }, RfcommReader::TICK_MS * 3));
+    CHECK(blocked.send(next, sizeof(next)));
+    CHECK(waitUntil([&] { return readAll() >= big.size() + sizeof(next); }, 1000));
+    CHECK_EQ(arrived.size(), big.size() + sizeof(next));
+    if (arrived.size() == big.size() + sizeof(next)) {
+        CHECK(std::equal(big.begin(), big.end(), arrived.begin()));
+        CHECK(std::equal(next, next + sizeof(next), arrived.begin() + big.size()));
+    }
+    blocked.stop();
+    CHECK_EQ(none.closes.load(), 0);
+    close(full[1]);
+
+    return checkResult("test_rfcommreader");
+}
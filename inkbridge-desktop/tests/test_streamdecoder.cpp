@@ -0,0 +1,323 @@
+// PenStreamDecoder on recorded byte streams: records split at every
+// possible byte, in-place decoding across a receive ring's wrap, sequence
+// numbers wrapping at 65535, late samples from before the first, compact
+// key frames followed by deltas, and UDP datagrams duplicating TCP samples.
+
+#include "check.h"
+#include "wirefixtures.h"
+#include "streamdecoder.h"
+#include "bytering.h"
+
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using Wire::Bytes;
+
+static constexpr int PEN          = 2;
+static constexpr int ERASER       = 4;
+static constexpr int DOWN         = 0;
+static constexpr int UP           = 1;
+static constexpr int MOVE         = 2;
+static constexpr int HOVER_MOVE   = 7;
+
+struct Collected {
+    std::vector<AccessoryEventData> samples;
+    int heartbeats = 0;
+};
+
+static bool same(const AccessoryEventData &d, const PenPacket &p) {
+    return d.toolType == p.toolType && d.action == p.action && d.x == p.x && d.y == p.y &&
+           d.pressure == p.pressure / 4096.0f && d.tiltX == p.tiltX && d.tiltY == p.tiltY;
+}
+
+static void checkSamples(const Collected &got, const std::vector<PenPacket> &want, int line) {
+    if (got.samples.size() != want.size()) {
+        std::cerr << "line " << line << ": " << got.samples.size() << " samples, expected "
+                  << want.size() << std::endl;
+        ++checkFailures();
+        return;
+    }
+    for (size_t i = 0; i < want.size(); ++i) {
+        if (!same(got.samples[i], want[i])) {
+            std::cerr << "line " << line << ": sample " << i << " differs (x " << got.samples[i].x
+                      << " vs " << want[i].x << ")" << std::endl;
+            ++checkFailures();
+            return;
+        }
+    }
+}
+
+// Through feed(), 'chunk' bytes at a time, as USB bulk reads arrive.
+static Collected feedInChunks(PenStreamDecoder &decoder, const Bytes &stream, size_t chunk) {
+    Collected got;
+    for (size_t pos = 0; pos < stream.size(); pos += chunk) {
+        const size_t len = std::min(chunk, stream.size() - pos);
+        decoder.feed(stream.data() + pos, len,
+                     [&](AccessoryEventData &d) { got.samples.push_back(d); },
+                     [&] { ++got.heartbeats; });
+    }
+    return got;
+}
+
+// Through a small ByteRing and decode(), 'chunk' bytes per read, as the
+// network transports do. The ring is small so records keep straddling its
+// wrap.
+static Collected decodeInRing(PenStreamDecoder &decoder, const Bytes &stream, size_t chunk) {
+    uint8_t storage[64];
+    ByteRing ring(storage, sizeof(storage));
+    Collected got;
+
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        iovec iov[2];
+        const int parts = ring.writable(iov);
+        size_t want = std::min(chunk, stream.size() - pos);
+        for (int i = 0; i < parts && want > 0; ++i) {
+            const size_t n = std::min(want, iov[i].iov_len);
+            std::memcpy(iov[i].iov_base, stream.data() + pos, n);
+            ring.commit(n);
+            pos  += n;
+            want -= n;
+        }
+
+        const uint8_t *first, *second;
+        size_t firstLen, secondLen;
+        ring.readable(first, firstLen, second, secondLen);
+        ring.consume(decoder.decode(first, firstLen, second, secondLen,
+                                    [&](AccessoryEventData &d) { got.samples.push_back(d); },
+                                    [&] { ++got.heartbeats; }));
+    }
+    CHECK(ring.size() == 0);
+    return got;
+}
+
+// A stream mixing every record kind, split at every possible byte.
+static void testSplitRecords() {
+    std::vector<PenPacket> want;
+    Bytes stream;
+
+    want.push_back(Wire::sample(PEN, HOVER_MOVE, 100, 200));
+    Wire::v1(stream, want.back());
+    Wire::heartbeat(stream);
+    want.push_back(Wire::sample(PEN, DOWN, 101, 201, 900, 5, -5));
+    Wire::v2(stream, 1, want.back());
+    want.push_back(Wire::sample(PEN, MOVE, 103, 199, 1200, 6, -4));
+    Wire::keyframe(stream, 2, want.back());
+    want.push_back(Wire::sample(PEN, MOVE, 110, 190, 1300, 6, -4));
+    Wire::delta(stream, want[2], want[3]);
+    want.push_back(Wire::sample(PEN, MOVE, 70110, 190, 1000, 7, -4));   // a 3-byte varint
+    Wire::delta(stream, want[3], want[4]);
+    want.push_back(Wire::sample(PEN, UP, 70110, 190, 0, 7, -4));
+    Wire::delta(stream, want[4], want[5]);
+    Wire::heartbeat(stream);
+    want.push_back(Wire::sample(PEN, HOVER_MOVE, 70120, 185));
+    Wire::v1(stream, want.back());
+
+    const uint64_t misframed = SequenceTracker::stats(SequenceTracker::LinkUsb).misframed.load();
+    for (size_t chunk = 1; chunk <= stream.size(); ++chunk) {
+        PenStreamDecoder fed;
+        Collected got = feedInChunks(fed, stream, chunk);
+        checkSamples(got, want, __LINE__);
+        CHECK_EQ(got.heartbeats, 2);
+
+        PenStreamDecoder ringed;
+        got = decodeInRing(ringed, stream, std::min<size_t>(chunk, 30));
+        checkSamples(got, want, __LINE__);
+        CHECK_EQ(got.heartbeats, 2);
+    }
+    CHECK_EQ(SequenceTracker::stats(SequenceTracker::LinkUsb).misframed.load(), misframed);
+}
+
+// Sequence numbers wrap at 65535: across the wrap nothing counts as lost,
+// a repeat is still a duplicate, and a single missing move is concealed.
+static void testSequenceWrap() {
+    SequenceTracker::Stats &st = SequenceTracker::stats(SequenceTracker::LinkWifiDirect);
+    const uint64_t lost = st.lost.load(), duplicates = st.duplicates.load();
+    const uint64_t concealed = st.concealed.load();
+
+    PenStreamDecoder decoder(SequenceTracker::LinkWifiDirect);
+    std::vector<PenPacket> want;
+    Bytes stream;
+    uint16_t seq = 65533;
+    for (int i = 0; i < 6; ++i, ++seq) {
+        want.push_back(Wire::sample(PEN, MOVE, 1000 + 10 * i, 500, 2048));
+        Wire::v2(stream, seq, want.back());
+    }
+    CHECK_EQ(seq, 3);
+    Wire::v2(stream, 0, want[3]);   // the copy of 0 arrives again
+    checkSamples(feedInChunks(decoder, stream, 7), want, __LINE__);
+    CHECK_EQ(st.lost.load(), lost);
+    CHECK_EQ(st.duplicates.load(), duplicates + 1);
+
+    // 65535 then 1: sample 0 went missing and its midpoint stands in.
+    PenStreamDecoder gapped(SequenceTracker::LinkWifiDirect);
+    stream.clear();
+    Wire::v2(stream, 65535, Wire::sample(PEN, MOVE, 100, 100, 1000));
+    Wire::v2(stream, 1, Wire::sample(PEN, MOVE, 120, 140, 2000));
+    const Collected got = feedInChunks(gapped, stream, stream.size());
+    CHECK_EQ(got.samples.size(), 3u);
+    if (got.samples.size() == 3) {
+        CHECK_EQ(got.samples[1].x, 110);
+        CHECK_EQ(got.samples[1].y, 120);
+        CHECK_EQ(got.samples[2].x, 120);
+    }
+    CHECK_EQ(st.lost.load(), lost + 1);
+    CHECK_EQ(st.concealed.load(), concealed + 1);
+}
+
+// A sample from before the first one, or from before a resync, was never
+// counted lost, so it arriving late must not take one off; a sample a gap
+// skipped takes off exactly one, and only once.
+static void testLateBeforeStart() {
+    SequenceTracker::Stats &st = SequenceTracker::stats(SequenceTracker::LinkUsb);
+    const uint64_t lost = st.lost.load(), reordered = st.reordered.load();
+    SequenceTracker tracker(SequenceTracker::LinkUsb);
+    int missing = 0;
+
+    CHECK(tracker.note(5, missing) == SequenceTracker::InOrder);
+    CHECK(tracker.note(4, missing) == SequenceTracker::Late);
+    CHECK_EQ(st.lost.load(), lost);
+
+    CHECK(tracker.note(8, missing) == SequenceTracker::AfterGap);
+    CHECK_EQ(missing, 2);
+    CHECK_EQ(st.lost.load(), lost + 2);
+    CHECK(tracker.note(6, missing) == SequenceTracker::Late);
+    CHECK(tracker.note(6, missing) == SequenceTracker::Duplicate);
+    CHECK(tracker.note(7, missing) == SequenceTracker::Late);
+    CHECK(tracker.note(3, missing) == SequenceTracker::Late);
+    CHECK_EQ(st.lost.load(), lost);
+
+    // The tablet restarts its counter, then one from before that arrives.
+    CHECK(tracker.note(60000, missing) == SequenceTracker::InOrder);
+    CHECK(tracker.note(59999, missing) == SequenceTracker::Late);
+    CHECK_EQ(st.lost.load(), lost);
+
+    tracker.reset();
+    CHECK(tracker.note(100, missing) == SequenceTracker::InOrder);
+    CHECK(tracker.note(99, missing) == SequenceTracker::Late);
+    CHECK_EQ(st.lost.load(), lost);
+
+    // A gap wider than the window: the positions it still covers come
+    // off one each.
+    CHECK(tracker.note(300, missing) == SequenceTracker::AfterGap);
+    CHECK_EQ(st.lost.load(), lost + 199);
+    CHECK(tracker.note(299, missing) == SequenceTracker::Late);
+    CHECK(tracker.note(240, missing) == SequenceTracker::Late);
+    CHECK_EQ(st.lost.load(), lost + 197);
+    CHECK_EQ(st.reordered.load(), reordered + 8);
+}
+
+// A key frame and the deltas that build on it decode to exactly what the
+// tablet encoded, across tool and action changes and large jumps; a delta
+// with no key frame before it is counted and dropped.
+static void testKeyframeDeltas() {
+    SequenceTracker::Stats &st = SequenceTracker::stats(SequenceTracker::LinkBluetooth);
+    PenStreamDecoder::WireStats &wire = PenStreamDecoder::wireStats(SequenceTracker::LinkBluetooth);
+    const uint64_t lost = st.lost.load(), duplicates = st.duplicates.load();
+    const uint64_t orphans = wire.orphanDeltas.load();
+    const uint64_t deltas = wire.deltas.load(), deltaBytes = wire.deltaBytes.load();
+
+    std::vector<PenPacket> want;
+    PenPacket p = Wire::sample(PEN, HOVER_MOVE, 5000, 5000, 0, 0, 0);
+    for (int i = 0; i < 80; ++i) {
+        if (i == 10) p.action = DOWN;
+        else if (i == 11) p.action = MOVE;
+        else if (i == 50) p.action = UP;
+        else if (i == 51) p.action = HOVER_MOVE;
+        if (i == 60) p.toolType = ERASER;
+        p.x += (i % 7) - 3;
+        p.y -= (i % 5);
+        if (i == 30) p.x -= 200000;   // far jump, negative
+        p.pressure = (p.action == MOVE || p.action == DOWN) ? 1000 + 37 * (i % 13) : 0;
+        p.tiltX = (i / 10) % 3;
+        want.push_back(p);
+    }
+
+    Bytes stream;
+    Wire::keyframe(stream, 65500, want[0]);   // the deltas carry it past the wrap
+    for (size_t i = 1; i < want.size(); ++i) Wire::delta(stream, want[i - 1], want[i]);
+    // The last delta's sequence number again, as a v2 copy: a duplicate.
+    Wire::v2(stream, static_cast<uint16_t>(65500 + want.size() - 1), want.back());
+
+    PenStreamDecoder decoder(SequenceTracker::LinkBluetooth);
+    const Collected got = decodeInRing(decoder, stream, 13);
+    checkSamples(got, want, __LINE__);
+    CHECK_EQ(st.lost.load(), lost);
+    CHECK_EQ(st.duplicates.load(), duplicates + 1);
+    CHECK_EQ(wire.deltas.load(), deltas + 79);
+    // Most moves fit marker, mask and two one-byte varints.
+    CHECK((wire.deltaBytes.load() - deltaBytes) / 79.0 < 6.0);
+
+    // A delta before any key frame has nothing to apply to.
+    PenStreamDecoder fresh(SequenceTracker::LinkBluetooth);
+    stream.clear();
+    Wire::delta(stream, want[0], want[1]);
+    Wire::keyframe(stream, 7, want[2]);
+    Wire::delta(stream, want[2], want[3]);
+    const Collected late = feedInChunks(fresh, stream, 3);
+    CHECK_EQ(late.samples.size(), 2u);
+    CHECK_EQ(wire.orphanDeltas.load(), orphans + 1);
+}
+
+// Samples arriving on both UDP and TCP: whichever copy comes first is
+// injected and the other is a duplicate. A datagram carries only whole v2
+// records and leaves a TCP record split around it intact.
+static void testUdpDuplicates() {
+    SequenceTracker::Stats &st = SequenceTracker::stats(SequenceTracker::LinkWifiDirect);
+    const uint64_t duplicates = st.duplicates.load(), misframed = st.misframed.load();
+    PenStreamDecoder decoder(SequenceTracker::LinkWifiDirect);
+    Collected got;
+    auto onSample    = [&](AccessoryEventData &d) { got.samples.push_back(d); };
+    auto onHeartbeat = [&] { ++got.heartbeats; };
+
+    const PenPacket down  = Wire::sample(PEN, DOWN, 300, 300, 800);
+    const PenPacket move1 = Wire::sample(PEN, MOVE, 305, 302, 900);
+    const PenPacket move2 = Wire::sample(PEN, MOVE, 311, 305, 950);
+    const PenPacket up    = Wire::sample(PEN, UP, 311, 305, 0);
+
+    // TCP: the touch-down (10). UDP, redundantly: 10, 11 and 12.
+    Bytes tcp;
+    Wire::v2(tcp, 10, down);
+    decoder.feed(tcp.data(), tcp.size(), onSample, onHeartbeat);
+    Bytes udp;
+    Wire::v2(udp, 10, down);
+    Wire::v2(udp, 11, move1);
+    Wire::v2(udp, 12, move2);
+    decoder.feedDatagram(udp.data(), udp.size(), onSample, onHeartbeat);
+
+    // TCP: the lift (13), split around the next datagram, which repeats
+    // 11 and 12 and also carries 13.
+    tcp.clear();
+    Wire::v2(tcp, 13, up);
+    decoder.feed(tcp.data(), 9, onSample, onHeartbeat);
+    udp.clear();
+    Wire::v2(udp, 11, move1);
+    Wire::v2(udp, 12, move2);
+    Wire::v2(udp, 13, up);
+    decoder.feedDatagram(udp.data(), udp.size(), onSample, onHeartbeat);
+    decoder.feed(tcp.data() + 9, tcp.size() - 9, onSample, onHeartbeat);
+
+    checkSamples(got, { down, move1, move2, up }, __LINE__);
+    CHECK_EQ(st.duplicates.load(), duplicates + 4);
+    CHECK_EQ(st.misframed.load(), misframed);
+
+    // Compact records are not allowed in a datagram: the rest of it is
+    // dropped as misframed.
+    udp.clear();
+    Wire::v2(udp, 14, Wire::sample(PEN, HOVER_MOVE, 320, 310));
+    Wire::delta(udp, Wire::sample(PEN, HOVER_MOVE, 320, 310), Wire::sample(PEN, HOVER_MOVE, 322, 311));
+    decoder.feedDatagram(udp.data(), udp.size(), onSample, onHeartbeat);
+    CHECK_EQ(got.samples.size(), 5u);
+    CHECK(st.misframed.load() > misframed);
+}
+
+int main() {
+    testSplitRecords();
+    testSequenceWrap();
+    testLateBeforeStart();
+    testKeyframeDeltas();
+    testUdpDuplicates();
+    return checkResult("test_streamdecoder");
+}
@@ -0,0 +1,98 @@
+// StylusStream and its reference reader through a real shm mapping: with no
+// reader attached publishing is skipped; a reader sees samples in order,
+// counts what the producer overwrote before it got there, and its wait()
+// wakes on a publish and times out without one.
+
+#include "check.h"
+#include "stylusstream.h"
+
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+static StylusStreamSample sampleAt(int i) {
+    StylusStreamSample s{};
+    s.rawX  = i;
+    s.rawY  = -i;
+    s.flags = STREAM_IN_RANGE;
+    return s;
+}
+
+static long elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - since).count();
+}
+
+int main() {
+    const std::string name = "/inkbridge-test-" + std::to_string(getpid());
+    StylusStream stream;
+    if (!stream.open(name)) {
+        std::cerr << "cannot create " << name << std::endl;
+        return 1;
+    }
+
+    // 1. Nobody attached: nothing is written.
+    for (int i = 0; i < 3; ++i) stream.publish(sampleAt(i));
+    CHECK_EQ(stream.skipped(), 3u);
+    CHECK_EQ(stream.published(), 0u);
+
+    // 2. A reader starts at the newest sample and sees the rest in order.
+    StylusStreamReader reader;
+    CHECK(reader.attach(name));
+    CHECK_EQ(stream.readers(), 1u);
+    StylusStreamSample got{};
+    CHECK(!reader.next(got));
+    for (int i = 0; i < 10; ++i) stream.publish(sampleAt(i));
+    for (int i = 0; i < 10; ++i) {
+        CHECK(reader.next(got));
+        CHECK_EQ(got.rawX, i);
+        CHECK_EQ(got.rawY, -i);
+    }
+    CHECK(!reader.next(got));
+    CHECK_EQ(reader.lost(), 0u);
+    CHECK_EQ(stream.skipped(), 3u);
+
+    // 3. The producer laps the reader by 100: those are lost, and the
+    //    reader picks up at the oldest sample still in the ring.
+    const int LAPPED = STREAM_CAPACITY + 100;
+    for (int i = 0; i < LAPPED; ++i) stream.publish(sampleAt(1000 + i));
+    int read = 0;
+    CHECK(reader.next(got));
+    CHECK_EQ(got.rawX, 1100);
+    for (read = 1; reader.next(got); ++read) {}
+    CHECK_EQ(read, static_cast<int>(STREAM_CAPACITY));
+    CHECK_EQ(got.rawX, 1000 + LAPPED - 1);
+    CHECK_EQ(reader.lost(), 100u);
+
+    // 4. wait() with nothing coming times out...
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!reader.wait(50));
+    CHECK(elapsedMs(start) >= 40);
+
+    //    ...and one in progress wakes on the next publish, well before its
+    //    timeout, through FUTEX_WAKE.
+    const uint64_t wakes = stream.wakes();
+    std::thread producer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        stream.publish(sampleAt(7));
+    });
+    start = std::chrono::steady_clock::now();
+    CHECK(reader.wait(5000));
+    CHECK(elapsedMs(start) < 2000);
+    producer.join();
+    CHECK(stream.wakes() > wakes);
+    CHECK(reader.next(got));
+    CHECK_EQ(got.rawX, 7);
+
+    // A sample already there: wait() returns at once.
+    stream.publish(sampleAt(8));
+    CHECK(reader.wait(5000));
+
+    reader.detach();
+    CHECK_EQ(stream.readers(), 0u);
+    stream.close();
+    StylusStreamReader late;
+    CHECK(!late.attach(name));
+    return checkResult("test_stylusstream");
+}
@@ -0,0 +1,121 @@
+// TouchDebouncer sample by sample: contact starts above the press threshold
+// and ends at or below the release threshold, neither within the dwell of
+// the previous change; an explicit lift ends contact at once; and a tablet
+// contact that was never passed on comes back as a tap at its lift.
+
+#include "check.h"
+#include "touchdebouncer.h"
+
+static constexpr uint64_t MS    = 1000;
+static constexpr uint64_t DWELL = TouchDebouncer::MIN_DWELL_US;
+
+// Thresholds: 0.10 releases, 0.12 presses; in between keeps the state.
+static void testThresholds() {
+    TouchDebouncer d;
+    d.setThreshold(0.10f);
+    uint64_t t = 100 * MS;
+
+    CHECK(!d.update(true, 0.11f, t));
+    CHECK(!d.update(true, 0.12f, t += 4 * MS));
+    CHECK(d.update(true, 0.13f, t += 4 * MS));
+    const uint64_t pressed = t;
+    CHECK(d.update(true, 0.11f, t = pressed + DWELL));
+    CHECK(!d.update(true, 0.10f, t += 4 * MS));
+    CHECK(!d.update(true, 0.11f, t += DWELL));
+    CHECK(d.update(true, 0.20f, t += 4 * MS));
+    CHECK(!d.tapped());
+    CHECK(!d.update(false, 0.0f, t += 4 * MS));
+    CHECK(!d.tapped());
+    CHECK_EQ(d.contacts(), 2u);
+    CHECK_EQ(d.taps(), 0u);
+}
+
+// Neither a press nor a pressure release happens within the dwell.
+static void testDwell() {
+    TouchDebouncer d;
+    d.setThreshold(0.10f);
+    uint64_t t = 100 * MS;
+
+    CHECK(d.update(true, 0.50f, t));
+    CHECK(d.update(true, 0.05f, t + DWELL - 1));
+    CHECK(!d.update(true, 0.05f, t + DWELL));
+    const uint64_t released = t + DWELL;
+    CHECK(!d.update(true, 0.50f, released + 5 * MS));
+    CHECK(d.update(true, 0.50f, released + DWELL));
+}
+
+// An explicit lift ends contact at once, inside the dwell too, and is not
+// a tap: the contact was passed on.
+static void testExplicitLift() {
+    TouchDebouncer d;
+    d.setThreshold(0.0f);
+    uint64_t t = 100 * MS;
+
+    CHECK(d.update(true, 0.50f, t));
+    CHECK(!d.update(false, 0.0f, t + 1 * MS));
+    CHECK(!d.tapped());
+    CHECK_EQ(d.taps(), 0u);
+    CHECK_EQ(d.suppressed(), 0u);
+}
+
+// A tap too light to reach the press threshold, and one inside the dwell
+// of the previous lift, both come back at their lift, for that sample
+// only; the down held back is no longer counted as suppressed.
+static void testTaps() {
+    TouchDebouncer d;
+    d.setThreshold(0.0f);
+    uint64_t t = 100 * MS;
+
+    CHECK(!d.update(true, 0.01f, t));
+    CHECK(!d.update(true, 0.015f, t += 4 * MS));
+    CHECK_EQ(d.suppressed(), 1u);
+    CHECK(d.update(false, 0.0f, t += 4 * MS));
+    CHECK(d.tapped());
+    CHECK(!d.update(false, 0.0f, t += 4 * MS));
+    CHECK(!d.tapped());
+    CHECK_EQ(d.taps(), 1u);
+    CHECK_EQ(d.contacts(), 1u);
+    CHECK_EQ(d.suppressed(), 0u);
+
+    // A stroke, then a firm tap 3 ms after its lift, over in 5 ms.
+    t += DWELL;
+    CHECK(d.update(true, 0.60f, t));
+    CHECK(!d.update(false, 0.0f, t += 20 * MS));
+    CHECK(!d.update(true, 0.60f, t += 3 * MS));
+    CHECK(d.update(false, 0.0f, t += 5 * MS));
+    CHECK(d.tapped());
+    CHECK_EQ(d.taps(), 2u);
+    CHECK_EQ(d.contacts(), 3u);
+
+    // A down held back only until the dwell ran out is a normal contact,
+    // and its lift is not a tap.
+    t += DWELL;
+    CHECK(d.update(true, 0.60f, t));
+    CHECK(!d.update(false, 0.0f, t += 20 * MS));
+    CHECK(!d.update(true, 0.60f, t += 2 * MS));
+    CHECK(d.update(true, 0.60f, t += DWELL));
+    CHECK(!d.update(false, 0.0f, t += 20 * MS));
+    CHECK(!d.tapped());
+    CHECK_EQ(d.taps(), 2u);
+}
+
+// The tool leaving proximity forgets a held-back down: there is no lift
+// to pass it on with.
+static void testReset() {
+    TouchDebouncer d;
+    d.setThreshold(0.0f);
+    CHECK(!d.update(true, 0.01f, 100 * MS));
+    d.reset();
+    CHECK(!d.update(false, 0.0f, 104 * MS));
+    CHECK(!d.tapped());
+    CHECK_EQ(d.taps(), 0u);
+}
+
+int main() {
+    testThresholds();
+    testDwell();
+    testExplicitLift();
+    testTaps();
+    testReset();
+    return checkResult("test_touchdebouncer");
+}
@@ -0,0 +1,278 @@
+// UinputWriter under backpressure: a non-blocking loopback TCP socket that
+// is not being read stands in for an fd that pushes back. TCP rather than a
+// pipe or a socketpair because it also takes part of a frame when its
+// buffer is nearly full, so both EAGAIN and partial writes occur. Every
+// frame that arrives must be whole and in order, the queue must stay
+// bounded, and flush() must never wait for the reader. Frames that change
+// a tool or BTN_TOUCH are not lost: what the kernel ends up with matches
+// the last frame flushed.
+
+#include "check.h"
+#include "uinputwriter.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/sockios.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <initializer_list>
+#include <thread>
+#include <utility>
+#include <vector>
+
+static constexpr int FRAME_EVENTS = 6;   // five axes + SYN_REPORT
+
+struct Counters {
+    uint64_t frames, deferred, partial, dropped, maxPending, flushNs;
+    static Counters now() {
+        const UinputWriter::Stats &st = UinputWriter::stats();
+        return { st.frames.load(), st.deferred.load(), st.partial.load(), st.dropped.load(),
+                 st.maxPending.load(), st.flushTimeTotalNs.load() };
+    }
+};
+
+static void writeFrame(UinputWriter &writer, int seq) {
+    writer.queue(EV_ABS, ABS_X, seq);
+    writer.queue(EV_ABS, ABS_Y, seq);
+    writer.queue(EV_ABS, ABS_PRESSURE, seq);
+    writer.queue(EV_ABS, ABS_TILT_X, seq);
+    writer.queue(EV_MSC, MSC_TIMESTAMP, seq);
+    writer.queue(EV_SYN, SYN_REPORT, 0);
+    Error err{};
+    writer.flush(&err);
+    CHECK_EQ(err.code, 0);
+}
+
+// Reads whatever the socket holds into 'stream'.
+static void readAvailable(int fd, std::vector<uint8_t> &stream) {
+    uint8_t buffer[16384];
+    while (true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) return;
+        stream.insert(stream.end(), buffer, buffer + n);
+    }
+}
+
+// Splits the byte stream into frames and checks that each is whole and
+// newer than the one before. Returns the sequence numbers received.
+static std::vector<int> parseFrames(const std::vector<uint8_t> &stream) {
+    std::vector<int> seqs;
+    CHECK_EQ(stream.size() % (FRAME_EVENTS * sizeof(input_event)), 0u);
+
+    const size_t count = stream.size() / sizeof(input_event);
+    std::vector<input_event> events(count);
+    std::memcpy(events.data(), stream.data(), count * sizeof(input_event));
+
+    for (size_t i = 0; i + FRAME_EVENTS <= count; i += FRAME_EVENTS) {
+        const int seq = events[i].value;
+        for (int j = 0; j < FRAME_EVENTS - 1; ++j) CHECK_EQ(events[i + j].value, seq);
+        CHECK(events[i + FRAME_EVENTS - 1].type == EV_SYN);
+        if (!seqs.empty()) CHECK(seq > seqs.back());
+        seqs.push_back(seq);
+    }
+    return seqs;
+}
+
+// Lets everything out: the reader's window opens wide, the queue goes out,
+// and the other end is read until TCP has nothing left in flight (with a
+// window this small, TCP would otherwise resume only on zero-window probes
+// seconds apart). The test waits for POLLOUT here; the writer never does.
+static void drain(UinputWriter &writer, int writeFd, int readFd, std::vector<uint8_t> &stream) {
+    int size = 1 << 20;
+    setsockopt(readFd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    int inFlight = 0;
+    for (int i = 0; i < 500; ++i) {
+        readAvailable(readFd, stream);
+        writer.retryPending();
+        if (ioctl(writeFd, SIOCOUTQ, &inFlight) < 0) inFlight = 0;
+        if (!writer.pending() && inFlight == 0) break;
+        pollfd pfd = { readFd, POLLIN, 0 };
+        poll(&pfd, 1, 10);
+    }
+    readAvailable(readFd, stream);
+    CHECK(!writer.pending());
+    CHECK_EQ(inFlight, 0);
+}
+
+// A frame as VirtualStylus builds it: the key changes 'keys' (code, value
+// pairs) in their own report, then the axes and BTN_TOUCH.
+static void penFrame(UinputWriter &writer, std::initializer_list<std::pair<int, int>> keys,
+                     int touch, int seq) {
+    for (const auto &key : keys) writer.queue(EV_KEY, key.first, key.second);
+    if (keys.size()) writer.queue(EV_SYN, SYN_REPORT, 0);
+    writer.queue(EV_ABS, ABS_X, seq);
+    writer.queue(EV_ABS, ABS_Y, seq);
+    writer.queue(EV_KEY, BTN_TOUCH, touch);
+    writer.queue(EV_ABS, ABS_PRESSURE, touch ? 500 : 0);
+    writer.queue(EV_SYN, SYN_REPORT, 0);
+    Error err{};
+    writer.flush(&err);
+    CHECK_EQ(err.code, 0);
+}
+
+// The value 'code' last had in a stream of whole reports, or -1 if it
+// never appeared.
+static int lastKey(const std::vector<uint8_t> &stream, int code) {
+    CHECK_EQ(stream.size() % sizeof(input_event), 0u);
+    std::vector<input_event> events(stream.size() / sizeof(input_event));
+    std::memcpy(events.data(), stream.data(), events.size() * sizeof(input_event));
+    CHECK(!events.empty() && events.back().type == EV_SYN);
+    int value = -1;
+    for (const input_event &ev : events) {
+        if (ev.type == EV_KEY && ev.code == code) value = ev.value;
+    }
+    return value;
+}
+
+// A connected loopback pair with buffers as small as the kernel allows, so
+// backpressure starts after a few hundred frames. fds[0] writes, fds[1] reads; both
+// non-blocking.
+static bool openPair(int fds[2]) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) < 0 ||
+        listen(listener, 1) < 0) {
+        return false;
+    }
+
+    int size = 1;   // the kernel rounds this up to its minimum
+    fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    if (connect(fds[0], reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) return false;
+    fds[1] = accept(listener, nullptr, nullptr);
+    close(listener);
+    if (fds[1] < 0) return false;
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+int main() {
+    int fds[2];
+    if (!openPair(fds)) {
+        std::cerr << "loopback socket: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    UinputWriter writer;
+    writer.attach(fds[0]);
+    std::vector<uint8_t> stream;
+
+    // 1. Nobody reads: frames queue, the queue stays bounded, the oldest
+    //    unstarted frames are dropped whole, and flush() does not wait.
+    const int STALLED = 1000;
+    const Counters before = Counters::now();
+    for (int seq = 0; seq < STALLED; ++seq) writeFrame(writer, seq);
+    const Counters stalled = Counters::now();
+
+    CHECK(stalled.deferred + stalled.partial > before.deferred + before.partial);
+    CHECK(stalled.dropped > before.dropped);
+    CHECK_EQ(stalled.maxPending, static_cast<uint64_t>(UinputWriter::PENDING_FRAMES));
+    const double avgFlushUs = (stalled.flushNs - before.flushNs) / 1000.0 / STALLED;
+    CHECK(avgFlushUs < 500.0);
+
+    // 2. The reader wakes up: the queue goes out in order, newest included.
+    drain(writer, fds[0], fds[1], stream);
+    std::vector<int> seqs = parseFrames(stream);
+    CHECK(!seqs.empty() && seqs.back() == STALLED - 1);
+    const Counters drained = Counters::now();
+    CHECK_EQ(seqs.size() + (drained.dropped - before.dropped), static_cast<size_t>(STALLED));
+
+    std::cout << "stalled: " << seqs.size() << " delivered, " << drained.dropped - before.dropped
+              << " dropped, " << stalled.deferred - before.deferred << " deferred, "
+              << stalled.partial - before.partial << " partial, avg flush " << avgFlushUs << " us"
+              << std::endl;
+
+    // 3. A reader that keeps stalling (1 ms reading, 3 ms not) while frames
+    //    come at about 20 kHz: whatever arrives is intact and in order, and
+    //    every frame is either delivered or counted as dropped.
+    const int STRESS = 20000;
+    stream.clear();
+    std::atomic<bool> writing{true};
+    std::thread reader([&] {
+        using namespace std::chrono;
+        while (writing) {
+            const auto until = steady_clock::now() + milliseconds(1);
+            while (steady_clock::now() < until) readAvailable(fds[1], stream);
+            std::this_thread::sleep_for(milliseconds(3));
+        }
+    });
+    const Counters start = Counters::now();
+    for (int seq = 0; seq < STRESS; ++seq) {
+        writeFrame(writer, seq);
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    writing = false;
+    reader.join();
+    drain(writer, fds[0], fds[1], stream);
+    seqs = parseFrames(stream);
+    const Counters end = Counters::now();
+    CHECK(!seqs.empty() && seqs.back() == STRESS - 1);
+    CHECK_EQ(seqs.size() + (end.dropped - start.dropped), static_cast<size_t>(STRESS));
+
+    std::cout << "stress: " << seqs.size() << " delivered, " << end.dropped - start.dropped
+              << " dropped, " << end.deferred - start.deferred << " deferred, "
+              << end.partial - start.partial << " partial" << std::endl;
+
+    writer.detach();
+    close(fds[0]);
+    close(fds[1]);
+
+    // 4. A fresh, stalled reader across a pen-down and a string of taps
+    //    quicker than the queue drains: moves make way first, then the
+    //    key-changing frames are resynced, never dropped alone. The reader
+    //    ends up with the state of the last frame: pen in range, touching.
+    if (!openPair(fds)) {
+        std::cerr << "loopback socket: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    writer.attach(fds[0]);
+    stream.clear();
+    const uint64_t resyncs = UinputWriter::stats().resyncs.load();
+    for (int seq = 0; seq < 400; ++seq) writeFrame(writer, seq);
+    penFrame(writer, { { BTN_TOOL_PEN, 1 } }, 0, 400);
+    for (int seq = 401; seq < 420; ++seq) penFrame(writer, {}, 0, seq);
+    for (int seq = 420; seq < 440; ++seq) penFrame(writer, {}, 1, seq);
+    for (int seq = 440; seq < 466; ++seq) penFrame(writer, {}, seq % 2, seq);
+    CHECK(writer.pending());
+    CHECK(UinputWriter::stats().resyncs.load() > resyncs);
+    drain(writer, fds[0], fds[1], stream);
+    CHECK_EQ(lastKey(stream, BTN_TOOL_PEN), 1);
+    CHECK_EQ(lastKey(stream, BTN_TOUCH), 1);
+
+    // 5. Stalled again across the pen-up and the exit: the reader ends with
+    //    the pen out of range and up.
+    int size = 1;
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    stream.clear();
+    for (int seq = 0; seq < 400; ++seq) writeFrame(writer, seq);
+    readAvailable(fds[1], stream);
+    for (int seq = 466; seq < 490; ++seq) penFrame(writer, {}, seq % 2, seq);
+    penFrame(writer, {}, 0, 490);
+    penFrame(writer, { { BTN_TOUCH, 0 }, { BTN_TOOL_PEN, 0 }, { BTN_TOOL_RUBBER, 0 } }, 0, 491);
+    drain(writer, fds[0], fds[1], stream);
+    CHECK_EQ(lastKey(stream, BTN_TOOL_PEN), 0);
+    CHECK_EQ(lastKey(stream, BTN_TOUCH), 0);
+
+    std::cout << "key state: " << UinputWriter::stats().resyncs.load() - resyncs
+              << " resyncs" << std::endl;
+
+    writer.detach();
+    close(fds[0]);
+    close(fds[1]);
+    return checkResult("test_uinputwriter");
+}
@@ -0,0 +1,94 @@
+#ifndef WIREFIXTURES_H
+#define WIREFIXTURES_H
+
+// Encodes what a tablet sends (see protocol.h), so tests can build byte
+// streams record by record instead of spelling out hex.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "protocol.h"
+
+namespace Wire {
+
+using Bytes = std::vector<uint8_t>;
+
+inline void put(Bytes &out, const void *data, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    out.insert(out.end(), p, p + len);
+}
+
+inline PenPacket sample(int tool, int action, int x, int y, int pressure = 0,
+                        int tiltX = 0, int tiltY = 0) {
+    PenPacket p{};
+    p.toolType = static_cast<uint8_t>(tool);
+    p.action   = static_cast<uint8_t>(action);
+    p.x = x;  p.y = y;  p.pressure = pressure;  p.tiltX = tiltX;  p.tiltY = tiltY;
+    return p;
+}
+
+inline void v1(Bytes &out, const PenPacket &p) { put(out, &p, sizeof(p)); }
+
+inline void v2(Bytes &out, uint16_t sequence, const PenPacket &p, uint8_t marker = PEN_PACKET_V2) {
+    PenPacketV2 packet{ marker, sequence, p };
+    put(out, &packet, sizeof(packet));
+}
+
+inline void keyframe(Bytes &out, uint16_t sequence, const PenPacket &p) {
+    v2(out, sequence, p, PEN_KEYFRAME);
+}
+
+inline void varint(Bytes &out, int32_t value) {
+    uint32_t v = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// 'next' as a PEN_DELTA on top of 'prev', sending only what changed.
+inline void delta(Bytes &out, const PenPacket &prev, const PenPacket &next) {
+    uint8_t mask = 0;
+    if (next.toolType != prev.toolType) mask |= DELTA_TOOL;
+    if (next.action   != prev.action)   mask |= DELTA_ACTION;
+    if (next.x        != prev.x)        mask |= DELTA_X;
+    if (next.y        != prev.y)        mask |= DELTA_Y;
+    if (next.pressure != prev.pressure) mask |= DELTA_PRESSURE;
+    if (next.tiltX    != prev.tiltX)    mask |= DELTA_TILT_X;
+    if (next.tiltY    != prev.tiltY)    mask |= DELTA_TILT_Y;
+
+    // int32 subtraction that wraps, as the tablet's does.
+    auto diff = [](int32_t a, int32_t b) {
+        return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+    };
+    out.push_back(PEN_DELTA);
+    out.push_back(mask);
+    if (mask & DELTA_TOOL)     out.push_back(next.toolType);
+    if (mask & DELTA_ACTION)   out.push_back(next.action);
+    if (mask & DELTA_X)        varint(out, diff(next.x, prev.x));
+    if (mask & DELTA_Y)        varint(out, diff(next.y, prev.y));
+    if (mask & DELTA_PRESSURE) varint(out, diff(next.pressure, prev.pressure));
+    if (mask & DELTA_TILT_X)   varint(out, diff(next.tiltX, prev.tiltX));
+    if (mask & DELTA_TILT_Y)   varint(out, diff(next.tiltY, prev.tiltY));
+}
+
+inline void heartbeat(Bytes &out) { out.insert(out.end(), sizeof(PenPacket), 0x7F); }
+
+inline void hello(Bytes &out, uint8_t version, uint8_t features) {
+    TabletHello h{};
+    h.type     = TABLET_HELLO;
+    h.length   = sizeof(TabletHello) - 2;
+    h.version  = version;
+    h.features = features;
+    put(out, &h, sizeof(h));
+}
+
+inline void datagramHeader(Bytes &out, uint32_t token) {
+    UdpDatagramHeader h{ UDP_DATAGRAM, 0, token };
+    put(out, &h, sizeof(h));
+}
+
+} // namespace Wire
+
+#endif // WIREFIXTURES_H
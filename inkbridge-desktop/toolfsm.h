@@ -0,0 +1,230 @@
+#ifndef TOOLFSM_H
+#define TOOLFSM_H
+
+#include <linux/input.h>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include "constants.h"
+
+/**
+ * ToolFsm — the stylus proximity / tool state machine as a constant table.
+ *
+ * Every (state, input) pair maps to the exact event sequence the kernel
+ * must see and the state that follows. The sequences are built once, at
+ * compile time, as ready-made input_event arrays, so VirtualStylus only
+ * looks the transition up and appends it to the frame with one memcpy
+ * (UinputWriter::append). Position, pressure, tilt and the barrel key are
+ * not part of the table; they follow in the frame's final report.
+ *
+ * A tool change is the three-phase protocol evdev and libinput require,
+ * each phase in its own SYN_REPORT:
+ *   Phase 1 — proximity-out: touch and pressure released, both tool bits
+ *             cleared (skipped when nothing was in range)
+ *   Phase 2 — proximity-in: the new tool bit alone
+ *   touch-arm — BTN_TOUCH + minimal pressure, only when the swap happens
+ *             mid-stroke, so the stroke's pressure is not discarded
+ * Merging any of these with each other or with axis data causes
+ * SYN_DROPPED, which stalls every input device on the seat. The
+ * static_asserts at the bottom check that ordering for every entry.
+ */
+namespace ToolFsm {
+
+enum State : uint8_t {
+    Out    = 0,   // no tool in range
+    Pen    = 1,
+    Eraser = 2
+};
+constexpr int STATE_COUNT = 3;
+
+enum Input : uint8_t {
+    PenHover    = 0,
+    PenTouch    = 1,
+    EraserHover = 2,
+    EraserTouch = 3,
+    Exit        = 4   // hover exit, cancel, watchdog lift, device teardown
+};
+constexpr int INPUT_COUNT = 5;
+
+constexpr Input positionInput(bool eraser, bool touching) {
+    return eraser ? (touching ? EraserTouch : EraserHover)
+                  : (touching ? PenTouch    : PenHover);
+}
+
+constexpr int MAX_EVENTS = 12;
+
+struct Transition {
+    std::array<input_event, MAX_EVENTS> events{};
+    uint8_t count = 0;
+    State   next  = Out;
+    bool    leavesProximity = false; // contains a proximity-out
+};
+
+namespace detail {
+
+constexpr input_event event(int type, int code, int value) {
+    input_event ev{};
+    ev.type  = static_cast<uint16_t>(type);
+    ev.code  = static_cast<uint16_t>(code);
+    ev.value = value;
+    return ev;
+}
+
+constexpr void push(Transition &t, int type, int code, int value) {
+    t.events[t.count++] = event(type, code, value);
+}
+
+constexpr State targetOf(Input input) {
+    switch (input) {
+    case PenHover:    case PenTouch:    return Pen;
+    case EraserHover: case EraserTouch: return Eraser;
+    default:                            return Out;
+    }
+}
+
+constexpr bool isTouch(Input input) {
+    return input == PenTouch || input == EraserTouch;
+}
+
+constexpr Transition build(State state, Input input) {
+    Transition t;
+    const State target = targetOf(input);
+    t.next = target;
+    if (target == state) return t;   // same tool (or still out): nothing to do
+
+    // Phase 1: proximity-out of whatever was in range, hover or touching.
+    if (state != Out) {
+        push(t, ET_KEY,      EC_KEY_TOUCH,         0);
+        push(t, ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, 0);
+        push(t, ET_KEY,      EC_KEY_TOOL_PEN,      0);
+        push(t, ET_KEY,      EC_KEY_TOOL_RUBBER,   0);
+        push(t, ET_SYNC,     EC_SYNC_REPORT,       0);
+        t.leavesProximity = true;
+    }
+    if (target == Out) return t;
+
+    // Phase 2: the new tool alone.
+    push(t, ET_KEY,  target == Eraser ? EC_KEY_TOOL_RUBBER : EC_KEY_TOOL_PEN, 1);
+    push(t, ET_SYNC, EC_SYNC_REPORT, 0);
+
+    // Touch-arm: the tool is in range but not touching yet.
+    if (isTouch(input)) {
+        push(t, ET_KEY,      EC_KEY_TOUCH,         1);
+        push(t, ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, 1);
+        push(t, ET_SYNC,     EC_SYNC_REPORT,       0);
+    }
+    return t;
+}
+
+constexpr std::array<Transition, STATE_COUNT * INPUT_COUNT> buildTable() {
+    std::array<Transition, STATE_COUNT * INPUT_COUNT> table{};
+    for (int s = 0; s < STATE_COUNT; ++s)
+        for (int i = 0; i < INPUT_COUNT; ++i)
+            table[s * INPUT_COUNT + i] = build(State(s), Input(i));
+    return table;
+}
+
+inline constexpr auto TABLE = buildTable();
+
+} // namespace detail
+
+constexpr const Transition &transition(State state, Input input) {
+    return detail::TABLE[int(state) * INPUT_COUNT + int(input)];
+}
+
+// ---------------------------------------------------------------------------
+// Compile-time checks, one instantiation per (state, input), so a broken
+// entry names itself in the error.
+// ---------------------------------------------------------------------------
+namespace check {
+
+constexpr bool is(const input_event &ev, int type, int code) {
+    return ev.type == type && ev.code == code;
+}
+constexpr bool isSync(const input_event &ev) { return is(ev, ET_SYNC, EC_SYNC_REPORT); }
+constexpr bool isToolBit(const input_event &ev) {
+    return is(ev, ET_KEY, EC_KEY_TOOL_PEN) || is(ev, ET_KEY, EC_KEY_TOOL_RUBBER);
+}
+
+// Every report (run of events up to a SYN_REPORT) is one of the three
+// phases, in order, and the last event closes a report.
+constexpr bool wellOrdered(const Transition &t, State state, Input input) {
+    if (t.count > MAX_EVENTS) return false;
+    if (t.count == 0) return true;
+    if (!isSync(t.events[t.count - 1])) return false;
+
+    int phase    = 0;   // 0 start, 1 out, 2 in, 3 touch-arm
+    int reportAt = 0;
+    for (int i = 0; i < t.count; ++i) {
+        if (!isSync(t.events[i])) continue;
+        const int len = i - reportAt;
+        const input_event &first = t.events[reportAt];
+        if (len == 0) return false;                    // no empty reports
+        if (isToolBit(first) && first.value == 1) {
+            // Phase 2: exactly the target tool bit, nothing else.
+            if (phase >= 2 || len != 1) return false;
+            const int code = detail::targetOf(input) == Eraser ? EC_KEY_TOOL_RUBBER : EC_KEY_TOOL_PEN;
+            if (first.code != code) return false;
+            phase = 2;
+        } else if (is(first, ET_KEY, EC_KEY_TOUCH) && first.value == 0) {
+            // Phase 1: releases touch and pressure before clearing both tools.
+            if (phase != 0 || len != 4 || state == Out) return false;
+            if (!is(t.events[reportAt + 1], ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE) || t.events[reportAt + 1].value != 0) return false;
+            if (!isToolBit(t.events[reportAt + 2]) || t.events[reportAt + 2].value != 0) return false;
+            if (!isToolBit(t.events[reportAt + 3]) || t.events[reportAt + 3].value != 0) return false;
+            if (t.events[reportAt + 2].code == t.events[reportAt + 3].code) return false;
+            phase = 1;
+        } else if (is(first, ET_KEY, EC_KEY_TOUCH) && first.value == 1) {
+            // Touch-arm: only after the tool is latched, only mid-stroke.
+            if (phase != 2 || len != 2 || !detail::isTouch(input)) return false;
+            if (!is(t.events[reportAt + 1], ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE) || t.events[reportAt + 1].value <= 0) return false;
+            phase = 3;
+        } else {
+            return false;                              // never axes or anything else
+        }
+        reportAt = i + 1;
+    }
+    return true;
+}
+
+constexpr bool correct(State state, Input input) {
+    const Transition &t = transition(state, input);
+    const State target = detail::targetOf(input);
+    if (t.next != target) return false;
+    // Staying with the same tool costs nothing.
+    if (state == target) return t.count == 0 && !t.leavesProximity;
+    // Leaving a tool always goes through proximity-out first...
+    if (t.leavesProximity != (state != Out)) return false;
+    if (state != Out && !(is(t.events[0], ET_KEY, EC_KEY_TOUCH) && t.events[0].value == 0)) return false;
+    // ...and a new tool is always asserted.
+    if (target != Out && t.count < 2) return false;
+    return wellOrdered(t, state, input);
+}
+
+template <int S, int I>
+struct Entry {
+    static_assert(correct(State(S), Input(I)), "tool transition breaks the SYN_DROPPED-safe ordering");
+    static constexpr bool ok = true;
+};
+
+template <int... N>
+constexpr bool all(std::integer_sequence<int, N...>) {
+    return (Entry<N / INPUT_COUNT, N % INPUT_COUNT>::ok && ...);
+}
+
+static_assert(all(std::make_integer_sequence<int, STATE_COUNT * INPUT_COUNT>{}));
+
+// Spot checks of the sequences themselves.
+static_assert(transition(Out,    PenHover).count    == 2);   // in
+static_assert(transition(Out,    EraserTouch).count == 5);   // in, arm
+static_assert(transition(Pen,    EraserHover).count == 7);   // out, in
+static_assert(transition(Eraser, PenTouch).count    == 10);  // out, in, arm
+static_assert(transition(Pen,    Exit).count        == 5);   // out
+static_assert(transition(Out,    Exit).count        == 0);
+static_assert(transition(Pen,    PenTouch).count    == 0);
+
+} // namespace check
+
+} // namespace ToolFsm
+
+#endif // TOOLFSM_H
@@ -0,0 +1,117 @@
+#ifndef TOUCHDEBOUNCER_H
+#define TOUCHDEBOUNCER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Decides nib contact on the desktop side, with hysteresis.
+ *
+ * Android reports ACTION_DOWN/MOVE as soon as the nib registers at all, so
+ * near the minimum-pressure threshold the old path sent BTN_TOUCH=1 with a
+ * pressure that rounded to 0 one sample and a real value the next. Apps
+ * saw that as a stroke broken into pieces.
+ *
+ * Contact starts only above the press threshold (the release threshold
+ * plus HYSTERESIS) and ends only below the release threshold, and neither
+ * may happen within MIN_DWELL_US of the previous change. An explicit lift
+ * from the tablet (hover or up) always ends contact at once.
+ *
+ * A tablet contact that ends before it was passed on (a light tap that
+ * never reached the press threshold, or one within the dwell of the
+ * previous lift) is not lost either: the lift sample comes back as a tap,
+ * one frame of contact that the caller releases in the same frame. See
+ * tapped().
+ *
+ * One instance per stylus, used under its mutex. The counters may be read
+ * from any thread.
+ */
+class TouchDebouncer
+{
+public:
+    static constexpr float    HYSTERESIS   = 0.02f;   // raw pressure units (0..1)
+    static constexpr uint64_t MIN_DWELL_US = 12000;   // ~2-3 samples at 120-240 Hz
+
+    // 'release' is the raw pressure at or below which the nib counts as
+    // lifted (the user's minimum pressure).
+    void setThreshold(float release) {
+        m_release = release;
+        m_press   = release + HYSTERESIS;
+    }
+
+    // 'reported': the tablet says the nib is down. Returns the debounced
+    // contact state for this sample; true for a tap's lift too.
+    bool update(bool reported, float pressure, uint64_t nowUs) {
+        m_tap = false;
+        const bool dwellOver = nowUs >= m_changedUs + MIN_DWELL_US;
+        bool contact = m_contact;
+        if (!m_contact) {
+            if (reported && pressure > m_press && dwellOver) contact = true;
+        } else if (!reported) {
+            contact = false;
+        } else if (pressure <= m_release && dwellOver) {
+            contact = false;
+        }
+
+        // The tablet lifted a contact we never passed on: pass it on now,
+        // as a tap, together with the down that was held back.
+        if (!reported && m_heldBack) {
+            m_heldBack     = false;
+            m_lastReported = false;
+            m_tap          = true;
+            m_changedUs    = nowUs;
+            m_contacts.fetch_add(1, std::memory_order_relaxed);
+            m_taps.fetch_add(1, std::memory_order_relaxed);
+            m_suppressed.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // A change on the tablet side that we did not pass on is one
+        // BTN_TOUCH flip (and usually its pair) the apps never see.
+        if (reported != m_lastReported && contact == m_contact) {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (reported && !m_lastReported) m_heldBack = !contact;
+        else if (contact) m_heldBack = false;
+        m_lastReported = reported;
+
+        if (contact != m_contact) {
+            m_contact   = contact;
+            m_changedUs = nowUs;
+            if (contact) m_contacts.fetch_add(1, std::memory_order_relaxed);
+        }
+        return m_contact;
+    }
+
+    // The last update() was a tap: contact for that sample only, to be
+    // released right after it.
+    bool tapped() const { return m_tap; }
+
+    // The tool left proximity: no contact, and the next press is not held
+    // back by the dwell.
+    void reset() {
+        m_contact      = false;
+        m_lastReported = false;
+        m_heldBack     = false;
+        m_tap          = false;
+        m_changedUs    = 0;
+    }
+
+    uint64_t contacts() const   { return m_contacts.load(std::memory_order_relaxed); }
+    uint64_t suppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
+    uint64_t taps() const       { return m_taps.load(std::memory_order_relaxed); }
+
+private:
+    float    m_release = 0.0f;
+    float    m_press   = HYSTERESIS;
+    bool     m_contact = false;
+    bool     m_lastReported = false;
+    bool     m_heldBack = false;   // the tablet's contact so far was not passed on
+    bool     m_tap = false;
+    uint64_t m_changedUs = 0;
+    std::atomic<uint64_t> m_contacts{0};
+    std::atomic<uint64_t> m_suppressed{0};
+    std::atomic<uint64_t> m_taps{0};        // contacts passed on at their lift (included in m_contacts)
+};
+
+#endif // TOUCHDEBOUNCER_H
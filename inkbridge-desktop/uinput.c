@@ -1,3 +1,4 @@
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -65,6 +66,11 @@ void init_stylus(int fd, const char* name, Error* err)
         ERROR(err, 1, "error: ioctl UI_SET_KEYBIT BTN_TOOL_RUBBER");
     if (ioctl(fd, UI_SET_KEYBIT, BTN_TOUCH) < 0)
         ERROR(err, 1, "error: ioctl UI_SET_KEYBIT BTN_TOUCH");
+    // barrel buttons, so a side-button press is a key event rather than a tool swap
+    if (ioctl(fd, UI_SET_KEYBIT, BTN_STYLUS) < 0)
+        ERROR(err, 1, "error: ioctl UI_SET_KEYBIT BTN_STYLUS");
+    if (ioctl(fd, UI_SET_KEYBIT, BTN_STYLUS2) < 0)
+        ERROR(err, 1, "error: ioctl UI_SET_KEYBIT BTN_STYLUS2");
 
     // setup sending timestamps
     if (ioctl(fd, UI_SET_EVBIT, EV_MSC) < 0)
@@ -107,6 +113,35 @@ int init_uinput_stylus(const char* name, Error* err)
     return device;
 }
 
+int uinput_evdev_path(int device, char* path, int len)
+{
+    // UI_GET_SYSNAME gives the input device ("input23"); its evdev child
+    // ("event19") is listed under it in sysfs.
+    char sysname[64];
+    if (ioctl(device, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0)
+        return -1;
+
+    char dirpath[128];
+    snprintf(dirpath, sizeof(dirpath), "/sys/devices/virtual/input/%s", sysname);
+    DIR* dir = opendir(dirpath);
+    if (!dir)
+        return -1;
+
+    int found = -1;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strncmp(entry->d_name, "event", 5) == 0)
+        {
+            snprintf(path, len, "/dev/input/%s", entry->d_name);
+            found = 0;
+            break;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
 void destroy_uinput_device(int fd)
 {
     ioctl(fd, UI_DEV_DESTROY);
@@ -122,3 +157,15 @@ void send_uinput_event(int device, int type, int code, int value, Error* err)
     if (write(device, &ev, sizeof(ev)) < 0)
         ERROR(err, 1, "error writing to device, filedescriptor: %d)", device);
 }
+
+long send_uinput_frame(int device, const void* data, size_t len, Error* err)
+{
+    ssize_t written = write(device, data, len);
+    if (written >= 0)
+        return written;
+    // the device is opened O_NONBLOCK: backpressure is for the caller to retry
+    int saved = errno;
+    if (saved != EAGAIN && saved != EWOULDBLOCK && saved != EINTR)
+        fill_error(err, 1, "error writing frame to device, filedescriptor: %d)", device);
+    return -saved;
+}
@@ -9,4 +9,12 @@ const int ACTION_CANCEL = 3;
 const int ACTION_OUTSIDE = 4;
 extern "C" int init_uinput_stylus(const char* name, Error* err);
 extern "C" void send_uinput_event(int device, int type, int code, int value, Error* err);
+// Writes 'len' bytes of a frame (whole input_events, SYN_REPORTs included)
+// in one syscall. Returns the bytes written, which may be fewer than 'len',
+// or -errno. 'err' is only filled for errors other than EAGAIN and EINTR.
+extern "C" long send_uinput_frame(int device, const void* data, size_t len, Error* err);
+// The evdev node ("/dev/input/eventN") of a created uinput device, found
+// through UI_GET_SYSNAME. Returns 0 on success, -1 if it cannot be resolved.
+extern "C" int uinput_evdev_path(int device, char* path, int len);
+extern "C" void destroy_uinput_device(int fd);
 #endif // UINPUT_H
@@ -0,0 +1,344 @@
+#include "uinputwriter.h"
+#include "uinput.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#ifdef INKBRIDGE_HAVE_IO_URING
+// error.h's fill_error() has C linkage but no extern "C" guard, so fill the
+// struct directly from here.
+static void setError(Error* err, const char* what, int fd) {
+    err->code = 1;
+    std::snprintf(err->error_str, sizeof(err->error_str), "%s, filedescriptor: %d", what, fd);
+}
+#endif
+
+// Indexes into m_keys.
+static constexpr int KEY_CODES[UinputWriter::TRACKED_KEYS] = {
+    BTN_TOOL_PEN, BTN_TOOL_RUBBER, BTN_TOUCH, BTN_STYLUS, BTN_STYLUS2
+};
+
+static int keyIndex(int code) {
+    for (int i = 0; i < UinputWriter::TRACKED_KEYS; ++i) {
+        if (KEY_CODES[i] == code) return i;
+    }
+    return -1;
+}
+
+UinputWriter::~UinputWriter() {
+    detach();
+}
+
+UinputWriter::Stats& UinputWriter::stats() {
+    static Stats s;
+    return s;
+}
+
+void UinputWriter::attach(int fd) {
+    detach();
+    m_fd = fd;
+    m_count = 0;
+    // A new device starts with every key up.
+    std::memset(m_keys, 0, sizeof(m_keys));
+    // Touch the frame now rather than on the first pen sample.
+    std::memset(m_frame, 0, sizeof(m_frame));
+#ifdef INKBRIDGE_HAVE_IO_URING
+    if (m_fd >= 0) m_uringReady = setupRing();
+#endif
+}
+
+void UinputWriter::detach() {
+#ifdef INKBRIDGE_HAVE_IO_URING
+    if (m_uringReady) io_uring_queue_exit(&m_ring);
+#endif
+    m_uringReady = false;
+    // Frames the kernel never took die with the device.
+    if (m_pendingCount) dropPending();
+    m_fd = -1;
+    m_count = 0;
+}
+
+void UinputWriter::queue(int type, int code, int value) {
+    if (m_fd < 0) return;
+    // A frame never gets this long in practice; if it does, pushing out
+    // what we have keeps the event order intact.
+    if (m_count == MAX_FRAME_EVENTS) {
+        Error err{};
+        flush(&err);
+    }
+    struct input_event &ev = m_frame[m_count++];
+    std::memset(&ev, 0, sizeof(ev));
+    ev.type  = type;
+    ev.code  = code;
+    ev.value = value;
+}
+
+void UinputWriter::append(const struct input_event* events, int count) {
+    if (m_fd < 0 || count <= 0) return;
+    if (m_count + count > MAX_FRAME_EVENTS) {
+        Error err{};
+        flush(&err);
+    }
+    std::memcpy(&m_frame[m_count], events, count * sizeof(struct input_event));
+    m_count += count;
+}
+
+void UinputWriter::flush(Error* err) {
+    if (m_fd < 0 || m_count == 0) return;
+
+    auto start = std::chrono::steady_clock::now();
+    Stats &st = stats();
+
+    // Anything still queued goes first, or the kernel would see frames out
+    // of order.
+    if (m_pendingCount) drainPending(err);
+
+    const bool keys = trackKeys(false);
+    if (m_pendingCount) {
+        st.deferred++;
+        enqueue(0, keys);
+    } else {
+        const long written = writeFrame(err);
+        const size_t bytes = m_count * sizeof(struct input_event);
+        if (written >= 0 && static_cast<size_t>(written) < bytes) {
+            st.partial++;
+            enqueue(written, keys);
+        } else if (written == -EAGAIN || written == -EWOULDBLOCK || written == -EINTR) {
+            st.deferred++;
+            enqueue(0, keys);
+        } else if (written < 0) {
+            st.dropped++;   // the device is gone or broken; err says why
+        }
+    }
+    // After enqueue(): a resync there restores the state before this frame.
+    trackKeys(true);
+
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    st.frames++;
+    st.events += m_count;
+    if (err->code) st.errors++;
+    st.flushTimeTotalNs += ns;
+    uint64_t prev = st.flushTimeMaxNs.load();
+    while (ns > prev && !st.flushTimeMaxNs.compare_exchange_weak(prev, ns)) {}
+
+    m_count = 0;
+}
+
+long UinputWriter::writeFrame(Error* err) {
+    stats().syscalls++;
+#ifdef INKBRIDGE_HAVE_IO_URING
+    if (m_uringReady) return flushRing(err);
+#endif
+    return flushWrite(err);
+}
+
+long UinputWriter::flushWrite(Error* err) {
+    return send_uinput_frame(m_fd, m_frame, m_count * sizeof(struct input_event), err);
+}
+
+bool UinputWriter::trackKeys(bool apply) {
+    int32_t keys[TRACKED_KEYS];
+    std::memcpy(keys, m_keys, sizeof(keys));
+    bool changed = false;
+    for (int i = 0; i < m_count; ++i) {
+        if (m_frame[i].type != EV_KEY) continue;
+        const int k = keyIndex(m_frame[i].code);
+        if (k < 0 || keys[k] == m_frame[i].value) continue;
+        keys[k] = m_frame[i].value;
+        changed = true;
+    }
+    if (apply) std::memcpy(m_keys, keys, sizeof(keys));
+    return changed;
+}
+
+// Queues m_frame from byte 'written' on. When the queue is full the oldest
+// unstarted frame that changes no key is dropped; the kernel never sees a
+// torn frame and the newest position is kept. If every unstarted frame
+// changes a key, they all make way for one resync frame instead.
+void UinputWriter::enqueue(size_t written, bool keys) {
+    Stats &st = stats();
+    if (m_pendingCount == PENDING_FRAMES) {
+        const int first = m_pending[m_pendingHead].offset > 0 ? 1 : 0;
+        int victim = first;
+        while (victim < m_pendingCount && m_pending[(m_pendingHead + victim) % PENDING_FRAMES].keys) {
+            ++victim;
+        }
+        if (victim < m_pendingCount) {
+            for (int i = victim; i + 1 < m_pendingCount; ++i) {
+                std::swap(m_pending[(m_pendingHead + i) % PENDING_FRAMES],
+                          m_pending[(m_pendingHead + i + 1) % PENDING_FRAMES]);
+            }
+            --m_pendingCount;
+            st.dropped++;
+        } else {
+            st.dropped += m_pendingCount - first;
+            st.resyncs++;
+            resync(m_pending[(m_pendingHead + first) % PENDING_FRAMES]);
+            m_pendingCount = first + 1;
+        }
+    }
+    PendingFrame &frame = m_pending[(m_pendingHead + m_pendingCount) % PENDING_FRAMES];
+    frame.bytes  = m_count * sizeof(struct input_event);
+    frame.offset = written;
+    frame.keys   = keys;
+    std::memcpy(frame.events, m_frame, frame.bytes);
+    ++m_pendingCount;
+
+    uint64_t depth = m_pendingCount;
+    uint64_t prev = st.maxPending.load();
+    while (depth > prev && !st.maxPending.compare_exchange_weak(prev, depth)) {}
+}
+
+// Brings the kernel to m_keys whatever it last saw: the Exit transition's
+// proximity-out (barrel keys released with it), then the tool alone, then
+// the touch-arm and the barrel keys, each in its own report.
+void UinputWriter::resync(PendingFrame &frame) const {
+    int count = 0;
+    auto push = [&](int type, int code, int value) {
+        struct input_event &ev = frame.events[count++];
+        std::memset(&ev, 0, sizeof(ev));
+        ev.type  = type;
+        ev.code  = code;
+        ev.value = value;
+    };
+    auto key = [this](int code) { return m_keys[keyIndex(code)]; };
+
+    push(EV_KEY, BTN_STYLUS,      0);
+    push(EV_KEY, BTN_STYLUS2,     0);
+    push(EV_KEY, BTN_TOUCH,       0);
+    push(EV_ABS, ABS_PRESSURE,    0);
+    push(EV_KEY, BTN_TOOL_PEN,    0);
+    push(EV_KEY, BTN_TOOL_RUBBER, 0);
+    push(EV_SYN, SYN_REPORT,      0);
+    if (key(BTN_TOOL_PEN) || key(BTN_TOOL_RUBBER)) {
+        push(EV_KEY, key(BTN_TOOL_RUBBER) ? BTN_TOOL_RUBBER : BTN_TOOL_PEN, 1);
+        push(EV_SYN, SYN_REPORT, 0);
+        if (key(BTN_TOUCH)) {
+            push(EV_KEY, BTN_TOUCH,    1);
+            push(EV_ABS, ABS_PRESSURE, 1);
+            push(EV_SYN, SYN_REPORT,   0);
+        }
+        if (key(BTN_STYLUS) || key(BTN_STYLUS2)) {
+            if (key(BTN_STYLUS))  push(EV_KEY, BTN_STYLUS,  1);
+            if (key(BTN_STYLUS2)) push(EV_KEY, BTN_STYLUS2, 1);
+            push(EV_SYN, SYN_REPORT, 0);
+        }
+    }
+    frame.bytes  = count * sizeof(struct input_event);
+    frame.offset = 0;
+    frame.keys   = true;
+}
+
+// Writes queued frames in order until the fd pushes back. Never waits.
+void UinputWriter::drainPending(Error* err) {
+    Stats &st = stats();
+
+    while (m_pendingCount) {
+        PendingFrame &frame = m_pending[m_pendingHead];
+        st.syscalls++;
+        st.retries++;
+        const long written = send_uinput_frame(m_fd,
+            reinterpret_cast<const char*>(frame.events) + frame.offset,
+            frame.bytes - frame.offset, err);
+
+        if (written > 0) {
+            frame.offset += written;
+            if (frame.offset == frame.bytes) {
+                m_pendingHead = (m_pendingHead + 1) % PENDING_FRAMES;
+                --m_pendingCount;
+            }
+            continue;
+        }
+        if (written == -EINTR) continue;
+        if (written < 0 && written != -EAGAIN && written != -EWOULDBLOCK && written != -EINTR) {
+            dropPending();
+        }
+        return;
+    }
+}
+
+void UinputWriter::dropPending() {
+    stats().dropped += m_pendingCount;
+    m_pendingHead  = 0;
+    m_pendingCount = 0;
+}
+
+void UinputWriter::retryPending() {
+    if (m_fd < 0 || m_pendingCount == 0) return;
+    Error err{};
+    drainPending(&err);
+    if (err.code) stats().errors++;
+}
+
+#ifdef INKBRIDGE_HAVE_IO_URING
+bool UinputWriter::setupRing() {
+    if (io_uring_queue_init(8, &m_ring, 0) < 0) {
+        std::cerr << "io_uring unavailable, using write() for uinput." << std::endl;
+        return false;
+    }
+    struct iovec iov;
+    iov.iov_base = m_frame;
+    iov.iov_len  = sizeof(m_frame);
+    if (io_uring_register_files(&m_ring, &m_fd, 1) < 0 ||
+        io_uring_register_buffers(&m_ring, &iov, 1) < 0) {
+        std::cerr << "io_uring registration failed, using write() for uinput." << std::endl;
+        io_uring_queue_exit(&m_ring);
+        return false;
+    }
+    return true;
+}
+
+long UinputWriter::flushRing(Error* err) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+    if (!sqe) return flushWrite(err);
+    // Fixed file index 0, fixed buffer index 0 (m_frame).
+    io_uring_prep_write_fixed(sqe, 0, m_frame, m_count * sizeof(struct input_event), 0, 0);
+    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+
+    // Submit and reap in one io_uring_enter. The frame buffer is reused by
+    // the next sample, so the write must be complete before we return.
+    if (io_uring_submit_and_wait(&m_ring, 1) < 0) {
+        setError(err, "error: io_uring submit", m_fd);
+        return -EIO;
+    }
+    long res = -EIO;
+    struct io_uring_cqe *cqe = nullptr;
+    if (io_uring_peek_cqe(&m_ring, &cqe) == 0 && cqe) {
+        res = cqe->res;
+        io_uring_cqe_seen(&m_ring, cqe);
+    }
+    // Same contract as send_uinput_frame(): backpressure is not an error.
+    if (res < 0 && res != -EAGAIN && res != -EWOULDBLOCK && res != -EINTR) {
+        setError(err, "error writing frame to device", m_fd);
+    }
+    return res;
+}
+#endif
+
+std::string UinputWriter::report() {
+    const Stats &st = stats();
+    uint64_t frames = st.frames.load();
+    std::ostringstream out;
+#ifdef INKBRIDGE_HAVE_IO_URING
+    out << "uinput backend: io_uring (write() fallback per device). ";
+#else
+    out << "uinput backend: write(). ";
+#endif
+    out << frames << " frames, " << st.events.load() << " events, "
+        << st.syscalls.load() << " syscalls, " << st.errors.load() << " errors";
+    out << "; backpressure: " << st.deferred.load() << " deferred, "
+        << st.partial.load() << " partial, " << st.retries.load() << " retries, "
+        << st.dropped.load() << " dropped, " << st.resyncs.load() << " resyncs, queue max "
+        << st.maxPending.load();
+    if (frames) {
+        out << ", flush avg " << (st.flushTimeTotalNs.load() / frames / 1000.0)
+            << " us, max " << (st.flushTimeMaxNs.load() / 1000.0) << " us";
+    }
+    return out.str();
+}
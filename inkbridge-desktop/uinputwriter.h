@@ -0,0 +1,141 @@
+#ifndef UINPUTWRITER_H
+#define UINPUTWRITER_H
+
+#include <linux/input.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "error.h"
+
+#ifdef INKBRIDGE_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+/**
+ * UinputWriter — batches one stylus frame into a single uinput write.
+ *
+ * VirtualStylus queues every event of a sample (tool swap phases, axes,
+ * timestamp and the SYN_REPORTs between them) and flushes once. The kernel
+ * consumes a multi-event write in order, so the three-phase proximity
+ * protocol is preserved while the ~10-18 write() calls per sample become one.
+ *
+ * Backends:
+ *   - write():  send_uinput_frame(), always available.
+ *   - io_uring: built with -DINKBRIDGE_IO_URING=ON (liburing, Linux 5.10+).
+ *     The uinput fd is registered as a fixed file and the frame array as a
+ *     fixed buffer, so each flush is a single WRITE_FIXED submission without
+ *     per-call fd lookup or buffer mapping. If the ring cannot be set up at
+ *     runtime (old kernel, seccomp, RLIMIT_MEMLOCK) the writer silently
+ *     falls back to write().
+ *
+ * Backpressure: a frame the fd does not take (EAGAIN, EINTR) or only takes
+ * part of is never dropped half-written: it, or its unwritten tail, goes
+ * into a small queue of PENDING_FRAMES whole frames that is written, in
+ * order and before anything newer, by the next flush() or retryPending().
+ * When the queue is full, the oldest unstarted frame that changes no key
+ * (a move: axes, and key values the kernel already has) is dropped; the
+ * frames after it carry the newer position. Frames that change a tool,
+ * BTN_TOUCH or a barrel key are never dropped on their own, as the kernel
+ * would then disagree with VirtualStylus's tool and button state until the
+ * watchdog lifted the pen. If every unstarted frame changes a key, they are
+ * replaced by one resync frame: the Exit transition's proximity-out, then
+ * the tool, touch and barrel keys the dropped frames left, each phase in
+ * its own report as ToolFsm requires. All of it is counted in Stats.
+ *
+ * uinput itself hardly ever pushes back: its write() handles every event
+ * synchronously and neither returns EAGAIN nor writes partially; at most
+ * a signal interrupts it. So the queue never waits for POLLOUT: flush() is
+ * called with the stylus mutex held, and waiting there would stall the
+ * watchdog and the other stages for a case uinput does not produce. Any
+ * non-blocking fd behaves the same way (tests/test_uinputwriter.cpp runs
+ * it against a socket nobody reads).
+ *
+ * Not thread-safe; VirtualStylus calls it under its own mutex.
+ */
+class UinputWriter
+{
+public:
+    static constexpr int MAX_FRAME_EVENTS = 32;
+    static constexpr int PENDING_FRAMES   = 8;
+    // The keys a dropped frame could leave wrong in the kernel.
+    static constexpr int TRACKED_KEYS     = 5;
+
+    // Process-wide counters so the two backends can be compared side by side.
+    struct Stats {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> events{0};
+        std::atomic<uint64_t> syscalls{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> deferred{0};      // frames queued whole (EAGAIN, or behind the queue)
+        std::atomic<uint64_t> partial{0};       // frames the kernel took only part of
+        std::atomic<uint64_t> retries{0};       // writes of queued frames
+        std::atomic<uint64_t> dropped{0};       // whole frames lost (queue full, device gone)
+        std::atomic<uint64_t> resyncs{0};       // key-changing frames replaced by a resync frame
+        std::atomic<uint64_t> maxPending{0};    // deepest the queue got
+        std::atomic<uint64_t> flushTimeTotalNs{0};
+        std::atomic<uint64_t> flushTimeMaxNs{0};
+    };
+
+    UinputWriter() = default;
+    ~UinputWriter();
+
+    UinputWriter(const UinputWriter&) = delete;
+    UinputWriter& operator=(const UinputWriter&) = delete;
+
+    // Binds the writer to a uinput fd (and sets up io_uring if enabled).
+    void attach(int fd);
+    void detach();
+
+    void queue(int type, int code, int value);
+    // Appends ready-made events (e.g. a ToolFsm transition) with one memcpy.
+    void append(const struct input_event* events, int count);
+    void flush(Error* err);
+    // Frames waiting for the kernel. retryPending() writes what it can
+    // (the watchdog calls it so a queued frame does not wait for the next
+    // pen sample).
+    bool pending() const { return m_pendingCount > 0; }
+    void retryPending();
+
+    bool usingIoUring() const { return m_uringReady; }
+
+    static Stats& stats();
+    static std::string report();
+
+private:
+    struct PendingFrame {
+        struct input_event events[MAX_FRAME_EVENTS];
+        size_t bytes  = 0;
+        size_t offset = 0;   // already written
+        bool   keys   = false;   // changes a tracked key: never dropped alone
+    };
+
+    // Bytes written or -errno.
+    long writeFrame(Error* err);
+    long flushWrite(Error* err);
+    void enqueue(size_t written, bool keys);
+    void resync(PendingFrame &frame) const;
+    // Whether m_frame changes a tracked key; with 'apply', m_keys takes the
+    // values it leaves.
+    bool trackKeys(bool apply);
+    void drainPending(Error* err);
+    void dropPending();
+#ifdef INKBRIDGE_HAVE_IO_URING
+    bool setupRing();
+    long flushRing(Error* err);
+    struct io_uring m_ring;
+#endif
+
+    int  m_fd = -1;
+    bool m_uringReady = false;
+    int  m_count = 0;
+    struct input_event m_frame[MAX_FRAME_EVENTS];
+
+    // Tracked key values after every frame handed to flush(), written or not.
+    int32_t m_keys[TRACKED_KEYS] = {};
+
+    PendingFrame m_pending[PENDING_FRAMES];   // ring, oldest at m_pendingHead
+    int          m_pendingHead  = 0;
+    int          m_pendingCount = 0;
+};
+
+#endif // UINPUTWRITER_H
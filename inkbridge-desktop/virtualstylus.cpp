@@ -1,5 +1,8 @@
 #include <QGuiApplication>
 #include <chrono>
+#include <algorithm>
+#include <array>
+#include <utility>
 #include <QDebug>
 #include <linux/input.h>
 #include "virtualstylus.h"
@@ -9,21 +12,51 @@
 #include "accessory.h"
 #include "pressuretranslator.h"
 #include "backend.h"
+#include "rtsched.h"
+#include "pipeline.h"
+#include "syndropmonitor.h"
+#include "stylusstream.h"
 
 using namespace std::chrono;
 
 const int ACTION_HOVER_ENTER = 9;
 const int ACTION_HOVER_EXIT  = 10;
 
+// Adaptive watchdog bounds. The timeout follows the observed cadence but
+// never drops below what a busy compositor can stall for, nor grows so
+// large that a dead link leaves a stroke stuck for seconds.
+const int64_t WATCHDOG_MIN_TIMEOUT_MS = 100;
+const int64_t WATCHDOG_MAX_TIMEOUT_MS = 2000;
+// Gaps longer than this are pauses, not the streaming cadence.
+const int64_t MAX_SAMPLE_GAP_MS       = 250;
+// Traffic this soon after a watchdog lift means the lift was unnecessary.
+const int64_t SPURIOUS_LIFT_WINDOW_MS = 1000;
+// Seat protection: while paced, a hover-move within this long of the last
+// one let through is held back and replaced by the next (~250 Hz instead of
+// the tablet's full rate). Pacing ends after this long without another
+// SYN_DROPPED.
+const uint64_t PACE_HOVER_US          = 4000;
+const int64_t  PACE_HOLD_MS           = 30000;
+
+static int64_t nowNs() {
+    return steady_clock::now().time_since_epoch().count();
+}
+
+static int64_t elapsedMs(int64_t fromNs, int64_t toNs) {
+    return duration_cast<milliseconds>(nanoseconds(toNs - fromNs)).count();
+}
+
 VirtualStylus::VirtualStylus(DisplayScreenTranslator * displayScreenTranslator,
                              PressureTranslator * pressureTranslator,
                              QObject *parent) : QObject(parent)
+    , m_createdAt(nowNs())
 {
     this->displayScreenTranslator = displayScreenTranslator;
     this->pressureTranslator      = pressureTranslator;
     this->inputWidth              = 32767;
     this->inputHeight             = 32767;
-    this->isPenActive             = false;
+
+    selectPipeline();
 
     m_lastEventTime   = steady_clock::now().time_since_epoch().count();
     m_watchdogRunning = true;
@@ -35,60 +68,41 @@ VirtualStylus::~VirtualStylus() {
     if (m_watchdogThread.joinable()) {
         m_watchdogThread.join();
     }
+    destroyStylus();
 }
 
-void VirtualStylus::initializeStylus(){
+void VirtualStylus::initializeStylus(const std::string& deviceName){
     std::lock_guard<std::mutex> lock(m_mutex);
     Error * err = new Error();
-    const char* deviceName = "pen-emu";
-    fd = init_uinput_stylus(deviceName, err);
+    fd = init_uinput_stylus(deviceName.c_str(), err);
     delete err;
+    m_deviceName = deviceName;
+    if (fd >= 0) {
+        m_writer.attach(fd);
+        if (m_synDropGuard) startSynDropMonitor();
+        if (m_sharedStream) openStream();
+    }
 }
 
 // ---------------------------------------------------------------------------
-// HELPER: sendProximityOut
+// HELPER: applyTransition
 //
-// Sends a complete, self-contained proximity-out report (Phase 1 of the
-// three-phase tool swap). After this sync, the kernel considers the device
-// fully out of range with no tool present.
+// Looks the (current tool, input) pair up in ToolFsm's compile-time table
+// and appends its precomposed events — proximity-out, proximity-in and
+// touch-arm, each in its own sync report — to the frame in one memcpy.
+// The table's static_asserts guarantee the SYN_DROPPED-safe ordering.
 //
-// Must be called before asserting any new tool bit. Covers both hover and
-// touch cases — clearing touch+pressure first ensures the sync is clean
-// regardless of whether the nib was contacting the surface.
-//
-// Caller is responsible for updating m_activeTool and isPenActive.
+// A held barrel key is released in the proximity-out report: a key must not
+// stay down for a tool that is out of range.
 // ---------------------------------------------------------------------------
-void VirtualStylus::sendProximityOut(Error* err) {
-    // Release touch and pressure before the proximity-out sync.
-    send_uinput_event(fd, ET_KEY,      EC_KEY_TOUCH,         0, err);
-    send_uinput_event(fd, ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, 0, err);
-
-    // Clear both tool bits defensively. If only one was set the other is a
-    // no-op (0->0), which the kernel ignores without harm.
-    send_uinput_event(fd, ET_KEY, EC_KEY_TOOL_PEN,    0, err);
-    send_uinput_event(fd, ET_KEY, EC_KEY_TOOL_RUBBER, 0, err);
-
-    // Phase 1 commit: kernel now sees no tool in range.
-    send_uinput_event(fd, ET_SYNC, EC_SYNC_REPORT, 0, err);
-}
-
-// ---------------------------------------------------------------------------
-// HELPER: sendProximityIn
-//
-// Asserts the new tool bit in its own dedicated sync report (Phase 2).
-// No position or pressure is included — those come in Phase 3. Sending
-// axis data before the tool-present bit is latched is a reliable trigger
-// for SYN_DROPPED on both X11 (evdev) and Wayland (libinput).
-// ---------------------------------------------------------------------------
-void VirtualStylus::sendProximityIn(int tool, Error* err) {
-    if (tool == 2) {
-        send_uinput_event(fd, ET_KEY, EC_KEY_TOOL_RUBBER, 1, err);
-    } else {
-        send_uinput_event(fd, ET_KEY, EC_KEY_TOOL_PEN,    1, err);
+void VirtualStylus::applyTransition(ToolFsm::Input input) {
+    const ToolFsm::Transition &t = ToolFsm::transition(m_toolState, input);
+    if (t.leavesProximity && m_buttonCode != 0) {
+        m_writer.queue(ET_KEY, m_buttonCode, 0);
+        m_buttonCode = 0;
     }
-
-    // Phase 2 commit: kernel now sees the new tool in range, ready for data.
-    send_uinput_event(fd, ET_SYNC, EC_SYNC_REPORT, 0, err);
+    m_writer.append(t.events.data(), t.count);
+    m_toolState = t.next;
 }
 
 // ---------------------------------------------------------------------------
@@ -96,15 +110,44 @@ void VirtualStylus::sendProximityIn(int tool, Error* err) {
 // the event stream has gone silent and forces a clean reset if so.
 // ---------------------------------------------------------------------------
 void VirtualStylus::watchdogLoop() {
+    RtSched::ThreadScope rt(RtSched::ThreadRole::Watchdog, "watchdog");
+
     while (m_watchdogRunning) {
+        // How late the 50 ms sleep returns is our scheduling jitter probe.
+        auto sleepStart = steady_clock::now();
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto overshoot = steady_clock::now() - sleepStart - milliseconds(50);
+        RtSched::recordWakeupLatency(overshoot.count() > 0
+            ? duration_cast<microseconds>(overshoot).count() : 0);
+
+        {
+            // The pen stopped (or the link went quiet) right after a
+            // held-back hover-move: put the cursor where the pen is.
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_pacedPending
+                && static_cast<uint64_t>(nowNs() / 1000) - m_lastPacedUs >= PACE_HOVER_US) {
+                flushPaced();
+            }
+        }
 
-        int64_t last    = m_lastEventTime.load();
-        int64_t now     = steady_clock::now().time_since_epoch().count();
-        int64_t diff_ms = duration_cast<milliseconds>(nanoseconds(now - last)).count();
+        int64_t diff_ms = elapsedMs(m_lastEventTime.load(), nowNs());
 
-        if (diff_ms > 150) {
+        if (diff_ms > m_timeoutMs.load()) {
             performWatchdogReset();
+        } else {
+            // A frame the kernel pushed back on must not wait for the
+            // next pen sample, which may be a long time coming.
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_writer.retryPending();
+        }
+
+        // The seat has been quiet long enough: back to full rate.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_paced && elapsedMs(m_lastDropTime, nowNs()) > PACE_HOLD_MS) {
+            qDebug() << "[SynDrop] No SYN_DROPPED for" << PACE_HOLD_MS / 1000 << "s, pacing off";
+            flushPaced();
+            m_paced = false;
+            selectPipeline();
         }
     }
 }
@@ -115,23 +158,25 @@ void VirtualStylus::performWatchdogReset() {
     // Re-check the timestamp now that we hold the lock. If the main thread
     // processed an event between our check above and here, the diff will be
     // small and we bail — this closes the race condition.
-    int64_t last    = m_lastEventTime.load();
-    int64_t now     = steady_clock::now().time_since_epoch().count();
-    int64_t diff_ms = duration_cast<milliseconds>(nanoseconds(now - last)).count();
-    if (diff_ms <= 150) return;
+    int64_t now     = nowNs();
+    int64_t diff_ms = elapsedMs(m_lastEventTime.load(), now);
+    if (diff_ms <= m_timeoutMs.load()) return;
 
-    if (!isPenActive) return;
+    if (m_toolState == ToolFsm::Out) return;
 
-    if(Backend::isDebugMode) qDebug() << "WATCHDOG: Stream silent, forcing stylus lift.";
+    if(Backend::isDebugMode) qDebug() << "WATCHDOG: Stream silent for" << diff_ms
+                                      << "ms, forcing stylus lift.";
+    m_lifts++;
+    m_lastLiftTime = now;
 
     Error * err = new Error();
 
-    // Use the shared helper so the watchdog reset produces the same
-    // kernel-valid proximity-out sequence as a normal tool swap.
-    sendProximityOut(err);
-
-    isPenActive  = false;
-    m_activeTool = -1;
+    // Same table entry as a hover exit, so the watchdog reset produces the
+    // same kernel-valid proximity-out sequence as a normal tool swap.
+    applyTransition(ToolFsm::Exit);
+    m_writer.flush(err);
+    m_debouncer.reset();
+    updateTimeout();
 
     delete err;
 }
@@ -142,171 +187,444 @@ void VirtualStylus::handleAccessoryEventData(AccessoryEventData * accessoryEvent
 
     // Timestamp is updated inside the lock so the watchdog's re-check
     // (which also runs under the lock) always sees the current value.
-    m_lastEventTime = steady_clock::now().time_since_epoch().count();
+    const int64_t now = nowNs();
+    m_lastEventTime = now;
+
+    // Streaming cadence: only back-to-back samples count, not the first
+    // sample after an idle stretch.
+    if (m_lastSampleTime > m_lastHeartbeatTime) {
+        int64_t gap = elapsedMs(m_lastSampleTime, now);
+        if (gap <= MAX_SAMPLE_GAP_MS) m_sampleGap.add(static_cast<double>(gap));
+    }
+    m_lastSampleTime = now;
+    noteTrafficAfterLift(now);
+
+    PenFrame frame;
+    frame.event = accessoryEventData;
+    // MSC_TIMESTAMP is in microseconds and wraps at 32 bits; consumers only
+    // look at differences. Use when the tablet saw the sample if the clocks
+    // are synced, so velocity is not distorted by transport jitter.
+    frame.timestampUs = accessoryEventData->hostTimeUs
+        ? accessoryEventData->hostTimeUs
+        : static_cast<uint64_t>(now / 1000);
+
+    // A held-back hover-move is superseded by the next one; anything else
+    // (contact, hover exit) must not overtake it.
+    if (m_pacedPending && (accessoryEventData->action & ~32) != ACTION_HOVER_MOVE) flushPaced();
+
+    m_pipeline(*this, frame);
+    // After the pipeline, so the bound follows the tool state it left.
+    updateTimeout();
+
+    if (m_stream) publishSample(frame, now);
+}
 
-    Error * err = new Error();
-    uint64_t epoch = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+// ---------------------------------------------------------------------------
+// Sample pipeline stages (see pipeline.h)
+//
+// Nested in VirtualStylus so they reach its state directly; every stage
+// runs with m_mutex held. The map and pressure stages come in variants,
+// and selectPipeline() picks the instantiation that matches the settings.
+// ---------------------------------------------------------------------------
+struct VirtualStylus::Stages {
+
+    // -----------------------------------------------------------------------
+    // DECODE: button and action bits
+    // -----------------------------------------------------------------------
+    struct Decode {
+        static bool apply(VirtualStylus &s, PenFrame &f) {
+            const AccessoryEventData *e = f.event;
+            const bool isButtonPressed = (e->action & 32);
+            const int  baseAction      =  e->action & ~32;
+
+            // The barrel button only changes the tool when eraser emulation
+            // is opted into. Otherwise it is a BTN_STYLUS/BTN_STYLUS2 key in
+            // the same frame as the position (Emit), so pressing it costs no
+            // proximity swap and apps never see the tool leave.
+            const bool eraserButton = (s.m_buttonMapping == ButtonMapping::Eraser);
+            f.buttonCode = (isButtonPressed && !eraserButton)
+                ? (s.m_buttonMapping == ButtonMapping::Stylus2 ? EC_KEY_STYLUS2 : EC_KEY_STYLUS)
+                : 0;
+            f.eraser = (isButtonPressed && eraserButton) || e->toolType == ERASER_TOOL_TYPE;
+
+            f.position = (baseAction == ACTION_DOWN        ||
+                          baseAction == ACTION_MOVE        ||
+                          baseAction == ACTION_HOVER_MOVE  ||
+                          baseAction == ACTION_HOVER_ENTER ||
+                          baseAction == ACTION_UP);
+            f.touching = (baseAction == ACTION_DOWN || baseAction == ACTION_MOVE);
+            return true;
+        }
+    };
 
     // -----------------------------------------------------------------------
-    // 1. PARSE BUTTON AND ACTION
+    // FILTER: touch contact with hysteresis and a minimum dwell, instead of
+    // following every ACTION_DOWN/MOVE the tablet reports
     // -----------------------------------------------------------------------
-    bool isButtonPressed = (accessoryEventData->action & 32);
-    int  baseAction      =  accessoryEventData->action & ~32;
-
-    int targetTool = (isButtonPressed || accessoryEventData->toolType == ERASER_TOOL_TYPE) ? 2 : 1;
-
-    bool isPositionEvent = (baseAction == ACTION_DOWN        ||
-                            baseAction == ACTION_MOVE        ||
-                            baseAction == ACTION_HOVER_MOVE  ||
-                            baseAction == ACTION_HOVER_ENTER ||
-                            baseAction == ACTION_UP);
-
-    if (isPositionEvent) {
-        bool isTouching = (baseAction == ACTION_DOWN || baseAction == ACTION_MOVE);
-
-        // -------------------------------------------------------------------
-        // 2. THREE-PHASE TOOL SWAP
-        //
-        // Runs whenever the kernel's latched tool differs from what we want.
-        // Covers all cases: first entry, hover swap, touch swap, re-entry
-        // after a watchdog reset.
-        //
-        // The kernel's evdev/libinput layer requires tool bit transitions to
-        // be isolated in their own sync reports. Merging them with position
-        // or pressure data — or with each other — causes SYN_DROPPED, which
-        // stalls ALL input devices on the seat (explaining the mouse freeze).
-        //
-        //   Phase 1 — sendProximityOut: clear old tool, sync
-        //   Phase 2 — sendProximityIn:  assert new tool, sync
-        //   Phase 3 — section 4 below: send position/pressure, sync
-        // -------------------------------------------------------------------
-        if (targetTool != m_activeTool) {
-
-            // Phase 1: If any tool was previously active (including hover-only),
-            // send a clean proximity-out before touching any tool bits.
-            // This is unconditional on tool type — hover doesn't need a touch
-            // lift, but it absolutely needs the tool bit cleared and synced.
-            if (m_activeTool != -1) {
-                sendProximityOut(err);
+    struct Debounce {
+        static bool apply(VirtualStylus &s, PenFrame &f) {
+            if (!f.position) {
+                s.m_debouncer.reset();
+                return true;
             }
+            f.touching = s.m_debouncer.update(f.touching, f.event->pressure, f.timestampUs);
+            f.tap      = s.m_debouncer.tapped();
+            return true;
+        }
+    };
 
-            // Phase 2: Assert the new tool bit in its own sync report.
-            sendProximityIn(targetTool, err);
-
-            m_activeTool = targetTool;
-
-            // If the swap happened mid-stroke (nib was touching), the kernel
-            // now has the new tool in range but no active touch. We must send
-            // an explicit BTN_TOUCH=1 + minimal pressure in a dedicated sync
-            // before Phase 3, otherwise the kernel receives pressure > 0
-            // without a prior touch-down and silently discards the stroke.
-            if (isTouching) {
-                send_uinput_event(fd, ET_KEY,      EC_KEY_TOUCH,         1, err);
-                send_uinput_event(fd, ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, 1, err);
-                send_uinput_event(fd, ET_SYNC,     EC_SYNC_REPORT,       0, err);
-                // The real pressure value is sent in section 4 and committed
-                // by the final sync at the bottom of this function.
+    // -----------------------------------------------------------------------
+    // FILTER: while the seat is overloaded, hold back hover-moves that
+    // arrive faster than PACE_HOVER_US. Only frames that would carry nothing
+    // but new axis values qualify: contact, tool changes, barrel key changes
+    // and proximity-outs always go through. The newest held-back frame is
+    // kept and injected later by flushPaced(), unless a newer hover-move
+    // supersedes it first, so the cursor never rests on a stale position.
+    // -----------------------------------------------------------------------
+    struct Pace {
+        static bool apply(VirtualStylus &s, PenFrame &f) {
+            if (!f.position) return true;
+            if (f.touching) {
+                // Clearing the clock also lets the next non-contact frame
+                // (the ACTION_UP that lifts the pen) through unconditionally.
+                s.m_lastPacedUs = 0;
+                return true;
+            }
+            const ToolFsm::State tool = f.eraser ? ToolFsm::Eraser : ToolFsm::Pen;
+            // Arrival time, not the tablet's: a burst is what hurts the seat.
+            const uint64_t now = static_cast<uint64_t>(nowNs() / 1000);
+            // Whatever was held back is older than this frame either way.
+            if (s.m_pacedPending) s.m_coalesced.fetch_add(1, std::memory_order_relaxed);
+            if (tool == s.m_toolState && f.buttonCode == s.m_buttonCode
+                && now - s.m_lastPacedUs < PACE_HOVER_US) {
+                s.m_pacedEvent       = *f.event;
+                s.m_pacedTimestampUs = f.timestampUs;
+                s.m_pacedPending     = true;
+                return false;
             }
+            s.m_pacedPending = false;
+            s.m_lastPacedUs  = now;
+            return true;
         }
+    };
 
-        isPenActive = true;
+    // -----------------------------------------------------------------------
+    // MAP: tablet coordinates to the absolute axis range
+    // -----------------------------------------------------------------------
 
-        // -------------------------------------------------------------------
-        // 3. COORDINATE LOGIC (UNMODIFIED)
-        // -------------------------------------------------------------------
-        int32_t finalX = 0;
-        int32_t finalY = 0;
-        if (!targetScreenGeometry.isEmpty() && inputWidth > 0 && inputHeight > 0) {
+    // Onto the selected monitor of the whole desktop; 'Swapped' is the
+    // "Fix Rotation" setting.
+    template <bool Swapped>
+    struct MapToScreen {
+        static bool apply(VirtualStylus &s, PenFrame &f) {
+            if (!f.position) return true;
+            const AccessoryEventData *e = f.event;
+            const QRect &screen  = s.targetScreenGeometry;
+            const QRect &desktop = s.totalDesktopGeometry;
             double calcX, calcY;
             double maxInputX, maxInputY;
-            if (this->swapAxis) {
-                calcX     = accessoryEventData->y;
-                calcY     = inputWidth - accessoryEventData->x;
-                maxInputX = inputHeight;
-                maxInputY = inputWidth;
+            if constexpr (Swapped) {
+                calcX     = e->y;
+                calcY     = s.inputWidth - e->x;
+                maxInputX = s.inputHeight;
+                maxInputY = s.inputWidth;
             } else {
-                calcX     = accessoryEventData->x;
-                calcY     = accessoryEventData->y;
-                maxInputX = inputWidth;
-                maxInputY = inputHeight;
+                calcX     = e->x;
+                calcY     = e->y;
+                maxInputX = s.inputWidth;
+                maxInputY = s.inputHeight;
             }
             double xPercent      = calcX / maxInputX;
             double yPercent      = calcY / maxInputY;
-            double monitorPixelX = targetScreenGeometry.x() + (xPercent * targetScreenGeometry.width());
-            double monitorPixelY = targetScreenGeometry.y() + (yPercent * targetScreenGeometry.height());
-            if (monitorPixelX < targetScreenGeometry.left())   monitorPixelX = targetScreenGeometry.left();
-            if (monitorPixelX > targetScreenGeometry.right())  monitorPixelX = targetScreenGeometry.right();
-            if (monitorPixelY < targetScreenGeometry.top())    monitorPixelY = targetScreenGeometry.top();
-            if (monitorPixelY > targetScreenGeometry.bottom()) monitorPixelY = targetScreenGeometry.bottom();
-            double totalWidth  = totalDesktopGeometry.width();
-            double totalHeight = totalDesktopGeometry.height();
-            double globalX = monitorPixelX - totalDesktopGeometry.x();
-            double globalY = monitorPixelY - totalDesktopGeometry.y();
-            finalX = (int32_t)((globalX / totalWidth)  * ABS_MAX_VAL);
-            finalY = (int32_t)((globalY / totalHeight) * ABS_MAX_VAL);
-        } else {
-            if(displayScreenTranslator->displayStyle == DisplayStyle::stretched){
-                finalX = displayScreenTranslator->getAbsXStretched(accessoryEventData);
-                finalY = displayScreenTranslator->getAbsYStretched(accessoryEventData);
+            double monitorPixelX = screen.x() + (xPercent * screen.width());
+            double monitorPixelY = screen.y() + (yPercent * screen.height());
+            if (monitorPixelX < screen.left())   monitorPixelX = screen.left();
+            if (monitorPixelX > screen.right())  monitorPixelX = screen.right();
+            if (monitorPixelY < screen.top())    monitorPixelY = screen.top();
+            if (monitorPixelY > screen.bottom()) monitorPixelY = screen.bottom();
+            double totalWidth  = desktop.width();
+            double totalHeight = desktop.height();
+            double globalX = monitorPixelX - desktop.x();
+            double globalY = monitorPixelY - desktop.y();
+            f.x = (int32_t)((globalX / totalWidth)  * ABS_MAX_VAL);
+            f.y = (int32_t)((globalY / totalHeight) * ABS_MAX_VAL);
+            return true;
+        }
+    };
+
+    // No monitor selected yet: DisplayScreenTranslator's primary-screen mapping.
+    struct MapTranslator {
+        static bool apply(VirtualStylus &s, PenFrame &f) {
+            if (!f.position) return true;
+            DisplayScreenTranslator *t = s.displayScreenTranslator;
+            if (t->displayStyle == DisplayStyle::stretched) {
+                f.x = t->getAbsXStretched(f.event);
+                f.y = t->getAbsYStretched(f.event);
             } else {
-                finalX = displayScreenTranslator->getAbsXFixed(accessoryEventData);
-                finalY = displayScreenTranslator->getAbsYFixed(accessoryEventData);
+                f.x = t->getAbsXFixed(f.event);
+                f.y = t->getAbsYFixed(f.event);
             }
+            return true;
         }
+    };
 
-        // -------------------------------------------------------------------
-        // 4. SEND POSITION AND PRESSURE (Phase 3 data — committed by final sync)
-        // -------------------------------------------------------------------
-        send_uinput_event(fd, ET_ABSOLUTE, EC_ABSOLUTE_X, finalX, err);
-        send_uinput_event(fd, ET_ABSOLUTE, EC_ABSOLUTE_Y, finalY, err);
+    // -----------------------------------------------------------------------
+    // PRESSURE
+    // -----------------------------------------------------------------------
 
-        if (isTouching) {
-            int p = pressureTranslator->getResultingPressure(accessoryEventData);
-            send_uinput_event(fd, ET_KEY,      EC_KEY_TOUCH,         1, err);
-            send_uinput_event(fd, ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, p, err);
-        } else {
-            send_uinput_event(fd, ET_KEY,      EC_KEY_TOUCH,         0, err);
-            send_uinput_event(fd, ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, 0, err);
+    // The user's sensitivity curve and threshold.
+    struct PressureCurve {
+        static bool apply(VirtualStylus &s, PenFrame &f) {
+            f.pressure = f.touching ? s.pressureTranslator->getResultingPressure(f.event) : 0;
+            return true;
         }
+    };
 
-        send_uinput_event(fd, ET_ABSOLUTE, ABS_TILT_X, accessoryEventData->tiltX, err);
-        send_uinput_event(fd, ET_ABSOLUTE, ABS_TILT_Y, accessoryEventData->tiltY, err);
-
-    } else {
-        // -------------------------------------------------------------------
-        // 5. EXIT LOGIC
-        //
-        // Use the shared proximity-out helper for the same clean sequence
-        // the kernel expects — identical to Phase 1 of a tool swap.
-        // -------------------------------------------------------------------
-        if (m_activeTool != -1) {
-            sendProximityOut(err);
+    // Default settings, where the curve is the identity: skips the pow().
+    struct PressureLinear {
+        static bool apply(VirtualStylus &s, PenFrame &f) {
+            f.pressure = f.touching ? s.pressureTranslator->getLinearPressure(f.event) : 0;
+            return true;
         }
+    };
 
-        isPenActive  = false;
-        m_activeTool = -1;
+    // -----------------------------------------------------------------------
+    // EMIT: tool state machine, axes, barrel key, one flush
+    // -----------------------------------------------------------------------
+    struct Emit {
+        static bool apply(VirtualStylus &s, PenFrame &f) {
+            if (f.position) {
+                // Three-phase tool swap. The kernel's evdev/libinput layer
+                // requires tool bit transitions to be isolated in their own
+                // sync reports. Merging them with position or pressure
+                // data — or with each other — causes SYN_DROPPED, which
+                // stalls ALL input devices on the seat (explaining the
+                // mouse freeze).
+                //
+                // ToolFsm holds the precomposed sequence for every (tool,
+                // input) pair: nothing for the same tool; otherwise
+                // proximity-out (if a tool was in range), proximity-in, and
+                // touch-arm when the swap happens mid-stroke. Covers first
+                // entry, hover swap, touch swap and re-entry after a
+                // watchdog reset. Phase 3 is the data below.
+                s.applyTransition(ToolFsm::positionInput(f.eraser, f.touching));
+
+                // Position and pressure (Phase 3 data — committed by the
+                // final sync).
+                s.m_writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_X, f.x);
+                s.m_writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_Y, f.y);
+                // A debounced contact can sit below the minimum pressure;
+                // keep the pressure axis off 0 while it lasts, as the
+                // touch-arm does, so BTN_TOUCH and pressure agree.
+                s.m_writer.queue(ET_KEY,      EC_KEY_TOUCH,         f.touching ? 1 : 0);
+                s.m_writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, f.touching ? std::max(f.pressure, 1) : 0);
+                s.m_writer.queue(ET_ABSOLUTE, ABS_TILT_X, f.event->tiltX);
+                s.m_writer.queue(ET_ABSOLUTE, ABS_TILT_Y, f.event->tiltY);
+
+                // Barrel key: only transitions are queued, so a held button
+                // costs nothing per frame.
+                if (f.buttonCode != s.m_buttonCode) {
+                    if (s.m_buttonCode != 0) s.m_writer.queue(ET_KEY, s.m_buttonCode, 0);
+                    if (f.buttonCode   != 0) s.m_writer.queue(ET_KEY, f.buttonCode,   1);
+                    s.m_buttonCode = f.buttonCode;
+                }
+            } else {
+                // Exit: the table's Exit entry, the same proximity-out as
+                // Phase 1 of a tool swap, or nothing if no tool was in
+                // range. It commits its own sync; the final one below then
+                // fires with no pending events, which the kernel treats as
+                // a harmless no-op.
+                s.applyTransition(ToolFsm::Exit);
+            }
 
-        // sendProximityOut already committed a sync. The unconditional sync
-        // at the bottom will fire with no pending events — the kernel treats
-        // an empty sync as a harmless no-op, so no SYN_DROPPED risk here.
+            // Final sync. For position events it is Phase 3; for a tool
+            // swap the third and final phase; for normal frames the only
+            // sync. The timestamp is included here rather than in each
+            // sub-sync so that only the frame-completing report carries
+            // timing data. Everything above was only queued: the whole
+            // frame, intermediate syncs included, reaches the kernel in
+            // this one flush.
+            Error err{};
+            s.m_writer.queue(ET_MSC,  EC_MSC_TIMESTAMP, static_cast<int32_t>(static_cast<uint32_t>(f.timestampUs)));
+            s.m_writer.queue(ET_SYNC, EC_SYNC_REPORT,   0);
+            // A tap the debouncer passed on at its lift: the contact above,
+            // then the lift in its own report, in the same write.
+            if (f.tap) {
+                s.m_writer.queue(ET_KEY,      EC_KEY_TOUCH,         0);
+                s.m_writer.queue(ET_ABSOLUTE, EC_ABSOLUTE_PRESSURE, 0);
+                s.m_writer.queue(ET_SYNC,     EC_SYNC_REPORT,       0);
+            }
+            s.m_writer.flush(&err);
+            f.injected = true;
+            return true;
+        }
+    };
+
+    // Index bits: 0 debounce, 1 paced, 2 linear pressure; above them the
+    // map (0 screen, 1 screen swapped, 2 translator).
+    template <int I>
+    using Map = std::conditional_t<(I >> 3) == 0, MapToScreen<false>,
+                std::conditional_t<(I >> 3) == 1, MapToScreen<true>, MapTranslator>>;
+    template <int I>
+    using Chain = StylusPipeline<Decode,
+                                 Optional<(I & 1) != 0, Debounce>,
+                                 Optional<(I & 2) != 0, Pace>,
+                                 Map<I>,
+                                 std::conditional_t<(I & 4) != 0, PressureLinear, PressureCurve>,
+                                 Emit>;
+
+    static constexpr int COUNT = 3 * 8;
+    template <int... I>
+    static constexpr std::array<Pipeline, COUNT> table(std::integer_sequence<int, I...>) {
+        return {{ &Chain<I>::template run<VirtualStylus>... }};
     }
+};
 
-    // -----------------------------------------------------------------------
-    // 6. FINAL SYNC
-    //
-    // For position events: this is Phase 3 — commits position and pressure.
-    // For exit events: this is an empty no-op sync after the proximity-out
-    //   that sendProximityOut already committed. Harmless.
-    // For tool-swap frames: this is the third and final phase.
-    // For normal frames (no swap): this is the only sync in the function.
-    //
-    // The timestamp is included here rather than in each sub-sync so that
-    // only the frame-completing report carries timing data.
-    // -----------------------------------------------------------------------
-    send_uinput_event(fd, ET_MSC,  EC_MSC_TIMESTAMP, epoch, err);
-    send_uinput_event(fd, ET_SYNC, EC_SYNC_REPORT,   0,     err);
+// ---------------------------------------------------------------------------
+// Pipeline selection
+//
+// The fixed set of instantiations, one per combination of map, pressure,
+// pacing and debounce (Stages::Chain). Called whenever a setting they depend
+// on changes, with m_mutex held, so the data path only ever makes one
+// indirect call per sample.
+// ---------------------------------------------------------------------------
+void VirtualStylus::selectPipeline() {
+    static constexpr auto PIPELINES = Stages::table(std::make_integer_sequence<int, Stages::COUNT>{});
+    const bool screen = !targetScreenGeometry.isEmpty() && inputWidth > 0 && inputHeight > 0;
+    const int  map    = screen ? (m_swapAxis ? 1 : 0) : 2;
+    m_pipeline = PIPELINES[map << 3
+                           | (pressureTranslator->isLinear() ? 4 : 0)
+                           | (m_paced ? 2 : 0)
+                           | (m_touchDebounce ? 1 : 0)];
+
+    // The release threshold follows the user's minimum pressure.
+    m_debouncer.setThreshold(pressureTranslator->minPressure / 100.0f);
+}
 
-    delete err;
+void VirtualStylus::setPressureCurve(int sensitivity, int minPressure) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    pressureTranslator->sensitivity = sensitivity;
+    pressureTranslator->minPressure = minPressure;
+    selectPipeline();
+}
+
+int VirtualStylus::pressureSensitivity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return pressureTranslator->sensitivity;
+}
+
+int VirtualStylus::minPressure() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return pressureTranslator->minPressure;
+}
+
+// ---------------------------------------------------------------------------
+// Adaptive watchdog
+//
+// The timeout is one of two learned bounds (mean + 4 * deviation), picked
+// by state:
+//   - streaming (a tool in range and the last traffic was a sample): the
+//     gap between samples, so a link that dies mid-stroke releases
+//     BTN_TOUCH within about WATCHDOG_MIN_TIMEOUT_MS;
+//   - idle (the last traffic was a heartbeat): the gap between liveness
+//     signals. Android only sends heartbeats every 100 ms (WiFi/BT) to
+//     500 ms (USB) when idle, so a fixed 150 ms timeout used to lift a
+//     resting pen over and over.
+// ---------------------------------------------------------------------------
+void VirtualStylus::noteHeartbeat() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int64_t now = nowNs();
+
+    int64_t since = std::max(m_lastSampleTime, m_lastHeartbeatTime);
+    if (since > 0) {
+        int64_t gap = elapsedMs(since, now);
+        if (gap <= WATCHDOG_MAX_TIMEOUT_MS) m_heartbeatGap.add(static_cast<double>(gap));
+    }
+    m_lastHeartbeatTime = now;
+    m_lastEventTime     = now;
+    noteTrafficAfterLift(now);
+    updateTimeout();
+}
+
+void VirtualStylus::setHeartbeatInterval(int ms) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Seed with a modest deviation; real heartbeats take over quickly.
+    m_heartbeatGap.mean   = ms;
+    m_heartbeatGap.dev    = ms / 8.0;
+    m_heartbeatGap.primed = true;
+    updateTimeout();
+}
+
+void VirtualStylus::setSampleInterval(double ms) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sampleGap.mean   = ms;
+    m_sampleGap.dev    = ms / 8.0;
+    m_sampleGap.primed = true;
+    updateTimeout();
+}
+
+void VirtualStylus::applyTabletHello(const TabletHello &hello) {
+    if (hello.sampleRateHz > 0) setSampleInterval(1000.0 / hello.sampleRateHz);
+    if ((hello.features & FEATURE_HEARTBEAT) && hello.heartbeatMs > 0) {
+        setHeartbeatInterval(hello.heartbeatMs);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (hello.surfaceWidth > 0 && hello.surfaceHeight > 0) {
+        inputWidth  = hello.surfaceWidth;
+        inputHeight = hello.surfaceHeight;
+    }
+    m_hello     = hello;
+    m_haveHello = true;
+    selectPipeline();
+}
+
+void VirtualStylus::setButtonMapping(ButtonMapping mapping) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // A key held under the old mapping is released by the next frame, which
+    // compares against m_buttonCode rather than the mapping.
+    m_buttonMapping = mapping;
+}
+
+ButtonMapping VirtualStylus::buttonMapping() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_buttonMapping;
+}
+
+bool VirtualStylus::tabletHello(TabletHello &hello) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    hello = m_hello;
+    return m_haveHello;
+}
+
+void VirtualStylus::updateTimeout() {
+    // The heartbeat bound must never cover a live stroke: on USB it is
+    // around 750 ms, five times the old fixed timeout.
+    const bool streaming = m_toolState != ToolFsm::Out && m_lastSampleTime > m_lastHeartbeatTime;
+    const CadenceEstimator &gap = streaming ? m_sampleGap : m_heartbeatGap;
+    double bound = gap.primed ? gap.bound() : 0.0;
+    int64_t timeout = static_cast<int64_t>(std::ceil(bound));
+    if (timeout < WATCHDOG_MIN_TIMEOUT_MS) timeout = WATCHDOG_MIN_TIMEOUT_MS;
+    if (timeout > WATCHDOG_MAX_TIMEOUT_MS) timeout = WATCHDOG_MAX_TIMEOUT_MS;
+    m_timeoutMs = timeout;
+}
+
+void VirtualStylus::noteTrafficAfterLift(int64_t now) {
+    if (m_lastLiftTime == 0) return;
+    if (elapsedMs(m_lastLiftTime, now) <= SPURIOUS_LIFT_WINDOW_MS) m_spuriousLifts++;
+    m_lastLiftTime = 0;
+}
+
+VirtualStylus::WatchdogStats VirtualStylus::watchdogStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    WatchdogStats stats;
+    stats.lifts          = m_lifts;
+    stats.spuriousLifts  = m_spuriousLifts;
+    stats.hours          = elapsedMs(m_createdAt, nowNs()) / 3600000.0;
+    stats.timeoutMs      = static_cast<int>(m_timeoutMs.load());
+    stats.sampleGapMs    = m_sampleGap.mean;
+    stats.heartbeatGapMs = m_heartbeatGap.mean;
+    return stats;
 }
 
 void VirtualStylus::displayEventDebugInfo(AccessoryEventData * accessoryEventData){
@@ -314,21 +632,208 @@ void VirtualStylus::displayEventDebugInfo(AccessoryEventData * accessoryEventDat
 }
 
 void VirtualStylus::destroyStylus(){
+    std::unique_ptr<SynDropMonitor> monitor;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        monitor = takeSynDropMonitor();
+    }
+    monitor.reset();
+
     std::lock_guard<std::mutex> lock(m_mutex);
     if(fd >= 0) {
-        // cleanup logic
+        // Leave the kernel with no tool in range so the compositor does not
+        // keep a stuck stroke for a device that is about to disappear.
+        if (m_toolState != ToolFsm::Out) {
+            Error * err = new Error();
+            applyTransition(ToolFsm::Exit);
+            m_writer.flush(err);
+            delete err;
+        }
+
+        m_stream.reset();
+        m_writer.detach();
+        destroy_uinput_device(fd);
+        fd = -1;
     }
 }
 
 void VirtualStylus::setTargetScreen(QRect geometry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
     this->targetScreenGeometry = geometry;
+    selectPipeline();
 }
 
 void VirtualStylus::setTotalDesktopGeometry(QRect geometry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
     this->totalDesktopGeometry = geometry;
 }
 
 void VirtualStylus::setInputResolution(int width, int height) {
+    std::lock_guard<std::mutex> lock(m_mutex);
     this->inputWidth  = width;
     this->inputHeight = height;
-}
\ No newline at end of file
+    selectPipeline();
+}
+
+void VirtualStylus::setSwapAxis(bool swap) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_swapAxis = swap;
+    selectPipeline();
+}
+
+bool VirtualStylus::swapAxis() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_swapAxis;
+}
+
+void VirtualStylus::setTouchDebounce(bool enable) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_touchDebounce = enable;
+    m_debouncer.reset();
+    selectPipeline();
+}
+
+bool VirtualStylus::touchDebounce() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_touchDebounce;
+}
+
+// ---------------------------------------------------------------------------
+// Seat protection
+//
+// SYN_DROPPED means a reader of our device lost events and has to resync;
+// for libinput that stalls the whole seat. The canary (SynDropMonitor) sees
+// the same overflow the compositor does, so its first SYN_DROPPED switches
+// the pipeline to the paced variant until the seat stays quiet.
+// ---------------------------------------------------------------------------
+void VirtualStylus::startSynDropMonitor() {
+    if (m_synDropMonitor || fd < 0) return;
+    auto monitor = std::make_unique<SynDropMonitor>([this]() { onSynDropped(); });
+    if (monitor->start(fd)) m_synDropMonitor = std::move(monitor);
+}
+
+std::unique_ptr<SynDropMonitor> VirtualStylus::takeSynDropMonitor() {
+    return std::move(m_synDropMonitor);
+}
+
+void VirtualStylus::onSynDropped() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastDropTime = nowNs();
+    m_synDrops++;
+    if (!m_paced) {
+        qDebug() << "[SynDrop] SYN_DROPPED on the stylus device, pacing hover output";
+        m_paced = true;
+        m_lastPacedUs = 0;
+        selectPipeline();
+    }
+}
+
+void VirtualStylus::flushPaced() {
+    if (!m_pacedPending) return;
+    m_pacedPending = false;
+    m_lastPacedUs  = 0;   // so Pace lets it through now
+
+    // Already published to the shared stream when it was held back.
+    PenFrame frame;
+    frame.event       = &m_pacedEvent;
+    frame.timestampUs = m_pacedTimestampUs;
+    m_pipeline(*this, frame);
+}
+
+void VirtualStylus::setSynDropGuard(bool enable) {
+    std::unique_ptr<SynDropMonitor> monitor;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_synDropGuard = enable;
+        if (enable) {
+            startSynDropMonitor();
+        } else {
+            monitor = takeSynDropMonitor();
+            if (m_paced) {
+                flushPaced();
+                m_paced = false;
+                selectPipeline();
+            }
+        }
+    }
+    // Stopped outside the lock: its callback may be waiting for m_mutex.
+    monitor.reset();
+}
+
+bool VirtualStylus::synDropGuard() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_synDropGuard;
+}
+
+VirtualStylus::SynDropStats VirtualStylus::synDropStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SynDropStats stats;
+    stats.enabled   = m_synDropGuard;
+    stats.incidents = m_synDrops;
+    stats.paced     = m_paced;
+    stats.coalesced = m_coalesced.load(std::memory_order_relaxed);
+    if (m_synDropMonitor) {
+        stats.node      = m_synDropMonitor->node();
+        stats.events    = m_synDropMonitor->events();
+    }
+    if (m_lastDropTime) stats.sinceDropS = elapsedMs(m_lastDropTime, nowNs()) / 1000.0;
+    return stats;
+}
+
+// ---------------------------------------------------------------------------
+// Shared-memory stream (see stylusstream.h for the layout)
+// ---------------------------------------------------------------------------
+void VirtualStylus::openStream() {
+    if (m_stream || fd < 0) return;
+    auto stream = std::make_unique<StylusStream>();
+    if (stream->open("/inkbridge-" + m_deviceName)) m_stream = std::move(stream);
+}
+
+void VirtualStylus::publishSample(const PenFrame &frame, int64_t now) {
+    const AccessoryEventData *e = frame.event;
+    StylusStreamSample sample{};
+    sample.timeUs      = frame.timestampUs;
+    sample.arrivalUs   = static_cast<uint64_t>(now / 1000);
+    sample.rawX        = e->x;
+    sample.rawY        = e->y;
+    sample.rawPressure = e->pressure;
+    sample.tiltX       = static_cast<int16_t>(e->tiltX);
+    sample.tiltY       = static_cast<int16_t>(e->tiltY);
+    sample.action      = static_cast<int16_t>(e->action);
+    sample.toolType    = static_cast<int16_t>(e->toolType);
+    sample.absX        = frame.x;
+    sample.absY        = frame.y;
+    sample.absPressure = frame.pressure;
+    sample.flags = (frame.touching   ? STREAM_TOUCHING    : 0)
+                 | (frame.eraser     ? STREAM_ERASER      : 0)
+                 | ((e->action & 32) ? STREAM_BUTTON      : 0)
+                 | (frame.position   ? STREAM_IN_RANGE    : 0)
+                 | (frame.injected   ? STREAM_INJECTED    : 0)
+                 | (e->hostTimeUs    ? STREAM_DEVICE_TIME : 0);
+    m_stream->publish(sample);
+}
+
+void VirtualStylus::setSharedStream(bool enable) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sharedStream = enable;
+    if (enable) openStream();
+    else        m_stream.reset();
+}
+
+bool VirtualStylus::sharedStream() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sharedStream;
+}
+
+VirtualStylus::StreamStats VirtualStylus::streamStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    StreamStats stats;
+    if (m_stream) {
+        stats.name      = m_stream->name();
+        stats.readers   = m_stream->readers();
+        stats.published = m_stream->published();
+        stats.skipped   = m_stream->skipped();
+        stats.wakes     = m_stream->wakes();
+    }
+    return stats;
+}
@@ -6,11 +6,28 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <string>
+#include <memory>
+#include <cmath>
 #include "accessory.h"
 #include "displayscreentranslator.h"
 #include "pressuretranslator.h"
+#include "uinputwriter.h"
+#include "protocol.h"
+#include "toolfsm.h"
+#include "pipeline.h"
+#include "touchdebouncer.h"
 
-class Error; // Forward declaration — full type only needed in .cpp
+class SynDropMonitor;
+class StylusStream;
+
+// What the pen's barrel button (action bit 32) is reported as. The values
+// are the indices of the settings combo box.
+enum class ButtonMapping {
+    Stylus  = 0, // BTN_STYLUS within the normal frame (default)
+    Stylus2 = 1, // BTN_STYLUS2 within the normal frame
+    Eraser  = 2  // opt-in: swap to the eraser tool while held
+};
 
 // We inherit from QObject for parent-child memory management,
 // but we now use std::thread for the watchdog to avoid QTimer threading issues.
@@ -26,49 +43,182 @@ public:
     ~VirtualStylus();
 
     void handleAccessoryEventData(AccessoryEventData * accessoryEventData);
-    void initializeStylus();
+    // A heartbeat proves the link is alive: it feeds the watchdog but is
+    // never injected.
+    void noteHeartbeat();
+    // Prior for the idle cadence until real heartbeats have been observed.
+    void setHeartbeatInterval(int ms);
+    // Prior for the streaming cadence until real samples have been observed.
+    void setSampleInterval(double ms);
+    // Takes the tablet's declared rate, heartbeat period and coordinate
+    // range from its hello instead of guessing them.
+    void applyTabletHello(const TabletHello &hello);
+    // False until the tablet sent a hello (legacy tablets never do).
+    bool tabletHello(TabletHello &hello) const;
+
+    struct WatchdogStats {
+        uint64_t lifts = 0;          // watchdog-forced proximity-outs
+        uint64_t spuriousLifts = 0;  // ...followed by traffic within 1 s
+        double   hours = 0.0;        // since this stylus was created
+        int      timeoutMs = 0;      // current adaptive timeout
+        double   sampleGapMs = 0.0;  // EWMA of inter-sample gaps
+        double   heartbeatGapMs = 0.0;
+    };
+    WatchdogStats watchdogStats() const;
+    // Creates the uinput device. Every session passes its own name so that
+    // several tablets show up as separate devices.
+    void initializeStylus(const std::string& deviceName = "pen-emu");
     void destroyStylus();
 
     // --- GEOMETRY SETTERS ---
     void setTargetScreen(QRect geometry);
     void setTotalDesktopGeometry(QRect geometry);
     void setInputResolution(int width, int height);
+    void setSwapAxis(bool swap);
+    bool swapAxis() const;
+    // The pressure curve lives in the PressureTranslator but is read by the
+    // pipeline on the ingest thread, so it is only written through here.
+    void setPressureCurve(int sensitivity, int minPressure);
+    int  pressureSensitivity() const;
+    int  minPressure() const;
+    // Desktop-side contact decision with hysteresis (TouchDebouncer).
+    void setTouchDebounce(bool enable);
+    bool touchDebounce() const;
+    const TouchDebouncer &touchDebouncer() const { return m_debouncer; }
+
+    // Seat protection: watch our evdev node for SYN_DROPPED and pace hover
+    // output while the seat is overloaded (SynDropMonitor). Off by default.
+    void setSynDropGuard(bool enable);
+    bool synDropGuard() const;
+    struct SynDropStats {
+        bool        enabled = false;
+        std::string node;             // empty until the monitor resolved it
+        uint64_t    incidents = 0;    // SYN_DROPPED seen by the canary
+        uint64_t    events = 0;       // events the canary read
+        bool        paced = false;    // hover coalescing currently on
+        uint64_t    coalesced = 0;    // hover-moves superseded by a later one
+        double      sinceDropS = 0.0; // since the last incident, 0 = none
+    };
+    SynDropStats synDropStats() const;
+
+    // Publishes every sample to /dev/shm/inkbridge-<device name> for local
+    // consumers (StylusStream). Off by default.
+    void setSharedStream(bool enable);
+    bool sharedStream() const;
+    struct StreamStats {
+        std::string name;             // empty when off
+        uint32_t    readers = 0;
+        uint64_t    published = 0;
+        uint64_t    skipped = 0;      // no reader attached
+        uint64_t    wakes = 0;
+    };
+    StreamStats streamStats() const;
 
-    bool swapAxis = false;
+    void setButtonMapping(ButtonMapping mapping);
+    ButtonMapping buttonMapping() const;
 
 private:
-    int fd;
+    int fd = -1;
+    UinputWriter m_writer; // One write per frame; protected by m_mutex
 
     // --- THREADING & WATCHDOG ---
     // We use a mutex to ensure the 'Watchdog Thread' and 'USB Thread'
     // don't try to write to the file descriptor (fd) at the exact same time.
-    std::mutex            m_mutex;
+    mutable std::mutex    m_mutex;
     std::thread           m_watchdogThread;
     std::atomic<bool>     m_watchdogRunning;
     std::atomic<int64_t>  m_lastEventTime; // Stores time in nanoseconds
 
-    bool isPenActive = false; // Protected by m_mutex
-    int  m_activeTool = -1;   // -1 = None, 1 = Pen, 2 = Eraser; protected by m_mutex
+    // --- ADAPTIVE TIMEOUT ---
+    // RFC 6298-style smoothed mean and mean deviation of an interval, in ms.
+    struct CadenceEstimator {
+        double mean = 0.0;
+        double dev  = 0.0;
+        bool   primed = false;
+        void add(double ms) {
+            if (!primed) { mean = ms; dev = ms / 2; primed = true; return; }
+            dev  += (std::abs(ms - mean) - dev) / 4;
+            mean += (ms - mean) / 8;
+        }
+        double bound() const { return mean + 4 * dev; }
+    };
+    // All protected by m_mutex, except m_timeoutMs which the watchdog reads
+    // without it.
+    CadenceEstimator m_sampleGap;    // between pen samples while streaming
+    CadenceEstimator m_heartbeatGap; // between liveness signals when idle
+    int64_t m_lastSampleTime    = 0;
+    int64_t m_lastHeartbeatTime = 0;
+    int64_t m_lastLiftTime      = 0; // last watchdog lift, 0 once resolved
+    std::atomic<int64_t>  m_timeoutMs{150};
+    std::atomic<uint64_t> m_lifts{0};
+    std::atomic<uint64_t> m_spuriousLifts{0};
+    const int64_t m_createdAt;
+
+    void updateTimeout();           // m_mutex held
+    void noteTrafficAfterLift(int64_t now); // m_mutex held
+    ToolFsm::State m_toolState = ToolFsm::Out; // tool the kernel has in range; protected by m_mutex
+    ButtonMapping m_buttonMapping = ButtonMapping::Stylus; // protected by m_mutex
+    int  m_buttonCode = 0;    // barrel key the kernel has down, 0 = none; protected by m_mutex
 
     void watchdogLoop();         // Background loop checking for timeouts
     void performWatchdogReset(); // Logic to force-lift the pen on timeout
 
-    // --- TOOL SWAP HELPERS ---
-    // These implement the kernel-mandated three-phase proximity protocol.
-    // Must be called with m_mutex already held.
-    void sendProximityOut(Error* err); // Phase 1: de-assert old tool, sync
-    void sendProximityIn(int tool, Error* err); // Phase 2: assert new tool, sync
+    // --- TOOL STATE MACHINE ---
+    // Queues the ToolFsm transition for 'input' (plus the release of a held
+    // barrel key when it leaves proximity) and moves m_toolState on.
+    // m_mutex must be held; the caller flushes m_writer.
+    void applyTransition(ToolFsm::Input input);
 
     DisplayScreenTranslator * displayScreenTranslator;
-    PressureTranslator      * pressureTranslator;
+    PressureTranslator      * pressureTranslator; // fields protected by m_mutex
 
     void displayEventDebugInfo(AccessoryEventData * accessoryEventData);
 
+    // --- SAMPLE PIPELINE ---
+    // decode -> filter -> map -> pressure -> emit, composed at compile time
+    // (see pipeline.h). The stages live in virtualstylus.cpp.
+    struct Stages;
+    using Pipeline = void (*)(VirtualStylus &, PenFrame &);
+    Pipeline m_pipeline = nullptr; // protected by m_mutex
+    void selectPipeline();         // m_mutex held
+    TouchDebouncer m_debouncer;    // protected by m_mutex
+    bool     m_touchDebounce = true;
+
+    // --- SEAT PROTECTION ---
+    // The monitor is only created, started and stopped by the thread that
+    // holds the settings (never from its own callback), and stopped without
+    // m_mutex held, since its callback takes m_mutex.
+    std::unique_ptr<SynDropMonitor> m_synDropMonitor; // protected by m_mutex
+    bool     m_synDropGuard = false;
+    bool     m_paced        = false;  // Pace stage in the pipeline
+    int64_t  m_lastDropTime = 0;      // ns, 0 = never
+    uint64_t m_synDrops     = 0;      // incidents over the stylus' lifetime
+    uint64_t m_lastPacedUs  = 0;      // last hover-move let through while paced
+    bool     m_pacedPending = false;  // m_pacedEvent held back, not yet superseded
+    AccessoryEventData m_pacedEvent{};
+    uint64_t m_pacedTimestampUs = 0;
+    std::atomic<uint64_t> m_coalesced{0};
+    void onSynDropped();              // monitor thread
+    void flushPaced();                // m_mutex held; injects the held-back hover-move
+    void startSynDropMonitor();       // m_mutex held
+    std::unique_ptr<SynDropMonitor> takeSynDropMonitor(); // m_mutex held; caller stops it unlocked
+
+    // --- SHARED-MEMORY STREAM ---
+    std::unique_ptr<StylusStream> m_stream; // protected by m_mutex
+    bool m_sharedStream = false;
+    std::string m_deviceName;
+    void openStream();                         // m_mutex held
+    void publishSample(const PenFrame &frame, int64_t now); // m_mutex held
+
     // --- VARIABLES ---
     QRect targetScreenGeometry;
     QRect totalDesktopGeometry;
     int   inputWidth  = 0;
     int   inputHeight = 0;
+    bool  m_swapAxis  = false;
+
+    TabletHello m_hello{};      // protected by m_mutex
+    bool        m_haveHello = false;
 };
 
 #endif // VIRTUALSTYLUS_H
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "wifidirectserver.h"
+#include "stylussession.h"
 #include <QDebug>
 #include <QNetworkDatagram>
 
@@ -17,6 +18,11 @@ WifiDirectServer::~WifiDirectServer() {
 // Public API
 // ---------------------------------------------------------------------------
 
+void WifiDirectServer::setSessionCallbacks(SessionFactory factory, SessionRelease release) {
+    m_sessionFactory = std::move(factory);
+    m_sessionRelease = std::move(release);
+}
+
 bool WifiDirectServer::startServer() {
     if (m_running) return true;
 
@@ -41,16 +47,9 @@ void WifiDirectServer::stopServer() {
     if (!m_running) return;
     m_running = false;
 
-    if (m_clientSocket) {
-        m_clientSocket->disconnectFromHost();
-        m_clientSocket->deleteLater();
-        m_clientSocket = nullptr;
-    }
-    if (m_tcpServer) {
-        m_tcpServer->close();
-        m_tcpServer->deleteLater();
-        m_tcpServer = nullptr;
-    }
+    // Joins the shard threads; every remaining client is released (and
+    // reported through clientDisconnected) on its way out.
+    m_reactor.reset();
     if (m_beaconSocket) {
         m_beaconSocket->close();
         m_beaconSocket->deleteLater();
@@ -60,10 +59,15 @@ void WifiDirectServer::stopServer() {
     qDebug() << "[P2P] Server stopped.";
 }
 
-bool WifiDirectServer::isRunning() const        { return m_running; }
-bool WifiDirectServer::isClientConnected() const {
-    return m_clientSocket &&
-           m_clientSocket->state() == QAbstractSocket::ConnectedState;
+bool WifiDirectServer::isRunning() const         { return m_running; }
+bool WifiDirectServer::isClientConnected() const { return clientCount() > 0; }
+int  WifiDirectServer::clientCount() const       { return m_reactor ? m_reactor->clientCount() : 0; }
+
+QString WifiDirectServer::latencyReport() const {
+    if (!m_reactor) return "WiFi Direct: not running.";
+    std::string report = m_reactor->latencyReport();
+    return report.empty() ? "WiFi Direct: no tablets connected."
+                          : QString::fromStdString(report).trimmed();
 }
 
 // ---------------------------------------------------------------------------
@@ -92,7 +96,7 @@ void WifiDirectServer::onBeaconReceived() {
         qDebug() << "[P2P] Beacon received. SSID:" << ssid;
 
         // Open TCP server immediately — it must be ready before Android scans
-        if (!m_tcpServer) {
+        if (!m_reactor) {
             if (!startTcpServer()) {
                 emit serverError("WiFi Direct: Could not open TCP data port.");
                 return;
@@ -122,51 +126,24 @@ void WifiDirectServer::onBeaconReceived() {
 // ---------------------------------------------------------------------------
 
 bool WifiDirectServer::startTcpServer() {
-    m_tcpServer = new QTcpServer(this);
-    if (!m_tcpServer->listen(QHostAddress::Any, DATA_PORT)) {
+    IngestReactor::Callbacks callbacks;
+    callbacks.onConnect = [this](int clientId, const std::string &peer) -> IngestSink * {
+        const QString ip = QString::fromStdString(peer);
+        StylusSession *session = m_sessionFactory ? m_sessionFactory(clientId, ip) : nullptr;
+        if (session) emit clientConnected(clientId, ip);
+        return session;
+    };
+    callbacks.onDisconnect = [this](int clientId, IngestSink *session) {
+        // Always one of ours: onConnect only hands out StylusSessions.
+        if (m_sessionRelease) m_sessionRelease(static_cast<StylusSession *>(session));
+        emit clientDisconnected(clientId);
+    };
+
+    m_reactor = std::make_unique<IngestReactor>(std::move(callbacks));
+    if (!m_reactor->start(DATA_PORT, 0, UDP_PORT)) {
         qCritical() << "[P2P] Failed to bind TCP port" << DATA_PORT;
-        m_tcpServer->deleteLater();
-        m_tcpServer = nullptr;
+        m_reactor.reset();
         return false;
     }
-    connect(m_tcpServer, &QTcpServer::newConnection,
-            this,        &WifiDirectServer::onNewTcpConnection);
-    qDebug() << "[P2P] TCP server listening on port" << DATA_PORT;
     return true;
 }
-
-void WifiDirectServer::onNewTcpConnection() {
-    if (!m_tcpServer) return;
-
-    if (m_clientSocket) {
-        QTcpSocket *rej = m_tcpServer->nextPendingConnection();
-        rej->disconnectFromHost();
-        rej->deleteLater();
-        return;
-    }
-
-    m_clientSocket = m_tcpServer->nextPendingConnection();
-    QString ip = m_clientSocket->peerAddress().toString();
-
-    connect(m_clientSocket, &QTcpSocket::readyRead,
-            this,           &WifiDirectServer::onTcpDataReady);
-    connect(m_clientSocket, &QTcpSocket::disconnected,
-            this,           &WifiDirectServer::onTcpClientDisconnected);
-
-    qDebug() << "[P2P] Tablet connected from" << ip;
-    emit clientConnected(ip);
-}
-
-void WifiDirectServer::onTcpDataReady() {
-    if (!m_clientSocket) return;
-    emit dataReceived(m_clientSocket->readAll());
-}
-
-void WifiDirectServer::onTcpClientDisconnected() {
-    qDebug() << "[P2P] Tablet disconnected.";
-    if (m_clientSocket) {
-        m_clientSocket->deleteLater();
-        m_clientSocket = nullptr;
-    }
-    emit clientDisconnected();
-}
\ No newline at end of file
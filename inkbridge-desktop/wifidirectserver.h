@@ -2,10 +2,13 @@
 #define WIFIDIRECTSERVER_H
 
 #include <QObject>
-#include <QTcpServer>
-#include <QTcpSocket>
 #include <QUdpSocket>
 #include <QTimer>
+#include <functional>
+#include <memory>
+#include "ingestreactor.h"
+
+class StylusSession;
 
 /**
  * WifiDirectServer — manual setup flow
@@ -15,11 +18,17 @@
  *   1. startServer() opens the UDP beacon listener on BEACON_PORT
  *   2. When Android's beacon arrives, credentials are extracted and
  *      emitted via credentialsReceived() for display in the UI
- *   3. The TCP server opens immediately so it's ready when the user
- *      manually connects the desktop WiFi and Android scans for it
+ *   3. The TCP ingest reactor opens immediately so it's ready when the
+ *      user manually connects the desktop WiFi and Android scans for it
  *   4. Android finds the TCP server at 192.168.49.x and connects
+ *   5. If the tablet's hello asks for it, the ack tells it which UDP port
+ *      (UDP_PORT + shard) to send its samples to, for lower latency
  *
- * Signals are identical to WifiServer so Backend wiring is unchanged.
+ * Only the beacon uses the Qt event loop. Tablet connections are served by
+ * an IngestReactor (epoll, one shard per core), which asks the session
+ * factory for a StylusSession per client and feeds it directly from the
+ * shard thread. clientConnected/clientDisconnected are informational and
+ * reach Qt-thread receivers queued.
  */
 class WifiDirectServer : public QObject
 {
@@ -29,19 +38,28 @@ public:
     explicit WifiDirectServer(QObject *parent = nullptr);
     ~WifiDirectServer();
 
+    // Called on reactor threads; must be thread-safe.
+    using SessionFactory = std::function<StylusSession *(int clientId, QString clientIp)>;
+    using SessionRelease = std::function<void(StylusSession *session)>;
+    void setSessionCallbacks(SessionFactory factory, SessionRelease release);
+
     bool startServer();
     void stopServer();
     bool isRunning() const;
     bool isClientConnected() const;
+    int  clientCount() const;
+    QString latencyReport() const;
 
     static constexpr quint16 DATA_PORT   = 4545;
     static constexpr quint16 BEACON_PORT = 4547;
+    // First of the reactor's per-shard UDP data ports (one per shard, up to
+    // IngestReactor::MAX_SHARDS), offered to tablets that agree to FEATURE_UDP.
+    static constexpr quint16 UDP_PORT    = 4550;
     static const     QString BEACON_PREFIX;
 
 signals:
-    void dataReceived(QByteArray data);
-    void clientConnected(QString clientIp);
-    void clientDisconnected();
+    void clientConnected(int clientId, QString clientIp);
+    void clientDisconnected(int clientId);
     void serverError(QString message);
     void statusChanged(QString message);
 
@@ -51,14 +69,12 @@ signals:
 
 private slots:
     void onBeaconReceived();
-    void onNewTcpConnection();
-    void onTcpDataReady();
-    void onTcpClientDisconnected();
 
 private:
     QUdpSocket *m_beaconSocket  = nullptr;
-    QTcpServer *m_tcpServer     = nullptr;
-    QTcpSocket *m_clientSocket  = nullptr;
+    std::unique_ptr<IngestReactor> m_reactor;
+    SessionFactory m_sessionFactory;
+    SessionRelease m_sessionRelease;
     bool        m_running       = false;
 
     bool startTcpServer();